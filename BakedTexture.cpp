@@ -0,0 +1,338 @@
+#include "BakedTexture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <stb_image.h>
+
+#include "BlockCompression.h"
+
+static const char BakedTextureMagic[4] = { 'B', 'T', 'E', 'X' };
+static const uint32_t BakedTextureVersion = 1;
+
+/// <summary>
+/// Halves an RGBA8 image by averaging each 2x2 square of pixels. Odd rows and columns at the edge are repeated.
+/// A side whose half size is the same as its full size (a side that is already 1 pixel long, or one that
+/// ResizeImage() does not need to halve) is kept as is.
+/// </summary>
+/// <param name="pixels">RGBA8 pixels of the larger image</param>
+/// <param name="width">Width of the larger image</param>
+/// <param name="height">Height of the larger image</param>
+/// <param name="halfWidth">Width of the smaller image</param>
+/// <param name="halfHeight">Height of the smaller image</param>
+/// <returns>RGBA8 pixels of the smaller image</returns>
+static std::vector<unsigned char> DownsampleImage(const std::vector<unsigned char>& pixels, int width, int height, int halfWidth, int halfHeight)
+{
+	int stepX = halfWidth < width ? 2 : 1;
+	int stepY = halfHeight < height ? 2 : 1;
+
+	std::vector<unsigned char> half(static_cast<size_t>(halfWidth) * halfHeight * 4);
+	for (int y = 0; y < halfHeight; ++y)
+	{
+		int y0 = std::min(y * stepY, height - 1);
+		int y1 = std::min(y * stepY + stepY - 1, height - 1);
+		for (int x = 0; x < halfWidth; ++x)
+		{
+			int x0 = std::min(x * stepX, width - 1);
+			int x1 = std::min(x * stepX + stepX - 1, width - 1);
+			for (int c = 0; c < 4; ++c)
+			{
+				int sum = pixels[(static_cast<size_t>(y0) * width + x0) * 4 + c] + pixels[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+					+ pixels[(static_cast<size_t>(y1) * width + x0) * 4 + c] + pixels[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+				half[(static_cast<size_t>(y) * halfWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+	return half;
+}
+
+/// <summary>
+/// Resizes an RGBA8 image. It is first halved while it is at least twice as large as the new size,
+/// and the rest of the way is sampled bilinearly, so that no source pixels are skipped.
+/// </summary>
+/// <param name="pixels">RGBA8 pixels</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="newWidth">Width of the resized image</param>
+/// <param name="newHeight">Height of the resized image</param>
+/// <returns>RGBA8 pixels of the resized image</returns>
+static std::vector<unsigned char> ResizeImage(std::vector<unsigned char> pixels, int width, int height, int newWidth, int newHeight)
+{
+	while (width >= newWidth * 2 || height >= newHeight * 2)
+	{
+		int halfWidth = width >= newWidth * 2 ? width / 2 : width;
+		int halfHeight = height >= newHeight * 2 ? height / 2 : height;
+		pixels = DownsampleImage(pixels, width, height, halfWidth, halfHeight);
+		width = halfWidth;
+		height = halfHeight;
+	}
+
+	if (width == newWidth && height == newHeight)
+	{
+		return pixels;
+	}
+
+	std::vector<unsigned char> resized(static_cast<size_t>(newWidth) * newHeight * 4);
+	for (int y = 0; y < newHeight; ++y)
+	{
+		// Pixel centers of the new image, in pixels of the old one
+		float sourceY = std::max((y + 0.5f) * height / newHeight - 0.5f, 0.0f);
+		int y0 = std::min(static_cast<int>(sourceY), height - 1);
+		int y1 = std::min(y0 + 1, height - 1);
+		float fy = sourceY - y0;
+		for (int x = 0; x < newWidth; ++x)
+		{
+			float sourceX = std::max((x + 0.5f) * width / newWidth - 0.5f, 0.0f);
+			int x0 = std::min(static_cast<int>(sourceX), width - 1);
+			int x1 = std::min(x0 + 1, width - 1);
+			float fx = sourceX - x0;
+			for (int c = 0; c < 4; ++c)
+			{
+				float top = pixels[(static_cast<size_t>(y0) * width + x0) * 4 + c] * (1.0f - fx) + pixels[(static_cast<size_t>(y0) * width + x1) * 4 + c] * fx;
+				float bottom = pixels[(static_cast<size_t>(y1) * width + x0) * 4 + c] * (1.0f - fx) + pixels[(static_cast<size_t>(y1) * width + x1) * 4 + c] * fx;
+				resized[(static_cast<size_t>(y) * newWidth + x) * 4 + c] = static_cast<unsigned char>(top * (1.0f - fy) + bottom * fy + 0.5f);
+			}
+		}
+	}
+	return resized;
+}
+
+/// <summary>
+/// Gets the path of the baked version of an image file (the same name with the extension replaced by .btex).
+/// </summary>
+/// <param name="imageFilePath">Path of the source image</param>
+/// <returns>Path of the baked texture</returns>
+std::string GetBakedTexturePath(const std::string& imageFilePath)
+{
+	size_t extension = imageFilePath.find_last_of('.');
+	size_t directory = imageFilePath.find_last_of("/\\");
+	if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+	{
+		return imageFilePath + ".btex";
+	}
+	return imageFilePath.substr(0, extension) + ".btex";
+}
+
+/// <summary>
+/// Gets the number of mip levels of a full mip chain, down to 1x1.
+/// </summary>
+/// <param name="width">Width of level 0</param>
+/// <param name="height">Height of level 0</param>
+/// <returns>Number of levels</returns>
+int GetMipLevelCount(int width, int height)
+{
+	int levelCount = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+		++levelCount;
+	}
+	return levelCount;
+}
+
+/// <summary>
+/// Gets the size of one level in the given format.
+/// </summary>
+/// <param name="format">Pixel format</param>
+/// <param name="width">Width of the level</param>
+/// <param name="height">Height of the level</param>
+/// <returns>Size in bytes</returns>
+size_t GetLevelSize(BakedTextureFormat format, int width, int height)
+{
+	switch (format)
+	{
+	case BakedBC1:
+		return GetCompressedImageSize(width, height, 8);
+	case BakedBC3:
+		return GetCompressedImageSize(width, height, 16);
+	default:
+		return static_cast<size_t>(width) * height * 4;
+	}
+}
+
+/// <summary>
+/// Decodes an image into RGBA8, resizes it, builds its full mip chain and converts every level to the given format.
+/// </summary>
+/// <param name="imageFilePath">Path of the source image</param>
+/// <param name="swapRedBlue">Whether to swap the red and blue channels (for images that are uploaded as BGRA)</param>
+/// <param name="format">Format of the levels</param>
+/// <param name="width">Width of level 0</param>
+/// <param name="height">Height of level 0</param>
+/// <param name="data">Receives the pixels of every level, back to back</param>
+/// <param name="levels">Receives the size and position of every level; offsets are relative to the start of data</param>
+/// <returns>True if the image was decoded, false otherwise</returns>
+bool LoadImageLevels(const std::string& imageFilePath, bool swapRedBlue, BakedTextureFormat format, int width, int height,
+	std::vector<unsigned char>& data, std::vector<BakedTextureLevel>& levels)
+{
+	int imageWidth, imageHeight, numChannels;
+	unsigned char* imageData = stbi_load(imageFilePath.c_str(), &imageWidth, &imageHeight, &numChannels, 4);
+	if (imageData == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> pixels(imageData, imageData + static_cast<size_t>(imageWidth) * imageHeight * 4);
+	stbi_image_free(imageData);
+
+	if (swapRedBlue)
+	{
+		for (size_t i = 0; i < pixels.size(); i += 4)
+		{
+			std::swap(pixels[i], pixels[i + 2]);
+		}
+	}
+
+	// UVs are normalized, so stretching the image to the requested size does not change how it maps onto a mesh
+	pixels = ResizeImage(std::move(pixels), imageWidth, imageHeight, width, height);
+
+	// Build every mip level down to 1x1, each starting on a 16-byte boundary
+	data.clear();
+	levels.clear();
+	int levelWidth = width;
+	int levelHeight = height;
+	for (;;)
+	{
+		data.resize((data.size() + 15) & ~static_cast<size_t>(15));
+		size_t offset = data.size();
+		if (format == BakedBC1)
+		{
+			CompressBC1(pixels.data(), levelWidth, levelHeight, data);
+		}
+		else if (format == BakedBC3)
+		{
+			CompressBC3(pixels.data(), levelWidth, levelHeight, data);
+		}
+		else
+		{
+			data.insert(data.end(), pixels.begin(), pixels.end());
+		}
+
+		levels.push_back({ static_cast<uint32_t>(levelWidth), static_cast<uint32_t>(levelHeight), static_cast<uint32_t>(offset), static_cast<uint32_t>(data.size() - offset) });
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+
+		int halfWidth = std::max(levelWidth / 2, 1);
+		int halfHeight = std::max(levelHeight / 2, 1);
+		pixels = DownsampleImage(pixels, levelWidth, levelHeight, halfWidth, halfHeight);
+		levelWidth = halfWidth;
+		levelHeight = halfHeight;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Turns an image into a baked texture file that can be uploaded to the GPU as is (see LoadImageLevels()).
+/// </summary>
+/// <param name="imageFilePath">Path of the source image</param>
+/// <param name="bakedFilePath">Path of the baked texture that will be written</param>
+/// <param name="swapRedBlue">Whether to swap the red and blue channels (for images that are uploaded as BGRA)</param>
+/// <param name="format">Format of the stored pixels</param>
+/// <param name="width">Width of level 0 (the image is resized to it)</param>
+/// <param name="height">Height of level 0 (the image is resized to it)</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool BakeTexture(const std::string& imageFilePath, const std::string& bakedFilePath, bool swapRedBlue, BakedTextureFormat format, int width, int height)
+{
+	// Store the rows bottom to top, the same way the runtime loader flips them, so they can be uploaded as is
+	stbi_set_flip_vertically_on_load(true);
+
+	std::vector<unsigned char> data;
+	std::vector<BakedTextureLevel> levels;
+	if (!LoadImageLevels(imageFilePath, swapRedBlue, format, width, height, data, levels))
+	{
+		std::cerr << "Failed to load image: " << imageFilePath << std::endl;
+		return false;
+	}
+
+	BakedTextureHeader header;
+	std::memcpy(header.magic, BakedTextureMagic, sizeof(header.magic));
+	header.version = BakedTextureVersion;
+	header.format = format;
+	header.width = width;
+	header.height = height;
+	header.levelCount = static_cast<uint32_t>(levels.size());
+
+	// The level data follows the header and level table, starting on a 16-byte boundary
+	size_t tableEnd = sizeof(BakedTextureHeader) + levels.size() * sizeof(BakedTextureLevel);
+	size_t dataStart = (tableEnd + 15) & ~static_cast<size_t>(15);
+	for (BakedTextureLevel& level : levels)
+	{
+		level.offset += static_cast<uint32_t>(dataStart);
+	}
+
+	FILE* file = std::fopen(bakedFilePath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		std::cerr << "Unable to open baked texture for writing: " << bakedFilePath << std::endl;
+		return false;
+	}
+
+	static const unsigned char padding[16] = {};
+	std::fwrite(&header, sizeof(header), 1, file);
+	std::fwrite(levels.data(), sizeof(BakedTextureLevel), levels.size(), file);
+	std::fwrite(padding, 1, dataStart - tableEnd, file);
+	std::fwrite(data.data(), 1, data.size(), file);
+
+	bool written = std::ferror(file) == 0;
+	std::fclose(file);
+	return written;
+}
+
+/// <summary>
+/// Checks that the contents of a baked texture file are complete and form a consistent mip chain, and finds its mip levels.
+/// </summary>
+/// <param name="data">Contents of the file</param>
+/// <param name="size">Size of the file in bytes</param>
+/// <param name="header">Receives a pointer to the header inside the data</param>
+/// <param name="levels">Receives a pointer to the mip level table inside the data</param>
+/// <returns>True if the file is a valid baked texture, false otherwise</returns>
+bool ReadBakedTexture(const unsigned char* data, size_t size, const BakedTextureHeader*& header, const BakedTextureLevel*& levels)
+{
+	if (size < sizeof(BakedTextureHeader))
+	{
+		return false;
+	}
+
+	header = reinterpret_cast<const BakedTextureHeader*>(data);
+	if (std::memcmp(header->magic, BakedTextureMagic, sizeof(header->magic)) != 0 || header->version != BakedTextureVersion
+		|| header->format >= BakedTextureFormatCount || header->levelCount == 0 || header->levelCount > 32
+		|| size < sizeof(BakedTextureHeader) + header->levelCount * sizeof(BakedTextureLevel))
+	{
+		return false;
+	}
+
+	// Dimensions beyond the largest OpenGL texture would overflow the level sizes
+	if (header->width == 0 || header->height == 0 || header->width > 65536 || header->height > 65536)
+	{
+		return false;
+	}
+
+	// Every level must halve the one before it, hold exactly its pixels and lie after it, inside the file
+	levels = reinterpret_cast<const BakedTextureLevel*>(data + sizeof(BakedTextureHeader));
+	uint32_t width = header->width;
+	uint32_t height = header->height;
+	size_t levelStart = sizeof(BakedTextureHeader) + header->levelCount * sizeof(BakedTextureLevel);
+	for (uint32_t i = 0; i < header->levelCount; ++i)
+	{
+		const BakedTextureLevel& level = levels[i];
+		if (level.width != width || level.height != height
+			|| level.size != GetLevelSize(static_cast<BakedTextureFormat>(header->format), static_cast<int>(width), static_cast<int>(height))
+			|| level.offset < levelStart || static_cast<size_t>(level.offset) + level.size > size)
+		{
+			return false;
+		}
+
+		levelStart = static_cast<size_t>(level.offset) + level.size;
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+
+	return true;
+}
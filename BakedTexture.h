@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Pixel formats that a baked texture can be stored in
+/// </summary>
+enum BakedTextureFormat
+{
+	BakedRGBA8,			// Uncompressed, 4 bytes per pixel
+	BakedBC1,			// DXT1, 8 bytes per 4x4 block (no alpha)
+	BakedBC3,			// DXT5, 16 bytes per 4x4 block
+	BakedTextureFormatCount
+};
+
+/// <summary>
+/// Header at the start of a baked texture file (.btex). All values are little-endian.
+/// The header is followed by one BakedTextureLevel per mip level and then the pixel data of every level.
+/// </summary>
+struct BakedTextureHeader
+{
+	char magic[4];				// "BTEX"
+	uint32_t version;
+	uint32_t format;			// BakedTextureFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;		// Full mip chain, down to 1x1
+};
+
+/// <summary>
+/// Struct describing where the pixels of one mip level are stored in a baked texture file
+/// </summary>
+struct BakedTextureLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t offset;			// Offset of the pixels from the start of the file (16-byte aligned)
+	uint32_t size;				// Size of the pixels in bytes
+};
+
+/// <summary>
+/// Gets the path of the baked version of an image file (the same name with the extension replaced by .btex).
+/// </summary>
+/// <param name="imageFilePath">Path of the source image</param>
+/// <returns>Path of the baked texture</returns>
+std::string GetBakedTexturePath(const std::string& imageFilePath);
+
+/// <summary>
+/// Decodes an image into RGBA8, resizes it, builds its full mip chain and converts every level to the given format.
+/// </summary>
+/// <param name="imageFilePath">Path of the source image</param>
+/// <param name="swapRedBlue">Whether to swap the red and blue channels (for images that are uploaded as BGRA)</param>
+/// <param name="format">Format of the levels</param>
+/// <param name="width">Width of level 0</param>
+/// <param name="height">Height of level 0</param>
+/// <param name="data">Receives the pixels of every level, back to back</param>
+/// <param name="levels">Receives the size and position of every level; offsets are relative to the start of data</param>
+/// <returns>True if the image was decoded, false otherwise</returns>
+bool LoadImageLevels(const std::string& imageFilePath, bool swapRedBlue, BakedTextureFormat format, int width, int height,
+	std::vector<unsigned char>& data, std::vector<BakedTextureLevel>& levels);
+
+/// <summary>
+/// Turns an image into a baked texture file that can be uploaded to the GPU as is (see LoadImageLevels()).
+/// </summary>
+/// <param name="imageFilePath">Path of the source image</param>
+/// <param name="bakedFilePath">Path of the baked texture that will be written</param>
+/// <param name="swapRedBlue">Whether to swap the red and blue channels (for images that are uploaded as BGRA)</param>
+/// <param name="format">Format of the stored pixels</param>
+/// <param name="width">Width of level 0 (the image is resized to it)</param>
+/// <param name="height">Height of level 0 (the image is resized to it)</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool BakeTexture(const std::string& imageFilePath, const std::string& bakedFilePath, bool swapRedBlue, BakedTextureFormat format, int width, int height);
+
+/// <summary>
+/// Gets the number of mip levels of a full mip chain, down to 1x1.
+/// </summary>
+/// <param name="width">Width of level 0</param>
+/// <param name="height">Height of level 0</param>
+/// <returns>Number of levels</returns>
+int GetMipLevelCount(int width, int height);
+
+/// <summary>
+/// Gets the size of one level in the given format.
+/// </summary>
+/// <param name="format">Pixel format</param>
+/// <param name="width">Width of the level</param>
+/// <param name="height">Height of the level</param>
+/// <returns>Size in bytes</returns>
+size_t GetLevelSize(BakedTextureFormat format, int width, int height);
+
+/// <summary>
+/// Checks that the contents of a baked texture file are complete and form a consistent mip chain, and finds its mip levels.
+/// </summary>
+/// <param name="data">Contents of the file</param>
+/// <param name="size">Size of the file in bytes</param>
+/// <param name="header">Receives a pointer to the header inside the data</param>
+/// <param name="levels">Receives a pointer to the mip level table inside the data</param>
+/// <returns>True if the file is a valid baked texture, false otherwise</returns>
+bool ReadBakedTexture(const unsigned char* data, size_t size, const BakedTextureHeader*& header, const BakedTextureLevel*& levels);
@@ -0,0 +1,544 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/// <summary>
+/// Images of the room, in the order room.scene lists them. Generated materials use them in turn.
+/// </summary>
+static const char* const BenchmarkImages[] = { "RoomTexture.png", "metal2.JPG", "metal.JPG", "metal4.JPG", "metal5.jpg", "dice.jpg", "pepe.jpg" };
+static const int BenchmarkImageCount = 7;
+
+/// <summary>
+/// Distance between the centers of neighboring rooms (the rooms themselves are 4 units wide)
+/// </summary>
+static const float BenchmarkRoomSpacing = 4.5f;
+
+/// <summary>
+/// Struct containing one object of the room, as room.scene places it
+/// </summary>
+struct BenchmarkRoomPart
+{
+	MeshType mesh;
+	int material;				// Material in room.scene; every room shifts it by one
+	glm::vec3 position;
+	glm::vec3 scale;
+	float rotationSpeed;		// Degrees per unit of time around the y axis
+};
+
+/// <summary>
+/// The room, the table, two chairs and the light bulb
+/// </summary>
+static const BenchmarkRoomPart BenchmarkRoom[] =
+{
+	{ MeshCube, 0, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(4.0f, 4.0f, 4.0f), 0.0f },
+	{ MeshCube, 1, glm::vec3(0.0f, -1.5f, 0.0f), glm::vec3(1.75f, 0.75f, 1.0f), 0.0f },
+	{ MeshCube, 1, glm::vec3(0.0f, -1.75f, 1.0f), glm::vec3(0.5f, 0.5f, 0.5f), 0.0f },
+	{ MeshCube, 1, glm::vec3(0.0f, -1.75f, -1.0f), glm::vec3(0.5f, 0.5f, 0.5f), 0.0f },
+	{ MeshOctahedron, 1, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.75f, 0.75f, 0.75f), 1.0f }
+};
+static const int BenchmarkRoomPartCount = 5;
+
+/// <summary>
+/// Colors that the point lights take in turn
+/// </summary>
+static const glm::vec3 BenchmarkLightColors[] =
+{
+	glm::vec3(1.0f, 0.6f, 0.3f), glm::vec3(0.3f, 0.6f, 1.0f), glm::vec3(0.4f, 1.0f, 0.4f), glm::vec3(1.0f, 0.3f, 0.8f)
+};
+
+/// <summary>
+/// Gets the configurations of a benchmark suite. Every suite starts from a base configuration and varies one
+/// parameter at a time: object count, texture count, light count and resolution.
+/// </summary>
+/// <param name="suite">"quick" or "full"</param>
+/// <returns>Configurations, or none if the suite does not exist</returns>
+std::vector<BenchmarkConfig> GetBenchmarkSuite(const std::string& suite)
+{
+	// The room with 7 textures and a few lights; the layers are kept small so that large texture counts fit in memory
+	const BenchmarkConfig base = { 1000, 7, 16, 800, 800, 512 };
+
+	std::vector<int> objectCounts, textureCounts, lightCounts;
+	std::vector<std::pair<int, int>> resolutions;
+	if (suite == "quick")
+	{
+		objectCounts = { 10, 1000, 10000 };
+		textureCounts = { 1, 32 };
+		lightCounts = { 0, 128 };
+		resolutions = { { 1280, 720 } };
+	}
+	else if (suite == "full")
+	{
+		objectCounts = { 10, 100, 1000, 10000, 100000, 1000000 };
+		textureCounts = { 1, 32, 128 };
+		lightCounts = { 0, 128, 1024 };
+		resolutions = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	}
+	else
+	{
+		return {};
+	}
+
+	std::vector<BenchmarkConfig> configs;
+	for (int objectCount : objectCounts)
+	{
+		BenchmarkConfig config = base;
+		config.objectCount = objectCount;
+		configs.push_back(config);
+	}
+	for (int textureCount : textureCounts)
+	{
+		BenchmarkConfig config = base;
+		config.textureCount = textureCount;
+		configs.push_back(config);
+	}
+	for (int lightCount : lightCounts)
+	{
+		BenchmarkConfig config = base;
+		config.lightCount = lightCount;
+		configs.push_back(config);
+	}
+	for (const std::pair<int, int>& resolution : resolutions)
+	{
+		BenchmarkConfig config = base;
+		config.width = resolution.first;
+		config.height = resolution.second;
+		configs.push_back(config);
+	}
+
+	// The base configuration appears in every sweep that contains its value, but only needs to run once
+	std::vector<BenchmarkConfig> unique;
+	for (const BenchmarkConfig& config : configs)
+	{
+		bool seen = std::any_of(unique.begin(), unique.end(), [&config](const BenchmarkConfig& other)
+		{
+			return GetBenchmarkName(other) == GetBenchmarkName(config);
+		});
+		if (!seen)
+		{
+			unique.push_back(config);
+		}
+	}
+	return unique;
+}
+
+/// <summary>
+/// Gets the configuration that a benchmark run was started with (see --benchmark-scene).
+/// </summary>
+/// <param name="options">Command line options</param>
+/// <returns>Configuration</returns>
+BenchmarkConfig GetBenchmarkConfig(const AppOptions& options)
+{
+	return { options.benchmarkObjects, options.benchmarkTextures, options.benchmarkLights, options.width, options.height, options.materialSize };
+}
+
+/// <summary>
+/// Gets the name that identifies a configuration in the results and the baseline.
+/// </summary>
+/// <param name="config">Configuration</param>
+/// <returns>Name such as "o1000-t7-l16-800x800"</returns>
+std::string GetBenchmarkName(const BenchmarkConfig& config)
+{
+	char name[96];
+	std::snprintf(name, sizeof(name), "o%d-t%d-l%d-%dx%d", config.objectCount, config.textureCount, config.lightCount, config.width, config.height);
+	return name;
+}
+
+/// <summary>
+/// Builds a scene of rooms like room.scene, laid out on a grid in front of the camera. The last room is cut short
+/// when the object count is not a multiple of five. Materials use the room's images in turn, and the point lights
+/// hang next to the bulbs of the first rooms.
+/// </summary>
+/// <param name="config">Configuration</param>
+/// <param name="materials">Receives the materials</param>
+/// <param name="objects">Receives the objects, grouped by mesh</param>
+/// <param name="lights">Receives the point lights</param>
+void GenerateBenchmarkScene(const BenchmarkConfig& config, std::vector<SceneMaterial>& materials, std::vector<SceneObject>& objects,
+	std::vector<ScenePointLight>& lights)
+{
+	materials.clear();
+	objects.clear();
+	lights.clear();
+
+	int textureCount = std::max(config.textureCount, 1);
+	for (int i = 0; i < textureCount; ++i)
+	{
+		// RoomTexture.png has always been uploaded with red and blue swapped
+		int image = i % BenchmarkImageCount;
+		materials.push_back({ BenchmarkImages[image], image == 0, true, true });
+	}
+
+	// Room 0 is where room.scene puts the room, around the camera. The others fill rows that lead away from it,
+	// alternating to the right and the left of the middle
+	int roomCount = (config.objectCount + BenchmarkRoomPartCount - 1) / BenchmarkRoomPartCount;
+	int columns = std::max(static_cast<int>(std::ceil(std::sqrt(static_cast<double>(roomCount)))), 1);
+	std::vector<glm::vec3> roomCenters;
+	objects.reserve(config.objectCount);
+	for (int room = 0; room < roomCount; ++room)
+	{
+		int column = room % columns;
+		int row = room / columns;
+		float side = (column % 2 == 1 ? 1.0f : -1.0f) * static_cast<float>((column + 1) / 2);
+		glm::vec3 center(side * BenchmarkRoomSpacing, 0.0f, -row * BenchmarkRoomSpacing);
+		roomCenters.push_back(center);
+
+		for (int part = 0; part < BenchmarkRoomPartCount && static_cast<int>(objects.size()) < config.objectCount; ++part)
+		{
+			const BenchmarkRoomPart& roomPart = BenchmarkRoom[part];
+			SceneObject object;
+			object.mesh = roomPart.mesh;
+			object.material = static_cast<GLuint>((roomPart.material + room) % textureCount);
+			object.position = center + roomPart.position;
+			object.scale = roomPart.scale;
+			object.rotationAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+			object.rotationSpeed = roomPart.rotationSpeed;
+			objects.push_back(object);
+		}
+	}
+
+	// Loaded scenes come grouped by mesh, which instanced drawing relies on
+	std::stable_sort(objects.begin(), objects.end(), [](const SceneObject& a, const SceneObject& b) { return a.mesh < b.mesh; });
+
+	// Lights circle the bulbs of the first rooms; once every room has one, the next round goes further out
+	for (int i = 0; i < config.lightCount && !roomCenters.empty(); ++i)
+	{
+		int room = i % static_cast<int>(roomCenters.size());
+		int round = i / static_cast<int>(roomCenters.size());
+		float angle = round * 2.39996f;
+		float distance = 0.8f + 0.1f * (round % 8);
+		glm::vec3 position = roomCenters[room] + glm::vec3(std::cos(angle) * distance, 0.5f, std::sin(angle) * distance);
+		lights.push_back({ position, BenchmarkLightColors[i % 4], 2.0f });
+	}
+}
+
+/// <summary>
+/// Moves the camera along the fixed path of the benchmark: forward through the first room while looking from one
+/// side to the other, so that every run sees the same views.
+/// </summary>
+/// <param name="state">Simulation state whose camera is replaced</param>
+/// <param name="frameIndex">Frame</param>
+/// <param name="frameCount">Frames of the run</param>
+void SetBenchmarkCamera(SimulationState& state, int frameIndex, int frameCount)
+{
+	float progress = frameCount > 1 ? static_cast<float>(frameIndex) / (frameCount - 1) : 0.0f;
+	float z = 1.5f - 2.5f * progress;
+	float angle = std::sin(progress * 6.2831853f) * 1.0f;
+
+	state.cameraMoveLeftRight = 0.0f;
+	state.cameraMoveForwardBackward = z;
+	state.cameraLookLeftRight = std::sin(angle);
+	state.cameraLookUpDown = 0.0f;
+	state.cameraLookForwardBackward = z - std::cos(angle);
+}
+
+/// <summary>
+/// Gets the most memory that the process has had resident so far.
+/// </summary>
+/// <returns>Megabytes</returns>
+double GetPeakMemoryMegabytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0.0;
+	}
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0.0;
+	}
+#if defined(__APPLE__)
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+/// <summary>
+/// Fills in the frame times of a result from the frames of a run, leaving out the warm-up frames.
+/// </summary>
+/// <param name="result">Result</param>
+/// <param name="frameMilliseconds">Time of every frame of the run</param>
+void SetBenchmarkFrameTimes(BenchmarkResult& result, const std::vector<double>& frameMilliseconds)
+{
+	// Runs that are too short to leave anything after the warm-up are measured whole
+	size_t first = frameMilliseconds.size() > static_cast<size_t>(BenchmarkWarmupFrames) ? BenchmarkWarmupFrames : 0;
+	std::vector<double> samples(frameMilliseconds.begin() + first, frameMilliseconds.end());
+	result.frameCount = static_cast<int>(samples.size());
+	if (samples.empty())
+	{
+		result.cpuFrameMilliseconds = 0.0;
+		result.cpuFrameP95Milliseconds = 0.0;
+		return;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	result.cpuFrameMilliseconds = samples[static_cast<size_t>(0.5 * (samples.size() - 1) + 0.5)];
+	result.cpuFrameP95Milliseconds = samples[static_cast<size_t>(0.95 * (samples.size() - 1) + 0.5)];
+}
+
+/// <summary>
+/// Appends a result to a JSON Lines file (one JSON object per line).
+/// </summary>
+/// <param name="filePath">Path of the file</param>
+/// <param name="result">Result</param>
+/// <returns>True if the result was written, false otherwise</returns>
+bool AppendBenchmarkResult(const std::string& filePath, const BenchmarkResult& result)
+{
+	FILE* file = std::fopen(filePath.c_str(), "a");
+	if (file == nullptr)
+	{
+		std::cerr << "Failed to write benchmark result: " << filePath << std::endl;
+		return false;
+	}
+
+	const BenchmarkConfig& config = result.config;
+	std::fprintf(file, "{\"name\":\"%s\",\"objects\":%d,\"textures\":%d,\"lights\":%d,\"width\":%d,\"height\":%d,\"materialSize\":%d,"
+		"\"frames\":%d,\"cpuFrameMs\":%.4f,\"cpuFrameP95Ms\":%.4f,\"gpuFrameMs\":%.4f,\"drawCalls\":%.2f,\"peakMemoryMb\":%.2f}\n",
+		result.name.c_str(), config.objectCount, config.textureCount, config.lightCount, config.width, config.height, config.materialSize,
+		result.frameCount, result.cpuFrameMilliseconds, result.cpuFrameP95Milliseconds, result.gpuFrameMilliseconds, result.drawCalls,
+		result.peakMemoryMegabytes);
+	std::fclose(file);
+	return true;
+}
+
+/// <summary>
+/// Reads the value of a key from a line that AppendBenchmarkResult() wrote.
+/// </summary>
+/// <param name="line">Line of the file</param>
+/// <param name="key">Key without quotes</param>
+/// <param name="value">Receives the value as text, without quotes</param>
+/// <returns>True if the line has the key, false otherwise</returns>
+static bool ReadJsonValue(const std::string& line, const std::string& key, std::string& value)
+{
+	size_t start = line.find("\"" + key + "\":");
+	if (start == std::string::npos)
+	{
+		return false;
+	}
+
+	start += key.size() + 3;
+	size_t end = line.find_first_of(",}", start);
+	value = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+	if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+	{
+		value = value.substr(1, value.size() - 2);
+	}
+	return true;
+}
+
+/// <summary>
+/// Reads the results that AppendBenchmarkResult() wrote.
+/// </summary>
+/// <param name="filePath">Path of the file</param>
+/// <param name="results">Receives the results</param>
+/// <returns>True if the file could be read, false otherwise</returns>
+bool ReadBenchmarkResults(const std::string& filePath, std::vector<BenchmarkResult>& results)
+{
+	std::ifstream file(filePath);
+	if (!file)
+	{
+		std::cerr << "Failed to read benchmark results: " << filePath << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		BenchmarkResult result = {};
+		std::string value;
+		if (!ReadJsonValue(line, "name", result.name))
+		{
+			continue;
+		}
+
+		auto readNumber = [&line, &value](const char* key, double fallback)
+		{
+			return ReadJsonValue(line, key, value) ? std::atof(value.c_str()) : fallback;
+		};
+		result.config.objectCount = static_cast<int>(readNumber("objects", 0));
+		result.config.textureCount = static_cast<int>(readNumber("textures", 0));
+		result.config.lightCount = static_cast<int>(readNumber("lights", 0));
+		result.config.width = static_cast<int>(readNumber("width", 0));
+		result.config.height = static_cast<int>(readNumber("height", 0));
+		result.config.materialSize = static_cast<int>(readNumber("materialSize", 0));
+		result.frameCount = static_cast<int>(readNumber("frames", 0));
+		result.cpuFrameMilliseconds = readNumber("cpuFrameMs", 0.0);
+		result.cpuFrameP95Milliseconds = readNumber("cpuFrameP95Ms", 0.0);
+		result.gpuFrameMilliseconds = readNumber("gpuFrameMs", -1.0);
+		result.drawCalls = readNumber("drawCalls", 0.0);
+		result.peakMemoryMegabytes = readNumber("peakMemoryMb", 0.0);
+		results.push_back(result);
+	}
+	return true;
+}
+
+/// <summary>
+/// Compares results with a baseline and prints every metric that got worse by more than the tolerance.
+/// Configurations that are missing from the baseline are skipped.
+/// </summary>
+/// <param name="results">Results of this run</param>
+/// <param name="baseline">Stored results</param>
+/// <param name="tolerance">Allowed increase as a fraction of the baseline (0.1 is 10%)</param>
+/// <returns>Number of regressed metrics</returns>
+int CompareBenchmarkResults(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline, double tolerance)
+{
+	int regressions = 0;
+	for (const BenchmarkResult& result : results)
+	{
+		auto stored = std::find_if(baseline.begin(), baseline.end(), [&result](const BenchmarkResult& other) { return other.name == result.name; });
+		if (stored == baseline.end())
+		{
+			std::cout << "  " << result.name << ": not in the baseline" << std::endl;
+			continue;
+		}
+
+		// Every metric gets a small absolute allowance as well, so that timer noise on tiny values is not a regression
+		struct { const char* name; double before; double after; double slack; } metrics[] =
+		{
+			{ "cpu frame ms", stored->cpuFrameMilliseconds, result.cpuFrameMilliseconds, 0.1 },
+			{ "gpu frame ms", stored->gpuFrameMilliseconds, result.gpuFrameMilliseconds, 0.1 },
+			{ "draw calls", stored->drawCalls, result.drawCalls, 0.0 },
+			{ "peak memory mb", stored->peakMemoryMegabytes, result.peakMemoryMegabytes, 1.0 }
+		};
+		for (const auto& metric : metrics)
+		{
+			// Negative values were not measured
+			if (metric.before < 0.0 || metric.after < 0.0)
+			{
+				continue;
+			}
+			if (metric.after > metric.before * (1.0 + tolerance) + metric.slack)
+			{
+				std::cout << "  REGRESSION " << result.name << " " << metric.name << ": " << metric.before << " -> " << metric.after
+					<< " (+" << std::fixed << std::setprecision(1) << (metric.before > 0.0 ? (metric.after / metric.before - 1.0) * 100.0 : 100.0)
+					<< "%)" << std::endl;
+				std::cout.unsetf(std::ios::floatfield);
+				std::cout << std::setprecision(6);
+				++regressions;
+			}
+		}
+	}
+	return regressions;
+}
+
+/// <summary>
+/// Puts quotes around a command line argument.
+/// </summary>
+/// <param name="argument">Argument</param>
+/// <returns>Quoted argument</returns>
+static std::string QuoteArgument(const std::string& argument)
+{
+	return "\"" + argument + "\"";
+}
+
+/// <summary>
+/// Runs every configuration of the suite that the options name, each in a headless child process of its own so
+/// that its memory is measured on its own, then writes the results and compares them with the baseline.
+/// </summary>
+/// <param name="programPath">Path of this executable (argv[0])</param>
+/// <param name="options">Command line options; the rendering paths they select are passed on to every run</param>
+/// <returns>Exit code: 0 if every run succeeded and nothing regressed, 1 otherwise</returns>
+int RunBenchmarkSuite(const char* programPath, const AppOptions& options)
+{
+	std::vector<BenchmarkConfig> configs = GetBenchmarkSuite(options.benchmarkSuite);
+	if (configs.empty())
+	{
+		std::cerr << "Unknown benchmark suite: " << options.benchmarkSuite << " (expected quick or full)" << std::endl;
+		return 1;
+	}
+
+	// The runs append to the output, so it starts out empty
+	std::remove(options.benchmarkOutputPath.c_str());
+
+	// Every run draws with the same paths as the suite was asked to
+	std::string pathArguments = options.software ? " --software" : " --headless";
+	pathArguments += options.instancing ? " --instanced" : "";
+	pathArguments += options.gpuDriven ? " --gpu-driven" : "";
+	pathArguments += options.culling ? "" : " --no-culling";
+	pathArguments += options.shadows ? " --shadows" : "";
+	pathArguments += options.occlusion ? " --occlusion" : "";
+	if (options.dynamicResolutionTarget > 0.0f)
+	{
+		pathArguments += " --dynamic-resolution " + std::to_string(options.dynamicResolutionTarget)
+			+ " --resolution-scale " + std::to_string(options.minResolutionScale) + "," + std::to_string(options.maxResolutionScale);
+	}
+	pathArguments += options.useBakedTextures ? "" : " --source-textures";
+	pathArguments += " --transform-threads " + std::to_string(options.transformThreads);
+	pathArguments += " --command-threads " + std::to_string(options.commandThreads);
+	pathArguments += " --software-threads " + std::to_string(options.softwareThreads);
+	pathArguments += " --shader-cache " + (options.shaderCacheDirectory.empty() ? std::string("off") : QuoteArgument(options.shaderCacheDirectory));
+	pathArguments += " --frames " + std::to_string(options.frameCount) + " --fps " + std::to_string(options.simulatedFps);
+
+	int failedRuns = 0;
+	for (size_t i = 0; i < configs.size(); ++i)
+	{
+		const BenchmarkConfig& config = configs[i];
+		std::string name = GetBenchmarkName(config);
+		std::cout << "Benchmark " << i + 1 << "/" << configs.size() << ": " << name << std::endl;
+
+		std::string command = QuoteArgument(programPath) + pathArguments
+			+ " --benchmark-scene " + std::to_string(config.objectCount) + "," + std::to_string(config.textureCount) + "," + std::to_string(config.lightCount)
+			+ " --benchmark-result " + QuoteArgument(options.benchmarkOutputPath)
+			+ " --width " + std::to_string(config.width) + " --height " + std::to_string(config.height)
+			+ " --material-size " + std::to_string(config.materialSize);
+		if (std::system(command.c_str()) != 0)
+		{
+			std::cerr << "Benchmark run failed: " << name << std::endl;
+			++failedRuns;
+		}
+	}
+
+	std::vector<BenchmarkResult> results;
+	ReadBenchmarkResults(options.benchmarkOutputPath, results);
+	std::cout << "Benchmark results (" << options.benchmarkOutputPath << "):" << std::endl;
+	std::cout << "  " << std::left << std::setw(28) << "configuration" << std::right << std::setw(12) << "cpu ms" << std::setw(12) << "cpu p95"
+		<< std::setw(12) << "gpu ms" << std::setw(12) << "draws" << std::setw(12) << "memory mb" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	for (const BenchmarkResult& result : results)
+	{
+		std::cout << "  " << std::left << std::setw(28) << result.name << std::right << std::setw(12) << result.cpuFrameMilliseconds
+			<< std::setw(12) << result.cpuFrameP95Milliseconds << std::setw(12) << result.gpuFrameMilliseconds << std::setw(12) << result.drawCalls
+			<< std::setw(12) << result.peakMemoryMegabytes << std::endl;
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+
+	int regressions = 0;
+	if (!options.benchmarkBaselinePath.empty())
+	{
+		std::vector<BenchmarkResult> baseline;
+		if (!ReadBenchmarkResults(options.benchmarkBaselinePath, baseline))
+		{
+			return 1;
+		}
+
+		std::cout << "Comparing with " << options.benchmarkBaselinePath << " (tolerance " << options.benchmarkTolerance << "%):" << std::endl;
+		regressions = CompareBenchmarkResults(results, baseline, options.benchmarkTolerance / 100.0);
+		std::cout << "  " << regressions << " regressed metrics" << std::endl;
+	}
+
+	if (failedRuns > 0)
+	{
+		std::cerr << failedRuns << " benchmark runs failed" << std::endl;
+	}
+	return failedRuns > 0 || regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Options.h"
+#include "Scene.h"
+#include "Simulation.h"
+
+/// <summary>
+/// Frames at the start of every benchmark run that are left out of the results (first uploads, shader and driver warm-up)
+/// </summary>
+const int BenchmarkWarmupFrames = 5;
+
+/// <summary>
+/// Struct containing one configuration of the benchmark suite: a scene built from copies of the room and the
+/// frame it is drawn into
+/// </summary>
+struct BenchmarkConfig
+{
+	int objectCount;			// Objects of the generated scene (five per room: the room, the table, two chairs and the bulb)
+	int textureCount;			// Materials, each one a layer of the material texture array
+	int lightCount;				// Point lights
+	int width;					// Width of the offscreen framebuffer
+	int height;					// Height of the offscreen framebuffer
+	int materialSize;			// Width and height of every material layer
+};
+
+/// <summary>
+/// Struct containing the measurements of one configuration over the frames after the warm-up
+/// </summary>
+struct BenchmarkResult
+{
+	std::string name;			// Name of the configuration, see GetBenchmarkName()
+	BenchmarkConfig config;
+	int frameCount;				// Frames that were measured
+	double cpuFrameMilliseconds;	// Median frame time on the CPU, including waiting for the GPU to finish
+	double cpuFrameP95Milliseconds;	// 95th percentile of the frame time
+	double gpuFrameMilliseconds;	// Median GPU time of the timed zones (-1 when there are no GPU timers)
+	double drawCalls;			// Draw calls per frame
+	double peakMemoryMegabytes;	// Peak resident memory of the process
+};
+
+/// <summary>
+/// Gets the configurations of a benchmark suite. Every suite starts from a base configuration and varies one
+/// parameter at a time: object count, texture count, light count and resolution.
+/// </summary>
+/// <param name="suite">"quick" or "full"</param>
+/// <returns>Configurations, or none if the suite does not exist</returns>
+std::vector<BenchmarkConfig> GetBenchmarkSuite(const std::string& suite);
+
+/// <summary>
+/// Gets the configuration that a benchmark run was started with (see --benchmark-scene).
+/// </summary>
+/// <param name="options">Command line options</param>
+/// <returns>Configuration</returns>
+BenchmarkConfig GetBenchmarkConfig(const AppOptions& options);
+
+/// <summary>
+/// Gets the name that identifies a configuration in the results and the baseline.
+/// </summary>
+/// <param name="config">Configuration</param>
+/// <returns>Name such as "o1000-t7-l16-800x800"</returns>
+std::string GetBenchmarkName(const BenchmarkConfig& config);
+
+/// <summary>
+/// Builds a scene of rooms like room.scene, laid out on a grid in front of the camera. The last room is cut short
+/// when the object count is not a multiple of five. Materials use the room's images in turn, and the point lights
+/// hang next to the bulbs of the first rooms.
+/// </summary>
+/// <param name="config">Configuration</param>
+/// <param name="materials">Receives the materials</param>
+/// <param name="objects">Receives the objects, grouped by mesh</param>
+/// <param name="lights">Receives the point lights</param>
+void GenerateBenchmarkScene(const BenchmarkConfig& config, std::vector<SceneMaterial>& materials, std::vector<SceneObject>& objects,
+	std::vector<ScenePointLight>& lights);
+
+/// <summary>
+/// Moves the camera along the fixed path of the benchmark: forward through the first room while looking from one
+/// side to the other, so that every run sees the same views.
+/// </summary>
+/// <param name="state">Simulation state whose camera is replaced</param>
+/// <param name="frameIndex">Frame</param>
+/// <param name="frameCount">Frames of the run</param>
+void SetBenchmarkCamera(SimulationState& state, int frameIndex, int frameCount);
+
+/// <summary>
+/// Gets the most memory that the process has had resident so far.
+/// </summary>
+/// <returns>Megabytes</returns>
+double GetPeakMemoryMegabytes();
+
+/// <summary>
+/// Fills in the frame times of a result from the frames of a run, leaving out the warm-up frames.
+/// </summary>
+/// <param name="result">Result</param>
+/// <param name="frameMilliseconds">Time of every frame of the run</param>
+void SetBenchmarkFrameTimes(BenchmarkResult& result, const std::vector<double>& frameMilliseconds);
+
+/// <summary>
+/// Appends a result to a JSON Lines file (one JSON object per line).
+/// </summary>
+/// <param name="filePath">Path of the file</param>
+/// <param name="result">Result</param>
+/// <returns>True if the result was written, false otherwise</returns>
+bool AppendBenchmarkResult(const std::string& filePath, const BenchmarkResult& result);
+
+/// <summary>
+/// Reads the results that AppendBenchmarkResult() wrote.
+/// </summary>
+/// <param name="filePath">Path of the file</param>
+/// <param name="results">Receives the results</param>
+/// <returns>True if the file could be read, false otherwise</returns>
+bool ReadBenchmarkResults(const std::string& filePath, std::vector<BenchmarkResult>& results);
+
+/// <summary>
+/// Compares results with a baseline and prints every metric that got worse by more than the tolerance.
+/// Configurations that are missing from the baseline are skipped.
+/// </summary>
+/// <param name="results">Results of this run</param>
+/// <param name="baseline">Stored results</param>
+/// <param name="tolerance">Allowed increase as a fraction of the baseline (0.1 is 10%)</param>
+/// <returns>Number of regressed metrics</returns>
+int CompareBenchmarkResults(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline, double tolerance);
+
+/// <summary>
+/// Runs every configuration of the suite that the options name, each in a headless child process of its own so
+/// that its memory is measured on its own, then writes the results and compares them with the baseline.
+/// </summary>
+/// <param name="programPath">Path of this executable (argv[0])</param>
+/// <param name="options">Command line options; the rendering paths they select are passed on to every run</param>
+/// <returns>Exit code: 0 if every run succeeded and nothing regressed, 1 otherwise</returns>
+int RunBenchmarkSuite(const char* programPath, const AppOptions& options);
@@ -0,0 +1,273 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/// <summary>
+/// Copies a 4x4 block of pixels. Blocks that stick out of the image repeat the pixels at its edge.
+/// </summary>
+/// <param name="pixels">RGBA8 pixels</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="blockX">Left pixel column of the block</param>
+/// <param name="blockY">First pixel row of the block</param>
+/// <param name="block">Receives the 16 pixels of the block, row by row</param>
+static void ReadBlock(const unsigned char* pixels, int width, int height, int blockX, int blockY, unsigned char block[16][4])
+{
+	for (int y = 0; y < 4; ++y)
+	{
+		for (int x = 0; x < 4; ++x)
+		{
+			int sourceX = std::min(blockX + x, width - 1);
+			int sourceY = std::min(blockY + y, height - 1);
+			const unsigned char* pixel = pixels + (static_cast<size_t>(sourceY) * width + sourceX) * 4;
+			std::copy(pixel, pixel + 4, block[y * 4 + x]);
+		}
+	}
+}
+
+/// <summary>
+/// Packs an 8-bit-per-channel color into 5:6:5 bits.
+/// </summary>
+/// <param name="color">Red, green and blue from 0 to 255</param>
+/// <returns>Packed color</returns>
+static uint16_t PackColor565(const float color[3])
+{
+	int r = static_cast<int>(std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f));
+	int g = static_cast<int>(std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f));
+	int b = static_cast<int>(std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+/// <summary>
+/// Expands a 5:6:5 color back to 8 bits per channel, the same way the GPU does.
+/// </summary>
+/// <param name="packed">Packed color</param>
+/// <param name="color">Receives red, green and blue from 0 to 255</param>
+static void UnpackColor565(uint16_t packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+/// <summary>
+/// Writes a BC1 color block. The endpoints are the extremes of the pixels along their principal axis,
+/// and every pixel picks the closest of the four colors that the GPU interpolates between them.
+/// </summary>
+/// <param name="block">16 RGBA8 pixels</param>
+/// <param name="output">Receives 8 bytes</param>
+static void EncodeColorBlock(const unsigned char block[16][4], unsigned char* output)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			mean[c] += block[i][c] / 16.0f;
+		}
+	}
+
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i)
+	{
+		float r = block[i][0] - mean[0];
+		float g = block[i][1] - mean[1];
+		float b = block[i][2] - mean[2];
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	// A few power iterations are enough to find the direction in which the colors vary the most
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 4; ++iteration)
+	{
+		float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+		if (length <= 0.0f)
+		{
+			break;
+		}
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	float minProjection = 0.0f;
+	float maxProjection = 0.0f;
+	float axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	for (int i = 0; i < 16; ++i)
+	{
+		float projection = ((block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2]) / axisLengthSquared;
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	float maxEndpoint[3], minEndpoint[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		maxEndpoint[c] = mean[c] + axis[c] * maxProjection;
+		minEndpoint[c] = mean[c] + axis[c] * minProjection;
+	}
+
+	// The first endpoint has to be the larger one, otherwise the block is decoded in 3-color mode
+	uint16_t color0 = PackColor565(maxEndpoint);
+	uint16_t color1 = PackColor565(minEndpoint);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	int palette[4][3];
+	UnpackColor565(color0, palette[0]);
+	UnpackColor565(color1, palette[1]);
+	for (int c = 0; c < 3; ++c)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			int bestIndex = 0;
+			int bestDistance = 1 << 30;
+			for (int p = 0; p < 4; ++p)
+			{
+				int r = block[i][0] - palette[p][0];
+				int g = block[i][1] - palette[p][1];
+				int b = block[i][2] - palette[p][2];
+				int distance = r * r + g * g + b * b;
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = p;
+				}
+			}
+			indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+		}
+	}
+
+	output[0] = color0 & 0xFF;
+	output[1] = color0 >> 8;
+	output[2] = color1 & 0xFF;
+	output[3] = color1 >> 8;
+	for (int i = 0; i < 4; ++i)
+	{
+		output[4 + i] = (indices >> (i * 8)) & 0xFF;
+	}
+}
+
+/// <summary>
+/// Writes a BC3 alpha block: the smallest and largest alpha of the block with 3-bit indices into
+/// the eight values that the GPU interpolates between them.
+/// </summary>
+/// <param name="block">16 RGBA8 pixels</param>
+/// <param name="output">Receives 8 bytes</param>
+static void EncodeAlphaBlock(const unsigned char block[16][4], unsigned char* output)
+{
+	int alpha0 = 0;
+	int alpha1 = 255;
+	for (int i = 0; i < 16; ++i)
+	{
+		alpha0 = std::max(alpha0, static_cast<int>(block[i][3]));
+		alpha1 = std::min(alpha1, static_cast<int>(block[i][3]));
+	}
+
+	int palette[8] = { alpha0, alpha1 };
+	for (int p = 2; p < 8; ++p)
+	{
+		palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+	}
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			int bestIndex = 0;
+			for (int p = 1; p < 8; ++p)
+			{
+				if (std::abs(block[i][3] - palette[p]) < std::abs(block[i][3] - palette[bestIndex]))
+				{
+					bestIndex = p;
+				}
+			}
+			indices |= static_cast<uint64_t>(bestIndex) << (i * 3);
+		}
+	}
+
+	output[0] = static_cast<unsigned char>(alpha0);
+	output[1] = static_cast<unsigned char>(alpha1);
+	for (int i = 0; i < 6; ++i)
+	{
+		output[2 + i] = (indices >> (i * 8)) & 0xFF;
+	}
+}
+
+/// <summary>
+/// Gets the number of bytes that an image takes up when it is block compressed.
+/// </summary>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="blockSize">Bytes per 4x4 block (8 for BC1, 16 for BC3)</param>
+/// <returns>Size of the compressed image in bytes</returns>
+size_t GetCompressedImageSize(int width, int height, size_t blockSize)
+{
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+/// <summary>
+/// Compresses RGBA8 pixels into BC1 (DXT1) blocks. Alpha is ignored.
+/// </summary>
+/// <param name="pixels">RGBA8 pixels, rows bottom to top like OpenGL expects them</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="blocks">Receives the compressed blocks (appended)</param>
+void CompressBC1(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& blocks)
+{
+	unsigned char block[16][4];
+	for (int y = 0; y < height; y += 4)
+	{
+		for (int x = 0; x < width; x += 4)
+		{
+			ReadBlock(pixels, width, height, x, y, block);
+			blocks.resize(blocks.size() + 8);
+			EncodeColorBlock(block, &blocks[blocks.size() - 8]);
+		}
+	}
+}
+
+/// <summary>
+/// Compresses RGBA8 pixels into BC3 (DXT5) blocks: an interpolated alpha block followed by a BC1 color block.
+/// </summary>
+/// <param name="pixels">RGBA8 pixels, rows bottom to top like OpenGL expects them</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="blocks">Receives the compressed blocks (appended)</param>
+void CompressBC3(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& blocks)
+{
+	unsigned char block[16][4];
+	for (int y = 0; y < height; y += 4)
+	{
+		for (int x = 0; x < width; x += 4)
+		{
+			ReadBlock(pixels, width, height, x, y, block);
+			blocks.resize(blocks.size() + 16);
+			EncodeAlphaBlock(block, &blocks[blocks.size() - 16]);
+			EncodeColorBlock(block, &blocks[blocks.size() - 8]);
+		}
+	}
+}
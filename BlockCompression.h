@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// Gets the number of bytes that an image takes up when it is block compressed.
+/// </summary>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="blockSize">Bytes per 4x4 block (8 for BC1, 16 for BC3)</param>
+/// <returns>Size of the compressed image in bytes</returns>
+size_t GetCompressedImageSize(int width, int height, size_t blockSize);
+
+/// <summary>
+/// Compresses RGBA8 pixels into BC1 (DXT1) blocks. Alpha is ignored.
+/// </summary>
+/// <param name="pixels">RGBA8 pixels, rows bottom to top like OpenGL expects them</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="blocks">Receives the compressed blocks (appended)</param>
+void CompressBC1(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& blocks);
+
+/// <summary>
+/// Compresses RGBA8 pixels into BC3 (DXT5) blocks: an interpolated alpha block followed by a BC1 color block.
+/// </summary>
+/// <param name="pixels">RGBA8 pixels, rows bottom to top like OpenGL expects them</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="blocks">Receives the compressed blocks (appended)</param>
+void CompressBC3(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& blocks);
@@ -0,0 +1,261 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// <summary>
+/// Creates a buffer and a buffer texture over it.
+/// </summary>
+/// <param name="buffer">Receives the buffer</param>
+/// <param name="texture">Receives the buffer texture</param>
+/// <param name="format">Texel format of the buffer texture</param>
+static void CreateBufferTexture(GLuint& buffer, GLuint& texture, GLenum format)
+{
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+/// <summary>
+/// Replaces the contents of a buffer. The old storage is orphaned, so frames still in flight keep reading it.
+/// </summary>
+/// <param name="buffer">Buffer</param>
+/// <param name="data">New contents</param>
+/// <param name="size">Size of the new contents</param>
+static void UploadBufferTexture(GLuint buffer, const void* data, size_t size)
+{
+	// A buffer texture over an empty buffer is not allowed, so there is always at least one texel
+	static const GLuint empty[4] = {};
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size > 0 ? size : sizeof(empty), size > 0 ? data : empty, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/// <summary>
+/// Gets the view-space distance at which a depth slice starts.
+/// </summary>
+/// <param name="clusters">Light clusters</param>
+/// <param name="slice">Depth slice, 0 to ClusterCountZ</param>
+/// <returns>Distance from the camera</returns>
+static float GetSliceDistance(const LightClusters& clusters, int slice)
+{
+	return clusters.nearPlane * std::pow(clusters.farPlane / clusters.nearPlane, static_cast<float>(slice) / ClusterCountZ);
+}
+
+/// <summary>
+/// Gets the depth slice that a view-space distance falls into.
+/// </summary>
+/// <param name="clusters">Light clusters</param>
+/// <param name="distance">Distance from the camera</param>
+/// <returns>Depth slice, clamped to the grid</returns>
+static int GetDepthSlice(const LightClusters& clusters, float distance)
+{
+	float slice = std::log(std::max(distance, clusters.nearPlane) / clusters.nearPlane) / std::log(clusters.farPlane / clusters.nearPlane) * ClusterCountZ;
+	return std::min(std::max(static_cast<int>(slice), 0), ClusterCountZ - 1);
+}
+
+/// <summary>
+/// Computes the view-space bounding box of every cluster from the inverse of the projection.
+/// </summary>
+/// <param name="clusters">Light clusters</param>
+/// <param name="projection">Projection matrix</param>
+static void BuildClusterBounds(LightClusters& clusters, const glm::mat4& projection)
+{
+	clusters.projection = projection;
+	clusters.boundsMin.resize(ClusterCount);
+	clusters.boundsMax.resize(ClusterCount);
+	glm::mat4 inverseProjection = glm::inverse(projection);
+
+	for (int y = 0; y < ClusterCountY; ++y)
+	{
+		for (int x = 0; x < ClusterCountX; ++x)
+		{
+			// Corners of the tile on the near plane; the cluster edges are the rays from the camera through them
+			glm::vec3 corners[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				float ndcX = -1.0f + 2.0f * (x + (i & 1)) / ClusterCountX;
+				float ndcY = -1.0f + 2.0f * (y + (i >> 1)) / ClusterCountY;
+				glm::vec4 corner = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+				corners[i] = glm::vec3(corner) / corner.w;
+			}
+
+			for (int z = 0; z < ClusterCountZ; ++z)
+			{
+				float sliceNear = GetSliceDistance(clusters, z);
+				float sliceFar = GetSliceDistance(clusters, z + 1);
+
+				glm::vec3 boundsMin(INFINITY);
+				glm::vec3 boundsMax(-INFINITY);
+				for (const glm::vec3& corner : corners)
+				{
+					glm::vec3 nearPoint = corner * (sliceNear / -corner.z);
+					glm::vec3 farPoint = corner * (sliceFar / -corner.z);
+					boundsMin = glm::min(boundsMin, glm::min(nearPoint, farPoint));
+					boundsMax = glm::max(boundsMax, glm::max(nearPoint, farPoint));
+				}
+
+				int cluster = (z * ClusterCountY + y) * ClusterCountX + x;
+				clusters.boundsMin[cluster] = boundsMin;
+				clusters.boundsMax[cluster] = boundsMax;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Creates the buffer textures of the clustered lighting.
+/// </summary>
+/// <param name="clusters">Light clusters that will be created</param>
+/// <param name="nearPlane">Distance of the near plane of the projection</param>
+/// <param name="farPlane">Distance of the far plane of the projection</param>
+void CreateLightClusters(LightClusters& clusters, float nearPlane, float farPlane)
+{
+	clusters.nearPlane = nearPlane;
+	clusters.farPlane = farPlane;
+	CreateBufferTexture(clusters.lightBuffer, clusters.lightTexture, GL_RGBA32F);
+	CreateBufferTexture(clusters.rangeBuffer, clusters.rangeTexture, GL_RG32UI);
+	CreateBufferTexture(clusters.indexBuffer, clusters.indexTexture, GL_R32UI);
+}
+
+/// <summary>
+/// Assigns the point lights to the clusters they reach, uploads the light lists and fills in the cluster part
+/// of the per-frame data. The cluster bounds are rebuilt whenever the projection changes.
+/// </summary>
+/// <param name="clusters">Light clusters</param>
+/// <param name="lights">Point lights of the scene</param>
+/// <param name="view">View matrix</param>
+/// <param name="projection">Projection matrix</param>
+/// <param name="width">Framebuffer width</param>
+/// <param name="height">Framebuffer height</param>
+/// <param name="frame">Per-frame data that receives the inverse projection and the grid size</param>
+void UpdateLightClusters(LightClusters& clusters, const std::vector<ScenePointLight>& lights, const glm::mat4& view,
+	const glm::mat4& projection, float width, float height, FrameUniforms& frame)
+{
+	if (clusters.boundsMin.empty() || clusters.projection != projection)
+	{
+		BuildClusterBounds(clusters, projection);
+	}
+
+	clusters.lightData.clear();
+	clusters.assignments.clear();
+	clusters.ranges.assign(ClusterCount * 2, 0);
+
+	for (size_t light = 0; light < lights.size(); ++light)
+	{
+		glm::vec3 center = glm::vec3(view * glm::vec4(lights[light].position, 1.0f));
+		float radius = lights[light].radius;
+		clusters.lightData.push_back(glm::vec4(center, radius));
+		clusters.lightData.push_back(glm::vec4(lights[light].color, 0.0f));
+
+		// Lights entirely in front of the near plane or behind the far plane reach no cluster
+		float nearest = -center.z - radius;
+		float farthest = -center.z + radius;
+		if (farthest < clusters.nearPlane || nearest > clusters.farPlane)
+		{
+			continue;
+		}
+
+		// Narrow the tiles down to the screen rectangle of the light's bounding box, unless it crosses the near plane
+		int minX = 0, maxX = ClusterCountX - 1;
+		int minY = 0, maxY = ClusterCountY - 1;
+		if (nearest > clusters.nearPlane)
+		{
+			glm::vec2 screenMin(INFINITY);
+			glm::vec2 screenMax(-INFINITY);
+			for (int i = 0; i < 8; ++i)
+			{
+				glm::vec3 corner = center + radius * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+				glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+				glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+				screenMin = glm::min(screenMin, ndc);
+				screenMax = glm::max(screenMax, ndc);
+			}
+			minX = std::max(static_cast<int>(std::floor((screenMin.x * 0.5f + 0.5f) * ClusterCountX)), 0);
+			maxX = std::min(static_cast<int>(std::floor((screenMax.x * 0.5f + 0.5f) * ClusterCountX)), ClusterCountX - 1);
+			minY = std::max(static_cast<int>(std::floor((screenMin.y * 0.5f + 0.5f) * ClusterCountY)), 0);
+			maxY = std::min(static_cast<int>(std::floor((screenMax.y * 0.5f + 0.5f) * ClusterCountY)), ClusterCountY - 1);
+		}
+
+		int minZ = GetDepthSlice(clusters, nearest);
+		int maxZ = GetDepthSlice(clusters, farthest);
+		for (int z = minZ; z <= maxZ; ++z)
+		{
+			for (int y = minY; y <= maxY; ++y)
+			{
+				for (int x = minX; x <= maxX; ++x)
+				{
+					// Sphere against box: distance from the center to the closest point of the box
+					int cluster = (z * ClusterCountY + y) * ClusterCountX + x;
+					glm::vec3 closest = glm::min(glm::max(center, clusters.boundsMin[cluster]), clusters.boundsMax[cluster]);
+					glm::vec3 offset = closest - center;
+					if (glm::dot(offset, offset) <= radius * radius)
+					{
+						clusters.assignments.push_back(static_cast<GLuint>(cluster));
+						clusters.assignments.push_back(static_cast<GLuint>(light));
+						++clusters.ranges[cluster * 2 + 1];
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort of the assignments into one contiguous light list per cluster
+	GLuint offset = 0;
+	for (int cluster = 0; cluster < ClusterCount; ++cluster)
+	{
+		clusters.ranges[cluster * 2] = offset;
+		offset += clusters.ranges[cluster * 2 + 1];
+		clusters.ranges[cluster * 2 + 1] = 0;
+	}
+	clusters.indices.resize(offset);
+	for (size_t i = 0; i < clusters.assignments.size(); i += 2)
+	{
+		GLuint cluster = clusters.assignments[i];
+		clusters.indices[clusters.ranges[cluster * 2] + clusters.ranges[cluster * 2 + 1]++] = clusters.assignments[i + 1];
+	}
+
+	UploadBufferTexture(clusters.lightBuffer, clusters.lightData.data(), clusters.lightData.size() * sizeof(glm::vec4));
+	UploadBufferTexture(clusters.rangeBuffer, clusters.ranges.data(), clusters.ranges.size() * sizeof(GLuint));
+	UploadBufferTexture(clusters.indexBuffer, clusters.indices.data(), clusters.indices.size() * sizeof(GLuint));
+
+	// The fragment shaders find their slice as log(distance) * scale + bias
+	float logDepthRange = std::log(clusters.farPlane / clusters.nearPlane);
+	frame.inverseProjection = glm::inverse(projection);
+	frame.clusterScale = glm::vec4(width, height, ClusterCountZ / logDepthRange, -ClusterCountZ * std::log(clusters.nearPlane) / logDepthRange);
+	frame.clusterGrid = glm::uvec4(static_cast<GLuint>(ClusterCountX), static_cast<GLuint>(ClusterCountY), static_cast<GLuint>(ClusterCountZ),
+		static_cast<GLuint>(lights.size()));
+}
+
+/// <summary>
+/// Binds the buffer textures to their texture units.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="clusters">Light clusters</param>
+void BindLightClusters(RenderState& state, const LightClusters& clusters)
+{
+	BindTextureCached(state, ClusterLightsTextureUnit, GL_TEXTURE_BUFFER, clusters.lightTexture);
+	BindTextureCached(state, ClusterRangesTextureUnit, GL_TEXTURE_BUFFER, clusters.rangeTexture);
+	BindTextureCached(state, ClusterIndicesTextureUnit, GL_TEXTURE_BUFFER, clusters.indexTexture);
+}
+
+/// <summary>
+/// Deletes the buffer textures.
+/// </summary>
+/// <param name="clusters">Light clusters</param>
+void DeleteLightClusters(LightClusters& clusters)
+{
+	glDeleteTextures(1, &clusters.lightTexture);
+	glDeleteBuffers(1, &clusters.lightBuffer);
+	glDeleteTextures(1, &clusters.rangeTexture);
+	glDeleteBuffers(1, &clusters.rangeBuffer);
+	glDeleteTextures(1, &clusters.indexTexture);
+	glDeleteBuffers(1, &clusters.indexBuffer);
+	clusters = LightClusters();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Number of clusters across the screen, down the screen and between the near and far plane
+/// </summary>
+const int ClusterCountX = 16;
+const int ClusterCountY = 16;
+const int ClusterCountZ = 24;
+const int ClusterCount = ClusterCountX * ClusterCountY * ClusterCountZ;
+
+/// <summary>
+/// Struct containing the clustered lighting of the scene's point lights. The view frustum is split into screen tiles
+/// and exponentially spaced depth slices; every frame the lights are assigned to the clusters they reach, and each
+/// fragment only loops over the lights of its own cluster. Lights, cluster ranges and light lists are buffer textures.
+/// </summary>
+struct LightClusters
+{
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	glm::mat4 projection = glm::mat4(0.0f);	// Projection that the cluster bounds were built for
+	std::vector<glm::vec3> boundsMin;		// View-space bounding box of every cluster
+	std::vector<glm::vec3> boundsMax;
+
+	std::vector<glm::vec4> lightData;		// Two texels per light: view-space position and radius, then color
+	std::vector<GLuint> ranges;				// Two values per cluster: offset into the light lists and number of lights
+	std::vector<GLuint> indices;			// Light lists of all clusters, one after the other
+	std::vector<GLuint> assignments;		// Cluster and light of every cluster the lights reach (pairs), kept between frames
+
+	GLuint lightBuffer = 0;
+	GLuint lightTexture = 0;
+	GLuint rangeBuffer = 0;
+	GLuint rangeTexture = 0;
+	GLuint indexBuffer = 0;
+	GLuint indexTexture = 0;
+};
+
+/// <summary>
+/// Creates the buffer textures of the clustered lighting.
+/// </summary>
+/// <param name="clusters">Light clusters that will be created</param>
+/// <param name="nearPlane">Distance of the near plane of the projection</param>
+/// <param name="farPlane">Distance of the far plane of the projection</param>
+void CreateLightClusters(LightClusters& clusters, float nearPlane, float farPlane);
+
+/// <summary>
+/// Assigns the point lights to the clusters they reach, uploads the light lists and fills in the cluster part
+/// of the per-frame data. The cluster bounds are rebuilt whenever the projection changes.
+/// </summary>
+/// <param name="clusters">Light clusters</param>
+/// <param name="lights">Point lights of the scene</param>
+/// <param name="view">View matrix</param>
+/// <param name="projection">Projection matrix</param>
+/// <param name="width">Framebuffer width</param>
+/// <param name="height">Framebuffer height</param>
+/// <param name="frame">Per-frame data that receives the inverse projection and the grid size</param>
+void UpdateLightClusters(LightClusters& clusters, const std::vector<ScenePointLight>& lights, const glm::mat4& view,
+	const glm::mat4& projection, float width, float height, FrameUniforms& frame);
+
+/// <summary>
+/// Binds the buffer textures to their texture units.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="clusters">Light clusters</param>
+void BindLightClusters(RenderState& state, const LightClusters& clusters);
+
+/// <summary>
+/// Deletes the buffer textures.
+/// </summary>
+/// <param name="clusters">Light clusters</param>
+void DeleteLightClusters(LightClusters& clusters);
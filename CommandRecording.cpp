@@ -0,0 +1,132 @@
+#include "CommandRecording.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Culling.h"
+
+/// <summary>
+/// Starts the worker threads and notes the material and mesh pairs of the scene objects.
+/// </summary>
+/// <param name="recorder">Command recorder that will be started</param>
+/// <param name="workerCount">Number of worker threads (0 picks one less than the number of hardware threads)</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="materialCount">Number of scene materials</param>
+void StartCommandRecorder(CommandRecorder& recorder, unsigned int workerCount, const std::vector<SceneObject>& scene, size_t materialCount)
+{
+	StartJobSystem(recorder.jobs, workerCount);
+	recorder.arenas.resize(GetJobThreadCount(recorder.jobs));
+
+	recorder.usedPrograms.assign(materialCount * MeshTypeCount, 0);
+	recorder.programs.assign(materialCount * MeshTypeCount, 0);
+	for (const SceneObject& object : scene)
+	{
+		recorder.usedPrograms[object.material * MeshTypeCount + object.mesh] = 1;
+	}
+}
+
+/// <summary>
+/// Records the ObjectData blocks and draw packets of the visible objects on all threads of the job system and
+/// appends the packets to the render queue in the order of the visible objects. Must be called on the OpenGL thread,
+/// between BeginUniformRingFrame() and UnmapUniformRing().
+/// </summary>
+/// <param name="recorder">Command recorder</param>
+/// <param name="queue">Render queue that receives the packets</param>
+/// <param name="ring">Uniform ring that receives the ObjectData blocks</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="sceneShaders">Shader variants of the scene</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="sceneMaterials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="visibleObjects">Indices of the objects to draw</param>
+/// <param name="viewMatrix">View matrix</param>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera, for the level of detail</param>
+/// <param name="vertexArray">Vertex array object with the mesh attributes</param>
+void RecordDrawCommands(CommandRecorder& recorder, RenderQueue& queue, UniformRing& ring, ShaderCache& shaderCache, ShaderVariantSet& sceneShaders,
+	const std::vector<SceneObject>& scene, const std::vector<SceneMaterial>& sceneMaterials, const MeshBuffers& meshBuffers,
+	const TransformStore& transforms, const std::vector<uint32_t>& visibleObjects, const glm::mat4& viewMatrix, const glm::mat4& viewProjection,
+	const glm::vec3& cameraPosition, float pixelsPerUnit, GLuint vertexArray)
+{
+	++recorder.frames;
+
+	// Finding a variant may have to finish building it, and hot reload can replace its program, so the programs are
+	// looked up here every frame rather than on the workers
+	for (size_t pair = 0; pair < recorder.programs.size(); ++pair)
+	{
+		if (recorder.usedPrograms[pair])
+		{
+			MeshType mesh = static_cast<MeshType>(pair % MeshTypeCount);
+			unsigned int features = SelectShaderFeatures(sceneMaterials[pair / MeshTypeCount], meshBuffers, mesh);
+			recorder.programs[pair] = GetShaderVariant(shaderCache, sceneShaders, features).shader.program;
+		}
+	}
+
+	// Every object gets the block at its own position in one reservation, the same offsets a single thread
+	// writing them in order would get
+	GLsizeiptr objectStride = GetUniformRingStride(ring, sizeof(ObjectUniforms));
+	GLintptr baseOffset = -1;
+	unsigned char* objectBlocks = ReserveUniformRing(ring, objectStride * static_cast<GLsizeiptr>(visibleObjects.size()), baseOffset);
+
+	for (CommandArena& arena : recorder.arenas)
+	{
+		arena.packets.clear();
+	}
+	size_t threadCount = recorder.arenas.size();
+	size_t jobSize = std::max(CommandJobMinObjects, (visibleObjects.size() + threadCount * CommandJobsPerThread - 1) / (threadCount * CommandJobsPerThread));
+	recorder.jobRanges.resize((visibleObjects.size() + jobSize - 1) / jobSize);
+
+	ParallelFor(recorder.jobs, visibleObjects.size(), jobSize, [&](size_t job, size_t first, size_t count, int thread)
+	{
+		CommandArena& arena = recorder.arenas[thread];
+		recorder.jobRanges[job] = { thread, arena.packets.size(), count };
+
+		const uint32_t* objects = visibleObjects.data() + first;
+		arena.matrices.resize(count);
+		MultiplyTransformRange(viewProjection, transforms.modelMatrices.data(), objects, count, arena.matrices.data());
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const SceneObject& object = scene[objects[i]];
+			const glm::mat4& model = transforms.modelMatrices[objects[i]];
+
+			GLintptr offset = -1;
+			if (objectBlocks != nullptr)
+			{
+				ObjectUniforms objectUniforms;
+				objectUniforms.transformationMatrix = arena.matrices[i];
+				objectUniforms.model = objectUniforms.transformationMatrix;
+				objectUniforms.material = object.material;
+				std::memcpy(objectBlocks + (first + i) * objectStride, &objectUniforms, sizeof(ObjectUniforms));
+				offset = baseOffset + static_cast<GLintptr>((first + i) * objectStride);
+			}
+
+			int lod = SelectObjectLod(object.mesh, meshBuffers, model, cameraPosition, pixelsPerUnit);
+			float depth = -(viewMatrix * model[3]).z / 100.0f;
+			GLuint program = recorder.programs[object.material * MeshTypeCount + object.mesh];
+			uint64_t key = MakeSortKey(program, object.material, vertexArray, object.mesh, depth);
+			arena.packets.push_back({ key, program, vertexArray, object.mesh, lod, 0, offset, static_cast<int32_t>(objects[i]) });
+		}
+	});
+	recorder.recordedJobs += static_cast<int64_t>(recorder.jobRanges.size());
+
+	// Jobs in object order, whichever thread ran them, so equal sort keys keep the order of a single thread
+	for (const CommandJobRange& range : recorder.jobRanges)
+	{
+		const std::vector<DrawPacket>& packets = recorder.arenas[range.thread].packets;
+		queue.packets.insert(queue.packets.end(), packets.begin() + range.firstPacket, packets.begin() + range.firstPacket + range.packetCount);
+	}
+}
+
+/// <summary>
+/// Stops the worker threads and frees the arenas.
+/// </summary>
+/// <param name="recorder">Command recorder</param>
+void StopCommandRecorder(CommandRecorder& recorder)
+{
+	StopJobSystem(recorder.jobs);
+	recorder.arenas.clear();
+	recorder.jobRanges.clear();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "ShaderProgram.h"
+#include "ShaderVariants.h"
+#include "Transforms.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Fewest visible objects that one recording job handles, so that small scenes do not pay more for the jobs than
+/// for the work in them
+/// </summary>
+const size_t CommandJobMinObjects = 64;
+
+/// <summary>
+/// Jobs per thread that the visible objects are split into, so that threads which finish early have jobs to steal
+/// </summary>
+const size_t CommandJobsPerThread = 4;
+
+/// <summary>
+/// Struct containing the draw packets that one thread recorded in the current frame, one job after another. The
+/// storage is only cleared between frames and never shrinks, so after the first frames recording allocates nothing.
+/// Each arena starts on its own cache line, so threads never write next to each other.
+/// </summary>
+struct alignas(64) CommandArena
+{
+	std::vector<DrawPacket> packets;
+	std::vector<glm::mat4> matrices;		// Scratch space for the transformation matrices of one job
+};
+
+/// <summary>
+/// Struct containing where a recording job left its packets
+/// </summary>
+struct CommandJobRange
+{
+	int thread;							// Arena that holds the packets
+	size_t firstPacket;					// First packet of the job in the arena
+	size_t packetCount;
+};
+
+/// <summary>
+/// Struct containing the per-object draw recording of the non-instanced path, spread over a work-stealing job
+/// system. Every job takes a range of the visible objects, multiplies their matrices, picks their levels of detail,
+/// writes their ObjectData blocks straight into the mapped uniform ring and records one draw packet per object into
+/// its thread's arena. The thread that owns the OpenGL context then merges the packets in object order, so the
+/// frame is the same as when one thread records it, and replays them through the render queue. Workers never call
+/// OpenGL: the programs of the shader variants are looked up on the OpenGL thread before the jobs start.
+/// </summary>
+struct CommandRecorder
+{
+	JobSystem jobs;
+	std::vector<CommandArena> arenas;		// One per thread of the job system
+	std::vector<CommandJobRange> jobRanges;	// One per job of the current frame, in object order
+	std::vector<uint8_t> usedPrograms;		// Non-zero for every material and mesh pair (material * MeshTypeCount + mesh) an object uses
+	std::vector<GLuint> programs;			// Shader variant of every used pair, looked up every frame
+
+	int64_t frames = 0;
+	int64_t recordedJobs = 0;
+};
+
+/// <summary>
+/// Starts the worker threads and notes the material and mesh pairs of the scene objects.
+/// </summary>
+/// <param name="recorder">Command recorder that will be started</param>
+/// <param name="workerCount">Number of worker threads (0 picks one less than the number of hardware threads)</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="materialCount">Number of scene materials</param>
+void StartCommandRecorder(CommandRecorder& recorder, unsigned int workerCount, const std::vector<SceneObject>& scene, size_t materialCount);
+
+/// <summary>
+/// Records the ObjectData blocks and draw packets of the visible objects on all threads of the job system and
+/// appends the packets to the render queue in the order of the visible objects. Must be called on the OpenGL thread,
+/// between BeginUniformRingFrame() and UnmapUniformRing().
+/// </summary>
+/// <param name="recorder">Command recorder</param>
+/// <param name="queue">Render queue that receives the packets</param>
+/// <param name="ring">Uniform ring that receives the ObjectData blocks</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="sceneShaders">Shader variants of the scene</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="sceneMaterials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="visibleObjects">Indices of the objects to draw</param>
+/// <param name="viewMatrix">View matrix</param>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera, for the level of detail</param>
+/// <param name="vertexArray">Vertex array object with the mesh attributes</param>
+void RecordDrawCommands(CommandRecorder& recorder, RenderQueue& queue, UniformRing& ring, ShaderCache& shaderCache, ShaderVariantSet& sceneShaders,
+	const std::vector<SceneObject>& scene, const std::vector<SceneMaterial>& sceneMaterials, const MeshBuffers& meshBuffers,
+	const TransformStore& transforms, const std::vector<uint32_t>& visibleObjects, const glm::mat4& viewMatrix, const glm::mat4& viewProjection,
+	const glm::vec3& cameraPosition, float pixelsPerUnit, GLuint vertexArray);
+
+/// <summary>
+/// Stops the worker threads and frees the arenas.
+/// </summary>
+/// <param name="recorder">Command recorder</param>
+void StopCommandRecorder(CommandRecorder& recorder);
@@ -0,0 +1,361 @@
+#include "Culling.h"
+
+#include <algorithm>
+
+/// <summary>
+/// Maximum number of objects in a leaf of the bounding volume hierarchy
+/// </summary>
+static const uint32_t BvhLeafSize = 4;
+
+/// <summary>
+/// Computes the smallest box that contains two boxes.
+/// </summary>
+/// <param name="a">First box</param>
+/// <param name="b">Second box</param>
+/// <returns>Union of the boxes</returns>
+static BoundingBox MergeBoundingBoxes(const BoundingBox& a, const BoundingBox& b)
+{
+	return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+/// <summary>
+/// Computes the bounding box of a transformed bounding box.
+/// </summary>
+/// <param name="box">Bounding box</param>
+/// <param name="matrix">Affine transformation</param>
+/// <returns>Axis-aligned box that contains the transformed box</returns>
+BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& matrix)
+{
+	// Transform the center, and grow the half size by the absolute value of every matrix entry
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 halfSize = (box.max - box.min) * 0.5f;
+
+	glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+	glm::vec3 newHalfSize(0.0f);
+	for (int column = 0; column < 3; ++column)
+	{
+		newHalfSize += glm::abs(glm::vec3(matrix[column])) * halfSize[column];
+	}
+
+	return { newCenter - newHalfSize, newCenter + newHalfSize };
+}
+
+/// <summary>
+/// Computes the world-space bounding box of a scene object from the bounds of its mesh.
+/// </summary>
+/// <param name="object">Scene object</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="modelMatrix">Model matrix of the object</param>
+/// <returns>World-space bounding box</returns>
+BoundingBox ComputeObjectBounds(const SceneObject& object, const MeshBuffers& meshBuffers, const glm::mat4& modelMatrix)
+{
+	const MeshRange& range = meshBuffers.ranges[object.mesh][0];
+	BoundingBox meshBounds = {
+		glm::vec3(range.boundsMin[0], range.boundsMin[1], range.boundsMin[2]),
+		glm::vec3(range.boundsMax[0], range.boundsMax[1], range.boundsMax[2])
+	};
+	return TransformBoundingBox(meshBounds, modelMatrix);
+}
+
+/// <summary>
+/// Picks the level of detail of one object from the radius its mesh's bounding sphere covers on the screen.
+/// </summary>
+/// <param name="mesh">Mesh of the object</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="modelMatrix">Model matrix of the object</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera (projection[1][1] times half the height)</param>
+/// <returns>Level of detail</returns>
+int SelectObjectLod(MeshType mesh, const MeshBuffers& meshBuffers, const glm::mat4& modelMatrix, const glm::vec3& cameraPosition, float pixelsPerUnit)
+{
+	if (meshBuffers.lodCounts[mesh] <= 1)
+	{
+		return 0;
+	}
+
+	// The mesh's sphere around its origin, grown by the largest scale of the model matrix
+	float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	float radius = meshBuffers.ranges[mesh][0].radius * scale;
+	float distance = glm::length(glm::vec3(modelMatrix[3]) - cameraPosition);
+
+	// From inside the sphere the object fills the screen
+	float screenRadius = distance > radius ? radius * pixelsPerUnit / distance : MeshLodReferenceRadius;
+	return SelectMeshLod(meshBuffers, mesh, screenRadius);
+}
+
+/// <summary>
+/// Picks the level of detail of every visible object from the radius its mesh's bounding sphere covers on the screen.
+/// </summary>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="visibleObjects">Indices of the visible objects</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera (projection[1][1] times half the height)</param>
+/// <param name="lods">Receives the level of detail of every visible object, in the same order</param>
+void SelectObjectLods(const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const TransformStore& transforms,
+	const std::vector<uint32_t>& visibleObjects, const glm::vec3& cameraPosition, float pixelsPerUnit, std::vector<uint8_t>& lods)
+{
+	lods.resize(visibleObjects.size());
+	for (size_t i = 0; i < visibleObjects.size(); ++i)
+	{
+		lods[i] = static_cast<uint8_t>(SelectObjectLod(scene[visibleObjects[i]].mesh, meshBuffers, transforms.modelMatrices[visibleObjects[i]],
+			cameraPosition, pixelsPerUnit));
+	}
+}
+
+/// <summary>
+/// Extracts the planes of the view frustum from a combined projection and view matrix.
+/// </summary>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <returns>Frustum planes</returns>
+Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+	// glm matrices are column-major, so row i is made of the i-th element of every column
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	// A clip-space point is inside when -w <= x, y, z <= w
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	return frustum;
+}
+
+/// <summary>
+/// Builds the node that owns a range of SceneBvh::objects, and the nodes below it.
+/// </summary>
+/// <param name="bvh">Hierarchy being built</param>
+/// <param name="nodeIndex">Index of the node, which has already been added</param>
+static void BuildBvhNode(SceneBvh& bvh, int32_t nodeIndex)
+{
+	uint32_t firstObject = bvh.nodes[nodeIndex].firstObject;
+	uint32_t objectCount = bvh.nodes[nodeIndex].objectCount;
+
+	BoundingBox bounds = bvh.objectBounds[bvh.objects[firstObject]];
+	BoundingBox centers = { (bounds.min + bounds.max) * 0.5f, (bounds.min + bounds.max) * 0.5f };
+	for (uint32_t i = firstObject + 1; i < firstObject + objectCount; ++i)
+	{
+		const BoundingBox& objectBounds = bvh.objectBounds[bvh.objects[i]];
+		glm::vec3 center = (objectBounds.min + objectBounds.max) * 0.5f;
+		bounds = MergeBoundingBoxes(bounds, objectBounds);
+		centers = MergeBoundingBoxes(centers, { center, center });
+	}
+	bvh.nodes[nodeIndex].bounds = bounds;
+
+	if (objectCount <= BvhLeafSize)
+	{
+		for (uint32_t i = firstObject; i < firstObject + objectCount; ++i)
+		{
+			bvh.objectLeaves[bvh.objects[i]] = nodeIndex;
+		}
+		return;
+	}
+
+	// Split at the median center along the axis where the centers are spread out the most
+	glm::vec3 extent = centers.max - centers.min;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	uint32_t leftCount = objectCount / 2;
+	std::vector<uint32_t>::iterator first = bvh.objects.begin() + firstObject;
+	std::nth_element(first, first + leftCount, first + objectCount, [&](uint32_t a, uint32_t b)
+	{
+		return bvh.objectBounds[a].min[axis] + bvh.objectBounds[a].max[axis] < bvh.objectBounds[b].min[axis] + bvh.objectBounds[b].max[axis];
+	});
+
+	int32_t childIndex = static_cast<int32_t>(bvh.nodes.size());
+	bvh.nodes[nodeIndex].firstChild = childIndex;
+	bvh.nodes.push_back({ bounds, nodeIndex, -1, firstObject, leftCount });
+	bvh.nodes.push_back({ bounds, nodeIndex, -1, firstObject + leftCount, objectCount - leftCount });
+	BuildBvhNode(bvh, childIndex);
+	BuildBvhNode(bvh, childIndex + 1);
+}
+
+/// <summary>
+/// Builds the bounding volume hierarchy over the scene objects with their current model matrices. Nodes are split
+/// at the median of the object centers along their longest axis.
+/// </summary>
+/// <param name="bvh">Hierarchy that will be built</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+void BuildSceneBvh(SceneBvh& bvh, const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const TransformStore& transforms)
+{
+	bvh.nodes.clear();
+	bvh.objects.resize(scene.size());
+	bvh.objectBounds.resize(scene.size());
+	bvh.objectLeaves.assign(scene.size(), -1);
+
+	for (uint32_t i = 0; i < scene.size(); ++i)
+	{
+		bvh.objects[i] = i;
+		bvh.objectBounds[i] = ComputeObjectBounds(scene[i], meshBuffers, transforms.modelMatrices[i]);
+	}
+
+	if (scene.empty())
+	{
+		return;
+	}
+
+	// A balanced binary tree with leaves of up to BvhLeafSize objects
+	bvh.nodes.reserve(2 * (scene.size() / BvhLeafSize + 1));
+	bvh.nodes.push_back({ BoundingBox(), -1, -1, 0, static_cast<uint32_t>(scene.size()) });
+	BuildBvhNode(bvh, 0);
+}
+
+/// <summary>
+/// Moves the bounds of the objects whose model matrices changed in the last UpdateTransforms() and refits the
+/// nodes above them. The tree itself is not rebuilt, so the cost only depends on the number of moving objects.
+/// </summary>
+/// <param name="bvh">Hierarchy</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+void RefitSceneBvh(SceneBvh& bvh, const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const TransformStore& transforms)
+{
+	for (uint32_t object : transforms.updatedObjects)
+	{
+		bvh.objectBounds[object] = ComputeObjectBounds(scene[object], meshBuffers, transforms.modelMatrices[object]);
+
+		// Recompute the leaf from its objects, then every parent from its two children. Once a node
+		// comes out the same as before, the nodes above it cannot change either
+		int32_t nodeIndex = bvh.objectLeaves[object];
+		while (nodeIndex != -1)
+		{
+			BvhNode& node = bvh.nodes[nodeIndex];
+			BoundingBox bounds;
+			if (node.firstChild == -1)
+			{
+				bounds = bvh.objectBounds[bvh.objects[node.firstObject]];
+				for (uint32_t i = node.firstObject + 1; i < node.firstObject + node.objectCount; ++i)
+				{
+					bounds = MergeBoundingBoxes(bounds, bvh.objectBounds[bvh.objects[i]]);
+				}
+			}
+			else
+			{
+				bounds = MergeBoundingBoxes(bvh.nodes[node.firstChild].bounds, bvh.nodes[node.firstChild + 1].bounds);
+			}
+
+			if (bounds.min == node.bounds.min && bounds.max == node.bounds.max)
+			{
+				break;
+			}
+			node.bounds = bounds;
+			nodeIndex = node.parent;
+		}
+	}
+}
+
+/// <summary>
+/// Tests a bounding box against the frustum planes that are still in the plane mask.
+/// </summary>
+/// <param name="box">Bounding box</param>
+/// <param name="frustum">View frustum</param>
+/// <param name="planeMask">Planes to test (bit i for plane i); planes that the box is completely inside of are removed</param>
+/// <returns>False if the box is completely outside of a plane, true otherwise</returns>
+static bool TestFrustum(const BoundingBox& box, const Frustum& frustum, unsigned int& planeMask)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if ((planeMask & (1u << i)) == 0)
+		{
+			continue;
+		}
+
+		// The corner furthest along the plane normal decides whether the box is outside,
+		// the opposite corner whether it is completely inside
+		const glm::vec4& plane = frustum.planes[i];
+		glm::vec3 normal = glm::vec3(plane);
+		glm::vec3 furthest(normal.x >= 0.0f ? box.max.x : box.min.x, normal.y >= 0.0f ? box.max.y : box.min.y, normal.z >= 0.0f ? box.max.z : box.min.z);
+		glm::vec3 nearest(normal.x >= 0.0f ? box.min.x : box.max.x, normal.y >= 0.0f ? box.min.y : box.max.y, normal.z >= 0.0f ? box.min.z : box.max.z);
+
+		if (glm::dot(normal, furthest) + plane.w < 0.0f)
+		{
+			return false;
+		}
+		if (glm::dot(normal, nearest) + plane.w >= 0.0f)
+		{
+			planeMask &= ~(1u << i);
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Tests a single bounding box against a frustum.
+/// </summary>
+/// <param name="box">Bounding box</param>
+/// <param name="frustum">Frustum</param>
+/// <returns>False if the box is completely outside of a plane, true otherwise</returns>
+bool IntersectsFrustum(const BoundingBox& box, const Frustum& frustum)
+{
+	unsigned int planeMask = 0x3F;
+	return TestFrustum(box, frustum, planeMask);
+}
+
+/// <summary>
+/// Finds the scene objects whose bounding boxes intersect the frustum. Subtrees that are completely
+/// outside are skipped and subtrees that are completely inside are accepted without further tests.
+/// </summary>
+/// <param name="bvh">Hierarchy</param>
+/// <param name="frustum">View frustum</param>
+/// <param name="visibleObjects">Receives the indices of the visible objects in ascending order</param>
+void CullSceneBvh(const SceneBvh& bvh, const Frustum& frustum, std::vector<uint32_t>& visibleObjects)
+{
+	visibleObjects.clear();
+	if (bvh.nodes.empty())
+	{
+		return;
+	}
+
+	// Each entry is a node and the planes that its parent was not completely inside of
+	struct StackEntry
+	{
+		int32_t node;
+		unsigned int planeMask;
+	};
+	StackEntry stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0x3Fu };
+
+	while (stackSize > 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		const BvhNode& node = bvh.nodes[entry.node];
+		if (!TestFrustum(node.bounds, frustum, entry.planeMask))
+		{
+			continue;
+		}
+
+		if (entry.planeMask == 0)
+		{
+			visibleObjects.insert(visibleObjects.end(), bvh.objects.begin() + node.firstObject, bvh.objects.begin() + node.firstObject + node.objectCount);
+		}
+		else if (node.firstChild == -1)
+		{
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; ++i)
+			{
+				unsigned int planeMask = entry.planeMask;
+				if (TestFrustum(bvh.objectBounds[bvh.objects[i]], frustum, planeMask))
+				{
+					visibleObjects.push_back(bvh.objects[i]);
+				}
+			}
+		}
+		else
+		{
+			stack[stackSize++] = { node.firstChild + 1, entry.planeMask };
+			stack[stackSize++] = { node.firstChild, entry.planeMask };
+		}
+	}
+
+	// Draw in scene order, which keeps objects that share a mesh together
+	std::sort(visibleObjects.begin(), visibleObjects.end());
+}
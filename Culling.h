@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Scene.h"
+#include "Transforms.h"
+
+/// <summary>
+/// Struct containing an axis-aligned bounding box
+/// </summary>
+struct BoundingBox
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+/// <summary>
+/// Struct containing the six planes of a view frustum (left, right, bottom, top, near, far).
+/// A point p is on the inner side of a plane when dot(plane.xyz, p) + plane.w >= 0.
+/// </summary>
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+/// <summary>
+/// Struct containing a node of the bounding volume hierarchy. Every node owns a contiguous range of
+/// SceneBvh::objects: the objects of all leaves below it.
+/// </summary>
+struct BvhNode
+{
+	BoundingBox bounds;
+	int32_t parent;				// -1 for the root
+	int32_t firstChild;			// Index of the left child (the right child follows it), -1 for leaves
+	uint32_t firstObject;		// First entry of SceneBvh::objects that belongs to the node
+	uint32_t objectCount;		// Number of objects below the node
+};
+
+/// <summary>
+/// Struct containing a bounding volume hierarchy over the world-space bounding boxes of the scene objects
+/// </summary>
+struct SceneBvh
+{
+	std::vector<BvhNode> nodes;				// nodes[0] is the root
+	std::vector<uint32_t> objects;			// Scene object indices in leaf order
+	std::vector<BoundingBox> objectBounds;	// World-space bounding box of every scene object
+	std::vector<int32_t> objectLeaves;		// Leaf node of every scene object
+};
+
+/// <summary>
+/// Computes the bounding box of a transformed bounding box.
+/// </summary>
+/// <param name="box">Bounding box</param>
+/// <param name="matrix">Affine transformation</param>
+/// <returns>Axis-aligned box that contains the transformed box</returns>
+BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& matrix);
+
+/// <summary>
+/// Computes the world-space bounding box of a scene object from the bounds of its mesh.
+/// </summary>
+/// <param name="object">Scene object</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="modelMatrix">Model matrix of the object</param>
+/// <returns>World-space bounding box</returns>
+BoundingBox ComputeObjectBounds(const SceneObject& object, const MeshBuffers& meshBuffers, const glm::mat4& modelMatrix);
+
+/// <summary>
+/// Picks the level of detail of one object from the radius its mesh's bounding sphere covers on the screen.
+/// </summary>
+/// <param name="mesh">Mesh of the object</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="modelMatrix">Model matrix of the object</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera (projection[1][1] times half the height)</param>
+/// <returns>Level of detail</returns>
+int SelectObjectLod(MeshType mesh, const MeshBuffers& meshBuffers, const glm::mat4& modelMatrix, const glm::vec3& cameraPosition, float pixelsPerUnit);
+
+/// <summary>
+/// Picks the level of detail of every visible object from the radius its mesh's bounding sphere covers on the screen.
+/// </summary>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="visibleObjects">Indices of the visible objects</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera (projection[1][1] times half the height)</param>
+/// <param name="lods">Receives the level of detail of every visible object, in the same order</param>
+void SelectObjectLods(const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const TransformStore& transforms,
+	const std::vector<uint32_t>& visibleObjects, const glm::vec3& cameraPosition, float pixelsPerUnit, std::vector<uint8_t>& lods);
+
+/// <summary>
+/// Extracts the planes of the view frustum from a combined projection and view matrix.
+/// </summary>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <returns>Frustum planes</returns>
+Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+/// <summary>
+/// Tests a single bounding box against a frustum.
+/// </summary>
+/// <param name="box">Bounding box</param>
+/// <param name="frustum">Frustum</param>
+/// <returns>False if the box is completely outside of a plane, true otherwise</returns>
+bool IntersectsFrustum(const BoundingBox& box, const Frustum& frustum);
+
+/// <summary>
+/// Builds the bounding volume hierarchy over the scene objects with their current model matrices. Nodes are split
+/// at the median of the object centers along their longest axis.
+/// </summary>
+/// <param name="bvh">Hierarchy that will be built</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+void BuildSceneBvh(SceneBvh& bvh, const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const TransformStore& transforms);
+
+/// <summary>
+/// Moves the bounds of the objects whose model matrices changed in the last UpdateTransforms() and refits the
+/// nodes above them. The tree itself is not rebuilt, so the cost only depends on the number of moving objects.
+/// </summary>
+/// <param name="bvh">Hierarchy</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+void RefitSceneBvh(SceneBvh& bvh, const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const TransformStore& transforms);
+
+/// <summary>
+/// Finds the scene objects whose bounding boxes intersect the frustum. Subtrees that are completely
+/// outside are skipped and subtrees that are completely inside are accepted without further tests.
+/// </summary>
+/// <param name="bvh">Hierarchy</param>
+/// <param name="frustum">View frustum</param>
+/// <param name="visibleObjects">Receives the indices of the visible objects in ascending order</param>
+void CullSceneBvh(const SceneBvh& bvh, const Frustum& frustum, std::vector<uint32_t>& visibleObjects);
@@ -0,0 +1,221 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+/// <summary>
+/// Frame time, as a fraction of the target, that the resolution is picked for when it changes. Aiming a little
+/// below the target keeps the next frames from going over it again right away.
+/// </summary>
+static const double DynamicResolutionHeadroom = 0.9;
+
+/// <summary>
+/// Frame time, as a fraction of the target, under which the resolution is raised again
+/// </summary>
+static const double DynamicResolutionRaiseThreshold = 0.8;
+
+/// <summary>
+/// Gets an internal size for a scale, as a multiple of DynamicResolutionStep within the output size.
+/// </summary>
+/// <param name="outputSize">Width or height of the output framebuffer</param>
+/// <param name="scale">Fraction of the output size</param>
+/// <returns>Width or height to render at</returns>
+static int GetScaledSize(int outputSize, float scale)
+{
+	int size = static_cast<int>(outputSize * scale / DynamicResolutionStep + 0.5f) * DynamicResolutionStep;
+	return std::min(std::max(size, DynamicResolutionStep), outputSize);
+}
+
+/// <summary>
+/// Creates the color and depth storage of the render target at the output size and attaches it.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+/// <returns>True if the render target is complete, false otherwise</returns>
+static bool AllocateDynamicResolutionTarget(DynamicResolution& resolution)
+{
+	glBindRenderbuffer(GL_RENDERBUFFER, resolution.colorRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, resolution.outputWidth, resolution.outputHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, resolution.depthRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, resolution.outputWidth, resolution.outputHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, resolution.framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolution.colorRenderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, resolution.depthRenderbuffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	resolution.width = GetScaledSize(resolution.outputWidth, resolution.scale);
+	resolution.height = GetScaledSize(resolution.outputHeight, resolution.scale);
+	resolution.smoothedMilliseconds = -1.0;
+	resolution.measuredFrames = 0;
+	return complete;
+}
+
+/// <summary>
+/// Creates the render target at the size of the output framebuffer and starts at the largest allowed scale.
+/// </summary>
+/// <param name="resolution">Dynamic resolution that will be created</param>
+/// <param name="outputWidth">Width of the output framebuffer</param>
+/// <param name="outputHeight">Height of the output framebuffer</param>
+/// <param name="targetMilliseconds">Frame time to stay under</param>
+/// <param name="minScale">Smallest fraction of the output size to render</param>
+/// <param name="maxScale">Largest fraction of the output size to render (at most 1)</param>
+/// <returns>True if the render target is complete, false otherwise</returns>
+bool CreateDynamicResolution(DynamicResolution& resolution, int outputWidth, int outputHeight, float targetMilliseconds, float minScale, float maxScale)
+{
+	resolution.targetMilliseconds = targetMilliseconds;
+	resolution.minScale = minScale;
+	resolution.maxScale = std::min(maxScale, 1.0f);
+	resolution.scale = resolution.maxScale;
+	resolution.lowestScale = resolution.maxScale;
+	resolution.outputWidth = outputWidth;
+	resolution.outputHeight = outputHeight;
+
+	glGenRenderbuffers(1, &resolution.colorRenderbuffer);
+	glGenRenderbuffers(1, &resolution.depthRenderbuffer);
+	glGenFramebuffers(1, &resolution.framebuffer);
+	for (int i = 0; i < DynamicResolutionLatency; ++i)
+	{
+		glGenQueries(2, resolution.queries[i]);
+		resolution.queryWidths[i] = 0;
+	}
+
+	if (!AllocateDynamicResolutionTarget(resolution))
+	{
+		std::cerr << "Dynamic resolution render target is incomplete!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Reallocates the render target when the output framebuffer changed size. The scale is kept.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+/// <param name="outputWidth">New width of the output framebuffer</param>
+/// <param name="outputHeight">New height of the output framebuffer</param>
+void ResizeDynamicResolution(DynamicResolution& resolution, int outputWidth, int outputHeight)
+{
+	// A minimized window has no framebuffer to draw into, so keep the old target until it comes back
+	if ((outputWidth == resolution.outputWidth && outputHeight == resolution.outputHeight) || outputWidth <= 0 || outputHeight <= 0)
+	{
+		return;
+	}
+
+	resolution.outputWidth = outputWidth;
+	resolution.outputHeight = outputHeight;
+	AllocateDynamicResolutionTarget(resolution);
+}
+
+/// <summary>
+/// Starts a frame: reads back the GPU time of the frame DynamicResolutionLatency frames ago, adjusts the internal
+/// resolution, and binds the render target with a viewport of the new resolution.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+/// <param name="previousFrameMilliseconds">CPU time of the previous frame, leaving out any wait for the display</param>
+void BeginDynamicResolutionFrame(DynamicResolution& resolution, double previousFrameMilliseconds)
+{
+	if (resolution.frameNumber >= 0)
+	{
+		resolution.cpuMilliseconds[resolution.frameNumber % DynamicResolutionLatency] = previousFrameMilliseconds;
+	}
+	++resolution.frameNumber;
+	int slot = static_cast<int>(resolution.frameNumber % DynamicResolutionLatency);
+
+	// Frames that were drawn before the last change say nothing about the current resolution. A GPU that has not
+	// even finished the frame by now is far behind, so its time is not waited for and the CPU time stands alone
+	if (resolution.queryWidths[slot] != 0)
+	{
+		if (resolution.queryWidths[slot] == resolution.width)
+		{
+			double milliseconds = resolution.cpuMilliseconds[slot];
+			GLint available = 0;
+			glGetQueryObjectiv(resolution.queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint64 start = 0;
+				GLuint64 end = 0;
+				glGetQueryObjectui64v(resolution.queries[slot][0], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(resolution.queries[slot][1], GL_QUERY_RESULT, &end);
+				milliseconds = std::max(milliseconds, (end - start) / 1.0e6);
+			}
+			resolution.smoothedMilliseconds = resolution.measuredFrames == 0 ? milliseconds : resolution.smoothedMilliseconds * 0.75 + milliseconds * 0.25;
+			++resolution.measuredFrames;
+		}
+		resolution.queryWidths[slot] = 0;
+	}
+
+	// Fill cost grows with the pixel count, so the scale of both sides follows the square root of the time ratio.
+	// The scale drops quickly when a frame runs over the target and rises slowly, so a steady load does not make
+	// it swing back and forth
+	double target = resolution.targetMilliseconds;
+	if (resolution.measuredFrames >= DynamicResolutionLatency
+		&& (resolution.smoothedMilliseconds > target || resolution.smoothedMilliseconds < target * DynamicResolutionRaiseThreshold))
+	{
+		double ratio = target * DynamicResolutionHeadroom / std::max(resolution.smoothedMilliseconds, 0.001);
+		float scale = resolution.scale * static_cast<float>(std::min(std::max(std::sqrt(ratio), 0.75), 1.1));
+		resolution.scale = std::min(std::max(scale, resolution.minScale), resolution.maxScale);
+
+		int width = GetScaledSize(resolution.outputWidth, resolution.scale);
+		int height = GetScaledSize(resolution.outputHeight, resolution.scale);
+		if (width != resolution.width || height != resolution.height)
+		{
+			resolution.width = width;
+			resolution.height = height;
+			resolution.smoothedMilliseconds = -1.0;
+			resolution.measuredFrames = 0;
+			++resolution.changes;
+		}
+	}
+
+	float frameScale = static_cast<float>(resolution.width) / resolution.outputWidth;
+	resolution.scaleSum += frameScale;
+	resolution.lowestScale = std::min(resolution.lowestScale, frameScale);
+	++resolution.frames;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, resolution.framebuffer);
+	glViewport(0, 0, resolution.width, resolution.height);
+
+	// Timestamps instead of an elapsed-time query, because the profiler's GPU zones may be timing inside the frame
+	glQueryCounter(resolution.queries[slot][0], GL_TIMESTAMP);
+	resolution.queryWidths[slot] = resolution.width;
+}
+
+/// <summary>
+/// Ends a frame: stretches the internal resolution onto the output framebuffer with linear filtering, then binds
+/// the output framebuffer with a viewport of its full size.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+/// <param name="outputFramebuffer">Framebuffer that the frame is shown from (0 for the window)</param>
+void EndDynamicResolutionFrame(DynamicResolution& resolution, GLuint outputFramebuffer)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, resolution.framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer);
+	glBlitFramebuffer(0, 0, resolution.width, resolution.height, 0, 0, resolution.outputWidth, resolution.outputHeight,
+		GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+	glViewport(0, 0, resolution.outputWidth, resolution.outputHeight);
+
+	int slot = static_cast<int>(resolution.frameNumber % DynamicResolutionLatency);
+	glQueryCounter(resolution.queries[slot][1], GL_TIMESTAMP);
+}
+
+/// <summary>
+/// Deletes the render target and the timer queries.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+void DeleteDynamicResolution(DynamicResolution& resolution)
+{
+	glDeleteFramebuffers(1, &resolution.framebuffer);
+	glDeleteRenderbuffers(1, &resolution.colorRenderbuffer);
+	glDeleteRenderbuffers(1, &resolution.depthRenderbuffer);
+	for (int i = 0; i < DynamicResolutionLatency; ++i)
+	{
+		glDeleteQueries(2, resolution.queries[i]);
+	}
+	resolution.framebuffer = 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+/// <summary>
+/// Number of frames between timing a frame on the GPU and reading the result back, so that reading it never stalls
+/// </summary>
+const int DynamicResolutionLatency = 4;
+
+/// <summary>
+/// Internal widths and heights are multiples of this many pixels, so that noise in the frame time does not change
+/// the resolution by a pixel or two every few frames
+/// </summary>
+const int DynamicResolutionStep = 8;
+
+/// <summary>
+/// Struct containing an offscreen render target whose resolution follows the measured frame time. The scene is drawn
+/// into the lower-left part of the target at the current internal resolution, then stretched onto the output
+/// framebuffer with a filtered blit. The target is allocated at the output size once, so changing the resolution
+/// costs nothing. A frame is measured as the longer of its CPU time, which includes the rendering when software
+/// OpenGL draws on the calling thread, and its GPU time, which covers a GPU that runs behind the CPU.
+/// </summary>
+struct DynamicResolution
+{
+	float targetMilliseconds = 0.0f;		// Frame time that the resolution is adjusted to stay under
+	float minScale = 0.5f;					// Smallest fraction of the output width and height that is rendered
+	float maxScale = 1.0f;					// Largest fraction of the output width and height that is rendered
+
+	int outputWidth = 0;					// Size of the output framebuffer, and of the target's storage
+	int outputHeight = 0;
+	float scale = 1.0f;						// Fraction of the output size that is rendered
+	int width = 0;							// Internal resolution of the current frame
+	int height = 0;
+
+	GLuint framebuffer = 0;
+	GLuint colorRenderbuffer = 0;
+	GLuint depthRenderbuffer = 0;
+
+	GLuint queries[DynamicResolutionLatency][2] = {};	// GL_TIMESTAMP queries at the start and the end of every frame
+	int queryWidths[DynamicResolutionLatency] = {};	// Internal width the frame was drawn at, 0 when no queries were issued
+	double cpuMilliseconds[DynamicResolutionLatency] = {};	// CPU time of the frame, as the caller measured it
+	int64_t frameNumber = -1;
+	double smoothedMilliseconds = -1.0;		// Running average of the frame time at the current resolution (-1 before the first)
+	int measuredFrames = 0;					// Frames in the running average since the resolution last changed
+
+	int64_t frames = 0;						// Frames drawn, for the average scale
+	double scaleSum = 0.0;
+	float lowestScale = 1.0f;
+	int64_t changes = 0;					// Number of times the resolution changed
+};
+
+/// <summary>
+/// Creates the render target at the size of the output framebuffer and starts at the largest allowed scale.
+/// </summary>
+/// <param name="resolution">Dynamic resolution that will be created</param>
+/// <param name="outputWidth">Width of the output framebuffer</param>
+/// <param name="outputHeight">Height of the output framebuffer</param>
+/// <param name="targetMilliseconds">Frame time to stay under</param>
+/// <param name="minScale">Smallest fraction of the output size to render</param>
+/// <param name="maxScale">Largest fraction of the output size to render (at most 1)</param>
+/// <returns>True if the render target is complete, false otherwise</returns>
+bool CreateDynamicResolution(DynamicResolution& resolution, int outputWidth, int outputHeight, float targetMilliseconds, float minScale, float maxScale);
+
+/// <summary>
+/// Reallocates the render target when the output framebuffer changed size. The scale is kept.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+/// <param name="outputWidth">New width of the output framebuffer</param>
+/// <param name="outputHeight">New height of the output framebuffer</param>
+void ResizeDynamicResolution(DynamicResolution& resolution, int outputWidth, int outputHeight);
+
+/// <summary>
+/// Starts a frame: reads back the GPU time of the frame DynamicResolutionLatency frames ago, adjusts the internal
+/// resolution, and binds the render target with a viewport of the new resolution.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+/// <param name="previousFrameMilliseconds">CPU time of the previous frame, leaving out any wait for the display</param>
+void BeginDynamicResolutionFrame(DynamicResolution& resolution, double previousFrameMilliseconds);
+
+/// <summary>
+/// Ends a frame: stretches the internal resolution onto the output framebuffer with linear filtering, then binds
+/// the output framebuffer with a viewport of its full size.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+/// <param name="outputFramebuffer">Framebuffer that the frame is shown from (0 for the window)</param>
+void EndDynamicResolutionFrame(DynamicResolution& resolution, GLuint outputFramebuffer);
+
+/// <summary>
+/// Deletes the render target and the timer queries.
+/// </summary>
+/// <param name="resolution">Dynamic resolution</param>
+void DeleteDynamicResolution(DynamicResolution& resolution);
@@ -0,0 +1,309 @@
+#include "FrameRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#else
+#include <csignal>
+#endif
+
+/// <summary>
+/// Converts an RGBA frame to the planes of a Y4M frame: full-resolution Y, Cb and Cr with the studio-swing
+/// BT.601 coefficients that players assume when the header does not say otherwise.
+/// </summary>
+/// <param name="rgba">RGBA frame, bottom row first</param>
+/// <param name="width">Width of the frame</param>
+/// <param name="height">Height of the frame</param>
+/// <param name="planes">Receives the Y, Cb and Cr planes one after another, top row first</param>
+static void ConvertToYuv444(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& planes)
+{
+	size_t planeSize = static_cast<size_t>(width) * height;
+	planes.resize(planeSize * 3);
+	unsigned char* yPlane = planes.data();
+	unsigned char* cbPlane = yPlane + planeSize;
+	unsigned char* crPlane = cbPlane + planeSize;
+
+	for (int row = 0; row < height; ++row)
+	{
+		const unsigned char* source = rgba + static_cast<size_t>(height - 1 - row) * width * 4;
+		size_t offset = static_cast<size_t>(row) * width;
+		for (int x = 0; x < width; ++x, source += 4)
+		{
+			int r = source[0], g = source[1], b = source[2];
+
+			// Fixed-point coefficients scaled by 256, rounded
+			yPlane[offset + x] = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			cbPlane[offset + x] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			crPlane[offset + x] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+}
+
+/// <summary>
+/// Converts an RGBA frame to RGB24.
+/// </summary>
+/// <param name="rgba">RGBA frame, bottom row first</param>
+/// <param name="width">Width of the frame</param>
+/// <param name="height">Height of the frame</param>
+/// <param name="rgb">Receives the RGB rows, top row first</param>
+static void ConvertToRgb(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& rgb)
+{
+	rgb.resize(static_cast<size_t>(width) * height * 3);
+	unsigned char* target = rgb.data();
+	for (int row = height - 1; row >= 0; --row)
+	{
+		const unsigned char* source = rgba + static_cast<size_t>(row) * width * 4;
+		for (int x = 0; x < width; ++x, source += 4, target += 3)
+		{
+			target[0] = source[0];
+			target[1] = source[1];
+			target[2] = source[2];
+		}
+	}
+}
+
+/// <summary>
+/// Main function of the writer thread: converts and writes queued frames until the recording stops and the
+/// queue is empty.
+/// </summary>
+/// <param name="recorder">Recorder</param>
+static void RunFrameWriter(FrameRecorder& recorder)
+{
+	std::vector<unsigned char> converted;
+	for (;;)
+	{
+		std::vector<unsigned char> frame;
+		{
+			std::unique_lock<std::mutex> lock(recorder.mutex);
+			recorder.frameQueued.wait(lock, [&recorder] { return recorder.stopping || !recorder.queue.empty(); });
+			if (recorder.queue.empty())
+			{
+				return;
+			}
+
+			frame = std::move(recorder.queue.front());
+			recorder.queue.pop_front();
+		}
+		recorder.frameWritten.notify_one();
+
+		bool written;
+		if (recorder.format == RecordingY4M)
+		{
+			ConvertToYuv444(frame.data(), recorder.width, recorder.height, converted);
+			written = std::fputs("FRAME\n", recorder.file) >= 0
+				&& std::fwrite(converted.data(), 1, converted.size(), recorder.file) == converted.size();
+		}
+		else
+		{
+			ConvertToRgb(frame.data(), recorder.width, recorder.height, converted);
+			written = std::fwrite(converted.data(), 1, converted.size(), recorder.file) == converted.size();
+		}
+
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		if (written)
+		{
+			++recorder.writtenFrames;
+		}
+		else if (!recorder.failed)
+		{
+			// A closed pipe or a full disk will not get better, so stop converting frames that cannot be written
+			std::cerr << "Unable to write to the recording, later frames are dropped" << std::endl;
+			recorder.failed = true;
+		}
+		recorder.freeFrames.push_back(std::move(frame));
+	}
+}
+
+/// <summary>
+/// Opens the output of a recording, creates the pixel buffer objects and starts the writer thread.
+/// </summary>
+/// <param name="recorder">Recorder that will be started</param>
+/// <param name="output">File path, or "|" followed by a command whose input receives the frames</param>
+/// <param name="format">File format</param>
+/// <param name="width">Width of the frames</param>
+/// <param name="height">Height of the frames</param>
+/// <param name="framesPerSecond">Frame rate written into the Y4M header</param>
+/// <returns>True if the output was opened, false otherwise</returns>
+bool StartFrameRecorder(FrameRecorder& recorder, const std::string& output, RecordingFormat format, int width, int height, float framesPerSecond)
+{
+	recorder.width = width;
+	recorder.height = height;
+	recorder.format = format;
+
+	if (!output.empty() && output[0] == '|')
+	{
+#if defined(_WIN32)
+		recorder.file = popen(output.c_str() + 1, "wb");
+#else
+		// Writing to a command that has exited raises SIGPIPE, which would end the whole program. Ignored, the write
+		// fails instead, and the writer thread stops the recording
+		std::signal(SIGPIPE, SIG_IGN);
+		recorder.file = popen(output.c_str() + 1, "w");
+#endif
+		recorder.isPipe = true;
+	}
+	else
+	{
+		recorder.file = std::fopen(output.c_str(), "wb");
+	}
+
+	if (recorder.file == nullptr)
+	{
+		std::cerr << "Unable to open recording output: " << output << std::endl;
+		return false;
+	}
+
+	if (format == RecordingY4M)
+	{
+		// Frame rates are written as a fraction, so a rate such as 29.97 survives
+		int rate = static_cast<int>(framesPerSecond * 1000.0f + 0.5f);
+		std::fprintf(recorder.file, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C444\n", width, height, std::max(rate, 1));
+	}
+
+	size_t frameSize = static_cast<size_t>(width) * height * 4;
+	glGenBuffers(FrameRecorderSlots, recorder.buffers);
+	for (int i = 0; i < FrameRecorderSlots; ++i)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, recorder.buffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	recorder.writer = std::thread(RunFrameWriter, std::ref(recorder));
+	return true;
+}
+
+/// <summary>
+/// Maps the oldest slot that is waiting, copies its frame into the writer's queue and frees the slot.
+/// </summary>
+/// <param name="recorder">Recorder</param>
+/// <param name="wait">Whether to wait for the read into the slot to finish; if not, the slot is only collected if it already has</param>
+/// <returns>True if the slot was collected, false if its read has not finished yet</returns>
+static bool CollectOldestSlot(FrameRecorder& recorder, bool wait)
+{
+	int slot = recorder.oldestSlot;
+	GLsync fence = recorder.fences[slot];
+
+	auto waitStart = std::chrono::steady_clock::now();
+	GLenum status = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		return false;
+	}
+	glDeleteSync(fence);
+	recorder.fences[slot] = nullptr;
+
+	size_t frameSize = static_cast<size_t>(recorder.width) * recorder.height * 4;
+	std::vector<unsigned char> frame;
+	bool dropped;
+	{
+		// Hold the render thread back rather than dropping frames when the writer cannot keep up
+		std::unique_lock<std::mutex> lock(recorder.mutex);
+		recorder.frameWritten.wait(lock, [&recorder] { return recorder.queue.size() < FrameRecorderQueueLength || recorder.failed; });
+		dropped = recorder.failed;
+		if (!recorder.freeFrames.empty())
+		{
+			frame = std::move(recorder.freeFrames.back());
+			recorder.freeFrames.pop_back();
+		}
+	}
+	recorder.waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+	if (!dropped)
+	{
+		frame.resize(frameSize);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, recorder.buffers[slot]);
+		const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+		if (pixels != nullptr)
+		{
+			std::memcpy(frame.data(), pixels, frameSize);
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		{
+			std::lock_guard<std::mutex> lock(recorder.mutex);
+			recorder.queue.push_back(std::move(frame));
+		}
+		recorder.frameQueued.notify_one();
+		++recorder.recordedFrames;
+	}
+
+	recorder.oldestSlot = (slot + 1) % FrameRecorderSlots;
+	--recorder.pendingSlots;
+	return true;
+}
+
+/// <summary>
+/// Starts reading back the frame in the current read framebuffer, and hands the frames whose reads have finished
+/// to the writer thread. Only waits for the GPU when a slot is needed again before its read is done.
+/// </summary>
+/// <param name="recorder">Recorder</param>
+void RecordFrame(FrameRecorder& recorder)
+{
+	// Collect every frame whose read has already finished, and the one in the slot that is about to be reused
+	while (recorder.pendingSlots > 0)
+	{
+		bool slotNeeded = recorder.pendingSlots == FrameRecorderSlots;
+		if (!CollectOldestSlot(recorder, slotNeeded))
+		{
+			break;
+		}
+	}
+
+	// The read goes into the buffer and returns right away; the fence tells when the GPU has finished it
+	int slot = recorder.nextSlot;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, recorder.buffers[slot]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, recorder.width, recorder.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	recorder.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	recorder.nextSlot = (slot + 1) % FrameRecorderSlots;
+	++recorder.pendingSlots;
+}
+
+/// <summary>
+/// Writes the frames that are still being read back, waits for the writer thread and closes the output.
+/// </summary>
+/// <param name="recorder">Recorder</param>
+/// <returns>True if every frame was written, false otherwise</returns>
+bool StopFrameRecorder(FrameRecorder& recorder)
+{
+	if (recorder.file == nullptr)
+	{
+		return false;
+	}
+
+	while (recorder.pendingSlots > 0)
+	{
+		CollectOldestSlot(recorder, true);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		recorder.stopping = true;
+	}
+	recorder.frameQueued.notify_one();
+	recorder.writer.join();
+
+	bool closed;
+	if (recorder.isPipe)
+	{
+		closed = pclose(recorder.file) == 0;
+	}
+	else
+	{
+		closed = std::fclose(recorder.file) == 0;
+	}
+	recorder.file = nullptr;
+
+	glDeleteBuffers(FrameRecorderSlots, recorder.buffers);
+
+	return closed && !recorder.failed && recorder.writtenFrames == recorder.recordedFrames;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Number of pixel buffer objects that frames are read back into. A frame is mapped when its slot comes around
+/// again, so the GPU has this many frames minus one to finish it before the render thread could ever wait.
+/// </summary>
+const int FrameRecorderSlots = 3;
+
+/// <summary>
+/// Most frames that may wait for the writer thread before the render thread waits for it
+/// </summary>
+const size_t FrameRecorderQueueLength = 8;
+
+/// <summary>
+/// File formats of a recording
+/// </summary>
+enum RecordingFormat
+{
+	RecordingY4M,				// YUV4MPEG2 with 4:4:4 BT.601 frames, which video tools read without any settings
+	RecordingRawRGB				// Bare RGB24 frames, top row first, with nothing in between
+};
+
+/// <summary>
+/// Struct containing a recording of the rendered frames. The render thread only starts asynchronous reads into a
+/// ring of pixel buffer objects; frames are mapped a few frames later, once their fences have passed, and a
+/// background thread converts and writes them to a file or pipe.
+/// </summary>
+struct FrameRecorder
+{
+	int width = 0;
+	int height = 0;
+	RecordingFormat format = RecordingY4M;
+	FILE* file = nullptr;
+	bool isPipe = false;					// The output was opened with popen() and is closed with pclose()
+
+	GLuint buffers[FrameRecorderSlots] = {};	// Pixel buffer objects (GL_PIXEL_PACK_BUFFER)
+	GLsync fences[FrameRecorderSlots] = {};	// Passed once the read into the slot has finished; null when the slot is free
+	int nextSlot = 0;						// Slot that the next frame is read into
+	int oldestSlot = 0;						// Oldest slot that is still waiting to be mapped
+	int pendingSlots = 0;					// Slots that were read into and not mapped yet
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable frameQueued;	// Signaled when a frame is queued or the recording stops
+	std::condition_variable frameWritten;	// Signaled when the writer takes a frame off the queue
+	std::deque<std::vector<unsigned char>> queue;	// RGBA frames, bottom row first, waiting to be written
+	std::vector<std::vector<unsigned char>> freeFrames;	// Frames that were written and can be reused
+	bool stopping = false;
+	bool failed = false;					// A write failed; later frames are dropped
+
+	int64_t recordedFrames = 0;				// Frames handed to the writer
+	int64_t writtenFrames = 0;				// Frames written to the output
+	double waitMilliseconds = 0.0;			// Time the render thread spent waiting for fences or the writer
+};
+
+/// <summary>
+/// Opens the output of a recording, creates the pixel buffer objects and starts the writer thread.
+/// </summary>
+/// <param name="recorder">Recorder that will be started</param>
+/// <param name="output">File path, or "|" followed by a command whose input receives the frames</param>
+/// <param name="format">File format</param>
+/// <param name="width">Width of the frames</param>
+/// <param name="height">Height of the frames</param>
+/// <param name="framesPerSecond">Frame rate written into the Y4M header</param>
+/// <returns>True if the output was opened, false otherwise</returns>
+bool StartFrameRecorder(FrameRecorder& recorder, const std::string& output, RecordingFormat format, int width, int height, float framesPerSecond);
+
+/// <summary>
+/// Starts reading back the frame in the current read framebuffer, and hands the frames whose reads have finished
+/// to the writer thread. Only waits for the GPU when a slot is needed again before its read is done.
+/// </summary>
+/// <param name="recorder">Recorder</param>
+void RecordFrame(FrameRecorder& recorder);
+
+/// <summary>
+/// Writes the frames that are still being read back, waits for the writer thread and closes the output.
+/// </summary>
+/// <param name="recorder">Recorder</param>
+/// <returns>True if every frame was written, false otherwise</returns>
+bool StopFrameRecorder(FrameRecorder& recorder);
@@ -0,0 +1,192 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+
+/// <summary>
+/// Storage buffer binding points of cull.csh
+/// </summary>
+enum GpuCullingBinding
+{
+	InstancesBinding = 0,
+	MeshBoundsBinding = 1,
+	CommandsBinding = 2,
+	VisibleObjectsBinding = 3
+};
+
+/// <summary>
+/// Number of invocations per work group of cull.csh
+/// </summary>
+static const GLuint CullGroupSize = 64;
+
+/// <summary>
+/// Checks whether the current context can run the GPU-driven path.
+/// </summary>
+/// <returns>True for OpenGL 4.3 or newer, false otherwise</returns>
+bool IsGpuCullingSupported()
+{
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+/// <summary>
+/// Creates the buffers, the vertex array object and the culling program of the GPU-driven path.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path that will be created</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <returns>True if the culling program linked, false otherwise</returns>
+bool CreateGpuCulling(GpuCulling& gpuCulling, ShaderCache& shaderCache, const std::vector<SceneObject>& scene,
+	const MeshBuffers& meshBuffers)
+{
+	BeginComputeProgram(shaderCache, gpuCulling.cullProgram, "cull.csh");
+	if (!FinishShaderProgram(shaderCache, gpuCulling.cullProgram))
+	{
+		return false;
+	}
+	gpuCulling.frustumPlanesLocation = glGetUniformLocation(gpuCulling.cullProgram.program, "frustumPlanes");
+	gpuCulling.objectCountLocation = glGetUniformLocation(gpuCulling.cullProgram.program, "objectCount");
+	gpuCulling.cameraPositionLocation = glGetUniformLocation(gpuCulling.cullProgram.program, "cameraPosition");
+	gpuCulling.pixelsPerUnitLocation = glGetUniformLocation(gpuCulling.cullProgram.program, "pixelsPerUnit");
+	gpuCulling.objectCount = static_cast<GLuint>(scene.size());
+
+	// Local bounding box of every mesh, with the number of levels and the bounding sphere radius in the w components
+	std::vector<glm::vec4> meshBounds;
+	for (int mesh = 0; mesh < MeshTypeCount; ++mesh)
+	{
+		const MeshRange& range = meshBuffers.ranges[mesh][0];
+		meshBounds.push_back(glm::vec4(range.boundsMin[0], range.boundsMin[1], range.boundsMin[2], static_cast<float>(meshBuffers.lodCounts[mesh])));
+		meshBounds.push_back(glm::vec4(range.boundsMax[0], range.boundsMax[1], range.boundsMax[2], range.radius));
+	}
+	glGenBuffers(1, &gpuCulling.meshBoundsBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gpuCulling.meshBoundsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, meshBounds.size() * sizeof(glm::vec4), meshBounds.data(), GL_STATIC_DRAW);
+
+	// Each level of a mesh gets room for all of the mesh's objects in the visible object buffer
+	GLuint meshObjectCounts[MeshTypeCount] = {};
+	for (const SceneObject& object : scene)
+	{
+		++meshObjectCounts[object.mesh];
+	}
+
+	GLuint baseInstance = 0;
+	gpuCulling.resetCommands.clear();
+	for (int mesh = 0; mesh < MeshTypeCount; ++mesh)
+	{
+		for (int lod = 0; lod < MeshLodCount; ++lod)
+		{
+			// Levels past the mesh's last one keep an empty command, so the command of a level is always mesh * MeshLodCount + lod
+			const MeshRange& range = meshBuffers.ranges[mesh][lod];
+			gpuCulling.resetCommands.push_back({ static_cast<GLuint>(range.indexCount), 0, range.firstIndex, range.baseVertex, baseInstance });
+			baseInstance += lod < meshBuffers.lodCounts[mesh] ? meshObjectCounts[mesh] : 0;
+		}
+	}
+
+	glGenBuffers(1, &gpuCulling.commandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCulling.commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, gpuCulling.resetCommands.size() * sizeof(DrawElementsIndirectCommand),
+		gpuCulling.resetCommands.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glGenBuffers(1, &gpuCulling.visibleBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gpuCulling.visibleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(baseInstance, 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// The instance attribute starts at each command's baseInstance, so one vertex array object serves every mesh and level
+	glGenVertexArrays(1, &gpuCulling.vao);
+	glBindVertexArray(gpuCulling.vao);
+	SetupVertexAttributes(meshBuffers);
+	glBindBuffer(GL_ARRAY_BUFFER, gpuCulling.visibleBuffer);
+	glEnableVertexAttribArray(4);
+	glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glVertexAttribDivisor(4, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+/// <summary>
+/// Culls every scene object against the frustum on the GPU, picks the level of detail of the visible ones and writes
+/// the indirect draw commands. The current instance data must have been uploaded.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+/// <param name="state">State cache</param>
+/// <param name="instanceBuffers">Instance buffers of the scene</param>
+/// <param name="frustum">View frustum</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera</param>
+void DispatchGpuCulling(GpuCulling& gpuCulling, RenderState& state, const InstanceBuffers& instanceBuffers, const Frustum& frustum,
+	const glm::vec3& cameraPosition, float pixelsPerUnit)
+{
+	// Start every command with no instances
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCulling.commandBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, gpuCulling.resetCommands.size() * sizeof(DrawElementsIndirectCommand), gpuCulling.resetCommands.data());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	UseProgramCached(state, gpuCulling.cullProgram.program);
+	glUniform4fv(gpuCulling.frustumPlanesLocation, 6, &frustum.planes[0][0]);
+	glUniform1ui(gpuCulling.objectCountLocation, gpuCulling.objectCount);
+	glUniform3f(gpuCulling.cameraPositionLocation, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+	glUniform1f(gpuCulling.pixelsPerUnitLocation, pixelsPerUnit);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, InstancesBinding, instanceBuffers.dataBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MeshBoundsBinding, gpuCulling.meshBoundsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandsBinding, gpuCulling.commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VisibleObjectsBinding, gpuCulling.visibleBuffer);
+
+	glDispatchCompute((gpuCulling.objectCount + CullGroupSize - 1) / CullGroupSize, 1, 1);
+
+	// The draw reads the commands as indirect arguments and the visible objects as a vertex attribute
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+/// <summary>
+/// Draws every visible object with one glMultiDrawElementsIndirect() call. The instanced shader program must be
+/// in use and the instance data must be bound.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+/// <param name="state">State cache</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+void DrawGpuCulled(const GpuCulling& gpuCulling, RenderState& state, const MeshBuffers& meshBuffers)
+{
+	BindVertexArrayCached(state, gpuCulling.vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCulling.commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, meshBuffers.indexType, nullptr, static_cast<GLsizei>(gpuCulling.resetCommands.size()), 0);
+	++state.drawCalls;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/// <summary>
+/// Reads back the number of objects that passed culling. Waits for the GPU, so it is only meant for statistics.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+/// <returns>Number of visible objects</returns>
+size_t ReadGpuVisibleCount(const GpuCulling& gpuCulling)
+{
+	std::vector<DrawElementsIndirectCommand> commands(gpuCulling.resetCommands.size());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCulling.commandBuffer);
+	glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	size_t visibleCount = 0;
+	for (const DrawElementsIndirectCommand& command : commands)
+	{
+		visibleCount += command.instanceCount;
+	}
+	return visibleCount;
+}
+
+/// <summary>
+/// Deletes the buffers, the vertex array object and the culling program.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+void DeleteGpuCulling(GpuCulling& gpuCulling)
+{
+	DeleteShaderProgram(gpuCulling.cullProgram);
+	glDeleteBuffers(1, &gpuCulling.meshBoundsBuffer);
+	glDeleteBuffers(1, &gpuCulling.commandBuffer);
+	glDeleteBuffers(1, &gpuCulling.visibleBuffer);
+	glDeleteVertexArrays(1, &gpuCulling.vao);
+	gpuCulling = GpuCulling();
+}
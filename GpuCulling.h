@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "Culling.h"
+#include "Instancing.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "ShaderProgram.h"
+
+/// <summary>
+/// Layout of one record of the indirect draw buffer, as glMultiDrawElementsIndirect() reads it
+/// </summary>
+struct DrawElementsIndirectCommand
+{
+	GLuint count;				// Number of indices of the mesh's level of detail
+	GLuint instanceCount;		// Number of visible objects, counted by cull.csh
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;		// First entry of the level's part of the visible object buffer
+};
+
+/// <summary>
+/// Struct containing the GPU-driven path (OpenGL 4.3): a compute shader culls every object against the frustum, picks
+/// its level of detail and fills one indirect draw command per mesh and level, and the whole scene is drawn with a
+/// single glMultiDrawElementsIndirect().
+/// The object transforms are the instance data buffer of the instanced path, read as a shader storage buffer.
+/// </summary>
+struct GpuCulling
+{
+	ShaderProgram cullProgram;				// cull.csh
+	GLint frustumPlanesLocation = -1;
+	GLint objectCountLocation = -1;
+	GLint cameraPositionLocation = -1;
+	GLint pixelsPerUnitLocation = -1;
+
+	GLuint meshBoundsBuffer = 0;			// Shader storage buffer with the local bounding box, bounding sphere and level count of every mesh
+	GLuint commandBuffer = 0;				// One DrawElementsIndirectCommand per mesh and level of detail
+	GLuint visibleBuffer = 0;				// Scene object of every drawn instance (storage buffer and vertex attribute 4)
+	GLuint vao = 0;							// Mesh attributes plus the visible object buffer as per-instance attribute
+	std::vector<DrawElementsIndirectCommand> resetCommands;	// Commands with no instances, copied in before every dispatch
+	GLuint objectCount = 0;
+};
+
+/// <summary>
+/// Checks whether the current context can run the GPU-driven path.
+/// </summary>
+/// <returns>True for OpenGL 4.3 or newer, false otherwise</returns>
+bool IsGpuCullingSupported();
+
+/// <summary>
+/// Creates the buffers, the vertex array object and the culling program of the GPU-driven path.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path that will be created</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <returns>True if the culling program linked, false otherwise</returns>
+bool CreateGpuCulling(GpuCulling& gpuCulling, ShaderCache& shaderCache, const std::vector<SceneObject>& scene,
+	const MeshBuffers& meshBuffers);
+
+/// <summary>
+/// Culls every scene object against the frustum on the GPU, picks the level of detail of the visible ones and writes
+/// the indirect draw commands. The current instance data must have been uploaded.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+/// <param name="state">State cache</param>
+/// <param name="instanceBuffers">Instance buffers of the scene</param>
+/// <param name="frustum">View frustum</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="pixelsPerUnit">Pixels that one unit covers at distance 1 from the camera</param>
+void DispatchGpuCulling(GpuCulling& gpuCulling, RenderState& state, const InstanceBuffers& instanceBuffers, const Frustum& frustum,
+	const glm::vec3& cameraPosition, float pixelsPerUnit);
+
+/// <summary>
+/// Draws every visible object with one glMultiDrawElementsIndirect() call. The instanced shader program must be
+/// in use and the instance data must be bound.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+/// <param name="state">State cache</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+void DrawGpuCulled(const GpuCulling& gpuCulling, RenderState& state, const MeshBuffers& meshBuffers);
+
+/// <summary>
+/// Reads back the number of objects that passed culling. Waits for the GPU, so it is only meant for statistics.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+/// <returns>Number of visible objects</returns>
+size_t ReadGpuVisibleCount(const GpuCulling& gpuCulling);
+
+/// <summary>
+/// Deletes the buffers, the vertex array object and the culling program.
+/// </summary>
+/// <param name="gpuCulling">GPU-driven path</param>
+void DeleteGpuCulling(GpuCulling& gpuCulling);
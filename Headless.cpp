@@ -0,0 +1,280 @@
+#include "Headless.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// macOS has no EGL, so headless rendering is only available on platforms that ship it (Linux with Mesa, etc.)
+#if !defined(__APPLE__)
+#define HEADLESS_USE_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#if HEADLESS_USE_EGL
+
+/// <summary>
+/// Checks whether an extension name appears in an EGL extension string.
+/// </summary>
+/// <param name="extensions">Space-separated extension string</param>
+/// <param name="name">Name of the extension</param>
+/// <returns>True if the extension is listed, false otherwise</returns>
+static bool HasEglExtension(const char* extensions, const std::string& name)
+{
+	if (extensions == nullptr)
+	{
+		return false;
+	}
+
+	std::string list = std::string(" ") + extensions + " ";
+	return list.find(" " + name + " ") != std::string::npos;
+}
+
+/// <summary>
+/// Opens the EGL display to render with. The Mesa surfaceless platform is preferred since it needs
+/// neither an X server nor a GPU; the default display is used as a fallback.
+/// </summary>
+/// <returns>Initialized EGL display, or EGL_NO_DISPLAY on failure</returns>
+static EGLDisplay OpenEglDisplay()
+{
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	if (HasEglExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay != nullptr)
+		{
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+	}
+
+	if (display == EGL_NO_DISPLAY)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || eglInitialize(display, &major, &minor) != EGL_TRUE)
+	{
+		return EGL_NO_DISPLAY;
+	}
+
+	return display;
+}
+
+#endif
+
+/// <summary>
+/// Creates an OpenGL core profile context without a window (EGL surfaceless platform, which works
+/// with Mesa llvmpipe on machines without a display or GPU) and makes it current on the calling thread.
+/// </summary>
+/// <param name="headless">Context that will be filled in</param>
+/// <param name="majorVersion">Requested OpenGL major version</param>
+/// <param name="minorVersion">Requested OpenGL minor version</param>
+/// <returns>True if the context was created, false otherwise</returns>
+bool CreateHeadlessContext(HeadlessContext& headless, int majorVersion, int minorVersion)
+{
+#if HEADLESS_USE_EGL
+	EGLDisplay display = OpenEglDisplay();
+	if (display == EGL_NO_DISPLAY)
+	{
+		std::cerr << "Failed to initialize EGL display!" << std::endl;
+		return false;
+	}
+
+	if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE)
+	{
+		std::cerr << "EGL does not support desktop OpenGL!" << std::endl;
+		eglTerminate(display);
+		return false;
+	}
+
+	const char* displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+	bool surfaceless = HasEglExtension(displayExtensions, "EGL_KHR_surfaceless_context");
+
+	// We never draw to an EGL surface (everything goes into our own framebuffer object),
+	// so any config works. A pbuffer config is only needed when surfaceless contexts are not supported.
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint numConfigs = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &numConfigs);
+	if (numConfigs == 0 && !HasEglExtension(displayExtensions, "EGL_KHR_no_config_context"))
+	{
+		std::cerr << "Failed to find a suitable EGL config!" << std::endl;
+		eglTerminate(display);
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+		EGL_CONTEXT_MINOR_VERSION, minorVersion,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		std::cerr << "Failed to create OpenGL " << majorVersion << "." << minorVersion << " context through EGL!" << std::endl;
+		eglTerminate(display);
+		return false;
+	}
+
+	EGLSurface surface = EGL_NO_SURFACE;
+	if (!surfaceless)
+	{
+		const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+	}
+
+	if (eglMakeCurrent(display, surface, surface, context) != EGL_TRUE)
+	{
+		std::cerr << "Failed to make the EGL context current!" << std::endl;
+		eglDestroyContext(display, context);
+		eglTerminate(display);
+		return false;
+	}
+
+	headless.display = display;
+	headless.context = context;
+	headless.surface = surface;
+	return true;
+#else
+	std::cerr << "Headless rendering is not supported on this platform!" << std::endl;
+	return false;
+#endif
+}
+
+/// <summary>
+/// Looks up an OpenGL function for the headless context. Pass this to gladLoadGLLoader().
+/// </summary>
+/// <param name="name">Name of the OpenGL function</param>
+/// <returns>Address of the function, or nullptr if it is not available</returns>
+void* GetHeadlessProcAddress(const char* name)
+{
+#if HEADLESS_USE_EGL
+	return reinterpret_cast<void*>(eglGetProcAddress(name));
+#else
+	return nullptr;
+#endif
+}
+
+/// <summary>
+/// Creates the offscreen framebuffer (color and depth renderbuffers) and binds it, so that
+/// everything that would normally go to the window goes to the framebuffer instead.
+/// OpenGL functions must be loaded before calling this.
+/// </summary>
+/// <param name="headless">Headless context</param>
+/// <param name="width">Width of the framebuffer</param>
+/// <param name="height">Height of the framebuffer</param>
+/// <returns>True if the framebuffer is complete, false otherwise</returns>
+bool CreateHeadlessFramebuffer(HeadlessContext& headless, int width, int height)
+{
+	glGenRenderbuffers(1, &headless.colorRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, headless.colorRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &headless.depthRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, headless.depthRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &headless.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, headless.framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless.colorRenderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headless.depthRenderbuffer);
+
+	headless.width = width;
+	headless.height = height;
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Offscreen framebuffer is incomplete!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Destroys the offscreen framebuffer and the context.
+/// </summary>
+/// <param name="headless">Headless context</param>
+void DestroyHeadlessContext(HeadlessContext& headless)
+{
+#if HEADLESS_USE_EGL
+	if (headless.context == nullptr)
+	{
+		return;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &headless.framebuffer);
+	glDeleteRenderbuffers(1, &headless.colorRenderbuffer);
+	glDeleteRenderbuffers(1, &headless.depthRenderbuffer);
+
+	EGLDisplay display = static_cast<EGLDisplay>(headless.display);
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (headless.surface != nullptr)
+	{
+		eglDestroySurface(display, static_cast<EGLSurface>(headless.surface));
+	}
+	eglDestroyContext(display, static_cast<EGLContext>(headless.context));
+	eglTerminate(display);
+
+	headless = HeadlessContext();
+#endif
+}
+
+/// <summary>
+/// Reads back the currently bound framebuffer and writes it to a binary PPM file.
+/// </summary>
+/// <param name="filePath">Path of the image file</param>
+/// <param name="width">Width of the region to read</param>
+/// <param name="height">Height of the region to read</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteFramebufferToFile(const std::string& filePath, int width, int height)
+{
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+
+	// Rows are tightly packed RGB, so make sure OpenGL does not pad them to 4 bytes
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+	return WriteImageToFile(filePath, width, height, pixels.data());
+}
+
+/// <summary>
+/// Writes an image to a binary PPM file.
+/// </summary>
+/// <param name="filePath">Path of the image file</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="pixels">Tightly packed RGB rows, bottom to top like OpenGL reads them back</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteImageToFile(const std::string& filePath, int width, int height, const unsigned char* pixels)
+{
+	FILE* file = std::fopen(filePath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		std::cerr << "Unable to open image file for writing: " << filePath << std::endl;
+		return false;
+	}
+
+	std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+	// OpenGL's origin is the lower-left corner, while image files start with the top row
+	size_t rowSize = static_cast<size_t>(width) * 3;
+	for (int row = height - 1; row >= 0; --row)
+	{
+		std::fwrite(pixels + row * rowSize, 1, rowSize, file);
+	}
+
+	std::fclose(file);
+	return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+
+/// <summary>
+/// Struct containing an OpenGL context that is not attached to a window,
+/// together with the framebuffer object that it renders into
+/// </summary>
+struct HeadlessContext
+{
+	void* display = nullptr;		// EGLDisplay
+	void* context = nullptr;		// EGLContext
+	void* surface = nullptr;		// EGLSurface (only used when surfaceless contexts are not supported)
+	GLuint framebuffer = 0;			// Offscreen framebuffer that replaces the window's default framebuffer
+	GLuint colorRenderbuffer = 0;
+	GLuint depthRenderbuffer = 0;
+	int width = 0;
+	int height = 0;
+};
+
+/// <summary>
+/// Creates an OpenGL core profile context without a window (EGL surfaceless platform, which works
+/// with Mesa llvmpipe on machines without a display or GPU) and makes it current on the calling thread.
+/// </summary>
+/// <param name="headless">Context that will be filled in</param>
+/// <param name="majorVersion">Requested OpenGL major version</param>
+/// <param name="minorVersion">Requested OpenGL minor version</param>
+/// <returns>True if the context was created, false otherwise</returns>
+bool CreateHeadlessContext(HeadlessContext& headless, int majorVersion, int minorVersion);
+
+/// <summary>
+/// Looks up an OpenGL function for the headless context. Pass this to gladLoadGLLoader().
+/// </summary>
+/// <param name="name">Name of the OpenGL function</param>
+/// <returns>Address of the function, or nullptr if it is not available</returns>
+void* GetHeadlessProcAddress(const char* name);
+
+/// <summary>
+/// Creates the offscreen framebuffer (color and depth renderbuffers) and binds it, so that
+/// everything that would normally go to the window goes to the framebuffer instead.
+/// OpenGL functions must be loaded before calling this.
+/// </summary>
+/// <param name="headless">Headless context</param>
+/// <param name="width">Width of the framebuffer</param>
+/// <param name="height">Height of the framebuffer</param>
+/// <returns>True if the framebuffer is complete, false otherwise</returns>
+bool CreateHeadlessFramebuffer(HeadlessContext& headless, int width, int height);
+
+/// <summary>
+/// Destroys the offscreen framebuffer and the context.
+/// </summary>
+/// <param name="headless">Headless context</param>
+void DestroyHeadlessContext(HeadlessContext& headless);
+
+/// <summary>
+/// Reads back the currently bound framebuffer and writes it to a binary PPM file.
+/// </summary>
+/// <param name="filePath">Path of the image file</param>
+/// <param name="width">Width of the region to read</param>
+/// <param name="height">Height of the region to read</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteFramebufferToFile(const std::string& filePath, int width, int height);
+
+/// <summary>
+/// Writes an image to a binary PPM file.
+/// </summary>
+/// <param name="filePath">Path of the image file</param>
+/// <param name="width">Width of the image</param>
+/// <param name="height">Height of the image</param>
+/// <param name="pixels">Tightly packed RGB rows, bottom to top like OpenGL reads them back</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteImageToFile(const std::string& filePath, int width, int height, const unsigned char* pixels);
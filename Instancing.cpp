@@ -0,0 +1,261 @@
+#include "Instancing.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "ShaderVariants.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Creates the instance buffers with room for the given number of objects. The instance data is written with UploadInstances().
+/// </summary>
+/// <param name="buffers">Instance buffers that will be created</param>
+/// <param name="instanceCount">Number of objects</param>
+void CreateInstanceBuffers(InstanceBuffers& buffers, size_t instanceCount)
+{
+	buffers.capacity = std::max<size_t>(instanceCount, 1);
+
+	glGenBuffers(1, &buffers.dataBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers.dataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, buffers.capacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// The instanced shader fetches the data of the object an instance draws, so culling only has to
+	// rewrite a list of object indices instead of moving the instance data around
+	glGenTextures(1, &buffers.dataTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, buffers.dataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffers.dataBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	glGenBuffers(1, &buffers.visibleBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.visibleBuffer);
+	glBufferData(GL_ARRAY_BUFFER, MeshLodCount * buffers.capacity * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// <summary>
+/// Builds the instance data of a scene object.
+/// </summary>
+/// <param name="model">Model matrix of the object</param>
+/// <param name="object">Scene object</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <returns>Instance data</returns>
+static InstanceData MakeInstanceData(const glm::mat4& model, const SceneObject& object, const std::vector<SceneMaterial>& materials,
+	const MeshBuffers& meshBuffers)
+{
+	GLuint features = SelectShaderFeatures(materials[object.material], meshBuffers, object.mesh);
+	return { model, object.material, static_cast<GLuint>(object.mesh), features, 0 };
+}
+
+/// <summary>
+/// Writes the initial instance data of a range of scene objects, so a scene can be uploaded in chunks while it is loaded.
+/// </summary>
+/// <param name="buffers">Instance buffers</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="first">Index of the first object</param>
+/// <param name="count">Number of objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+void UploadInstances(const InstanceBuffers& buffers, const std::vector<SceneObject>& scene, size_t first, size_t count,
+	const std::vector<SceneMaterial>& materials, const MeshBuffers& meshBuffers)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::vector<InstanceData> instances(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const SceneObject& object = scene[first + i];
+		instances[i] = MakeInstanceData(ComputeModelMatrix(object, 0.0f), object, materials, meshBuffers);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers.dataBuffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(InstanceData), count * sizeof(InstanceData), instances.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/// <summary>
+/// Groups consecutive scene objects that share a mesh into batches and creates one vertex array object per batch
+/// and level of detail.
+/// Loaded scenes are sorted by mesh, so every mesh ends up in a single batch.
+/// </summary>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="buffers">Instance buffers</param>
+/// <returns>List of instance batches</returns>
+std::vector<InstanceBatch> CreateInstanceBatches(const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const InstanceBuffers& buffers)
+{
+	std::vector<InstanceBatch> batches;
+
+	for (size_t i = 0; i < scene.size(); ++i)
+	{
+		if (batches.empty() || batches.back().mesh != scene[i].mesh)
+		{
+			InstanceBatch batch = {};
+			batch.mesh = scene[i].mesh;
+			batch.firstInstance = static_cast<GLintptr>(i);
+			batches.push_back(batch);
+		}
+
+		++batches.back().instanceCount;
+	}
+
+	// Instanced draws in OpenGL 3.3 always start at instance 0, so each batch and level gets its own vertex array object
+	// whose instance attribute starts at the batch's part of the level's part of the visible buffer
+	for (InstanceBatch& batch : batches)
+	{
+		for (int lod = 0; lod < meshBuffers.lodCounts[batch.mesh]; ++lod)
+		{
+			glGenVertexArrays(1, &batch.vaos[lod]);
+			glBindVertexArray(batch.vaos[lod]);
+
+			SetupVertexAttributes(meshBuffers);
+
+			// Vertex attribute 4 - Scene object of the instance
+			GLintptr firstEntry = lod * static_cast<GLintptr>(buffers.capacity) + batch.firstInstance;
+			glBindBuffer(GL_ARRAY_BUFFER, buffers.visibleBuffer);
+			glEnableVertexAttribArray(4);
+			glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)(firstEntry * sizeof(GLuint)));
+			glVertexAttribDivisor(4, 1);
+		}
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return batches;
+}
+
+/// <summary>
+/// Re-uploads the instance data of the objects whose model matrices changed in the last UpdateTransforms().
+/// All other objects keep the data uploaded before.
+/// </summary>
+/// <param name="buffers">Instance buffers</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+void UpdateDynamicInstances(const InstanceBuffers& buffers, const std::vector<SceneObject>& scene, const TransformStore& transforms,
+	const std::vector<SceneMaterial>& materials, const MeshBuffers& meshBuffers)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers.dataBuffer);
+
+	for (uint32_t object : transforms.updatedObjects)
+	{
+		InstanceData data = MakeInstanceData(transforms.modelMatrices[object], scene[object], materials, meshBuffers);
+		glBufferSubData(GL_TEXTURE_BUFFER, object * sizeof(InstanceData), sizeof(InstanceData), &data);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/// <summary>
+/// Writes the indices of the visible objects of every batch into the batch's part of the visible buffer,
+/// split by the level of detail they are drawn with.
+/// </summary>
+/// <param name="batches">Instance batches, which receive their visible counts</param>
+/// <param name="buffers">Instance buffers</param>
+/// <param name="visibleObjects">Indices of the visible scene objects in ascending order</param>
+/// <param name="visibleLods">Level of detail of every visible object</param>
+void UpdateVisibleInstances(std::vector<InstanceBatch>& batches, const InstanceBuffers& buffers, const std::vector<uint32_t>& visibleObjects,
+	const std::vector<uint8_t>& visibleLods)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.visibleBuffer);
+
+	// Orphan last frame's list, which the GPU may still be reading
+	glBufferData(GL_ARRAY_BUFFER, MeshLodCount * buffers.capacity * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+
+	// Batches cover consecutive objects, so the visible objects of a batch are a consecutive part of the sorted list
+	std::vector<uint32_t> lodObjects;
+	std::vector<uint32_t>::const_iterator visible = visibleObjects.begin();
+	for (InstanceBatch& batch : batches)
+	{
+		std::vector<uint32_t>::const_iterator first = std::lower_bound(visible, visibleObjects.end(), static_cast<uint32_t>(batch.firstInstance));
+		visible = std::lower_bound(first, visibleObjects.end(), static_cast<uint32_t>(batch.firstInstance + batch.instanceCount));
+		std::fill(batch.visibleCounts, batch.visibleCounts + MeshLodCount, 0);
+
+		// Meshes with a single level can upload their part of the list as it is
+		if (batch.vaos[1] == 0)
+		{
+			batch.visibleCounts[0] = static_cast<GLsizei>(visible - first);
+			if (batch.visibleCounts[0] > 0)
+			{
+				glBufferSubData(GL_ARRAY_BUFFER, batch.firstInstance * sizeof(GLuint), batch.visibleCounts[0] * sizeof(GLuint), &*first);
+			}
+			continue;
+		}
+
+		// Otherwise sort the objects by level first, keeping them in ascending order within a level
+		size_t firstIndex = first - visibleObjects.begin();
+		size_t count = visible - first;
+		for (size_t i = firstIndex; i < firstIndex + count; ++i)
+		{
+			++batch.visibleCounts[visibleLods[i]];
+		}
+
+		size_t lodOffsets[MeshLodCount];
+		size_t offset = 0;
+		for (int lod = 0; lod < MeshLodCount; ++lod)
+		{
+			lodOffsets[lod] = offset;
+			offset += batch.visibleCounts[lod];
+		}
+
+		lodObjects.resize(count);
+		for (size_t i = firstIndex; i < firstIndex + count; ++i)
+		{
+			lodObjects[lodOffsets[visibleLods[i]]++] = visibleObjects[i];
+		}
+
+		offset = 0;
+		for (int lod = 0; lod < MeshLodCount; ++lod)
+		{
+			if (batch.visibleCounts[lod] > 0)
+			{
+				GLintptr firstEntry = lod * static_cast<GLintptr>(buffers.capacity) + batch.firstInstance;
+				glBufferSubData(GL_ARRAY_BUFFER, firstEntry * sizeof(GLuint), batch.visibleCounts[lod] * sizeof(GLuint), &lodObjects[offset]);
+			}
+			offset += batch.visibleCounts[lod];
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// <summary>
+/// Binds the buffer texture with the instance data to its texture unit.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="buffers">Instance buffers</param>
+void BindInstanceData(RenderState& state, const InstanceBuffers& buffers)
+{
+	BindTextureCached(state, InstancesTextureUnit, GL_TEXTURE_BUFFER, buffers.dataTexture);
+}
+
+/// <summary>
+/// Deletes the vertex array objects of the batches.
+/// </summary>
+/// <param name="batches">Instance batches</param>
+void DeleteInstanceBatches(std::vector<InstanceBatch>& batches)
+{
+	for (InstanceBatch& batch : batches)
+	{
+		glDeleteVertexArrays(MeshLodCount, batch.vaos);
+	}
+	batches.clear();
+}
+
+/// <summary>
+/// Deletes the instance buffers.
+/// </summary>
+/// <param name="buffers">Instance buffers</param>
+void DeleteInstanceBuffers(InstanceBuffers& buffers)
+{
+	glDeleteTextures(1, &buffers.dataTexture);
+	glDeleteBuffers(1, &buffers.dataBuffer);
+	glDeleteBuffers(1, &buffers.visibleBuffer);
+	buffers = InstanceBuffers();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "Transforms.h"
+
+/// <summary>
+/// Struct containing the instance data of a scene object, which main.vsh reads from a buffer texture with INSTANCED
+/// (five RGBA32F texels per object)
+/// </summary>
+struct InstanceData
+{
+	glm::mat4 model;		// Model matrix (texels 0 to 3, one column each)
+	GLuint material;		// Layer of the material texture array (texel 4, read with floatBitsToUint())
+	GLuint mesh;			// MeshType, read by cull.csh on the GPU-driven path
+	GLuint features;		// ShaderFeature flags of the object's own material and mesh (see ShaderVariants.h)
+	GLuint padding;
+};
+
+/// <summary>
+/// Struct containing the buffers of the instanced path. The instance data of every scene object stays in one
+/// buffer; each frame only the indices of the visible objects are written to the per-instance attribute buffer.
+/// The attribute buffer has one part of capacity entries per level of detail.
+/// </summary>
+struct InstanceBuffers
+{
+	GLuint dataBuffer = 0;			// InstanceData of every scene object, instance i belongs to scene object i
+	GLuint dataTexture = 0;			// Buffer texture over dataBuffer
+	GLuint visibleBuffer = 0;		// Vertex attribute 4: scene object drawn by each instance
+	size_t capacity = 0;			// Number of objects that the buffers have room for
+};
+
+/// <summary>
+/// Struct containing consecutive scene objects that share a mesh, so they can be drawn with one instanced draw call
+/// per level of detail. Each draw call is a DrawPacket with the level's vertex array object and visible count.
+/// </summary>
+struct InstanceBatch
+{
+	MeshType mesh;
+	GLuint vaos[MeshLodCount];			// Per level of detail: vertex array object whose instance attribute points at this
+										// batch's part of the level's visible buffer part, 0 past the mesh's levels
+	GLintptr firstInstance;				// Index of the batch's first scene object
+	GLsizei instanceCount;				// Number of scene objects in the batch
+	GLsizei visibleCounts[MeshLodCount];	// Number of them that passed culling this frame, per level of detail
+};
+
+/// <summary>
+/// Creates the instance buffers with room for the given number of objects. The instance data is written with UploadInstances().
+/// </summary>
+/// <param name="buffers">Instance buffers that will be created</param>
+/// <param name="instanceCount">Number of objects</param>
+void CreateInstanceBuffers(InstanceBuffers& buffers, size_t instanceCount);
+
+/// <summary>
+/// Writes the initial instance data of a range of scene objects, so a scene can be uploaded in chunks while it is loaded.
+/// </summary>
+/// <param name="buffers">Instance buffers</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="first">Index of the first object</param>
+/// <param name="count">Number of objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+void UploadInstances(const InstanceBuffers& buffers, const std::vector<SceneObject>& scene, size_t first, size_t count,
+	const std::vector<SceneMaterial>& materials, const MeshBuffers& meshBuffers);
+
+/// <summary>
+/// Groups consecutive scene objects that share a mesh into batches and creates one vertex array object per batch
+/// and level of detail.
+/// Loaded scenes are sorted by mesh, so every mesh ends up in a single batch.
+/// </summary>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="buffers">Instance buffers</param>
+/// <returns>List of instance batches</returns>
+std::vector<InstanceBatch> CreateInstanceBatches(const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers, const InstanceBuffers& buffers);
+
+/// <summary>
+/// Re-uploads the instance data of the objects whose model matrices changed in the last UpdateTransforms().
+/// All other objects keep the data uploaded before.
+/// </summary>
+/// <param name="buffers">Instance buffers</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+void UpdateDynamicInstances(const InstanceBuffers& buffers, const std::vector<SceneObject>& scene, const TransformStore& transforms,
+	const std::vector<SceneMaterial>& materials, const MeshBuffers& meshBuffers);
+
+/// <summary>
+/// Writes the indices of the visible objects of every batch into the batch's part of the visible buffer,
+/// split by the level of detail they are drawn with.
+/// </summary>
+/// <param name="batches">Instance batches, which receive their visible counts</param>
+/// <param name="buffers">Instance buffers</param>
+/// <param name="visibleObjects">Indices of the visible scene objects in ascending order</param>
+/// <param name="visibleLods">Level of detail of every visible object</param>
+void UpdateVisibleInstances(std::vector<InstanceBatch>& batches, const InstanceBuffers& buffers, const std::vector<uint32_t>& visibleObjects,
+	const std::vector<uint8_t>& visibleLods);
+
+/// <summary>
+/// Binds the buffer texture with the instance data to its texture unit.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="buffers">Instance buffers</param>
+void BindInstanceData(RenderState& state, const InstanceBuffers& buffers);
+
+/// <summary>
+/// Deletes the vertex array objects of the batches.
+/// </summary>
+/// <param name="batches">Instance batches</param>
+void DeleteInstanceBatches(std::vector<InstanceBatch>& batches);
+
+/// <summary>
+/// Deletes the instance buffers.
+/// </summary>
+/// <param name="buffers">Instance buffers</param>
+void DeleteInstanceBuffers(InstanceBuffers& buffers);
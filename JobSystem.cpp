@@ -0,0 +1,190 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+/// <summary>
+/// Takes the next job for a thread: the newest job of its own queue, or else the oldest job of another thread's
+/// queue, trying the threads after it in turn.
+/// </summary>
+/// <param name="system">Job system</param>
+/// <param name="thread">Index of the thread</param>
+/// <param name="job">Receives the job</param>
+/// <returns>True if a job was taken, false if every queue is empty</returns>
+static bool TakeJob(JobSystem& system, int thread, Job& job)
+{
+	int threadCount = static_cast<int>(system.queues.size());
+	for (int i = 0; i < threadCount; ++i)
+	{
+		int victim = (thread + i) % threadCount;
+		JobQueue& queue = *system.queues[victim];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+		{
+			continue;
+		}
+
+		if (victim == thread)
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			system.stolenJobs++;
+		}
+		system.queuedJobs--;
+		return true;
+	}
+	return false;
+}
+
+/// <summary>
+/// Runs a job and wakes the submitting thread if it was the last one.
+/// </summary>
+/// <param name="system">Job system</param>
+/// <param name="thread">Index of the thread that runs it</param>
+/// <param name="job">Job</param>
+static void RunJob(JobSystem& system, int thread, Job& job)
+{
+	job(thread);
+	if (--system.pendingJobs == 0)
+	{
+		std::lock_guard<std::mutex> lock(system.sleepMutex);
+		system.jobsFinished.notify_all();
+	}
+}
+
+/// <summary>
+/// Main function of a worker thread: runs and steals jobs, and sleeps while there are none, until the system is stopped.
+/// </summary>
+/// <param name="system">Job system</param>
+/// <param name="thread">Index of the thread</param>
+static void RunJobWorker(JobSystem& system, int thread)
+{
+	for (;;)
+	{
+		Job job;
+		if (TakeJob(system, thread, job))
+		{
+			RunJob(system, thread, job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(system.sleepMutex);
+		system.jobsQueued.wait(lock, [&system] { return system.stopping || system.queuedJobs > 0; });
+		if (system.stopping)
+		{
+			return;
+		}
+	}
+}
+
+/// <summary>
+/// Starts the worker threads of a job system.
+/// </summary>
+/// <param name="system">Job system</param>
+/// <param name="workerCount">Number of worker threads (0 picks one less than the number of hardware threads, at least one)</param>
+void StartJobSystem(JobSystem& system, unsigned int workerCount)
+{
+	if (workerCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	system.stopping = false;
+	for (unsigned int i = 0; i <= workerCount; ++i)
+	{
+		system.queues.push_back(std::make_unique<JobQueue>());
+	}
+	for (unsigned int i = 1; i <= workerCount; ++i)
+	{
+		system.workers.emplace_back(RunJobWorker, std::ref(system), static_cast<int>(i));
+	}
+}
+
+/// <summary>
+/// Stops the worker threads. No jobs may be running.
+/// </summary>
+/// <param name="system">Job system</param>
+void StopJobSystem(JobSystem& system)
+{
+	{
+		std::lock_guard<std::mutex> lock(system.sleepMutex);
+		system.stopping = true;
+	}
+	system.jobsQueued.notify_all();
+
+	for (std::thread& worker : system.workers)
+	{
+		worker.join();
+	}
+	system.workers.clear();
+	system.queues.clear();
+}
+
+/// <summary>
+/// Gets the number of threads that run jobs, including the one that calls ParallelFor().
+/// </summary>
+/// <param name="system">Job system</param>
+/// <returns>Number of worker threads plus one</returns>
+int GetJobThreadCount(const JobSystem& system)
+{
+	return static_cast<int>(system.workers.size()) + 1;
+}
+
+/// <summary>
+/// Splits a range of items into jobs of at most jobSize items, spreads them over the queues of all threads and runs
+/// them, helping on the calling thread. Returns when every job has finished.
+/// </summary>
+/// <param name="system">Job system</param>
+/// <param name="count">Number of items</param>
+/// <param name="jobSize">Largest number of items of one job</param>
+/// <param name="function">Called with the index of the job, its first item, its number of items and the thread it runs on</param>
+void ParallelFor(JobSystem& system, size_t count, size_t jobSize, const std::function<void(size_t job, size_t first, size_t count, int thread)>& function)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// A single job is not worth waking the workers for
+	size_t jobCount = (count + jobSize - 1) / jobSize;
+	if (jobCount == 1)
+	{
+		function(0, 0, count, 0);
+		system.submittedJobs++;
+		return;
+	}
+
+	// Consecutive jobs go to different threads, so every thread starts out with its share of the range
+	int threadCount = static_cast<int>(system.queues.size());
+	system.pendingJobs += static_cast<int>(jobCount);
+	for (size_t job = 0; job < jobCount; ++job)
+	{
+		size_t first = job * jobSize;
+		size_t jobItems = std::min(jobSize, count - first);
+		JobQueue& queue = *system.queues[job % threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back([&function, job, first, jobItems](int thread) { function(job, first, jobItems, thread); });
+		system.queuedJobs++;
+	}
+	system.submittedJobs += static_cast<int64_t>(jobCount);
+
+	// Taking the lock makes sure that a worker which just found the queues empty is already waiting, so it gets woken
+	{
+		std::lock_guard<std::mutex> lock(system.sleepMutex);
+	}
+	system.jobsQueued.notify_all();
+
+	// Run jobs here as well until the queues are empty, then wait for the ones still running elsewhere
+	Job job;
+	while (TakeJob(system, 0, job))
+	{
+		RunJob(system, 0, job);
+	}
+	std::unique_lock<std::mutex> lock(system.sleepMutex);
+	system.jobsFinished.wait(lock, [&system] { return system.pendingJobs == 0; });
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Job that runs on one thread of a job system. It gets the index of the thread it runs on: 0 for the thread that
+/// called ParallelFor(), 1 and up for the worker threads, so it can use data that belongs to that thread.
+/// </summary>
+typedef std::function<void(int thread)> Job;
+
+/// <summary>
+/// Struct containing the jobs of one thread. The owner takes jobs from the back, other threads steal from the front.
+/// </summary>
+struct JobQueue
+{
+	std::mutex mutex;
+	std::deque<Job> jobs;
+};
+
+/// <summary>
+/// Struct containing worker threads that each have their own queue of jobs. A thread that runs out of jobs steals
+/// from the others, so a job that takes longer than the rest does not hold up the threads that finished theirs.
+/// The thread that submits the jobs runs them too while it waits.
+/// </summary>
+struct JobSystem
+{
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<JobQueue>> queues;	// One per thread, queue 0 belongs to the submitting thread
+	std::atomic<int> queuedJobs{ 0 };		// Jobs waiting in the queues
+	std::atomic<int> pendingJobs{ 0 };		// Jobs that are queued or running
+	std::mutex sleepMutex;
+	std::condition_variable jobsQueued;		// Wakes the workers when jobs were submitted or the system stops
+	std::condition_variable jobsFinished;	// Wakes the submitting thread when the last job finished
+	bool stopping = false;
+
+	std::atomic<int64_t> stolenJobs{ 0 };	// Jobs that ran on another thread than the one they were queued on
+	int64_t submittedJobs = 0;
+};
+
+/// <summary>
+/// Starts the worker threads of a job system.
+/// </summary>
+/// <param name="system">Job system</param>
+/// <param name="workerCount">Number of worker threads (0 picks one less than the number of hardware threads, at least one)</param>
+void StartJobSystem(JobSystem& system, unsigned int workerCount = 0);
+
+/// <summary>
+/// Stops the worker threads. No jobs may be running.
+/// </summary>
+/// <param name="system">Job system</param>
+void StopJobSystem(JobSystem& system);
+
+/// <summary>
+/// Gets the number of threads that run jobs, including the one that calls ParallelFor().
+/// </summary>
+/// <param name="system">Job system</param>
+/// <returns>Number of worker threads plus one</returns>
+int GetJobThreadCount(const JobSystem& system);
+
+/// <summary>
+/// Splits a range of items into jobs of at most jobSize items, spreads them over the queues of all threads and runs
+/// them, helping on the calling thread. Returns when every job has finished.
+/// </summary>
+/// <param name="system">Job system</param>
+/// <param name="count">Number of items</param>
+/// <param name="jobSize">Largest number of items of one job</param>
+/// <param name="function">Called with the index of the job, its first item, its number of items and the thread it runs on</param>
+void ParallelFor(JobSystem& system, size_t count, size_t jobSize, const std::function<void(size_t job, size_t first, size_t count, int thread)>& function);
@@ -3,10 +3,15 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
-#include <fstream>
+#include <cstdio>
 #include <iostream>
+#include <numeric>
 #include <string>
+#include <thread>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -15,34 +20,37 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "BakedTexture.h"
+#include "Benchmark.h"
+#include "ClusteredLighting.h"
+#include "CommandRecording.h"
+#include "Culling.h"
+#include "DynamicResolution.h"
+#include "FrameRecorder.h"
+#include "GpuCulling.h"
+#include "Headless.h"
+#include "Instancing.h"
+#include "Mesh.h"
+#include "MeshGenerator.h"
+#include "Occlusion.h"
+#include "Options.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "ShadowMap.h"
+#include "ShaderProgram.h"
+#include "ShaderVariants.h"
+#include "Simulation.h"
+#include "SoftwareRenderer.h"
+#include "TextureLoader.h"
+#include "Transforms.h"
+#include "Uniforms.h"
+
 // ---------------
 // Function declarations
 // ---------------
 
-/// <summary>
-/// Creates a shader program based on the provided file paths for the vertex and fragment shaders.
-/// </summary>
-/// <param name="vertexShaderFilePath">Vertex shader file path</param>
-/// <param name="fragmentShaderFilePath">Fragment shader file path</param>
-/// <returns>OpenGL handle to the created shader program</returns>
-GLuint CreateShaderProgram(const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath);
-
-/// <summary>
-/// Creates a shader based on the provided shader type and the path to the file containing the shader source.
-/// </summary>
-/// <param name="shaderType">Shader type</param>
-/// <param name="shaderFilePath">Path to the file containing the shader source</param>
-/// <returns>OpenGL handle to the created shader</returns>
-GLuint CreateShaderFromFile(const GLuint& shaderType, const std::string& shaderFilePath);
-
-/// <summary>
-/// Creates a shader based on the provided shader type and the string containing the shader source.
-/// </summary>
-/// <param name="shaderType">Shader type</param>
-/// <param name="shaderSource">Shader source string</param>
-/// <returns>OpenGL handle to the created shader</returns>
-GLuint CreateShaderFromSource(const GLuint& shaderType, const std::string& shaderSource);
-
 /// <summary>
 /// Function for handling the event when the size of the framebuffer changed.
 /// </summary>
@@ -52,64 +60,197 @@ GLuint CreateShaderFromSource(const GLuint& shaderType, const std::string& shade
 void FramebufferSizeChangedCallback(GLFWwindow* window, int width, int height);
 
 /// <summary>
-/// Struct containing data about a vertex
+/// Renders the headless frames on the CPU with the software rasterizer instead of OpenGL.
 /// </summary>
-struct Vertex
-{
-	GLfloat x, y, z;	// Position
-	GLubyte r, g, b;	// Color
-	GLfloat u, v;		// UV coordinates
-	GLfloat nx, ny, nz; //Normal
-};
-
-GLfloat ambientStrength = 0.5f;
+/// <param name="options">Command line options</param>
+/// <param name="meshData">CPU-side meshes</param>
+/// <param name="sceneStream">Compiled scene whose objects have not been read yet (closed here)</param>
+/// <param name="sceneMaterials">Materials of the scene</param>
+/// <param name="scene">Scene objects read so far</param>
+/// <param name="sceneLights">Point lights of the scene</param>
+/// <param name="startupStart">Time at which the program started</param>
+/// <param name="sceneMilliseconds">Time spent loading the scene so far</param>
+/// <returns>Exit code of the program</returns>
+int RunSoftwareRenderer(const AppOptions& options, const MeshData& meshData, SceneStream& sceneStream, const std::vector<SceneMaterial>& sceneMaterials,
+	std::vector<SceneObject>& scene, const std::vector<ScenePointLight>& sceneLights, std::chrono::steady_clock::time_point startupStart,
+	double sceneMilliseconds);
 
 /// <summary>
 /// Main function.
 /// </summary>
+/// <param name="argc">Number of command line arguments</param>
+/// <param name="argv">Command line arguments (see PrintUsage() in Options.cpp)</param>
 /// <returns>An integer indicating whether the program ended successfully or not.
 /// A value of 0 indicates the program ended succesfully, while a non-zero value indicates
 /// something wrong happened during execution.</returns>
-int main()
+int main(int argc, char* argv[])
 {
-	// Initialize GLFW
-	int glfwInitStatus = glfwInit();
-	if (glfwInitStatus == GLFW_FALSE)
+	AppOptions options;
+	if (!ParseCommandLine(argc, argv, options))
 	{
-		std::cerr << "Failed to initialize GLFW!" << std::endl;
 		return 1;
 	}
 
-	// Tell GLFW that we prefer to use OpenGL 3.3
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	// The benchmark suite runs every configuration in a child process of its own and only collects the results
+	if (!options.benchmarkSuite.empty())
+	{
+		return RunBenchmarkSuite(argv[0], options);
+	}
 
-	// Tell GLFW that we prefer to use the modern OpenGL
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// Offline step: convert the scene text into the binary form that loads without parsing
+	std::string compiledScenePath = GetCompiledScenePath(options.sceneFilePath);
+	if (options.compileScene)
+	{
+		if (!CompileScene(options.sceneFilePath, compiledScenePath))
+		{
+			return 1;
+		}
+		std::cout << "Compiled " << options.sceneFilePath << " -> " << compiledScenePath << std::endl;
+		if (!options.bakeTextures)
+		{
+			return 0;
+		}
+	}
 
-	// Tell GLFW to create a window
-	float windowWidth = 800;
-	float windowHeight = 800;
-	GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Final Project", nullptr, nullptr);
-	if (window == nullptr)
+	// Used to measure how long it takes until the first frame is on screen
+	std::chrono::steady_clock::time_point startupStart = std::chrono::steady_clock::now();
+
+	// Materials, objects and point lights of the scene. A compiled scene is only mapped here; its objects are streamed
+	// into the instance buffer once there is a context. Otherwise the text version is parsed
+	std::chrono::steady_clock::time_point sceneStart = std::chrono::steady_clock::now();
+	std::vector<SceneMaterial> sceneMaterials;
+	std::vector<SceneObject> scene;
+	std::vector<ScenePointLight> sceneLights;
+	SceneStream sceneStream;
+	if (options.benchmarkObjects > 0)
+	{
+		// Benchmark runs draw copies of the room instead of a scene file
+		GenerateBenchmarkScene(GetBenchmarkConfig(options), sceneMaterials, scene, sceneLights);
+	}
+	else if (!(options.useCompiledScene && OpenSceneStream(sceneStream, compiledScenePath, sceneMaterials, sceneLights))
+		&& !ParseSceneText(options.sceneFilePath, sceneMaterials, scene, sceneLights))
 	{
-		std::cerr << "Failed to create GLFW window!" << std::endl;
-		glfwTerminate();
 		return 1;
 	}
+	double sceneMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sceneStart).count();
 
-	// Tell GLFW to use the OpenGL context that was assigned to the window that we just created
-	glfwMakeContextCurrent(window);
+	// Offline step: convert the images into textures that load without decoding
+	if (options.bakeTextures)
+	{
+		CloseSceneStream(sceneStream);
+
+		bool baked = true;
+		for (const SceneMaterial& material : sceneMaterials)
+		{
+			if (material.filePath.empty())
+			{
+				continue;
+			}
+
+			// Every layer of the material texture array has the same size, so the images are resized to it here
+			std::string bakedFilePath = GetBakedTexturePath(material.filePath);
+			if (BakeTexture(material.filePath, bakedFilePath, material.swapRedBlue, options.bakeFormat, options.materialSize, options.materialSize))
+			{
+				std::cout << "Baked " << material.filePath << " -> " << bakedFilePath << std::endl;
+			}
+			else
+			{
+				baked = false;
+			}
+		}
+		return baked ? 0 : 1;
+	}
 
-	// Register the callback function that handles when the framebuffer size has changed
-	glfwSetFramebufferSizeCallback(window, FramebufferSizeChangedCallback);
+	float windowWidth = static_cast<float>(options.width);
+	float windowHeight = static_cast<float>(options.height);
 
-	// Tell GLAD to load the OpenGL function pointers
-	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
+	GLFWwindow* window = nullptr;
+	HeadlessContext headless;
+
+	if (options.software)
 	{
-		std::cerr << "Failed to initialize GLAD!" << std::endl;
-		return 1;
+		// The software renderer draws on the CPU, so there is no context at all
+	}
+	else if (options.headless)
+	{
+		// Render boxes have no display, so create the context through EGL instead of through a window.
+		// The GPU-driven path needs OpenGL 4.3; without it, the 3.3 paths are used
+		bool created = options.gpuDriven && CreateHeadlessContext(headless, 4, 3);
+		if (!created && !CreateHeadlessContext(headless, 3, 3))
+		{
+			return 1;
+		}
+
+		// Tell GLAD to load the OpenGL function pointers
+		if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(GetHeadlessProcAddress)))
+		{
+			std::cerr << "Failed to initialize GLAD!" << std::endl;
+			DestroyHeadlessContext(headless);
+			return 1;
+		}
+
+		// Everything below draws into the currently bound framebuffer, which is now our offscreen one
+		if (!CreateHeadlessFramebuffer(headless, options.width, options.height))
+		{
+			DestroyHeadlessContext(headless);
+			return 1;
+		}
+
+		std::cout << "Headless renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+	}
+	else
+	{
+		// Initialize GLFW
+		int glfwInitStatus = glfwInit();
+		if (glfwInitStatus == GLFW_FALSE)
+		{
+			std::cerr << "Failed to initialize GLFW!" << std::endl;
+			return 1;
+		}
+
+		// Tell GLFW that we prefer to use OpenGL 3.3 (4.3 for the GPU-driven path)
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, options.gpuDriven ? 4 : 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+
+		// Tell GLFW that we prefer to use the modern OpenGL
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		// Tell GLFW to create a window, falling back to OpenGL 3.3 if 4.3 is not available
+		window = glfwCreateWindow(options.width, options.height, "Final Project", nullptr, nullptr);
+		if (window == nullptr && options.gpuDriven)
+		{
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+			window = glfwCreateWindow(options.width, options.height, "Final Project", nullptr, nullptr);
+		}
+		if (window == nullptr)
+		{
+			std::cerr << "Failed to create GLFW window!" << std::endl;
+			glfwTerminate();
+			return 1;
+		}
+
+		// Tell GLFW to use the OpenGL context that was assigned to the window that we just created
+		glfwMakeContextCurrent(window);
+
+		// Register the callback function that handles when the framebuffer size has changed
+		glfwSetFramebufferSizeCallback(window, FramebufferSizeChangedCallback);
+
+		// Wait for this many vertical blanks per buffer swap (0 swaps immediately)
+		glfwSwapInterval(options.swapInterval);
+
+		// Tell GLAD to load the OpenGL function pointers
+		if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
+		{
+			std::cerr << "Failed to initialize GLAD!" << std::endl;
+			return 1;
+		}
+	}
+
+	if (options.gpuDriven && !options.software && !IsGpuCullingSupported())
+	{
+		std::cerr << "OpenGL 4.3 is not available, using the CPU culling path instead of the GPU-driven one" << std::endl;
+		options.gpuDriven = false;
 	}
 
 	float time = 0;
@@ -205,467 +346,804 @@ int main()
 	vertices[58] = { 0.0f, -0.5f, 0.0f,		255, 255, 255,		0.0f, 0.0f,		0.0f,0.0f,0.0f };
 	vertices[59] = { -0.5f, 0.0f, 0.0f,		255, 255, 255,		1.0f, 0.0f,		0.0f,0.0f,0.0f };
 
-	// Create a vertex buffer object (VBO), and upload our vertices data to the VBO
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Turn the triangle lists into indexed meshes with a compact vertex format
+	// (merged duplicate vertices, packed normals, half-float UVs, cache-friendly triangle order)
+	MeshData meshData;
+	AppendTriangleList(meshData, MeshCube, 0, &vertices[0], 36);
+	AppendTriangleList(meshData, MeshOctahedron, 0, &vertices[36], 24);
+
+	// Boxes, spheres and cylinders with proper normals for scene files, with coarser levels of detail for far objects
+	AppendGeneratedMeshes(meshData);
+
+	// Everything from here on needs OpenGL, so the software renderer takes over with the same meshes and scene
+	if (options.software)
+	{
+		if (!options.recordPath.empty())
+		{
+			std::cout << "Recording reads frames back from OpenGL, so it is ignored by the software renderer" << std::endl;
+		}
+		if (options.dynamicResolutionTarget > 0.0f)
+		{
+			std::cout << "Dynamic resolution blits its render target with OpenGL, so it is ignored by the software renderer" << std::endl;
+		}
+		if (options.occlusion)
+		{
+			std::cout << "Occlusion culling uses OpenGL queries, so it is ignored by the software renderer" << std::endl;
+		}
+		return RunSoftwareRenderer(options, meshData, sceneStream, sceneMaterials, scene, sceneLights, startupStart, sceneMilliseconds);
+	}
+
+	// Upload the meshes to vertex and index buffers on the GPU
+	MeshBuffers meshBuffers = UploadMeshData(meshData);
+
+	// Program, vertex array, texture and uniform binds of the render loop go through this cache of the current state
+	RenderState renderState;
 
 	// Create a vertex array object that contains data on how to map vertex attributes
 	// (e.g., position, color) to vertex shader properties.
 	GLuint vao;
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
+	SetupVertexAttributes(meshBuffers);
+	glBindVertexArray(0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	// Linked programs are cached on disk, keyed by their sources and the driver, so later launches skip compiling
+	std::chrono::steady_clock::time_point shaderStart = std::chrono::steady_clock::now();
+	ShaderCache shaderCache;
+	CreateShaderCache(shaderCache, options.shaderCacheDirectory);
 
-	// Vertex attribute 0 - Position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    //file path -- anton /Users/Anton/Documents/OpenGL/projects/helloTriangle/helloTriangle/
+	// The scene shaders are variants of main.vsh and main.fsh, which are built once the objects are loaded
+	// and it is known which variants they need
+	ShaderVariantSet sceneShaders;
+	CreateShaderVariantSet(sceneShaders, "main.vsh", "main.fsh");
+	double shaderMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
+
+	// Cube shadow map of the main light; the static objects are only drawn into it again when they or the light change
+	ShadowMap shadowMap;
+	if (options.shadows && !CreateShadowMap(shadowMap, shaderCache, 1024, 256, 25.0f))
+	{
+		std::cerr << "Failed to build the shadow program, drawing without shadows" << std::endl;
+		DeleteShadowMap(shadowMap);
+		options.shadows = false;
+	}
 
-	// Vertex attribute 1 - Color
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(offsetof(Vertex, r)));
+	// Camera and light data goes into one uniform block that every program shares,
+	// while per-object matrices are streamed through a ring of uniform buffer ranges
+	GLuint frameUniformBuffer = CreateFrameUniformBuffer();
+	UniformRing objectUniformRing;
+	CreateUniformRing(objectUniformRing, 64 * sizeof(ObjectUniforms));
+
+	// The scene's point lights are sorted into a grid of view-space clusters every frame,
+	// so each fragment only shades with the lights near it
+	LightClusters lightClusters;
+	CreateLightClusters(lightClusters, 0.1f, 100.0f);
+
+	// Upload the initial instance data of every object. Objects of a compiled scene are copied out of the mapping
+	// and uploaded a chunk at a time, so the instance data of a huge scene is never staged all at once
+	sceneStart = std::chrono::steady_clock::now();
+	const size_t sceneChunkSize = 4096;
+	size_t sceneObjectCount = sceneStream.header != nullptr ? sceneStream.header->objectCount : scene.size();
+	scene.reserve(sceneObjectCount);
+	InstanceBuffers instanceBuffers;
+	CreateInstanceBuffers(instanceBuffers, sceneObjectCount);
+	size_t uploadedObjects = 0;
+	do
+	{
+		UploadInstances(instanceBuffers, scene, uploadedObjects, scene.size() - uploadedObjects, sceneMaterials, meshBuffers);
+		uploadedObjects = scene.size();
+	} while (StreamSceneObjects(sceneStream, scene, sceneChunkSize));
+	CloseSceneStream(sceneStream);
+	sceneMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sceneStart).count();
+
+	// Objects that share a mesh are next to each other, so each mesh is drawn with a single instanced draw call
+	std::vector<InstanceBatch> instanceBatches = CreateInstanceBatches(scene, meshBuffers, instanceBuffers);
+	BindInstanceData(renderState, instanceBuffers);
+
+	// Transforms of the objects with their cached model matrices; only the animated objects are recomputed each frame
+	TransformStore transforms;
+	CreateTransformStore(transforms, scene);
+
+	// Optional worker threads that share the per-object matrix multiplications of large scenes
+	ThreadPool transformPool;
+	if (options.transformThreads > 0)
+	{
+		StartThreadPool(transformPool, options.transformThreads);
+	}
+
+	// Optional work-stealing workers that record the draws of the per-object path for this thread to replay
+	CommandRecorder commandRecorder;
+	bool recordCommands = options.commandThreads > 0 && !options.instancing && !options.gpuDriven;
+	if (recordCommands)
+	{
+		StartCommandRecorder(commandRecorder, options.commandThreads, scene, sceneMaterials.size());
+	}
 
-	// Vertex attribute 2 - UV coordinate
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, u)));
+	// Bounding volume hierarchy over the objects, so that the ones outside the view are not drawn.
+	// The GPU-driven path culls in a compute shader instead and draws the whole scene with one indirect call
+	SceneBvh sceneBvh;
+	GpuCulling gpuCulling;
+	if (options.gpuDriven)
+	{
+		if (!CreateGpuCulling(gpuCulling, shaderCache, scene, meshBuffers))
+		{
+			std::cerr << "Failed to build cull.csh, using the CPU culling path" << std::endl;
+			DeleteGpuCulling(gpuCulling);
+			options.gpuDriven = false;
+		}
+	}
+	if (options.culling && !options.gpuDriven)
+	{
+		BuildSceneBvh(sceneBvh, scene, meshBuffers, transforms);
+	}
 
-	// Vertex attribute 2 - Normal
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, nx)));
+	// Occlusion culling removes what is hidden from the objects the CPU culling found, so it has nothing to work on
+	// in the GPU-driven path
+	OcclusionCulling occlusion;
+	if (options.occlusion && options.gpuDriven)
+	{
+		std::cout << "Occlusion culling is not used with --gpu-driven" << std::endl;
+		options.occlusion = false;
+	}
+	if (options.occlusion && !CreateOcclusionCulling(occlusion, shaderCache, meshData, scene.size()))
+	{
+		std::cerr << "Failed to build the occlusion program, drawing without occlusion culling" << std::endl;
+		DeleteOcclusionCulling(occlusion);
+		options.occlusion = false;
+	}
 
-	glBindVertexArray(0);
+	// Objects drawn this frame, in scene order. Without culling that is every object
+	std::vector<uint32_t> visibleObjects;
+	if (!options.culling)
+	{
+		for (uint32_t i = 0; i < scene.size(); ++i)
+		{
+			visibleObjects.push_back(i);
+		}
+	}
 
-    //file path -- anton /Users/Anton/Documents/OpenGL/projects/helloTriangle/helloTriangle/
-	// Create a shader program
-	GLuint program = CreateShaderProgram("main.vsh", "main.fsh");
+	// Every draw uses the shader variant with only the features that its material and mesh need. Instance batches and
+	// the GPU-driven draw mix materials, so they use every feature one of their objects needs, and each instance
+	// switches off the ones its own object does not. All variants are started before waiting on any, so the driver
+	// can compile them side by side
+	shaderStart = std::chrono::steady_clock::now();
+	std::vector<unsigned int> batchFeatures;
+	unsigned int gpuDrivenFeatures = 0;
+	if (options.gpuDriven)
+	{
+		gpuDrivenFeatures = SelectShaderFeatures(scene, 0, scene.size(), sceneMaterials, meshBuffers) | ShaderFeatureInstanced;
+		RequestShaderVariant(shaderCache, sceneShaders, gpuDrivenFeatures);
+	}
+	else if (options.instancing)
+	{
+		for (const InstanceBatch& batch : instanceBatches)
+		{
+			batchFeatures.push_back(SelectShaderFeatures(scene, batch.firstInstance, batch.instanceCount, sceneMaterials, meshBuffers) | ShaderFeatureInstanced);
+			RequestShaderVariant(shaderCache, sceneShaders, batchFeatures.back());
+		}
+	}
+	else
+	{
+		for (const SceneObject& object : scene)
+		{
+			RequestShaderVariant(shaderCache, sceneShaders, SelectShaderFeatures(sceneMaterials[object.material], meshBuffers, object.mesh));
+		}
+	}
+	FinishShaderVariants(shaderCache, sceneShaders);
+	shaderMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
 
 	// Tell OpenGL the dimensions of the region where stuff will be drawn.
 	// For now, tell OpenGL to use the whole screen
 	glViewport(0, 0, windowWidth, windowHeight);
 
-	// Create a variable that will contain the ID for our texture,
-	// and use glGenTextures() to generate the texture itself
-	GLuint tex;
-	glGenTextures(1, &tex);
+	// Every material is a layer of one texture array, so objects select their material by layer index
+	// and nothing is rebound between draws. The images are loaded on worker threads (mapping their baked
+	// versions, or decoding them) and streamed to the GPU through pixel buffer objects. Every layer starts
+	// out as a placeholder, so the first frame does not wait for the decoders
+	TextureLoader textureLoader;
+	textureLoader.useBakedTextures = options.useBakedTextures;
+	StartTextureLoader(textureLoader);
 
-	// --- Load our image using stb_image ---
+	std::vector<TextureLayerFile> materialFiles;
+	for (const SceneMaterial& material : sceneMaterials)
+	{
+		materialFiles.push_back({ material.filePath, material.swapRedBlue });
+	}
+	TextureArray materials;
+	LoadTextureArrayAsync(textureLoader, materials, materialFiles, options.materialSize);
 
-	// Im image-space (pixels), (0, 0) is the upper-left corner of the image
-	// However, in u-v coordinates, (0, 0) is the lower-left corner of the image
-	// This means that the image will appear upside-down when we use the image data as is
-	// This function tells stbi to flip the image vertically so that it is not upside-down when we use it
-	stbi_set_flip_vertically_on_load(true);
+	// Bind the material texture array to its texture unit for good
+	BindTextureCached(renderState, MaterialsTextureUnit, GL_TEXTURE_2D_ARRAY, materials.texture);
+	BindLightClusters(renderState, lightClusters);
+	if (options.shadows)
+	{
+		BindShadowMap(renderState, shadowMap);
+	}
+
+	// Captured frames have to be the same on every run, so headless mode waits for the real textures by default
+	if (options.headless && !options.asyncTextures)
+	{
+		FinishTextureLoads(textureLoader);
+	}
 
-	// 'imageWidth' and imageHeight will contain the width and height of the loaded image respectively
-	int imageWidth, imageHeight, numChannels;
+	glEnable(GL_DEPTH_TEST);
 
-	// Read the image data and store it in an unsigned char array
-	unsigned char* imageData = stbi_load("RoomTexture.png", &imageWidth, &imageHeight, &numChannels, 0);
+	// Camera and ambient light are advanced in fixed steps, on a thread of their own when there is a window.
+	// Headless runs step the simulation on the render thread with the fixed clock so every run stays the same
+	Simulation simulation;
+	StartSimulation(simulation, options.simulationRate, !options.headless);
 
-	// Make sure that we actually loaded the image before uploading the data to the GPU
-	if (imageData != nullptr)
+	// Frame phase timers, only created when profiling was asked for
+	Profiler profiler;
+	if (options.profile)
 	{
-		// Our texture is 2D, so we bind our texture to the GL_TEXTURE_2D target
-		glBindTexture(GL_TEXTURE_2D, tex);
-
-		// Set the filtering methods for magnification and minification
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		CreateProfiler(profiler, !options.traceFilePath.empty());
+	}
+	bool profileKeyWasDown = false;
 
-		// Set the wrapping method for the s-axis (x-axis) and t-axis (y-axis)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// Earliest time of the next swap when the frame rate is limited
+	std::chrono::steady_clock::time_point nextFrameDeadline = std::chrono::steady_clock::now();
 
-		// Upload the image data to GPU memory
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, imageData);
+	// Draw packets of the frame, sorted by state before they are issued
+	RenderQueue renderQueue;
 
-		// If we set minification to use mipmaps, we can tell OpenGL to generate the mipmaps for us
-		//glGenerateMipmap(GL_TEXTURE_2D);
+	// Transformation matrices and levels of detail of the visible objects, reused every frame
+	std::vector<glm::mat4> transformationMatrices;
+	std::vector<uint8_t> visibleLods;
 
-		// Once we have copied the data over to the GPU, we can delete
-		// the data on the CPU side, since we won't be using it anymore
-		stbi_image_free(imageData);
-		imageData = nullptr;
-	}
-	else
+	// Every frame is streamed to the recording through a ring of pixel buffer objects, so reading it back does not
+	// stall the frame; windows record at the framebuffer size they start with
+	FrameRecorder recorder;
+	bool recording = false;
+	if (!options.recordPath.empty())
 	{
-		std::cerr << "Failed to load image" << std::endl;
+		int recordWidth = options.width;
+		int recordHeight = options.height;
+		if (!options.headless)
+		{
+			glfwGetFramebufferSize(window, &recordWidth, &recordHeight);
+		}
+		float recordFps = options.headless ? options.simulatedFps : (options.maxFps > 0.0f ? options.maxFps : 60.0f);
+		recording = StartFrameRecorder(recorder, options.recordPath, options.recordFormat, recordWidth, recordHeight, recordFps);
 	}
-    
-    GLuint tex1;
-    glGenTextures(1, &tex1);
-
-    // Read the image data for a second texture, and store it in our unsigned char array
-    // We can reuse the "imageData" array since we already uploaded the previous image data
-    // to GPU memory. The same applies for imageWidth, imageHeight, and numChannels
-    imageData = stbi_load("metal2.jpg", &imageWidth, &imageHeight, &numChannels, 0);
-    // Make sure that we actually loaded the image before uploading the data to the GPU
-    if (imageData != nullptr)
-    {
-        // Our texture is 2D, so we bind our texture to the GL_TEXTURE_2D target
-        glBindTexture(GL_TEXTURE_2D, tex1);
-
-        // Set the filtering methods for magnification and minification
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-        // Set the wrapping method for the s-axis (x-axis) and t-axis (y-axis)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-        // Upload the image data to GPU memory
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-
-        // If we set minification to use mipmaps, we can tell OpenGL to generate the mipmaps for us
-        //glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Once we have copied the data over to the GPU, we can delete
-        // the data on the CPU side, since we won't be using it anymore
-        stbi_image_free(imageData);
-        imageData = nullptr;
-    }
-    else
-    {
-        std::cerr << "Failed to load image" << std::endl;
-    }
 
-	glEnable(GL_DEPTH_TEST);
-
-	float cameraMoveForwardBackward = 1.0f;
-	float cameraMoveLeftRight = 0.0f;
-	float cameraLookUpDown = 0.0f;
-	float cameraLookLeftRight = 0.0f;
-	float cameraLookForwardBackward = 0.0f;
+	// With a frame time target, the scene is drawn into a render target whose resolution follows the frame time (the
+	// larger of CPU and GPU time) of the last frames, and stretched onto the window or the headless framebuffer at the
+	// end of every frame
+	DynamicResolution dynamicResolution;
+	bool useDynamicResolution = false;
+	if (options.dynamicResolutionTarget > 0.0f)
+	{
+		int outputWidth = options.width;
+		int outputHeight = options.height;
+		if (!options.headless)
+		{
+			glfwGetFramebufferSize(window, &outputWidth, &outputHeight);
+		}
+		useDynamicResolution = CreateDynamicResolution(dynamicResolution, outputWidth, outputHeight, options.dynamicResolutionTarget,
+			options.minResolutionScale, options.maxResolutionScale);
+	}
+	GLuint outputFramebuffer = options.headless ? headless.framebuffer : 0;
+	double previousFrameMilliseconds = 0.0;
+
+	// Headless runs use a fixed simulated clock so that every run produces the same frames
+	int frameIndex = 0;
+	double totalFrameMilliseconds = 0.0;
+	double minFrameMilliseconds = 0.0;
+	double maxFrameMilliseconds = 0.0;
+	double firstFrameMilliseconds = 0.0;
+	size_t totalVisibleObjects = 0;
+	std::vector<double> frameTimes;
 
 	// Render loop
-	while (!glfwWindowShouldClose(window))
+	while (options.headless ? frameIndex < options.frameCount : !glfwWindowShouldClose(window))
 	{
-		// Clear the color and depth buffer
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		BeginProfileFrame(profiler);
 
-		// Get time for rotation
-		time = glfwGetTime() * 60;
-        
+		// Swap in the material layers that finished loading since the last frame
+		UpdateTextureLoader(textureLoader);
 
-		// Use the shader program that we created
-		glUseProgram(program);
+		// Rebuild the programs whose shader files were saved; the old ones stay in use until the new ones are linked
+		if (options.hotReload)
+		{
+			UpdateShaderVariants(shaderCache, sceneShaders);
+		}
 
-		// Use the vertex array object that we created
-		glBindVertexArray(vao);
+		// Pick the internal resolution of this frame and draw into its render target
+		float renderWidth = windowWidth;
+		float renderHeight = windowHeight;
+		if (useDynamicResolution)
+		{
+			if (!options.headless)
+			{
+				int framebufferWidth = 0;
+				int framebufferHeight = 0;
+				glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+				ResizeDynamicResolution(dynamicResolution, framebufferWidth, framebufferHeight);
+			}
+			BeginDynamicResolutionFrame(dynamicResolution, previousFrameMilliseconds);
+			renderWidth = static_cast<float>(dynamicResolution.width);
+			renderHeight = static_cast<float>(dynamicResolution.height);
+		}
 
-		// Bind our texture to texture unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex);
-        
-        // Bind our second texture to texture unit 1
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, tex1);
+		// Clear the color and depth buffer
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// Make our sampler in the fragment shader use texture unit 0
-		GLint texUniformLocation = glGetUniformLocation(program, "tex");
-		glUniform1i(texUniformLocation, 0);
-        
-        //Ambient Strength Uniform Float
-        GLint ambientUniformLocation = glGetUniformLocation(program, "ambientStrength");
-        glUniform1f(ambientUniformLocation, ambientStrength);
-    
+		// Get time for rotation and the latest camera and light state
+		SimulationState state;
+		if (options.headless)
+		{
+			time = frameIndex * 60.0f / options.simulatedFps;
+
+			BeginProfileZone(profiler, ZoneInput);
+			double frameSeconds = frameIndex / static_cast<double>(options.simulatedFps);
+			AdvanceSimulation(simulation, frameSeconds);
+			state = GetSimulationState(simulation, frameSeconds);
+			if (options.benchmarkObjects > 0)
+			{
+				SetBenchmarkCamera(state, frameIndex, options.frameCount);
+			}
+			EndProfileZone(profiler);
+		}
+		else
+		{
+			time = glfwGetTime() * 60;
+			state = GetSimulationState(simulation, GetSimulationClock(simulation));
+		}
         
-		// Light
-		glm::vec3 lightColorVector(1.0f, 1.0f, 1.0f);
-        glUniform3f(glGetUniformLocation(program, "lightColor"), 1.0f, 1.0f, 1.0f);
+		// Recompute the model matrices of the objects that moved
+		BeginProfileZone(profiler, ZoneTransforms);
+		SetTransformTime(transforms, time);
+		UpdateTransforms(transforms);
 
-		GLint lightPosUniformLocation = glGetUniformLocation(program, "lightPos");
-		glUniform3f(lightPosUniformLocation, 0.0f, 1.0f, 0.0f);
+		// Instanced draws and shadow casters read the model matrices from the instance data, so only the animated objects need new data
+		if (options.instancing || options.gpuDriven || options.shadows)
+		{
+			UpdateDynamicInstances(instanceBuffers, scene, transforms, sceneMaterials, meshBuffers);
+		}
+		EndProfileZone(profiler);
 
 		// View Matrix and Perspective Projection Matrix
 		glm::mat4 viewMatrix = glm::mat4(1.0f);
-		viewMatrix = glm::lookAt(glm::vec3(cameraMoveLeftRight, 0.0f, cameraMoveForwardBackward), glm::vec3(cameraLookLeftRight, cameraLookUpDown, cameraLookForwardBackward), glm::vec3(0.0f, 1.0f, 0.0f));
+		viewMatrix = glm::lookAt(glm::vec3(state.cameraMoveLeftRight, 0.0f, state.cameraMoveForwardBackward), glm::vec3(state.cameraLookLeftRight, state.cameraLookUpDown, state.cameraLookForwardBackward), glm::vec3(0.0f, 1.0f, 0.0f));
 		float aspectRatio = windowWidth / windowHeight;
 		glm::mat4 perspectiveProjMatrix = glm::perspective(90.0f, aspectRatio, 0.1f, 100.0f);
-        
-        // View and Projection Uniform Init
-        GLint viewMatrixUniformLocation = glGetUniformLocation(program, "view");
-        glUniformMatrix4fv(viewMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-        GLint projectionMatrixUniformLocation = glGetUniformLocation(program, "projection");
-        glUniformMatrix4fv(projectionMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(perspectiveProjMatrix));
-
-		// Room Cube
-		glm::mat4 modelMatrix = glm::mat4(1.0f);
-		modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-		// modelMatrix = glm::rotate(modelMatrix, glm::radians(time), glm::vec3(0.0f, .0f, 0.0f));
-		modelMatrix = glm::scale(modelMatrix, glm::vec3(4.0f, 4.0f,4.0f));
-
-		glm::mat4 finalMatrix = perspectiveProjMatrix * viewMatrix * modelMatrix;
-
-        //Transformation Matrix Init
-		GLint transformationMatrixUniformLocation = glGetUniformLocation(program, "transformationMatrix");
-		glUniformMatrix4fv(transformationMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-        
-        //Model Matrix init
-        GLint modelMatrixUniformLocation = glGetUniformLocation(program, "model");
-        glUniformMatrix4fv(modelMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glDrawArrays(GL_TRIANGLES, 6, 6);
-		glDrawArrays(GL_TRIANGLES, 12, 6);
-		glDrawArrays(GL_TRIANGLES, 18, 6);
-		glDrawArrays(GL_TRIANGLES, 24, 6);
-		glDrawArrays(GL_TRIANGLES, 30, 6);
-
-        //change texture to next
-        glUniform1i(texUniformLocation, 1);
-
-		// Table Cube
-		glm::mat4 secondCube = glm::mat4(1.0f);
-		secondCube = glm::translate(secondCube, glm::vec3(0.0f, -1.5f, 0.0f));
-		secondCube = glm::scale(secondCube, glm::vec3(1.75f, 0.75f, 1.0f));
-
-		finalMatrix = perspectiveProjMatrix * viewMatrix * secondCube;
-		glUniformMatrix4fv(transformationMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-        glUniformMatrix4fv(modelMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glDrawArrays(GL_TRIANGLES, 6, 6);
-		glDrawArrays(GL_TRIANGLES, 12, 6);
-		glDrawArrays(GL_TRIANGLES, 18, 6);
-		glDrawArrays(GL_TRIANGLES, 24, 6);
-		glDrawArrays(GL_TRIANGLES, 30, 6);
-
-		// Front Chair
-		glm::mat4 thirdCube = glm::mat4(1.0f);
-		thirdCube = glm::translate(thirdCube, glm::vec3(0.0f, -1.75f, 1.0f));
-		thirdCube = glm::scale(thirdCube, glm::vec3(0.5f, 0.5f, 0.5f));
-
-		finalMatrix = perspectiveProjMatrix * viewMatrix * thirdCube;
-		glUniformMatrix4fv(transformationMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-        glUniformMatrix4fv(modelMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glDrawArrays(GL_TRIANGLES, 6, 6);
-		glDrawArrays(GL_TRIANGLES, 12, 6);
-		glDrawArrays(GL_TRIANGLES, 18, 6);
-		glDrawArrays(GL_TRIANGLES, 24, 6);
-		glDrawArrays(GL_TRIANGLES, 30, 6);
-
-
-		// Back Chair
-		glm::mat4 fourthCube = glm::mat4(1.0f);
-		fourthCube = glm::translate(fourthCube, glm::vec3(0.0f, -1.75f, -1.0f));
-		fourthCube = glm::scale(fourthCube, glm::vec3(0.5f, 0.5f, 0.5f));
-
-		finalMatrix = perspectiveProjMatrix * viewMatrix * fourthCube;
-		glUniformMatrix4fv(transformationMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-        glUniformMatrix4fv(modelMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glDrawArrays(GL_TRIANGLES, 6, 6);
-		glDrawArrays(GL_TRIANGLES, 12, 6);
-		glDrawArrays(GL_TRIANGLES, 18, 6);
-		glDrawArrays(GL_TRIANGLES, 24, 6);
-		glDrawArrays(GL_TRIANGLES, 30, 6);
-
-		// Bulb
-		glm::mat4 octahedron = glm::mat4(1.0f);
-		octahedron = glm::translate(octahedron, glm::vec3(0.0f, 1.0f, 0.0f));
-		octahedron = glm::scale(octahedron, glm::vec3(0.75f, 0.75f, 0.75f));
-		octahedron = glm::rotate(octahedron, glm::radians(time), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		finalMatrix = perspectiveProjMatrix * viewMatrix * octahedron;
-		glUniformMatrix4fv(transformationMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(finalMatrix));
-
-		glDrawArrays(GL_TRIANGLES, 36, 3);
-		glDrawArrays(GL_TRIANGLES, 39, 3);
-		glDrawArrays(GL_TRIANGLES, 42, 3);
-		glDrawArrays(GL_TRIANGLES, 45, 3);
-		glDrawArrays(GL_TRIANGLES, 48, 3);
-		glDrawArrays(GL_TRIANGLES, 51, 3);
-		glDrawArrays(GL_TRIANGLES, 54, 3);
-		glDrawArrays(GL_TRIANGLES, 57, 3);
-
-
-
-		// "Unuse" the vertex array object
-		glBindVertexArray(0);
+		glm::mat4 viewProjection = perspectiveProjMatrix * viewMatrix;
+
+		// Camera and light, uploaded once for all programs
+		FrameUniforms frameUniforms = {};
+		frameUniforms.view = viewMatrix;
+		frameUniforms.projection = perspectiveProjMatrix;
+		frameUniforms.lightPos = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
+		frameUniforms.lightColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+		frameUniforms.ambientStrength = state.ambientStrength;
+		frameUniforms.inverseView = glm::inverse(viewMatrix);
+
+		// The level of detail of an object follows the radius its bounding sphere covers on the screen
+		glm::vec3 cameraPosition = glm::vec3(frameUniforms.inverseView[3]);
+		float pixelsPerUnit = perspectiveProjMatrix[1][1] * renderHeight * 0.5f;
+
+		// Sort the point lights into the clusters they reach
+		BeginProfileZone(profiler, ZoneLights);
+		UpdateLightClusters(lightClusters, sceneLights, viewMatrix, perspectiveProjMatrix, renderWidth, renderHeight, frameUniforms);
+		EndProfileZone(profiler);
+
+		// Bring the shadow map of the main light up to date
+		if (options.shadows)
+		{
+			BeginProfileZone(profiler, ZoneShadows);
+			UpdateShadowMap(shadowMap, renderState, glm::vec3(frameUniforms.lightPos), scene, meshBuffers, transforms, vao, frameUniforms);
+			EndProfileZone(profiler);
+		}
 
-		// Tell GLFW to swap the screen buffer with the offscreen buffer
-		glfwSwapBuffers(window);
+		// Move the bounds of the animated objects, which only touches the nodes above them, and find what the camera sees
+		if (options.culling && !options.gpuDriven)
+		{
+			BeginProfileZone(profiler, ZoneCulling);
+			RefitSceneBvh(sceneBvh, scene, meshBuffers, transforms);
+			CullSceneBvh(sceneBvh, ExtractFrustum(viewProjection), visibleObjects);
+			EndProfileZone(profiler);
+		}
 
-		// Tell GLFW to process window events (e.g., input events, window closed events, etc.)
-		glfwPollEvents();
+		// Drop the objects that the largest ones hide, or that were hidden in last frame's queries
+		if (options.occlusion)
+		{
+			BeginProfileZone(profiler, ZoneCulling);
+			if (!options.culling)
+			{
+				visibleObjects.resize(scene.size());
+				std::iota(visibleObjects.begin(), visibleObjects.end(), 0);
+			}
+			CullOccludedObjects(occlusion, scene, meshBuffers, transforms, viewProjection, cameraPosition, visibleObjects);
+			EndProfileZone(profiler);
+		}
+		totalVisibleObjects += options.gpuDriven ? 0 : visibleObjects.size();
 
-		if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		if (options.gpuDriven)
 		{
-			cameraMoveLeftRight -= 0.001f;
-			cameraLookLeftRight -= 0.001f;
+			// Bounds and culling are worked out from the instance data on the GPU
+			BeginProfileZone(profiler, ZoneUniformUpload);
+			UpdateFrameUniformsCached(renderState, frameUniformBuffer, frameUniforms);
+			EndProfileZone(profiler);
+
+			// Without culling, every plane is one that nothing is behind
+			Frustum frustum = ExtractFrustum(viewProjection);
+			if (!options.culling)
+			{
+				std::fill(frustum.planes, frustum.planes + 6, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+			}
+
+			BeginProfileZone(profiler, ZoneGpuCulling);
+			DispatchGpuCulling(gpuCulling, renderState, instanceBuffers, frustum, cameraPosition, pixelsPerUnit);
+			EndProfileZone(profiler);
+
+			// The whole scene in one draw call
+			BeginProfileZone(profiler, ZoneDraw);
+			UseProgramCached(renderState, GetShaderVariant(shaderCache, sceneShaders, gpuDrivenFeatures).shader.program);
+			DrawGpuCulled(gpuCulling, renderState, meshBuffers);
+			EndProfileZone(profiler);
 		}
-        
-		if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		else if (options.instancing)
 		{
-			cameraMoveLeftRight += 0.001f;
-			cameraLookLeftRight += 0.001f;
+			// Every object's data stays in the instance buffer, and the instances of each batch are the indices of its visible objects
+			BeginProfileZone(profiler, ZoneUniformUpload);
+			UpdateFrameUniformsCached(renderState, frameUniformBuffer, frameUniforms);
+			SelectObjectLods(scene, meshBuffers, transforms, visibleObjects, cameraPosition, pixelsPerUnit, visibleLods);
+			UpdateVisibleInstances(instanceBatches, instanceBuffers, visibleObjects, visibleLods);
+			EndProfileZone(profiler);
+
+			// One draw call per mesh and level of detail: all visible cubes (room, table, chairs) at once, then the bulb
+			BeginProfileZone(profiler, ZoneDraw);
+			ClearRenderQueue(renderQueue, 0, 0);
+			for (size_t b = 0; b < instanceBatches.size(); ++b)
+			{
+				const InstanceBatch& batch = instanceBatches[b];
+				GLuint program = GetShaderVariant(shaderCache, sceneShaders, batchFeatures[b]).shader.program;
+				for (int lod = 0; lod < MeshLodCount; ++lod)
+				{
+					if (batch.visibleCounts[lod] > 0)
+					{
+						uint64_t key = MakeSortKey(program, 0, batch.vaos[lod], batch.mesh, 0.0f);
+						SubmitDrawPacket(renderQueue, { key, program, batch.vaos[lod], batch.mesh, lod, batch.visibleCounts[lod], -1,
+							static_cast<int32_t>(batch.firstInstance) });
+					}
+				}
+			}
+			ExecuteRenderQueue(renderQueue, renderState, meshBuffers, profiler);
+			EndProfileZone(profiler);
 		}
-        
-		if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+		else if (recordCommands)
 		{
-			cameraMoveForwardBackward -= 0.001f;
-			cameraLookForwardBackward -= 0.001f;
+			// The workers multiply the matrices, fill the uniform ring and record the draw packets of ranges of the
+			// visible objects; this thread merges their packets and issues them
+			BeginProfileZone(profiler, ZoneUniformUpload);
+			UpdateFrameUniformsCached(renderState, frameUniformBuffer, frameUniforms);
+			GLsizeiptr objectStride = GetUniformRingStride(objectUniformRing, sizeof(ObjectUniforms));
+			BeginUniformRingFrame(objectUniformRing, objectStride * static_cast<GLsizeiptr>(visibleObjects.size()));
+			ClearRenderQueue(renderQueue, objectUniformRing.buffer, sizeof(ObjectUniforms));
+			RecordDrawCommands(commandRecorder, renderQueue, objectUniformRing, shaderCache, sceneShaders, scene, sceneMaterials, meshBuffers,
+				transforms, visibleObjects, viewMatrix, viewProjection, cameraPosition, pixelsPerUnit, vao);
+			UnmapUniformRing(objectUniformRing);
+			EndProfileZone(profiler);
+
+			BeginProfileZone(profiler, ZoneDraw);
+			ExecuteRenderQueue(renderQueue, renderState, meshBuffers, profiler);
+			EndUniformRingFrame(objectUniformRing);
+			EndProfileZone(profiler);
+		}
+		else
+		{
+			// Multiply the view-projection matrix with the cached model matrices of the visible objects in one batch
+			BeginProfileZone(profiler, ZoneTransforms);
+			MultiplyTransforms(viewProjection, transforms, visibleObjects, transformationMatrices, options.transformThreads > 0 ? &transformPool : nullptr);
+			SelectObjectLods(scene, meshBuffers, transforms, visibleObjects, cameraPosition, pixelsPerUnit, visibleLods);
+			EndProfileZone(profiler);
+
+			// Write the matrices of every object into this frame's part of the uniform ring first,
+			// since the ring has to be unmapped again before anything can be drawn from it
+			BeginProfileZone(profiler, ZoneUniformUpload);
+			UpdateFrameUniformsCached(renderState, frameUniformBuffer, frameUniforms);
+			GLsizeiptr objectStride = GetUniformRingStride(objectUniformRing, sizeof(ObjectUniforms));
+			BeginUniformRingFrame(objectUniformRing, objectStride * static_cast<GLsizeiptr>(visibleObjects.size()));
+
+			// Each object also gets a draw packet, sorted by material, mesh and distance from the camera
+			ClearRenderQueue(renderQueue, objectUniformRing.buffer, sizeof(ObjectUniforms));
+			for (size_t i = 0; i < visibleObjects.size(); ++i)
+			{
+				const SceneObject& object = scene[visibleObjects[i]];
+				ObjectUniforms objectUniforms;
+				objectUniforms.transformationMatrix = transformationMatrices[i];
+				objectUniforms.model = objectUniforms.transformationMatrix;
+				objectUniforms.material = object.material;
+				GLintptr offset = WriteUniformRing(objectUniformRing, &objectUniforms, sizeof(ObjectUniforms));
+
+				float depth = -(viewMatrix * transforms.modelMatrices[visibleObjects[i]][3]).z / 100.0f;
+				GLuint program = GetShaderVariant(shaderCache, sceneShaders, SelectShaderFeatures(sceneMaterials[object.material], meshBuffers, object.mesh)).shader.program;
+				uint64_t key = MakeSortKey(program, object.material, vao, object.mesh, depth);
+				SubmitDrawPacket(renderQueue, { key, program, vao, object.mesh, visibleLods[i], 0, offset, static_cast<int32_t>(visibleObjects[i]) });
+			}
+
+			UnmapUniformRing(objectUniformRing);
+			EndProfileZone(profiler);
+
+			// One object at a time: point the ObjectData block at its matrices and material, and draw its mesh
+			BeginProfileZone(profiler, ZoneDraw);
+			ExecuteRenderQueue(renderQueue, renderState, meshBuffers, profiler);
+
+			EndUniformRingFrame(objectUniformRing);
+			EndProfileZone(profiler);
+		}
 
+		// Test the bounding boxes picked during culling against the finished depth buffer; the results are read next frame
+		if (options.occlusion)
+		{
+			BeginProfileZone(profiler, ZoneOcclusion);
+			IssueOcclusionQueries(occlusion, renderState, meshBuffers, vao, viewProjection);
+			EndProfileZone(profiler);
 		}
-		if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+
+		// Stretch the frame from its internal resolution onto the window or the headless framebuffer
+		if (useDynamicResolution)
 		{
-			cameraMoveForwardBackward += 0.001f;
-			cameraLookForwardBackward += 0.001f;
+			EndDynamicResolutionFrame(dynamicResolution, outputFramebuffer);
 		}
-		
-		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+
+		// Start reading the finished frame back before it is swapped away, and pass on the ones read earlier
+		if (recording)
 		{
-			cameraLookUpDown += 0.001f;
+			BeginProfileZone(profiler, ZoneCapture);
+			RecordFrame(recorder);
+			EndProfileZone(profiler);
 		}
-		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+
+		if (options.headless)
 		{
-			cameraLookUpDown -= 0.001f;
+			// Wait for the frame to finish so the measured time includes the actual rendering work
+			BeginProfileZone(profiler, ZoneSwap);
+			glFinish();
+			EndProfileZone(profiler);
+
+			// The GPU-driven path only knows how many objects were drawn once the frame is done
+			if (options.gpuDriven)
+			{
+				totalVisibleObjects += ReadGpuVisibleCount(gpuCulling);
+			}
+
+			double frameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+			totalFrameMilliseconds += frameMilliseconds;
+			minFrameMilliseconds = frameIndex == 0 ? frameMilliseconds : std::min(minFrameMilliseconds, frameMilliseconds);
+			maxFrameMilliseconds = std::max(maxFrameMilliseconds, frameMilliseconds);
+			frameTimes.push_back(frameMilliseconds);
+			previousFrameMilliseconds = frameMilliseconds;
+			if (frameIndex == 0)
+			{
+				firstFrameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count();
+			}
+
+			bool capture = options.captureAllFrames
+				|| std::find(options.captureFrames.begin(), options.captureFrames.end(), frameIndex) != options.captureFrames.end()
+				|| (options.captureFrames.empty() && options.benchmarkResultPath.empty() && frameIndex == options.frameCount - 1);
+			if (capture)
+			{
+				char fileName[64];
+				std::snprintf(fileName, sizeof(fileName), "/frame_%05d.ppm", frameIndex);
+				BeginProfileZone(profiler, ZoneCapture);
+				WriteFramebufferToFile(options.outputDirectory + fileName, options.width, options.height);
+				EndProfileZone(profiler);
+			}
+
+			EndProfileFrame(profiler);
+			++frameIndex;
+			continue;
 		}
-		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+
+		// Tell GLFW to swap the screen buffer with the offscreen buffer
+		BeginProfileZone(profiler, ZoneSwap);
+		std::chrono::steady_clock::time_point swapStart = std::chrono::steady_clock::now();
+		glfwSwapBuffers(window);
+		EndProfileZone(profiler);
+
+		// With vsync the swap mostly waits for the display, which says nothing about the load; without it, the swap
+		// is where software OpenGL finishes drawing the frame
+		std::chrono::steady_clock::time_point frameEnd = options.swapInterval == 0 ? std::chrono::steady_clock::now() : swapStart;
+		previousFrameMilliseconds = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+
+		// Tell GLFW to process window events (e.g., input events, window closed events, etc.)
+		BeginProfileZone(profiler, ZoneInput);
+		glfwPollEvents();
+
+		// Hand the held keys to the simulation, which applies them per second instead of per frame
+		static const struct { int glfwKey; SimulationKey key; } KeyBindings[] =
+		{
+			{ GLFW_KEY_LEFT, KeyMoveLeft }, { GLFW_KEY_RIGHT, KeyMoveRight }, { GLFW_KEY_UP, KeyMoveForward }, { GLFW_KEY_DOWN, KeyMoveBackward },
+			{ GLFW_KEY_W, KeyLookUp }, { GLFW_KEY_S, KeyLookDown }, { GLFW_KEY_A, KeyLookLeft }, { GLFW_KEY_D, KeyLookRight },
+			{ GLFW_KEY_SPACE, KeyResetCamera }, { GLFW_KEY_U, KeyAmbientDown }, { GLFW_KEY_I, KeyAmbientUp }
+		};
+		uint32_t keys = 0;
+		for (const auto& binding : KeyBindings)
 		{
-			cameraLookLeftRight -= 0.001f;
+			if (glfwGetKey(window, binding.glfwKey) == GLFW_PRESS)
+			{
+				keys |= binding.key;
+			}
 		}
-		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		SetSimulationInput(simulation, keys);
+		EndProfileZone(profiler);
+
+		// P prints the profile of the last frames and writes the trace recorded so far
+		bool profileKeyDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+		if (profileKeyDown && !profileKeyWasDown)
 		{
-			cameraLookLeftRight += 0.001f;
+			PrintProfileSummary(profiler);
+			if (!options.traceFilePath.empty())
+			{
+				WriteChromeTrace(profiler, options.traceFilePath);
+			}
 		}
-		if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+		profileKeyWasDown = profileKeyDown;
+
+		// Keep the frames at least 1 / maxFps apart; a frame that ran late moves the schedule instead of causing a burst
+		if (options.maxFps > 0.0f)
 		{
-			cameraMoveForwardBackward = 1.0f;
-			cameraMoveLeftRight = 0.0f;
-			cameraLookUpDown = 0.0f;
-			cameraLookLeftRight = 0.0f;
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			nextFrameDeadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.maxFps));
+			if (nextFrameDeadline < now)
+			{
+				nextFrameDeadline = now;
+			}
+			std::this_thread::sleep_until(nextFrameDeadline);
 		}
-        if (glfwGetKey(window, GLFW_KEY_U))
-        {
-            if(ambientStrength > 0)
-            {
-            ambientStrength -= 0.02f;
-            }
-        }
-        if (glfwGetKey(window, GLFW_KEY_I))
-        {
-            if(ambientStrength < 1)
-            {
-            ambientStrength += 0.02f;
-            }
-        }
-        glUniformMatrix4fv(viewMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-        glUniformMatrix4fv(projectionMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(perspectiveProjMatrix));
+
+		EndProfileFrame(profiler);
 	}
 
 	// --- Cleanup ---
 
-	// Make sure to delete the shader program
-	glDeleteProgram(program);
-
-	// Delete the VBO that contains our vertices
-	glDeleteBuffers(1, &vbo);
-
-	// Delete the vertex array object
-	glDeleteVertexArrays(1, &vao);
+	// Stop the simulation thread
+	StopSimulation(simulation);
 
-	// Remember to tell GLFW to clean itself up before exiting the application
-	glfwTerminate();
+	// Write the frames that are still in flight and close the recording
+	if (recording)
+	{
+		bool recorded = StopFrameRecorder(recorder);
+		std::cout << "Recorded " << recorder.writtenFrames << " frames to " << options.recordPath << " (render thread waited "
+			<< recorder.waitMilliseconds << " ms)" << (recorded ? "" : ", some frames were not written") << std::endl;
+	}
 
-	return 0;
-}
+	// Report the frame phase timings and write the trace
+	PrintProfileSummary(profiler);
+	if (!options.traceFilePath.empty())
+	{
+		WriteChromeTrace(profiler, options.traceFilePath);
+	}
 
-/// <summary>
-/// Creates a shader program based on the provided file paths for the vertex and fragment shaders.
-/// </summary>
-/// <param name="vertexShaderFilePath">Vertex shader file path</param>
-/// <param name="fragmentShaderFilePath">Fragment shader file path</param>
-/// <returns>OpenGL handle to the created shader program</returns>
-GLuint CreateShaderProgram(const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath)
-{
-	GLuint vertexShader = CreateShaderFromFile(GL_VERTEX_SHADER, vertexShaderFilePath);
-	GLuint fragmentShader = CreateShaderFromFile(GL_FRAGMENT_SHADER, fragmentShaderFilePath);
+	// Hand the measurements of a benchmark run back to the suite
+	bool benchmarkWritten = true;
+	if (!options.benchmarkResultPath.empty())
+	{
+		BenchmarkResult result;
+		result.config = GetBenchmarkConfig(options);
+		result.name = GetBenchmarkName(result.config);
+		SetBenchmarkFrameTimes(result, frameTimes);
+		result.gpuFrameMilliseconds = GetProfileGpuFrameMedian(profiler);
+		result.drawCalls = static_cast<double>(renderState.drawCalls) / std::max(frameIndex, 1);
+		result.peakMemoryMegabytes = GetPeakMemoryMegabytes();
+		benchmarkWritten = AppendBenchmarkResult(options.benchmarkResultPath, result);
+	}
+	DeleteProfiler(profiler);
 
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
+	// Delete the render target of the dynamic resolution, keeping its numbers for the summary
+	double averageResolutionScale = dynamicResolution.scaleSum / std::max<int64_t>(dynamicResolution.frames, 1);
+	if (useDynamicResolution)
+	{
+		DeleteDynamicResolution(dynamicResolution);
+	}
 
-	glLinkProgram(program);
+	// Delete the buffers and the culling program of the GPU-driven path
+	if (options.gpuDriven)
+	{
+		DeleteGpuCulling(gpuCulling);
+	}
 
-	glDetachShader(program, vertexShader);
-	glDeleteShader(vertexShader);
-	glDetachShader(program, fragmentShader);
-	glDeleteShader(fragmentShader);
+	// Delete the occlusion queries and their program
+	if (options.occlusion)
+	{
+		DeleteOcclusionCulling(occlusion);
+	}
 
-	// Check shader program link status
-	GLint linkStatus;
-	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-	if (linkStatus != GL_TRUE) {
-		char infoLog[512];
-		GLsizei infoLogLen = sizeof(infoLog);
-		glGetProgramInfoLog(program, infoLogLen, &infoLogLen, infoLog);
-		std::cerr << "program link error: " << infoLog << std::endl;
+	// Delete the shadow maps and their program, keeping the pass counts for the summary
+	int64_t staticShadowPasses = shadowMap.staticPasses;
+	int64_t dynamicShadowFacePasses = shadowMap.dynamicFacePasses;
+	if (options.shadows)
+	{
+		DeleteShadowMap(shadowMap);
 	}
 
-	return program;
-}
+	// Make sure to delete the shader programs, keeping the variant count for the summary
+	int sceneShaderVariants = CountShaderVariants(sceneShaders);
+	DeleteShaderVariantSet(sceneShaders);
 
-/// <summary>
-/// Creates a shader based on the provided shader type and the path to the file containing the shader source.
-/// </summary>
-/// <param name="shaderType">Shader type</param>
-/// <param name="shaderFilePath">Path to the file containing the shader source</param>
-/// <returns>OpenGL handle to the created shader</returns>
-GLuint CreateShaderFromFile(const GLuint& shaderType, const std::string& shaderFilePath)
-{
-	std::ifstream shaderFile(shaderFilePath);
-	if (shaderFile.fail())
+	// Delete the uniform buffers and the light lists
+	glDeleteBuffers(1, &frameUniformBuffer);
+	DeleteUniformRing(objectUniformRing);
+	DeleteLightClusters(lightClusters);
+
+	// Stop the transform worker threads
+	if (options.transformThreads > 0)
 	{
-		std::cerr << "Unable to open shader file: " << shaderFilePath << std::endl;
-		return 0;
+		StopThreadPool(transformPool);
 	}
 
-	std::string shaderSource;
-	std::string temp;
-	while (std::getline(shaderFile, temp))
+	// Stop the command recording workers, keeping their numbers for the summary
+	int commandThreadCount = GetJobThreadCount(commandRecorder.jobs);
+	int64_t commandFrames = commandRecorder.frames;
+	int64_t commandJobs = commandRecorder.recordedJobs;
+	int64_t stolenCommandJobs = commandRecorder.jobs.stolenJobs;
+	if (recordCommands)
 	{
-		shaderSource += temp + "\n";
+		StopCommandRecorder(commandRecorder);
 	}
-	shaderFile.close();
 
-	return CreateShaderFromSource(shaderType, shaderSource);
-}
+	// Delete the instance buffers and the vertex array objects of the instance batches
+	DeleteInstanceBatches(instanceBatches);
+	DeleteInstanceBuffers(instanceBuffers);
 
-/// <summary>
-/// Creates a shader based on the provided shader type and the string containing the shader source.
-/// </summary>
-/// <param name="shaderType">Shader type</param>
-/// <param name="shaderSource">Shader source string</param>
-/// <returns>OpenGL handle to the created shader</returns>
-GLuint CreateShaderFromSource(const GLuint& shaderType, const std::string& shaderSource)
-{
-	GLuint shader = glCreateShader(shaderType);
+	// Delete the buffers that contain our meshes
+	DeleteMeshBuffers(meshBuffers);
 
-	const char* shaderSourceCStr = shaderSource.c_str();
-	GLint shaderSourceLen = static_cast<GLint>(shaderSource.length());
-	glShaderSource(shader, 1, &shaderSourceCStr, &shaderSourceLen);
-	glCompileShader(shader);
+	// Delete the vertex array object
+	glDeleteVertexArrays(1, &vao);
 
-	// Check compilation status
-	GLint compileStatus;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
-	if (compileStatus == GL_FALSE)
+	// Stop the decode threads and delete the material texture array
+	StopTextureLoader(textureLoader);
+	DeleteTextureArray(materials);
+
+	if (options.headless)
 	{
-		char infoLog[512];
-		GLsizei infoLogLen = sizeof(infoLog);
-		glGetShaderInfoLog(shader, infoLogLen, &infoLogLen, infoLog);
-		std::cerr << "shader compilation error: " << infoLog << std::endl;
+		std::cout << "Rendered " << frameIndex << " frames: avg " << totalFrameMilliseconds / std::max(frameIndex, 1)
+			<< " ms, min " << minFrameMilliseconds << " ms, max " << maxFrameMilliseconds << " ms" << std::endl;
+		std::cout << "First frame finished " << firstFrameMilliseconds << " ms after startup" << std::endl;
+		std::cout << "Scene loaded after " << sceneMilliseconds << " ms (" << scene.size() << " objects, "
+			<< sceneMaterials.size() << " materials, " << sceneLights.size() << " lights)" << std::endl;
+		std::cout << "Drew " << static_cast<double>(totalVisibleObjects) / std::max(frameIndex, 1) << " of " << scene.size()
+			<< " objects per frame on average" << std::endl;
+		std::cout << "State changes: " << renderState.issuedCalls << " issued, " << renderState.skippedCalls << " skipped as redundant" << std::endl;
+		std::cout << "Draw calls: " << static_cast<double>(renderState.drawCalls) / std::max(frameIndex, 1) << " per frame on average" << std::endl;
+		if (options.shadows)
+		{
+			std::cout << "Shadow map: static cube map drawn " << staticShadowPasses << " times, " << dynamicShadowFacePasses
+				<< " dynamic face passes" << std::endl;
+		}
+		if (recordCommands)
+		{
+			std::cout << "Command recording: " << commandThreadCount << " threads, "
+				<< static_cast<double>(commandJobs) / std::max<int64_t>(commandFrames, 1) << " jobs per frame, "
+				<< stolenCommandJobs << " of " << commandJobs << " jobs stolen" << std::endl;
+		}
+		if (options.occlusion)
+		{
+			double occlusionFrames = static_cast<double>(std::max<int64_t>(occlusion.frames, 1));
+			std::cout << "Occlusion culling: " << occlusion.depthHiddenObjects / occlusionFrames << " objects hidden by the depth buffer and "
+				<< occlusion.queryHiddenObjects / occlusionFrames << " by queries per frame, " << occlusion.issuedQueries / occlusionFrames
+				<< " queries per frame" << std::endl;
+		}
+		if (useDynamicResolution)
+		{
+			std::cout << "Dynamic resolution: average scale " << averageResolutionScale << ", lowest " << dynamicResolution.lowestScale
+				<< ", " << dynamicResolution.changes << " changes (" << dynamicResolution.width << "x" << dynamicResolution.height << " at the end)" << std::endl;
+		}
+		std::cout << "Shader programs ready after " << shaderMilliseconds << " ms (" << shaderCache.hits << " from cache, "
+			<< shaderCache.misses << " compiled, " << sceneShaderVariants << " scene shader variants)" << std::endl;
+
+		DestroyHeadlessContext(headless);
+		return benchmarkWritten ? 0 : 1;
 	}
 
-	return shader;
+	// Remember to tell GLFW to clean itself up before exiting the application
+	glfwTerminate();
+
+	return 0;
 }
 
 /// <summary>
@@ -680,3 +1158,169 @@ void FramebufferSizeChangedCallback(GLFWwindow* window, int width, int height)
 	// update the dimensions of the region to the new size
 	glViewport(0, 0, width, height);
 }
+
+/// <summary>
+/// Renders the headless frames on the CPU with the software rasterizer instead of OpenGL.
+/// </summary>
+/// <param name="options">Command line options</param>
+/// <param name="meshData">CPU-side meshes</param>
+/// <param name="sceneStream">Compiled scene whose objects have not been read yet (closed here)</param>
+/// <param name="sceneMaterials">Materials of the scene</param>
+/// <param name="scene">Scene objects read so far</param>
+/// <param name="sceneLights">Point lights of the scene</param>
+/// <param name="startupStart">Time at which the program started</param>
+/// <param name="sceneMilliseconds">Time spent loading the scene so far</param>
+/// <returns>Exit code of the program</returns>
+int RunSoftwareRenderer(const AppOptions& options, const MeshData& meshData, SceneStream& sceneStream, const std::vector<SceneMaterial>& sceneMaterials,
+	std::vector<SceneObject>& scene, const std::vector<ScenePointLight>& sceneLights, std::chrono::steady_clock::time_point startupStart,
+	double sceneMilliseconds)
+{
+	if (options.shadows || options.instancing || options.gpuDriven)
+	{
+		std::cerr << "The software renderer ignores --shadows, --instanced and --gpu-driven" << std::endl;
+	}
+
+	// Read the rest of a compiled scene; there is no instance buffer to stream it into
+	std::chrono::steady_clock::time_point sceneStart = std::chrono::steady_clock::now();
+	while (StreamSceneObjects(sceneStream, scene, 4096))
+	{
+	}
+	CloseSceneStream(sceneStream);
+	sceneMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sceneStart).count();
+
+	// Unpacked meshes, frame buffers and worker threads, then the material images decoded on those threads
+	SoftwareRenderer renderer;
+	CreateSoftwareRenderer(renderer, options.width, options.height, meshData, options.softwareThreads);
+	int failedMaterials = LoadSoftwareMaterials(renderer, sceneMaterials, options.materialSize);
+	if (failedMaterials > 0)
+	{
+		std::cerr << failedMaterials << " material images failed to load, drawing them gray" << std::endl;
+	}
+
+	// Transforms and culling are the same as on the OpenGL paths
+	TransformStore transforms;
+	CreateTransformStore(transforms, scene);
+
+	SceneBvh sceneBvh;
+	std::vector<uint32_t> visibleObjects;
+	if (options.culling)
+	{
+		BuildSceneBvh(sceneBvh, scene, renderer.meshes, transforms);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < scene.size(); ++i)
+		{
+			visibleObjects.push_back(i);
+		}
+	}
+	std::vector<uint8_t> visibleLods;
+
+	Simulation simulation;
+	StartSimulation(simulation, options.simulationRate, false);
+
+	float windowWidth = static_cast<float>(options.width);
+	float windowHeight = static_cast<float>(options.height);
+	int frameIndex = 0;
+	double totalFrameMilliseconds = 0.0;
+	double minFrameMilliseconds = 0.0;
+	double maxFrameMilliseconds = 0.0;
+	double firstFrameMilliseconds = 0.0;
+	size_t totalVisibleObjects = 0;
+	size_t totalTriangles = 0;
+	std::vector<double> frameTimes;
+
+	while (frameIndex < options.frameCount)
+	{
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+		// Same fixed clock, camera and light as the headless OpenGL loop
+		float time = frameIndex * 60.0f / options.simulatedFps;
+		double frameSeconds = frameIndex / static_cast<double>(options.simulatedFps);
+		AdvanceSimulation(simulation, frameSeconds);
+		SimulationState state = GetSimulationState(simulation, frameSeconds);
+		if (options.benchmarkObjects > 0)
+		{
+			SetBenchmarkCamera(state, frameIndex, options.frameCount);
+		}
+
+		SetTransformTime(transforms, time);
+		UpdateTransforms(transforms);
+
+		glm::mat4 viewMatrix = glm::lookAt(glm::vec3(state.cameraMoveLeftRight, 0.0f, state.cameraMoveForwardBackward), glm::vec3(state.cameraLookLeftRight, state.cameraLookUpDown, state.cameraLookForwardBackward), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 perspectiveProjMatrix = glm::perspective(90.0f, windowWidth / windowHeight, 0.1f, 100.0f);
+
+		FrameUniforms frameUniforms = {};
+		frameUniforms.view = viewMatrix;
+		frameUniforms.projection = perspectiveProjMatrix;
+		frameUniforms.lightPos = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
+		frameUniforms.lightColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+		frameUniforms.ambientStrength = state.ambientStrength;
+		frameUniforms.inverseView = glm::inverse(viewMatrix);
+
+		if (options.culling)
+		{
+			RefitSceneBvh(sceneBvh, scene, renderer.meshes, transforms);
+			CullSceneBvh(sceneBvh, ExtractFrustum(perspectiveProjMatrix * viewMatrix), visibleObjects);
+		}
+		SelectObjectLods(scene, renderer.meshes, transforms, visibleObjects, glm::vec3(frameUniforms.inverseView[3]),
+			perspectiveProjMatrix[1][1] * windowHeight * 0.5f, visibleLods);
+		totalVisibleObjects += visibleObjects.size();
+
+		DrawSoftwareFrame(renderer, scene, sceneMaterials, sceneLights, transforms, visibleObjects, visibleLods, frameUniforms);
+		totalTriangles += renderer.triangleCount;
+
+		double frameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+		totalFrameMilliseconds += frameMilliseconds;
+		minFrameMilliseconds = frameIndex == 0 ? frameMilliseconds : std::min(minFrameMilliseconds, frameMilliseconds);
+		maxFrameMilliseconds = std::max(maxFrameMilliseconds, frameMilliseconds);
+		frameTimes.push_back(frameMilliseconds);
+		if (frameIndex == 0)
+		{
+			firstFrameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count();
+		}
+
+		bool capture = options.captureAllFrames
+			|| std::find(options.captureFrames.begin(), options.captureFrames.end(), frameIndex) != options.captureFrames.end()
+			|| (options.captureFrames.empty() && options.benchmarkResultPath.empty() && frameIndex == options.frameCount - 1);
+		if (capture)
+		{
+			char fileName[64];
+			std::snprintf(fileName, sizeof(fileName), "/frame_%05d.ppm", frameIndex);
+			WriteSoftwareFrameToFile(renderer, options.outputDirectory + fileName);
+		}
+
+		++frameIndex;
+	}
+
+	StopSimulation(simulation);
+	unsigned int threadCount = static_cast<unsigned int>(renderer.pool.workers.size());
+	DeleteSoftwareRenderer(renderer);
+
+	std::cout << "Software renderer: " << GetSoftwareSimdName() << ", " << threadCount << " worker threads, "
+		<< SoftwareTileSize << "x" << SoftwareTileSize << " tiles" << std::endl;
+	std::cout << "Rendered " << frameIndex << " frames: avg " << totalFrameMilliseconds / std::max(frameIndex, 1)
+		<< " ms, min " << minFrameMilliseconds << " ms, max " << maxFrameMilliseconds << " ms" << std::endl;
+	std::cout << "First frame finished " << firstFrameMilliseconds << " ms after startup" << std::endl;
+	std::cout << "Scene loaded after " << sceneMilliseconds << " ms (" << scene.size() << " objects, "
+		<< sceneMaterials.size() << " materials, " << sceneLights.size() << " lights)" << std::endl;
+	std::cout << "Drew " << static_cast<double>(totalVisibleObjects) / std::max(frameIndex, 1) << " of " << scene.size()
+		<< " objects and " << static_cast<double>(totalTriangles) / std::max(frameIndex, 1) << " triangles per frame on average" << std::endl;
+
+	// Benchmark runs of the software renderer have no GPU time and no draw calls
+	if (!options.benchmarkResultPath.empty())
+	{
+		BenchmarkResult result;
+		result.config = GetBenchmarkConfig(options);
+		result.name = GetBenchmarkName(result.config);
+		SetBenchmarkFrameTimes(result, frameTimes);
+		result.gpuFrameMilliseconds = -1.0;
+		result.drawCalls = 0.0;
+		result.peakMemoryMegabytes = GetPeakMemoryMegabytes();
+		if (!AppendBenchmarkResult(options.benchmarkResultPath, result))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Maps a whole file into memory for reading. Pages are only read from disk when they are touched.
+/// </summary>
+/// <param name="file">Mapped file that will be filled in</param>
+/// <param name="filePath">Path of the file</param>
+/// <returns>True if the file was mapped, false if it does not exist, is empty or cannot be mapped</returns>
+bool OpenMappedFile(MappedFile& file, const std::string& filePath)
+{
+#if defined(_WIN32)
+	HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	file.data = static_cast<const unsigned char*>(data);
+	file.size = static_cast<size_t>(fileSize.QuadPart);
+	file.fileHandle = fileHandle;
+	file.mappingHandle = mappingHandle;
+	return true;
+#else
+	int descriptor = open(filePath.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+	{
+		close(descriptor);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+	// The mapping stays valid after the descriptor is closed
+	close(descriptor);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	file.data = static_cast<const unsigned char*>(data);
+	file.size = static_cast<size_t>(status.st_size);
+	return true;
+#endif
+}
+
+/// <summary>
+/// Unmaps a file that was mapped with OpenMappedFile().
+/// </summary>
+/// <param name="file">Mapped file</param>
+void CloseMappedFile(MappedFile& file)
+{
+	if (file.data == nullptr)
+	{
+		return;
+	}
+
+#if defined(_WIN32)
+	UnmapViewOfFile(file.data);
+	CloseHandle(static_cast<HANDLE>(file.mappingHandle));
+	CloseHandle(static_cast<HANDLE>(file.fileHandle));
+#else
+	munmap(const_cast<unsigned char*>(file.data), file.size);
+#endif
+
+	file = MappedFile();
+}
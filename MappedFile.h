@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// <summary>
+/// Struct containing a read-only view of a file that is mapped into memory
+/// </summary>
+struct MappedFile
+{
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	void* fileHandle = nullptr;		// Windows only: file and mapping handles
+	void* mappingHandle = nullptr;
+};
+
+/// <summary>
+/// Maps a whole file into memory for reading. Pages are only read from disk when they are touched.
+/// </summary>
+/// <param name="file">Mapped file that will be filled in</param>
+/// <param name="filePath">Path of the file</param>
+/// <returns>True if the file was mapped, false if it does not exist, is empty or cannot be mapped</returns>
+bool OpenMappedFile(MappedFile& file, const std::string& filePath);
+
+/// <summary>
+/// Unmaps a file that was mapped with OpenMappedFile().
+/// </summary>
+/// <param name="file">Mapped file</param>
+void CloseMappedFile(MappedFile& file);
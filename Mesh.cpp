@@ -0,0 +1,567 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+/// <summary>
+/// Number of entries of the vertex cache that the triangle order is optimized for.
+/// Larger than most hardware caches on purpose; the ordering degrades gracefully on smaller ones.
+/// </summary>
+static const int VertexCacheSize = 32;
+
+/// <summary>
+/// Struct used as the key when merging duplicate vertices: the packed vertex plus its color
+/// </summary>
+struct VertexKey
+{
+	PackedVertex vertex;
+	GLuint color;
+
+	bool operator==(const VertexKey& other) const
+	{
+		return std::memcmp(this, &other, sizeof(VertexKey)) == 0;
+	}
+};
+
+/// <summary>
+/// Hashes the bytes of a vertex key (FNV-1a).
+/// </summary>
+struct VertexKeyHash
+{
+	size_t operator()(const VertexKey& key) const
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+		size_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < sizeof(VertexKey); ++i)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+};
+
+/// <summary>
+/// Converts a vertex into the compact format.
+/// </summary>
+/// <param name="vertex">Vertex as written by hand</param>
+/// <returns>Packed vertex</returns>
+static PackedVertex PackVertex(const Vertex& vertex)
+{
+	PackedVertex packed;
+	packed.x = vertex.x;
+	packed.y = vertex.y;
+	packed.z = vertex.z;
+	packed.normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.nx, vertex.ny, vertex.nz, 0.0f));
+	packed.u = glm::packHalf1x16(vertex.u);
+	packed.v = glm::packHalf1x16(vertex.v);
+	return packed;
+}
+
+/// <summary>
+/// Computes the score of a vertex for the vertex cache optimization. Vertices that are in the cache and
+/// vertices with few remaining triangles score higher, so their triangles are emitted sooner.
+/// </summary>
+/// <param name="cachePosition">Position of the vertex in the simulated cache (-1 if not in the cache)</param>
+/// <param name="remainingTriangles">Number of triangles using the vertex that have not been emitted yet</param>
+/// <returns>Score of the vertex</returns>
+static float ComputeVertexScore(int cachePosition, int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The three vertices of the last triangle get a fixed score, so that the next triangle
+		// does not simply reuse the same edge over and over
+		if (cachePosition < 3)
+		{
+			score = 0.75f;
+		}
+		else
+		{
+			float scale = 1.0f / (VertexCacheSize - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+		}
+	}
+
+	// Boost vertices that have only a few triangles left, to get rid of lone triangles early
+	score += 2.0f * std::pow(static_cast<float>(remainingTriangles), -0.5f);
+	return score;
+}
+
+/// <summary>
+/// Reorders the triangles of an index list so that consecutive triangles reuse recently
+/// transformed vertices (Tom Forsyth's linear-speed vertex cache optimization).
+/// </summary>
+/// <param name="indices">Triangle indices, reordered in place</param>
+/// <param name="vertexCount">Number of vertices referenced by the indices</param>
+void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Build the list of triangles that use each vertex
+	std::vector<int> triangleListStart(vertexCount + 1, 0);
+	for (GLuint index : indices)
+	{
+		triangleListStart[index + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		triangleListStart[v + 1] += triangleListStart[v];
+	}
+
+	std::vector<int> remainingTriangles(vertexCount, 0);
+	std::vector<int> vertexTriangles(indices.size());
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			GLuint v = indices[t * 3 + corner];
+			vertexTriangles[triangleListStart[v] + remainingTriangles[v]++] = static_cast<int>(t);
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		vertexScore[v] = ComputeVertexScore(-1, remainingTriangles[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> triangleEmitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<GLuint> optimized;
+	optimized.reserve(indices.size());
+
+	std::vector<GLuint> cache;
+	std::vector<GLuint> newCache;
+	cache.reserve(VertexCacheSize + 3);
+	newCache.reserve(VertexCacheSize + 3);
+
+	size_t scanPosition = 0;
+	int bestTriangle = -1;
+
+	for (size_t emitted = 0; emitted < triangleCount; ++emitted)
+	{
+		// No candidate from the cache: fall back to the best remaining triangle in index order
+		if (bestTriangle < 0)
+		{
+			float bestScore = -1.0f;
+			for (size_t t = scanPosition; t < triangleCount; ++t)
+			{
+				if (!triangleEmitted[t] && triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = static_cast<int>(t);
+				}
+			}
+		}
+
+		// Emit the triangle and remove it from the triangle lists of its vertices
+		triangleEmitted[bestTriangle] = true;
+		while (scanPosition < triangleCount && triangleEmitted[scanPosition])
+		{
+			++scanPosition;
+		}
+
+		GLuint triangleVertices[3];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			GLuint v = indices[bestTriangle * 3 + corner];
+			triangleVertices[corner] = v;
+			optimized.push_back(v);
+
+			int* list = &vertexTriangles[triangleListStart[v]];
+			int count = remainingTriangles[v];
+			for (int i = 0; i < count; ++i)
+			{
+				if (list[i] == bestTriangle)
+				{
+					list[i] = list[count - 1];
+					break;
+				}
+			}
+			remainingTriangles[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		newCache.assign(triangleVertices, triangleVertices + 3);
+		for (GLuint v : cache)
+		{
+			if (v != triangleVertices[0] && v != triangleVertices[1] && v != triangleVertices[2])
+			{
+				newCache.push_back(v);
+			}
+		}
+
+		// Vertices pushed out of the cache lose their cache bonus, and so do their triangles
+		for (size_t i = VertexCacheSize; i < newCache.size(); ++i)
+		{
+			GLuint v = newCache[i];
+			cachePosition[v] = -1;
+			vertexScore[v] = ComputeVertexScore(-1, remainingTriangles[v]);
+
+			const int* list = &vertexTriangles[triangleListStart[v]];
+			for (int j = 0; j < remainingTriangles[v]; ++j)
+			{
+				int t = list[j];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+			}
+		}
+		if (newCache.size() > static_cast<size_t>(VertexCacheSize))
+		{
+			newCache.resize(VertexCacheSize);
+		}
+		cache.swap(newCache);
+
+		// Update the scores of the cached vertices and their triangles, and pick the next triangle among them
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			cachePosition[cache[i]] = static_cast<int>(i);
+			vertexScore[cache[i]] = ComputeVertexScore(static_cast<int>(i), remainingTriangles[cache[i]]);
+		}
+
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (GLuint v : cache)
+		{
+			const int* list = &vertexTriangles[triangleListStart[v]];
+			for (int i = 0; i < remainingTriangles[v]; ++i)
+			{
+				int t = list[i];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(optimized);
+}
+
+/// <summary>
+/// Computes the average number of vertex cache misses per triangle of an index list for a FIFO cache.
+/// </summary>
+/// <param name="indices">Triangle indices</param>
+/// <param name="cacheSize">Number of entries in the simulated cache</param>
+/// <returns>Average cache miss ratio (3.0 means no reuse at all)</returns>
+float ComputeAverageCacheMissRatio(const std::vector<GLuint>& indices, size_t cacheSize)
+{
+	if (indices.empty())
+	{
+		return 0.0f;
+	}
+
+	std::vector<GLuint> cache;
+	size_t misses = 0;
+	for (GLuint index : indices)
+	{
+		bool hit = false;
+		for (GLuint cached : cache)
+		{
+			if (cached == index)
+			{
+				hit = true;
+				break;
+			}
+		}
+
+		if (!hit)
+		{
+			++misses;
+			cache.insert(cache.begin(), index);
+			if (cache.size() > cacheSize)
+			{
+				cache.pop_back();
+			}
+		}
+	}
+
+	return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+/// <summary>
+/// Converts a triangle list (three vertices per triangle, no sharing) into an indexed mesh:
+/// duplicate vertices are merged, vertices are packed into the compact format and the
+/// triangles are reordered for the post-transform vertex cache. The mesh is appended to the mesh data as the given
+/// level of detail; the levels of a mesh must be appended in order.
+/// </summary>
+/// <param name="meshData">Mesh data that receives the mesh</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="lod">Level of detail</param>
+/// <param name="triangles">Triangle list vertices</param>
+/// <param name="vertexCount">Number of vertices in the triangle list (a multiple of three)</param>
+void AppendTriangleList(MeshData& meshData, MeshType mesh, int lod, const Vertex* triangles, size_t vertexCount)
+{
+	// Merge vertices that are identical after packing
+	std::unordered_map<VertexKey, GLuint, VertexKeyHash> uniqueVertices;
+	std::vector<VertexKey> vertices;
+	std::vector<GLuint> indices;
+	indices.reserve(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		VertexKey key;
+		std::memset(&key, 0, sizeof(key));
+		key.vertex = PackVertex(triangles[i]);
+		key.color = triangles[i].r | (triangles[i].g << 8) | (triangles[i].b << 16) | 0xFF000000u;
+
+		std::unordered_map<VertexKey, GLuint, VertexKeyHash>::iterator found = uniqueVertices.find(key);
+		if (found == uniqueVertices.end())
+		{
+			found = uniqueVertices.emplace(key, static_cast<GLuint>(vertices.size())).first;
+			vertices.push_back(key);
+		}
+		indices.push_back(found->second);
+	}
+
+	OptimizeVertexCache(indices, vertices.size());
+
+	// Renumber the vertices in the order the triangles first use them, so vertex fetches walk the buffer forwards
+	std::vector<GLuint> remap(vertices.size(), ~0u);
+	GLuint nextVertex = 0;
+	for (GLuint& index : indices)
+	{
+		if (remap[index] == ~0u)
+		{
+			remap[index] = nextVertex++;
+		}
+		index = remap[index];
+	}
+
+	std::vector<VertexKey> ordered(vertices.size());
+	for (size_t v = 0; v < vertices.size(); ++v)
+	{
+		ordered[remap[v]] = vertices[v];
+	}
+
+	MeshRange& range = meshData.ranges[mesh][lod];
+	meshData.lodCounts[mesh] = lod + 1;
+	range.firstIndex = static_cast<GLuint>(meshData.indices.size());
+	range.indexCount = static_cast<GLsizei>(indices.size());
+	range.baseVertex = static_cast<GLint>(meshData.vertices.size());
+	range.vertexCount = static_cast<GLsizei>(ordered.size());
+
+	// Bounding box of the positions, which the culling code transforms into world space, and the bounding sphere
+	// around the origin, which sets the level of detail
+	range.radius = 0.0f;
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		const GLfloat position[3] = { triangles[i].x, triangles[i].y, triangles[i].z };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			range.boundsMin[axis] = i == 0 ? position[axis] : std::min(range.boundsMin[axis], position[axis]);
+			range.boundsMax[axis] = i == 0 ? position[axis] : std::max(range.boundsMax[axis], position[axis]);
+		}
+		range.radius = std::max(range.radius, std::sqrt(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]));
+		meshData.hasNormals[mesh] = meshData.hasNormals[mesh] || triangles[i].nx != 0.0f || triangles[i].ny != 0.0f || triangles[i].nz != 0.0f;
+	}
+
+	meshData.indices.insert(meshData.indices.end(), indices.begin(), indices.end());
+
+	// The color stream is only created once a vertex that is not white shows up
+	bool hasColors = !meshData.colors.empty();
+	for (const VertexKey& key : ordered)
+	{
+		hasColors = hasColors || key.color != 0xFFFFFFFFu;
+	}
+	if (hasColors && meshData.colors.empty())
+	{
+		meshData.colors.assign(meshData.vertices.size(), 0xFFFFFFFFu);
+	}
+
+	for (const VertexKey& key : ordered)
+	{
+		meshData.vertices.push_back(key.vertex);
+		if (hasColors)
+		{
+			meshData.colors.push_back(key.color);
+		}
+	}
+}
+
+/// <summary>
+/// Copies the ranges, levels of detail and normal flags of the mesh data without uploading anything, for code that
+/// draws from the CPU-side meshes (its buffer names stay 0).
+/// </summary>
+/// <param name="meshData">Mesh data</param>
+/// <returns>Mesh buffers without any buffers</returns>
+MeshBuffers DescribeMeshData(const MeshData& meshData)
+{
+	MeshBuffers buffers;
+	for (int mesh = 0; mesh < MeshTypeCount; ++mesh)
+	{
+		for (int lod = 0; lod < MeshLodCount; ++lod)
+		{
+			buffers.ranges[mesh][lod] = meshData.ranges[mesh][lod];
+		}
+		buffers.lodCounts[mesh] = meshData.lodCounts[mesh];
+		buffers.hasNormals[mesh] = meshData.hasNormals[mesh];
+	}
+	return buffers;
+}
+
+/// <summary>
+/// Uploads the mesh data into vertex, color and index buffers.
+/// </summary>
+/// <param name="meshData">Mesh data</param>
+/// <returns>Mesh buffers</returns>
+MeshBuffers UploadMeshData(const MeshData& meshData)
+{
+	MeshBuffers buffers = DescribeMeshData(meshData);
+
+	glGenBuffers(1, &buffers.vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, meshData.vertices.size() * sizeof(PackedVertex), meshData.vertices.data(), GL_STATIC_DRAW);
+
+	if (!meshData.colors.empty())
+	{
+		glGenBuffers(1, &buffers.colorBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.colorBuffer);
+		glBufferData(GL_ARRAY_BUFFER, meshData.colors.size() * sizeof(GLuint), meshData.colors.data(), GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// Indices are relative to each mesh's base vertex, so 16 bits are enough unless a single mesh is huge
+	GLuint maxIndex = 0;
+	for (GLuint index : meshData.indices)
+	{
+		maxIndex = index > maxIndex ? index : maxIndex;
+	}
+
+	glGenBuffers(1, &buffers.indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+	if (maxIndex <= 0xFFFF)
+	{
+		std::vector<GLushort> shortIndices(meshData.indices.begin(), meshData.indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+		buffers.indexType = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshData.indices.size() * sizeof(GLuint), meshData.indices.data(), GL_STATIC_DRAW);
+		buffers.indexType = GL_UNSIGNED_INT;
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return buffers;
+}
+
+/// <summary>
+/// Deletes the mesh buffers.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+void DeleteMeshBuffers(MeshBuffers& buffers)
+{
+	glDeleteBuffers(1, &buffers.vertexBuffer);
+	glDeleteBuffers(1, &buffers.colorBuffer);
+	glDeleteBuffers(1, &buffers.indexBuffer);
+	buffers = MeshBuffers();
+}
+
+/// <summary>
+/// Sets up the per-vertex attributes (position, color, UV, normal) and the index buffer
+/// of the currently bound vertex array object.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+void SetupVertexAttributes(const MeshBuffers& buffers)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+
+	// Vertex attribute 0 - Position
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, x));
+
+	// Vertex attribute 2 - UV coordinate (half floats)
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)(offsetof(PackedVertex, u)));
+
+	// Vertex attribute 3 - Normal (10 bits per component, signed normalized)
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)(offsetof(PackedVertex, normal)));
+
+	// Vertex attribute 1 - Color, from its own stream if there is one; otherwise every vertex is white
+	if (buffers.colorBuffer != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.colorBuffer);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GLuint), (void*)0);
+	}
+	else
+	{
+		glDisableVertexAttribArray(1);
+		glVertexAttrib4f(1, 1.0f, 1.0f, 1.0f, 1.0f);
+	}
+
+	// The element array binding is part of the vertex array object's state
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+}
+
+/// <summary>
+/// Picks the level of detail of a mesh for the size it covers on the screen.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="screenRadius">Radius of the mesh's bounding sphere on the screen, in pixels</param>
+/// <returns>Level of detail</returns>
+int SelectMeshLod(const MeshBuffers& buffers, MeshType mesh, float screenRadius)
+{
+	// Each level takes over below half the radius of the one before, so a triangle keeps about the same size on the
+	// screen as long as every level has a quarter of the triangles of the one before
+	int lod = 0;
+	float limit = MeshLodReferenceRadius;
+	while (lod + 1 < buffers.lodCounts[mesh] && screenRadius < limit)
+	{
+		++lod;
+		limit *= 0.5f;
+	}
+	return lod;
+}
+
+/// <summary>
+/// Draws a mesh. The vertex array object that was set up with the mesh buffers must be bound.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="lod">Level of detail</param>
+void DrawMesh(const MeshBuffers& buffers, MeshType mesh, int lod)
+{
+	const MeshRange& range = buffers.ranges[mesh][lod];
+	size_t indexSize = buffers.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, buffers.indexType, (void*)(range.firstIndex * indexSize), range.baseVertex);
+}
+
+/// <summary>
+/// Draws several instances of a mesh. The vertex array object that was set up with the mesh buffers must be bound.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="lod">Level of detail</param>
+/// <param name="instanceCount">Number of instances</param>
+void DrawMeshInstanced(const MeshBuffers& buffers, MeshType mesh, int lod, GLsizei instanceCount)
+{
+	const MeshRange& range = buffers.ranges[mesh][lod];
+	size_t indexSize = buffers.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, buffers.indexType, (void*)(range.firstIndex * indexSize), instanceCount, range.baseVertex);
+}
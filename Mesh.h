@@ -0,0 +1,175 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// Struct containing data about a vertex, as written by hand in main()
+/// </summary>
+struct Vertex
+{
+	GLfloat x, y, z;	// Position
+	GLubyte r, g, b;	// Color
+	GLfloat u, v;		// UV coordinates
+	GLfloat nx, ny, nz; //Normal
+};
+
+/// <summary>
+/// Struct containing a vertex in the compact format that is uploaded to the GPU (20 bytes instead of 36)
+/// </summary>
+struct PackedVertex
+{
+	GLfloat x, y, z;	// Position
+	GLuint normal;		// Normal packed as GL_INT_2_10_10_10_REV (signed normalized, w unused)
+	GLushort u, v;		// UV coordinates as half floats
+};
+
+/// <summary>
+/// Shapes that are stored in the mesh buffers
+/// </summary>
+enum MeshType
+{
+	MeshCube,
+	MeshOctahedron,
+	MeshBox,			// Generated by MeshGenerator.cpp from here on
+	MeshSphere,
+	MeshCylinder,
+	MeshTypeCount
+};
+
+/// <summary>
+/// Largest number of levels of detail of a mesh. Level 0 is the finest; each level has about half the detail of the one before.
+/// </summary>
+const int MeshLodCount = 4;
+
+/// <summary>
+/// Screen-space radius in pixels from which on the finest level of detail is drawn. Every coarser level takes over
+/// below half the radius of the level before it.
+/// </summary>
+const float MeshLodReferenceRadius = 200.0f;
+
+/// <summary>
+/// Struct containing the part of the index buffer that makes up a mesh
+/// </summary>
+struct MeshRange
+{
+	GLuint firstIndex;		// First index of the mesh in the index buffer
+	GLsizei indexCount;		// Number of indices (three per triangle)
+	GLint baseVertex;		// Value added to every index of the mesh, so indices can stay 16-bit
+	GLsizei vertexCount;	// Number of unique vertices of the mesh
+	GLfloat boundsMin[3];	// Corners of the axis-aligned bounding box of the vertex positions
+	GLfloat boundsMax[3];
+	GLfloat radius;			// Largest distance of a vertex position from the origin
+};
+
+/// <summary>
+/// Struct containing the CPU-side data of all meshes before it is uploaded
+/// </summary>
+struct MeshData
+{
+	std::vector<PackedVertex> vertices;
+	std::vector<GLuint> colors;			// Optional color stream (RGBA8, one per vertex); stays empty while every vertex is white
+	std::vector<GLuint> indices;		// Indices relative to the mesh's base vertex
+	MeshRange ranges[MeshTypeCount][MeshLodCount] = {};	// Every level of detail of every mesh
+	int lodCounts[MeshTypeCount] = {};	// Number of levels of detail of every mesh
+	bool hasNormals[MeshTypeCount] = {};	// Whether any vertex of the mesh has a normal (the hand-written octahedron has none)
+};
+
+/// <summary>
+/// Struct containing the GPU buffers of all meshes
+/// </summary>
+struct MeshBuffers
+{
+	GLuint vertexBuffer = 0;
+	GLuint colorBuffer = 0;				// 0 when the meshes have no color stream
+	GLuint indexBuffer = 0;
+	GLenum indexType = GL_UNSIGNED_SHORT;
+	MeshRange ranges[MeshTypeCount][MeshLodCount] = {};	// Every level of detail of every mesh; level 0 has the bounds used for culling
+	int lodCounts[MeshTypeCount] = {};
+	bool hasNormals[MeshTypeCount] = {};
+};
+
+/// <summary>
+/// Converts a triangle list (three vertices per triangle, no sharing) into an indexed mesh:
+/// duplicate vertices are merged, vertices are packed into the compact format and the
+/// triangles are reordered for the post-transform vertex cache. The mesh is appended to the mesh data as the given
+/// level of detail; the levels of a mesh must be appended in order.
+/// </summary>
+/// <param name="meshData">Mesh data that receives the mesh</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="lod">Level of detail</param>
+/// <param name="triangles">Triangle list vertices</param>
+/// <param name="vertexCount">Number of vertices in the triangle list (a multiple of three)</param>
+void AppendTriangleList(MeshData& meshData, MeshType mesh, int lod, const Vertex* triangles, size_t vertexCount);
+
+/// <summary>
+/// Reorders the triangles of an index list so that consecutive triangles reuse recently
+/// transformed vertices (Tom Forsyth's linear-speed vertex cache optimization).
+/// </summary>
+/// <param name="indices">Triangle indices, reordered in place</param>
+/// <param name="vertexCount">Number of vertices referenced by the indices</param>
+void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+
+/// <summary>
+/// Computes the average number of vertex cache misses per triangle of an index list for a FIFO cache.
+/// </summary>
+/// <param name="indices">Triangle indices</param>
+/// <param name="cacheSize">Number of entries in the simulated cache</param>
+/// <returns>Average cache miss ratio (3.0 means no reuse at all)</returns>
+float ComputeAverageCacheMissRatio(const std::vector<GLuint>& indices, size_t cacheSize);
+
+/// <summary>
+/// Copies the ranges, levels of detail and normal flags of the mesh data without uploading anything, for code that
+/// draws from the CPU-side meshes (its buffer names stay 0).
+/// </summary>
+/// <param name="meshData">Mesh data</param>
+/// <returns>Mesh buffers without any buffers</returns>
+MeshBuffers DescribeMeshData(const MeshData& meshData);
+
+/// <summary>
+/// Uploads the mesh data into vertex, color and index buffers.
+/// </summary>
+/// <param name="meshData">Mesh data</param>
+/// <returns>Mesh buffers</returns>
+MeshBuffers UploadMeshData(const MeshData& meshData);
+
+/// <summary>
+/// Deletes the mesh buffers.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+void DeleteMeshBuffers(MeshBuffers& buffers);
+
+/// <summary>
+/// Sets up the per-vertex attributes (position, color, UV, normal) and the index buffer
+/// of the currently bound vertex array object.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+void SetupVertexAttributes(const MeshBuffers& buffers);
+
+/// <summary>
+/// Picks the level of detail of a mesh for the size it covers on the screen.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="screenRadius">Radius of the mesh's bounding sphere on the screen, in pixels</param>
+/// <returns>Level of detail</returns>
+int SelectMeshLod(const MeshBuffers& buffers, MeshType mesh, float screenRadius);
+
+/// <summary>
+/// Draws a mesh. The vertex array object that was set up with the mesh buffers must be bound.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="lod">Level of detail</param>
+void DrawMesh(const MeshBuffers& buffers, MeshType mesh, int lod);
+
+/// <summary>
+/// Draws several instances of a mesh. The vertex array object that was set up with the mesh buffers must be bound.
+/// </summary>
+/// <param name="buffers">Mesh buffers</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="lod">Level of detail</param>
+/// <param name="instanceCount">Number of instances</param>
+void DrawMeshInstanced(const MeshBuffers& buffers, MeshType mesh, int lod, GLsizei instanceCount);
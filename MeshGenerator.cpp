@@ -0,0 +1,217 @@
+#include "MeshGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Ratio of a circle's circumference to its diameter
+/// </summary>
+static const float Pi = 3.14159265358979f;
+
+/// <summary>
+/// Builds a white vertex.
+/// </summary>
+/// <param name="position">Position</param>
+/// <param name="normal">Normal</param>
+/// <param name="u">Horizontal texture coordinate</param>
+/// <param name="v">Vertical texture coordinate</param>
+/// <returns>Vertex</returns>
+static Vertex MakeVertex(const glm::vec3& position, const glm::vec3& normal, float u, float v)
+{
+	return { position.x, position.y, position.z, 255, 255, 255, u, v, normal.x, normal.y, normal.z };
+}
+
+/// <summary>
+/// Generates a box from -0.5 to 0.5 on every axis with flat face normals. Every face has the whole texture.
+/// </summary>
+/// <param name="triangles">Receives the triangle list</param>
+void GenerateBox(std::vector<Vertex>& triangles)
+{
+	// Normal and the two axes along every face, ordered so that uAxis x vAxis = normal (counter-clockwise from outside)
+	static const glm::vec3 faces[6][3] = {
+		{ glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		{ glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) },
+		{ glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) }
+	};
+	static const float corners[6][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f } };
+
+	triangles.clear();
+	for (const glm::vec3* face : faces)
+	{
+		for (const float* corner : corners)
+		{
+			glm::vec3 position = face[0] * 0.5f + face[1] * (corner[0] - 0.5f) + face[2] * (corner[1] - 0.5f);
+			triangles.push_back(MakeVertex(position, face[0], corner[0], corner[1]));
+		}
+	}
+}
+
+/// <summary>
+/// Computes the texture coordinates of a point on the unit sphere: longitude around the y axis and latitude.
+/// </summary>
+/// <param name="direction">Point on the unit sphere</param>
+/// <returns>Texture coordinates</returns>
+static glm::vec2 SphereTextureCoordinates(const glm::vec3& direction)
+{
+	float u = 0.5f + std::atan2(direction.z, direction.x) / (2.0f * Pi);
+	float v = 0.5f + std::asin(std::min(std::max(direction.y, -1.0f), 1.0f)) / Pi;
+	return glm::vec2(u, v);
+}
+
+/// <summary>
+/// Generates a sphere of radius 0.5 by subdividing an icosahedron and pushing the new vertices out onto the sphere.
+/// The normals point away from the center and the texture is wrapped around the vertical axis.
+/// </summary>
+/// <param name="triangles">Receives the triangle list</param>
+/// <param name="subdivisions">Number of times every triangle is split into four</param>
+void GenerateSphere(std::vector<Vertex>& triangles, int subdivisions)
+{
+	// Icosahedron with counter-clockwise faces
+	const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+	std::vector<glm::vec3> directions = {
+		glm::vec3(-1.0f, t, 0.0f), glm::vec3(1.0f, t, 0.0f), glm::vec3(-1.0f, -t, 0.0f), glm::vec3(1.0f, -t, 0.0f),
+		glm::vec3(0.0f, -1.0f, t), glm::vec3(0.0f, 1.0f, t), glm::vec3(0.0f, -1.0f, -t), glm::vec3(0.0f, 1.0f, -t),
+		glm::vec3(t, 0.0f, -1.0f), glm::vec3(t, 0.0f, 1.0f), glm::vec3(-t, 0.0f, -1.0f), glm::vec3(-t, 0.0f, 1.0f)
+	};
+	std::vector<uint32_t> faces = {
+		0, 11, 5,	0, 5, 1,	0, 1, 7,	0, 7, 10,	0, 10, 11,
+		1, 5, 9,	5, 11, 4,	11, 10, 2,	10, 7, 6,	7, 1, 8,
+		3, 9, 4,	3, 4, 2,	3, 2, 6,	3, 6, 8,	3, 8, 9,
+		4, 9, 5,	2, 4, 11,	6, 2, 10,	8, 6, 7,	9, 8, 1
+	};
+	for (glm::vec3& direction : directions)
+	{
+		direction = glm::normalize(direction);
+	}
+
+	// Split every triangle into four; the triangles on both sides of an edge share its midpoint
+	for (int level = 0; level < subdivisions; ++level)
+	{
+		std::unordered_map<uint64_t, uint32_t> midpoints;
+		auto midpoint = [&](uint32_t a, uint32_t b)
+		{
+			uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+			std::unordered_map<uint64_t, uint32_t>::iterator found = midpoints.find(key);
+			if (found != midpoints.end())
+			{
+				return found->second;
+			}
+			uint32_t index = static_cast<uint32_t>(directions.size());
+			directions.push_back(glm::normalize(directions[a] + directions[b]));
+			midpoints.emplace(key, index);
+			return index;
+		};
+
+		std::vector<uint32_t> split;
+		split.reserve(faces.size() * 4);
+		for (size_t i = 0; i < faces.size(); i += 3)
+		{
+			uint32_t a = faces[i], b = faces[i + 1], c = faces[i + 2];
+			uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			split.insert(split.end(), { a, ab, ca,	b, bc, ab,	c, ca, bc,	ab, bc, ca });
+		}
+		faces.swap(split);
+	}
+
+	triangles.clear();
+	triangles.reserve(faces.size());
+	for (size_t i = 0; i < faces.size(); i += 3)
+	{
+		glm::vec2 uvs[3];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			uvs[corner] = SphereTextureCoordinates(directions[faces[i + corner]]);
+		}
+
+		// Triangles across the seam get u past 1 instead of wrapping back to 0
+		float maxU = std::max(uvs[0].x, std::max(uvs[1].x, uvs[2].x));
+		for (glm::vec2& uv : uvs)
+		{
+			uv.x += maxU - uv.x > 0.5f ? 1.0f : 0.0f;
+		}
+
+		// The longitude of a pole is undefined, so it takes the average of the other two corners
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			const glm::vec3& direction = directions[faces[i + corner]];
+			if (std::abs(direction.x) < 1e-6f && std::abs(direction.z) < 1e-6f)
+			{
+				uvs[corner].x = (uvs[(corner + 1) % 3].x + uvs[(corner + 2) % 3].x) * 0.5f;
+			}
+		}
+
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			const glm::vec3& direction = directions[faces[i + corner]];
+			triangles.push_back(MakeVertex(direction * 0.5f, direction, uvs[corner].x, uvs[corner].y));
+		}
+	}
+}
+
+/// <summary>
+/// Generates a cylinder of radius 0.5 along the y axis from -0.5 to 0.5, with smooth sides and flat caps.
+/// </summary>
+/// <param name="triangles">Receives the triangle list</param>
+/// <param name="segments">Number of segments around the axis</param>
+void GenerateCylinder(std::vector<Vertex>& triangles, int segments)
+{
+	const glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+	triangles.clear();
+	for (int segment = 0; segment < segments; ++segment)
+	{
+		float u0 = static_cast<float>(segment) / segments;
+		float u1 = static_cast<float>(segment + 1) / segments;
+		glm::vec3 normal0(std::cos(u0 * 2.0f * Pi), 0.0f, std::sin(u0 * 2.0f * Pi));
+		glm::vec3 normal1(std::cos(u1 * 2.0f * Pi), 0.0f, std::sin(u1 * 2.0f * Pi));
+
+		Vertex bottom0 = MakeVertex(normal0 * 0.5f - up * 0.5f, normal0, u0, 0.0f);
+		Vertex bottom1 = MakeVertex(normal1 * 0.5f - up * 0.5f, normal1, u1, 0.0f);
+		Vertex top0 = MakeVertex(normal0 * 0.5f + up * 0.5f, normal0, u0, 1.0f);
+		Vertex top1 = MakeVertex(normal1 * 0.5f + up * 0.5f, normal1, u1, 1.0f);
+		triangles.insert(triangles.end(), { bottom0, top1, bottom1,		bottom0, top0, top1 });
+
+		// Caps are fans around the center, with the texture laid flat across them
+		Vertex capCenter = MakeVertex(up * 0.5f, up, 0.5f, 0.5f);
+		Vertex cap0 = MakeVertex(normal0 * 0.5f + up * 0.5f, up, 0.5f + normal0.x * 0.5f, 0.5f + normal0.z * 0.5f);
+		Vertex cap1 = MakeVertex(normal1 * 0.5f + up * 0.5f, up, 0.5f + normal1.x * 0.5f, 0.5f + normal1.z * 0.5f);
+		triangles.insert(triangles.end(), { capCenter, cap1, cap0 });
+
+		capCenter = MakeVertex(-up * 0.5f, -up, 0.5f, 0.5f);
+		cap0 = MakeVertex(normal0 * 0.5f - up * 0.5f, -up, 0.5f + normal0.x * 0.5f, 0.5f + normal0.z * 0.5f);
+		cap1 = MakeVertex(normal1 * 0.5f - up * 0.5f, -up, 0.5f + normal1.x * 0.5f, 0.5f + normal1.z * 0.5f);
+		triangles.insert(triangles.end(), { capCenter, cap0, cap1 });
+	}
+}
+
+/// <summary>
+/// Generates the box, the sphere and the cylinder at all of their levels of detail and appends them to the mesh data.
+/// </summary>
+/// <param name="meshData">Mesh data that receives the meshes</param>
+void AppendGeneratedMeshes(MeshData& meshData)
+{
+	std::vector<Vertex> triangles;
+
+	// A box has nothing to leave out, so it only has one level
+	GenerateBox(triangles);
+	AppendTriangleList(meshData, MeshBox, 0, triangles.data(), triangles.size());
+
+	for (int lod = 0; lod < MeshLodCount; ++lod)
+	{
+		GenerateSphere(triangles, SphereLodSubdivisions[lod]);
+		AppendTriangleList(meshData, MeshSphere, lod, triangles.data(), triangles.size());
+	}
+
+	for (int lod = 0; lod < MeshLodCount; ++lod)
+	{
+		GenerateCylinder(triangles, CylinderLodSegments[lod]);
+		AppendTriangleList(meshData, MeshCylinder, lod, triangles.data(), triangles.size());
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "Mesh.h"
+
+/// <summary>
+/// Number of subdivisions of the icosahedron for every level of detail of the sphere (20 * 4^n triangles)
+/// </summary>
+const int SphereLodSubdivisions[MeshLodCount] = { 4, 3, 2, 1 };
+
+/// <summary>
+/// Number of segments around the axis for every level of detail of the cylinder (4 * n triangles)
+/// </summary>
+const int CylinderLodSegments[MeshLodCount] = { 64, 32, 16, 8 };
+
+/// <summary>
+/// Generates a box from -0.5 to 0.5 on every axis with flat face normals. Every face has the whole texture.
+/// </summary>
+/// <param name="triangles">Receives the triangle list</param>
+void GenerateBox(std::vector<Vertex>& triangles);
+
+/// <summary>
+/// Generates a sphere of radius 0.5 by subdividing an icosahedron and pushing the new vertices out onto the sphere.
+/// The normals point away from the center and the texture is wrapped around the vertical axis.
+/// </summary>
+/// <param name="triangles">Receives the triangle list</param>
+/// <param name="subdivisions">Number of times every triangle is split into four</param>
+void GenerateSphere(std::vector<Vertex>& triangles, int subdivisions);
+
+/// <summary>
+/// Generates a cylinder of radius 0.5 along the y axis from -0.5 to 0.5, with smooth sides and flat caps.
+/// </summary>
+/// <param name="triangles">Receives the triangle list</param>
+/// <param name="segments">Number of segments around the axis</param>
+void GenerateCylinder(std::vector<Vertex>& triangles, int segments);
+
+/// <summary>
+/// Generates the box, the sphere and the cylinder at all of their levels of detail and appends them to the mesh data.
+/// </summary>
+/// <param name="meshData">Mesh data that receives the meshes</param>
+void AppendGeneratedMeshes(MeshData& meshData);
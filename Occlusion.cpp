@@ -0,0 +1,461 @@
+#include "Occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// <summary>
+/// Smallest size on the screen, as bounding radius over distance, of an object that is drawn into the CPU depth buffer
+/// </summary>
+static const float OcclusionMinOccluderSize = 0.1f;
+
+/// <summary>
+/// Bounding boxes are grown by this fraction of their size (plus the same in world units) before they are drawn
+/// inside a query, so the faces of a box-shaped object never hide its own bounding box
+/// </summary>
+static const float OcclusionBoxMargin = 0.01f;
+
+/// <summary>
+/// Struct containing the screen area and nearest depth of a bounding box
+/// </summary>
+struct ScreenBounds
+{
+	float minX, minY, maxX, maxY;		// Pixels of the finest level of the CPU depth buffer
+	float minDepth;						// Nearest window depth
+};
+
+/// <summary>
+/// Projects the corners of a bounding box onto the CPU depth buffer.
+/// </summary>
+/// <param name="box">World-space bounding box</param>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="bounds">Receives the screen area and nearest depth</param>
+/// <returns>False if the box reaches the near plane, so that it cannot be hidden; true otherwise</returns>
+static bool ProjectBoundingBox(const BoundingBox& box, const glm::mat4& viewProjection, ScreenBounds& bounds)
+{
+	bounds.minX = bounds.minY = bounds.minDepth = std::numeric_limits<float>::max();
+	bounds.maxX = bounds.maxY = -std::numeric_limits<float>::max();
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 position((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+		if (clip.z < -clip.w)
+		{
+			return false;
+		}
+
+		// Window depth is z / w, which is the smallest at a corner of the box
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float x = (ndc.x * 0.5f + 0.5f) * OcclusionBufferSize;
+		float y = (ndc.y * 0.5f + 0.5f) * OcclusionBufferSize;
+		bounds.minX = std::min(bounds.minX, x);
+		bounds.maxX = std::max(bounds.maxX, x);
+		bounds.minY = std::min(bounds.minY, y);
+		bounds.maxY = std::max(bounds.maxY, y);
+		bounds.minDepth = std::min(bounds.minDepth, ndc.z * 0.5f + 0.5f);
+	}
+	return true;
+}
+
+/// <summary>
+/// Draws a triangle into the finest level of the CPU depth buffer. Only pixels that the triangle covers completely
+/// are written, with the farthest depth the triangle has inside them, so the buffer never claims to hide more than
+/// the occluder does.
+/// </summary>
+/// <param name="depth">Finest level of the depth buffer</param>
+/// <param name="a">First vertex in pixels and window depth</param>
+/// <param name="b">Second vertex</param>
+/// <param name="c">Third vertex</param>
+static void RasterizeOccluderTriangle(std::vector<float>& depth, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (std::abs(area) < 1.0e-6f)
+	{
+		return;
+	}
+	if (area < 0.0f)
+	{
+		std::swap(b, c);
+		area = -area;
+	}
+
+	int minX = std::max(static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))), 0);
+	int maxX = std::min(static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))), OcclusionBufferSize - 1);
+	int minY = std::max(static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))), 0);
+	int maxY = std::min(static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))), OcclusionBufferSize - 1);
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// Edge functions that are positive inside the triangle. Moving the test point half a pixel towards the edge
+	// on both axes gives the smallest value at any corner of the pixel
+	const glm::vec3* from[3] = { &a, &b, &c };
+	const glm::vec3* to[3] = { &b, &c, &a };
+	float edgeA[3], edgeB[3], edgeC[3], edgeMargin[3];
+	for (int edge = 0; edge < 3; ++edge)
+	{
+		edgeA[edge] = from[edge]->y - to[edge]->y;
+		edgeB[edge] = to[edge]->x - from[edge]->x;
+		edgeC[edge] = -edgeA[edge] * from[edge]->x - edgeB[edge] * from[edge]->y;
+		edgeMargin[edge] = 0.5f * (std::abs(edgeA[edge]) + std::abs(edgeB[edge]));
+	}
+
+	// Depth is linear in window coordinates, so its largest value in a pixel is half a pixel of slope past the center
+	float depthDx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+	float depthDy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+	float depthMargin = 0.5f * (std::abs(depthDx) + std::abs(depthDy));
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float centerY = y + 0.5f;
+		for (int x = minX; x <= maxX; ++x)
+		{
+			float centerX = x + 0.5f;
+			bool covered = true;
+			for (int edge = 0; edge < 3 && covered; ++edge)
+			{
+				covered = edgeA[edge] * centerX + edgeB[edge] * centerY + edgeC[edge] >= edgeMargin[edge];
+			}
+			if (covered)
+			{
+				float farthest = std::min(a.z + depthDx * (centerX - a.x) + depthDy * (centerY - a.y) + depthMargin, 1.0f);
+				float& texel = depth[static_cast<size_t>(y) * OcclusionBufferSize + x];
+				texel = std::min(texel, farthest);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Draws an occluder triangle in clip space, cutting off the part in front of the near plane first.
+/// </summary>
+/// <param name="depth">Finest level of the depth buffer</param>
+/// <param name="clip">Clip-space vertices</param>
+static void DrawOccluderTriangle(std::vector<float>& depth, const glm::vec4 clip[3])
+{
+	// Sutherland-Hodgman against z >= -w; a triangle becomes at most a quad
+	glm::vec4 polygon[4];
+	int count = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		const glm::vec4& current = clip[i];
+		const glm::vec4& next = clip[(i + 1) % 3];
+		float currentDistance = current.z + current.w;
+		float nextDistance = next.z + next.w;
+		if (currentDistance >= 0.0f)
+		{
+			polygon[count++] = current;
+		}
+		if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+		{
+			polygon[count++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+		}
+	}
+
+	glm::vec3 window[4];
+	for (int i = 0; i < count; ++i)
+	{
+		glm::vec3 ndc = glm::vec3(polygon[i]) / polygon[i].w;
+		window[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * OcclusionBufferSize, (ndc.y * 0.5f + 0.5f) * OcclusionBufferSize, ndc.z * 0.5f + 0.5f);
+	}
+	for (int i = 2; i < count; ++i)
+	{
+		RasterizeOccluderTriangle(depth, window[0], window[i - 1], window[i]);
+	}
+}
+
+/// <summary>
+/// Tests whether a bounding box is behind the occluders in every texel it covers.
+/// </summary>
+/// <param name="occlusion">Occlusion culling with a finished depth buffer</param>
+/// <param name="bounds">Screen area and nearest depth of the box</param>
+/// <returns>True if the box is hidden, false otherwise</returns>
+static bool IsHiddenByDepthBuffer(const OcclusionCulling& occlusion, const ScreenBounds& bounds)
+{
+	int minX = std::max(static_cast<int>(std::floor(bounds.minX)), 0);
+	int maxX = std::min(static_cast<int>(std::floor(bounds.maxX)), OcclusionBufferSize - 1);
+	int minY = std::max(static_cast<int>(std::floor(bounds.minY)), 0);
+	int maxY = std::min(static_cast<int>(std::floor(bounds.maxY)), OcclusionBufferSize - 1);
+	if (minX > maxX || minY > maxY)
+	{
+		return false;
+	}
+
+	// Go up the levels until the box covers at most four texels along each axis
+	int level = 0;
+	while (level < OcclusionLevelCount - 1 && ((maxX >> level) - (minX >> level) > 3 || (maxY >> level) - (minY >> level) > 3))
+	{
+		++level;
+	}
+
+	int size = OcclusionBufferSize >> level;
+	const std::vector<float>& depth = occlusion.levels[level];
+	for (int y = minY >> level; y <= maxY >> level; ++y)
+	{
+		for (int x = minX >> level; x <= maxX >> level; ++x)
+		{
+			if (depth[static_cast<size_t>(y) * size + x] >= bounds.minDepth)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Copies the coarsest level of detail of every mesh for the CPU depth buffer and starts building the query program.
+/// Coarser levels of the generated meshes lie inside the finer ones, so they never hide more than the real object.
+/// </summary>
+/// <param name="occlusion">Occlusion culling that will be created</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="meshData">CPU-side meshes</param>
+/// <param name="objectCount">Number of scene objects</param>
+/// <returns>True if the query program linked, false otherwise</returns>
+bool CreateOcclusionCulling(OcclusionCulling& occlusion, ShaderCache& shaderCache, const MeshData& meshData, size_t objectCount)
+{
+	BeginShaderProgram(shaderCache, occlusion.program, "occlusion.vsh", "occlusion.fsh");
+	if (!FinishShaderProgram(shaderCache, occlusion.program))
+	{
+		return false;
+	}
+	ResolveProgramUniforms(occlusion.uniforms, occlusion.program.program);
+
+	for (int mesh = 0; mesh < MeshTypeCount; ++mesh)
+	{
+		if (meshData.lodCounts[mesh] == 0)
+		{
+			continue;
+		}
+
+		const MeshRange& range = meshData.ranges[mesh][meshData.lodCounts[mesh] - 1];
+		OccluderMesh& occluder = occlusion.meshes[mesh];
+		for (GLsizei i = 0; i < range.vertexCount; ++i)
+		{
+			const PackedVertex& vertex = meshData.vertices[range.baseVertex + i];
+			occluder.positions.push_back(glm::vec3(vertex.x, vertex.y, vertex.z));
+		}
+		occluder.indices.assign(meshData.indices.begin() + range.firstIndex, meshData.indices.begin() + range.firstIndex + range.indexCount);
+	}
+
+	for (int level = 0; level < OcclusionLevelCount; ++level)
+	{
+		int size = OcclusionBufferSize >> level;
+		occlusion.levels[level].assign(static_cast<size_t>(size) * size, 1.0f);
+	}
+
+	occlusion.queries.resize(objectCount);
+	if (objectCount > 0)
+	{
+		glGenQueries(static_cast<GLsizei>(objectCount), occlusion.queries.data());
+	}
+	occlusion.queryFrames.assign(objectCount, -1);
+	occlusion.hidden.assign(objectCount, 0);
+	return true;
+}
+
+/// <summary>
+/// Removes the objects that are hidden from the list of visible objects: reads the query results of the last
+/// frame, draws the largest visible objects into the CPU depth buffer and tests the rest against it. Also picks
+/// the objects that IssueOcclusionQueries() tests after this frame's draws.
+/// </summary>
+/// <param name="occlusion">Occlusion culling</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="visibleObjects">Objects inside the view frustum; the hidden ones are removed</param>
+void CullOccludedObjects(OcclusionCulling& occlusion, const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers,
+	const TransformStore& transforms, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, std::vector<uint32_t>& visibleObjects)
+{
+	++occlusion.frameNumber;
+	++occlusion.frames;
+
+	// The queries of the last frame have had a whole frame to finish. One that has not is not waited for,
+	// and its object counts as visible, which is always safe
+	for (uint32_t object : occlusion.queryObjects)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(occlusion.queries[object], GL_QUERY_RESULT_AVAILABLE, &available);
+		GLuint passed = 1;
+		if (available)
+		{
+			glGetQueryObjectuiv(occlusion.queries[object], GL_QUERY_RESULT, &passed);
+		}
+		occlusion.hidden[object] = passed == 0 ? 1 : 0;
+	}
+	occlusion.queryObjects.clear();
+	occlusion.queryBounds.clear();
+
+	// Pick the objects that cover the most of the view as occluders; the ones the camera is inside come first
+	occlusion.visibleBounds.resize(visibleObjects.size());
+	occlusion.occluders.clear();
+	for (size_t i = 0; i < visibleObjects.size(); ++i)
+	{
+		BoundingBox box = ComputeObjectBounds(scene[visibleObjects[i]], meshBuffers, transforms.modelMatrices[visibleObjects[i]]);
+		occlusion.visibleBounds[i] = box;
+
+		bool containsCamera = cameraPosition.x >= box.min.x && cameraPosition.y >= box.min.y && cameraPosition.z >= box.min.z
+			&& cameraPosition.x <= box.max.x && cameraPosition.y <= box.max.y && cameraPosition.z <= box.max.z;
+		float distance = glm::length((box.min + box.max) * 0.5f - cameraPosition);
+		float size = containsCamera ? std::numeric_limits<float>::max() : glm::length(box.max - box.min) * 0.5f / std::max(distance, 0.001f);
+		if (size >= OcclusionMinOccluderSize)
+		{
+			occlusion.occluders.push_back({ size, static_cast<uint32_t>(i) });
+		}
+	}
+	size_t occluderCount = std::min(occlusion.occluders.size(), static_cast<size_t>(OcclusionMaxOccluders));
+	std::partial_sort(occlusion.occluders.begin(), occlusion.occluders.begin() + occluderCount, occlusion.occluders.end(),
+		[](const OcclusionCandidate& a, const OcclusionCandidate& b) { return a.size > b.size; });
+	occlusion.occluders.resize(occluderCount);
+
+	// Draw the occluders into the finest level, then keep the farthest depth of every 2x2 block in the next level up
+	std::vector<float>& finest = occlusion.levels[0];
+	std::fill(finest.begin(), finest.end(), 1.0f);
+	for (const OcclusionCandidate& occluder : occlusion.occluders)
+	{
+		uint32_t object = visibleObjects[occluder.index];
+		const OccluderMesh& mesh = occlusion.meshes[scene[object].mesh];
+		glm::mat4 modelViewProjection = viewProjection * transforms.modelMatrices[object];
+
+		occlusion.clipPositions.resize(mesh.positions.size());
+		for (size_t i = 0; i < mesh.positions.size(); ++i)
+		{
+			occlusion.clipPositions[i] = modelViewProjection * glm::vec4(mesh.positions[i], 1.0f);
+		}
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			glm::vec4 triangle[3] = { occlusion.clipPositions[mesh.indices[i]], occlusion.clipPositions[mesh.indices[i + 1]],
+				occlusion.clipPositions[mesh.indices[i + 2]] };
+			DrawOccluderTriangle(finest, triangle);
+		}
+	}
+	for (int level = 1; level < OcclusionLevelCount; ++level)
+	{
+		int size = OcclusionBufferSize >> level;
+		const std::vector<float>& below = occlusion.levels[level - 1];
+		std::vector<float>& depth = occlusion.levels[level];
+		for (int y = 0; y < size; ++y)
+		{
+			const float* row0 = &below[static_cast<size_t>(y) * 2 * size * 2];
+			const float* row1 = row0 + size * 2;
+			for (int x = 0; x < size; ++x)
+			{
+				depth[static_cast<size_t>(y) * size + x] = std::max(std::max(row0[x * 2], row0[x * 2 + 1]), std::max(row1[x * 2], row1[x * 2 + 1]));
+			}
+		}
+	}
+
+	// Occluders are always drawn. The rest is tested against the depth buffer first, then by the last query result
+	size_t kept = 0;
+	for (size_t i = 0; i < visibleObjects.size(); ++i)
+	{
+		uint32_t object = visibleObjects[i];
+		const BoundingBox& box = occlusion.visibleBounds[i];
+		bool isOccluder = std::any_of(occlusion.occluders.begin(), occlusion.occluders.end(),
+			[i](const OcclusionCandidate& occluder) { return occluder.index == i; });
+
+		ScreenBounds bounds;
+		if (isOccluder || !ProjectBoundingBox(box, viewProjection, bounds))
+		{
+			visibleObjects[kept++] = object;
+			continue;
+		}
+
+		if (IsHiddenByDepthBuffer(occlusion, bounds))
+		{
+			++occlusion.depthHiddenObjects;
+			continue;
+		}
+
+		// A result from before the last frame is out of date. Hidden objects are tested every frame so they come back
+		// as soon as they can be seen; visible ones only every few frames, spread out over the objects
+		bool tested = occlusion.queryFrames[object] == occlusion.frameNumber - 1;
+		bool hidden = tested && occlusion.hidden[object];
+		if (hidden || (object + occlusion.frameNumber) % OcclusionVisibleQueryInterval == 0)
+		{
+			occlusion.queryObjects.push_back(object);
+			occlusion.queryBounds.push_back(box);
+		}
+
+		if (hidden)
+		{
+			++occlusion.queryHiddenObjects;
+			continue;
+		}
+		visibleObjects[kept++] = object;
+	}
+	visibleObjects.resize(kept);
+}
+
+/// <summary>
+/// Draws the bounding boxes of the objects that CullOccludedObjects() picked inside occlusion queries, without
+/// writing color or depth. Must be called after the objects of the frame were drawn.
+/// </summary>
+/// <param name="occlusion">Occlusion culling</param>
+/// <param name="state">State cache</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="vertexArray">Vertex array object with the mesh attributes</param>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+void IssueOcclusionQueries(OcclusionCulling& occlusion, RenderState& state, const MeshBuffers& meshBuffers, GLuint vertexArray,
+	const glm::mat4& viewProjection)
+{
+	if (occlusion.queryObjects.empty())
+	{
+		return;
+	}
+
+	UseProgramCached(state, occlusion.program.program);
+	BindVertexArrayCached(state, vertexArray);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+
+	// The cube mesh is stretched over every bounding box
+	const MeshRange& cube = meshBuffers.ranges[MeshCube][0];
+	glm::vec3 cubeMin(cube.boundsMin[0], cube.boundsMin[1], cube.boundsMin[2]);
+	glm::vec3 cubeSize = glm::vec3(cube.boundsMax[0], cube.boundsMax[1], cube.boundsMax[2]) - cubeMin;
+
+	for (size_t i = 0; i < occlusion.queryObjects.size(); ++i)
+	{
+		uint32_t object = occlusion.queryObjects[i];
+		const BoundingBox& box = occlusion.queryBounds[i];
+		glm::vec3 margin = (box.max - box.min) * OcclusionBoxMargin + glm::vec3(OcclusionBoxMargin);
+		glm::vec3 boxMin = box.min - margin;
+		glm::vec3 scale = (box.max + margin - boxMin) / cubeSize;
+
+		glm::mat4 boxMatrix(1.0f);
+		boxMatrix[0][0] = scale.x;
+		boxMatrix[1][1] = scale.y;
+		boxMatrix[2][2] = scale.z;
+		boxMatrix[3] = glm::vec4(boxMin - cubeMin * scale, 1.0f);
+		glm::mat4 boxViewProjection = viewProjection * boxMatrix;
+		glUniformMatrix4fv(occlusion.uniforms.locations[UniformBoxViewProjection], 1, GL_FALSE, &boxViewProjection[0][0]);
+
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, occlusion.queries[object]);
+		DrawMesh(meshBuffers, MeshCube, 0);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		++state.drawCalls;
+
+		occlusion.queryFrames[object] = occlusion.frameNumber;
+	}
+	occlusion.issuedQueries += static_cast<int64_t>(occlusion.queryObjects.size());
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+}
+
+/// <summary>
+/// Deletes the queries and the query program.
+/// </summary>
+/// <param name="occlusion">Occlusion culling</param>
+void DeleteOcclusionCulling(OcclusionCulling& occlusion)
+{
+	if (!occlusion.queries.empty())
+	{
+		glDeleteQueries(static_cast<GLsizei>(occlusion.queries.size()), occlusion.queries.data());
+	}
+	occlusion.queries.clear();
+	DeleteShaderProgram(occlusion.program);
+}
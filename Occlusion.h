@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Culling.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "ShaderProgram.h"
+#include "Transforms.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Width and height of the finest level of the CPU depth buffer. It covers the whole view, whatever its aspect ratio.
+/// </summary>
+const int OcclusionBufferSize = 256;
+
+/// <summary>
+/// Number of levels of the CPU depth buffer, from OcclusionBufferSize down to a single texel
+/// </summary>
+const int OcclusionLevelCount = 9;
+
+/// <summary>
+/// Most objects that are drawn into the CPU depth buffer every frame, picked by the size they cover on the screen
+/// </summary>
+const int OcclusionMaxOccluders = 16;
+
+/// <summary>
+/// Frames between the occlusion queries of an object that was visible the last time it was tested. Objects that were
+/// hidden are tested every frame, so they come back one frame after they show up.
+/// </summary>
+const int OcclusionVisibleQueryInterval = 4;
+
+/// <summary>
+/// Struct containing the coarsest level of detail of a mesh as triangles on the CPU, for drawing into the depth buffer
+/// </summary>
+struct OccluderMesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<GLuint> indices;
+};
+
+/// <summary>
+/// Struct containing a visible object that may be drawn into the CPU depth buffer
+/// </summary>
+struct OcclusionCandidate
+{
+	float size;							// Bounding radius over distance to the camera
+	uint32_t index;						// Position in the list of visible objects
+};
+
+/// <summary>
+/// Struct containing the two occlusion culling stages that run after frustum culling. The largest visible objects are
+/// drawn on the CPU into a small hierarchical depth buffer, which every other visible object's bounding box is tested
+/// against; it only keeps the farthest depth of every texel, so it never hides anything that can be seen. What it
+/// lets through is tested with GL_ANY_SAMPLES_PASSED queries that draw the bounding boxes against the finished depth
+/// buffer of the frame. Their results are only read in the next frame, so the CPU never waits for them, and an
+/// object that comes into view appears one frame late.
+/// </summary>
+struct OcclusionCulling
+{
+	ShaderProgram program;					// occlusion.vsh and occlusion.fsh
+	ProgramUniforms uniforms;
+	OccluderMesh meshes[MeshTypeCount];
+
+	std::vector<float> levels[OcclusionLevelCount];	// Farthest window depth of every texel, rows bottom to top
+
+	std::vector<GLuint> queries;			// Occlusion query of every scene object (generated for all objects up front)
+	std::vector<int64_t> queryFrames;		// Frame that every object's query was last issued in (-1 before the first)
+	std::vector<uint8_t> hidden;			// Non-zero for objects that their last query found hidden
+	std::vector<uint32_t> queryObjects;		// Objects whose bounding boxes are tested after this frame's draws
+	std::vector<BoundingBox> queryBounds;	// Their world-space bounding boxes
+	int64_t frameNumber = 0;
+
+	std::vector<BoundingBox> visibleBounds;	// Bounding boxes of the visible objects, reused every frame
+	std::vector<OcclusionCandidate> occluders;
+	std::vector<glm::vec4> clipPositions;
+
+	int64_t depthHiddenObjects = 0;			// Objects hidden by the CPU depth buffer, over all frames
+	int64_t queryHiddenObjects = 0;			// Objects hidden by the result of their last query, over all frames
+	int64_t issuedQueries = 0;				// Occlusion queries issued, over all frames
+	int64_t frames = 0;
+};
+
+/// <summary>
+/// Copies the coarsest level of detail of every mesh for the CPU depth buffer and starts building the query program.
+/// Coarser levels of the generated meshes lie inside the finer ones, so they never hide more than the real object.
+/// </summary>
+/// <param name="occlusion">Occlusion culling that will be created</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="meshData">CPU-side meshes</param>
+/// <param name="objectCount">Number of scene objects</param>
+/// <returns>True if the query program linked, false otherwise</returns>
+bool CreateOcclusionCulling(OcclusionCulling& occlusion, ShaderCache& shaderCache, const MeshData& meshData, size_t objectCount);
+
+/// <summary>
+/// Removes the objects that are hidden from the list of visible objects: reads the query results of the last
+/// frame, draws the largest visible objects into the CPU depth buffer and tests the rest against it. Also picks
+/// the objects that IssueOcclusionQueries() tests after this frame's draws.
+/// </summary>
+/// <param name="occlusion">Occlusion culling</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="cameraPosition">World-space position of the camera</param>
+/// <param name="visibleObjects">Objects inside the view frustum; the hidden ones are removed</param>
+void CullOccludedObjects(OcclusionCulling& occlusion, const std::vector<SceneObject>& scene, const MeshBuffers& meshBuffers,
+	const TransformStore& transforms, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, std::vector<uint32_t>& visibleObjects);
+
+/// <summary>
+/// Draws the bounding boxes of the objects that CullOccludedObjects() picked inside occlusion queries, without
+/// writing color or depth. Must be called after the objects of the frame were drawn.
+/// </summary>
+/// <param name="occlusion">Occlusion culling</param>
+/// <param name="state">State cache</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="vertexArray">Vertex array object with the mesh attributes</param>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+void IssueOcclusionQueries(OcclusionCulling& occlusion, RenderState& state, const MeshBuffers& meshBuffers, GLuint vertexArray,
+	const glm::mat4& viewProjection);
+
+/// <summary>
+/// Deletes the queries and the query program.
+/// </summary>
+/// <param name="occlusion">Occlusion culling</param>
+void DeleteOcclusionCulling(OcclusionCulling& occlusion);
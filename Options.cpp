@@ -0,0 +1,508 @@
+#include "Options.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+/// <summary>
+/// Reads the value that follows a command line switch.
+/// </summary>
+/// <param name="argc">Number of arguments</param>
+/// <param name="argv">Argument strings</param>
+/// <param name="index">Index of the switch; advanced past the value on success</param>
+/// <param name="value">Value of the switch</param>
+/// <returns>True if the switch has a value, false otherwise</returns>
+static bool ReadSwitchValue(int argc, char* argv[], int& index, std::string& value)
+{
+	if (index + 1 >= argc)
+	{
+		std::cerr << "Missing value for " << argv[index] << std::endl;
+		return false;
+	}
+
+	value = argv[++index];
+	return true;
+}
+
+/// <summary>
+/// Reads the integer value that follows a command line switch.
+/// </summary>
+/// <param name="argc">Number of arguments</param>
+/// <param name="argv">Argument strings</param>
+/// <param name="index">Index of the switch; advanced past the value on success</param>
+/// <param name="value">Value of the switch</param>
+/// <returns>True if the switch has a valid integer value, false otherwise</returns>
+static bool ReadIntValue(int argc, char* argv[], int& index, int& value)
+{
+	std::string text;
+	if (!ReadSwitchValue(argc, argv, index, text))
+	{
+		return false;
+	}
+
+	char* end = nullptr;
+	long parsed = std::strtol(text.c_str(), &end, 10);
+	if (text.empty() || *end != '\0')
+	{
+		std::cerr << "Invalid number for " << argv[index - 1] << ": " << text << std::endl;
+		return false;
+	}
+
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+/// <summary>
+/// Reads the floating-point value that follows a command line switch.
+/// </summary>
+/// <param name="argc">Number of arguments</param>
+/// <param name="argv">Argument strings</param>
+/// <param name="index">Index of the switch; advanced past the value on success</param>
+/// <param name="value">Value of the switch</param>
+/// <returns>True if the switch has a valid number, false otherwise</returns>
+static bool ReadFloatValue(int argc, char* argv[], int& index, float& value)
+{
+	std::string text;
+	if (!ReadSwitchValue(argc, argv, index, text))
+	{
+		return false;
+	}
+
+	char* end = nullptr;
+	float parsed = std::strtof(text.c_str(), &end);
+	if (text.empty() || *end != '\0')
+	{
+		std::cerr << "Invalid number for " << argv[index - 1] << ": " << text << std::endl;
+		return false;
+	}
+
+	value = parsed;
+	return true;
+}
+
+/// <summary>
+/// Parses a comma-separated list of frame numbers (e.g. "0,30,59") or the word "all".
+/// </summary>
+/// <param name="list">List of frames</param>
+/// <param name="options">Options that will receive the frames</param>
+/// <returns>True if the list is valid, false otherwise</returns>
+static bool ParseCaptureList(const std::string& list, AppOptions& options)
+{
+	if (list == "all")
+	{
+		options.captureAllFrames = true;
+		return true;
+	}
+
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		char* end = nullptr;
+		long frame = std::strtol(item.c_str(), &end, 10);
+		if (item.empty() || *end != '\0' || frame < 0)
+		{
+			std::cerr << "Invalid frame number in capture list: " << item << std::endl;
+			return false;
+		}
+		options.captureFrames.push_back(static_cast<int>(frame));
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Parses the object, texture and light counts of a generated benchmark scene (e.g. "1000,7,16").
+/// </summary>
+/// <param name="list">Comma-separated counts</param>
+/// <param name="options">Options that will receive the counts</param>
+/// <returns>True if the counts are valid, false otherwise</returns>
+static bool ParseBenchmarkScene(const std::string& list, AppOptions& options)
+{
+	int counts[3] = {};
+	std::stringstream stream(list);
+	std::string item;
+	int index = 0;
+	while (std::getline(stream, item, ','))
+	{
+		char* end = nullptr;
+		long count = std::strtol(item.c_str(), &end, 10);
+		if (index >= 3 || item.empty() || *end != '\0' || count < 0)
+		{
+			std::cerr << "Invalid benchmark scene: " << list << " (expected objects,textures,lights)" << std::endl;
+			return false;
+		}
+		counts[index++] = static_cast<int>(count);
+	}
+	if (index != 3 || counts[0] == 0 || counts[1] == 0)
+	{
+		std::cerr << "Invalid benchmark scene: " << list << " (expected objects,textures,lights with at least one object and texture)" << std::endl;
+		return false;
+	}
+
+	options.benchmarkObjects = counts[0];
+	options.benchmarkTextures = counts[1];
+	options.benchmarkLights = counts[2];
+	return true;
+}
+
+/// <summary>
+/// Parses the bounds of the dynamic resolution scale, given as "min,max".
+/// </summary>
+/// <param name="list">Comma-separated bounds</param>
+/// <param name="options">Options that receive the bounds</param>
+/// <returns>True if the bounds are valid, false otherwise</returns>
+static bool ParseResolutionScale(const std::string& list, AppOptions& options)
+{
+	size_t comma = list.find(',');
+	char* minEnd = nullptr;
+	char* maxEnd = nullptr;
+	float minScale = std::strtof(list.c_str(), &minEnd);
+	float maxScale = comma == std::string::npos ? 0.0f : std::strtof(list.c_str() + comma + 1, &maxEnd);
+	if (comma == std::string::npos || minEnd != list.c_str() + comma || maxEnd == nullptr || *maxEnd != '\0'
+		|| minScale <= 0.0f || minScale > maxScale || maxScale > 1.0f)
+	{
+		std::cerr << "Invalid resolution scale: " << list << " (expected min,max with 0 < min <= max <= 1)" << std::endl;
+		return false;
+	}
+
+	options.minResolutionScale = minScale;
+	options.maxResolutionScale = maxScale;
+	return true;
+}
+
+/// <summary>
+/// Parses the command line arguments into the provided options struct.
+/// </summary>
+/// <param name="argc">Number of arguments</param>
+/// <param name="argv">Argument strings</param>
+/// <param name="options">Options that will be filled in</param>
+/// <returns>True if the arguments are valid and the program should keep running, false otherwise</returns>
+bool ParseCommandLine(int argc, char* argv[], AppOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		std::string value;
+		bool valid = true;
+
+		if (arg == "--help" || arg == "-h")
+		{
+			PrintUsage(argv[0]);
+			return false;
+		}
+		else if (arg == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (arg == "--instanced")
+		{
+			options.instancing = true;
+		}
+		else if (arg == "--no-culling")
+		{
+			options.culling = false;
+		}
+		else if (arg == "--gpu-driven")
+		{
+			options.gpuDriven = true;
+		}
+		else if (arg == "--shadows")
+		{
+			options.shadows = true;
+		}
+		else if (arg == "--occlusion")
+		{
+			options.occlusion = true;
+		}
+		else if (arg == "--transform-threads")
+		{
+			valid = ReadIntValue(argc, argv, i, options.transformThreads);
+		}
+		else if (arg == "--command-threads")
+		{
+			valid = ReadIntValue(argc, argv, i, options.commandThreads);
+		}
+		else if (arg == "--software")
+		{
+			options.software = true;
+			options.headless = true;
+		}
+		else if (arg == "--software-threads")
+		{
+			valid = ReadIntValue(argc, argv, i, options.softwareThreads);
+		}
+		else if (arg == "--scene")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.sceneFilePath);
+		}
+		else if (arg == "--compile-scene")
+		{
+			options.compileScene = true;
+		}
+		else if (arg == "--source-scene")
+		{
+			options.useCompiledScene = false;
+		}
+		else if (arg == "--async-textures")
+		{
+			options.asyncTextures = true;
+		}
+		else if (arg == "--source-textures")
+		{
+			options.useBakedTextures = false;
+		}
+		else if (arg == "--bake-textures")
+		{
+			options.bakeTextures = true;
+		}
+		else if (arg == "--bake-format")
+		{
+			valid = ReadSwitchValue(argc, argv, i, value);
+			if (valid && value == "rgba8")
+			{
+				options.bakeFormat = BakedRGBA8;
+			}
+			else if (valid && value == "bc1")
+			{
+				options.bakeFormat = BakedBC1;
+			}
+			else if (valid && value == "bc3")
+			{
+				options.bakeFormat = BakedBC3;
+			}
+			else if (valid)
+			{
+				std::cerr << "Invalid bake format: " << value << " (expected rgba8, bc1 or bc3)" << std::endl;
+				valid = false;
+			}
+		}
+		else if (arg == "--material-size")
+		{
+			valid = ReadIntValue(argc, argv, i, options.materialSize);
+		}
+		else if (arg == "--shader-cache")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.shaderCacheDirectory);
+			if (options.shaderCacheDirectory == "off")
+			{
+				options.shaderCacheDirectory.clear();
+			}
+		}
+		else if (arg == "--hot-reload")
+		{
+			options.hotReload = true;
+		}
+		else if (arg == "--vsync")
+		{
+			valid = ReadSwitchValue(argc, argv, i, value);
+			if (valid && value == "on")
+			{
+				options.swapInterval = 1;
+			}
+			else if (valid && value == "off")
+			{
+				options.swapInterval = 0;
+			}
+			else if (valid)
+			{
+				char* end = nullptr;
+				long interval = std::strtol(value.c_str(), &end, 10);
+				if (value.empty() || *end != '\0' || interval < 0)
+				{
+					std::cerr << "Invalid vsync setting: " << value << " (expected on, off or a swap interval)" << std::endl;
+					valid = false;
+				}
+				options.swapInterval = static_cast<int>(interval);
+			}
+		}
+		else if (arg == "--max-fps")
+		{
+			valid = ReadFloatValue(argc, argv, i, options.maxFps);
+		}
+		else if (arg == "--sim-rate")
+		{
+			valid = ReadFloatValue(argc, argv, i, options.simulationRate);
+		}
+		else if (arg == "--profile")
+		{
+			options.profile = true;
+		}
+		else if (arg == "--trace")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.traceFilePath);
+			options.profile = true;
+		}
+		else if (arg == "--dynamic-resolution")
+		{
+			valid = ReadFloatValue(argc, argv, i, options.dynamicResolutionTarget);
+		}
+		else if (arg == "--resolution-scale")
+		{
+			valid = ReadSwitchValue(argc, argv, i, value) && ParseResolutionScale(value, options);
+		}
+		else if (arg == "--width")
+		{
+			valid = ReadIntValue(argc, argv, i, options.width);
+		}
+		else if (arg == "--height")
+		{
+			valid = ReadIntValue(argc, argv, i, options.height);
+		}
+		else if (arg == "--frames")
+		{
+			valid = ReadIntValue(argc, argv, i, options.frameCount);
+		}
+		else if (arg == "--fps")
+		{
+			valid = ReadFloatValue(argc, argv, i, options.simulatedFps);
+		}
+		else if (arg == "--capture")
+		{
+			valid = ReadSwitchValue(argc, argv, i, value) && ParseCaptureList(value, options);
+		}
+		else if (arg == "--output")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.outputDirectory);
+		}
+		else if (arg == "--record")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.recordPath);
+		}
+		else if (arg == "--record-format")
+		{
+			valid = ReadSwitchValue(argc, argv, i, value);
+			if (valid && value == "y4m")
+			{
+				options.recordFormat = RecordingY4M;
+			}
+			else if (valid && value == "rgb")
+			{
+				options.recordFormat = RecordingRawRGB;
+			}
+			else if (valid)
+			{
+				std::cerr << "Invalid recording format: " << value << " (expected y4m or rgb)" << std::endl;
+				valid = false;
+			}
+		}
+		else if (arg == "--benchmark")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.benchmarkSuite);
+		}
+		else if (arg == "--benchmark-output")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.benchmarkOutputPath);
+		}
+		else if (arg == "--benchmark-baseline")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.benchmarkBaselinePath);
+		}
+		else if (arg == "--benchmark-tolerance")
+		{
+			valid = ReadFloatValue(argc, argv, i, options.benchmarkTolerance);
+		}
+		else if (arg == "--benchmark-scene")
+		{
+			valid = ReadSwitchValue(argc, argv, i, value) && ParseBenchmarkScene(value, options);
+		}
+		else if (arg == "--benchmark-result")
+		{
+			valid = ReadSwitchValue(argc, argv, i, options.benchmarkResultPath);
+			options.profile = true;
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			PrintUsage(argv[0]);
+			return false;
+		}
+
+		if (!valid)
+		{
+			return false;
+		}
+	}
+
+	if (options.width <= 0 || options.height <= 0 || options.frameCount <= 0 || options.simulatedFps <= 0.0f || options.materialSize <= 0)
+	{
+		std::cerr << "Width, height, frame count, fps and material size must be positive" << std::endl;
+		return false;
+	}
+
+	if (options.benchmarkTolerance < 0.0f)
+	{
+		std::cerr << "Benchmark tolerance cannot be negative" << std::endl;
+		return false;
+	}
+
+	if (options.dynamicResolutionTarget < 0.0f)
+	{
+		std::cerr << "Dynamic resolution target cannot be negative" << std::endl;
+		return false;
+	}
+
+	if (options.maxFps < 0.0f || options.simulationRate <= 0.0f)
+	{
+		std::cerr << "Frame rate limit cannot be negative and simulation rate must be positive" << std::endl;
+		return false;
+	}
+
+	if (options.transformThreads < 0 || options.commandThreads < 0 || options.softwareThreads < 0)
+	{
+		std::cerr << "Transform, command and software thread counts cannot be negative" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Prints the list of supported command line arguments.
+/// </summary>
+/// <param name="programName">Name of the executable</param>
+void PrintUsage(const char* programName)
+{
+	std::cout << "Usage: " << programName << " [options]\n"
+		<< "  --width <pixels>        Width of the window or offscreen framebuffer (default 800)\n"
+		<< "  --height <pixels>       Height of the window or offscreen framebuffer (default 800)\n"
+		<< "  --instanced             Draw all objects that share a mesh with one instanced draw call\n"
+		<< "  --no-culling            Draw every object, even the ones outside the view frustum\n"
+		<< "  --gpu-driven            Cull on the GPU and draw with one indirect call (OpenGL 4.3, else ignored)\n"
+		<< "  --shadows               Shadow the main light with a cube shadow map that is only redrawn on change\n"
+		<< "  --occlusion             Skip objects hidden behind others (CPU depth buffer, then last frame's queries)\n"
+		<< "  --transform-threads <n> Worker threads for per-object matrix math (default 0: main thread)\n"
+		<< "  --command-threads <n>   Worker threads that record the per-object draws for the main thread to replay (default 0)\n"
+		<< "  --headless              Render offscreen through EGL without opening a window\n"
+		<< "  --software              Render headless on the CPU with the tiled SIMD rasterizer (no OpenGL)\n"
+		<< "  --software-threads <n>  Worker threads of the software rasterizer (default 0: one per core, less one)\n"
+		<< "  --scene <file>          Scene text file to load (default room.scene)\n"
+		<< "  --compile-scene         Write the compiled .bscene version of the scene, then exit\n"
+		<< "  --source-scene          Parse the scene text even when a compiled scene exists\n"
+		<< "  --shader-cache <dir>    Directory of cached shader program binaries, or off (default ShaderCache)\n"
+		<< "  --hot-reload            Rebuild shader programs in the background when their files change\n"
+		<< "  --bake-textures         Write a baked .btex file with mip levels next to every image, then exit\n"
+		<< "  --bake-format <format>  Pixel format of baked textures: bc1 (default), bc3 or rgba8\n"
+		<< "  --material-size <size>  Width and height of every material layer (default 2048)\n"
+		<< "  --source-textures       Decode the original images even when baked textures exist\n"
+		<< "  --async-textures        Do not wait for textures before the first headless frame\n"
+		<< "  --vsync <on|off|n>      Vertical blanks per buffer swap in a window (default on)\n"
+		<< "  --max-fps <rate>        Upper limit of the window frame rate (default 0: no limit)\n"
+		<< "  --sim-rate <rate>       Fixed steps per second of the camera and light simulation (default 120)\n"
+		<< "  --dynamic-resolution <ms> Lower the internal resolution to keep the frame time (the larger of CPU and GPU time) under this (default 0: off)\n"
+		<< "  --resolution-scale <min,max> Bounds of the dynamic resolution scale per side (default 0.5,1)\n"
+		<< "  --profile               Time the frame phases on the CPU and GPU; print percentiles at exit or on P\n"
+		<< "  --trace <file>          Write a Chrome trace of the frame phases at exit or on P (implies --profile)\n"
+		<< "  --frames <count>        Number of frames to render in headless mode (default 60)\n"
+		<< "  --fps <rate>            Frame rate of the fixed headless clock (default 60)\n"
+		<< "  --capture <list|all>    Frames to write to disk, e.g. 0,30,59 (default: last frame)\n"
+		<< "  --output <directory>    Directory for captured frames (default: current directory)\n"
+		<< "  --record <file|\"|cmd\"> Stream every frame as video to a file or to the input of a command\n"
+		<< "  --record-format <fmt>   Format of the recording: y4m (default) or rgb (raw RGB24 frames)\n"
+		<< "  --benchmark <suite>     Run the quick or full benchmark suite of generated scenes, then exit\n"
+		<< "  --benchmark-output <f>  JSON Lines file of the benchmark results (default benchmark.jsonl)\n"
+		<< "  --benchmark-baseline <f> Results of an earlier run; fail when a metric regresses past them\n"
+		<< "  --benchmark-tolerance <p> Percentage a metric may exceed its baseline by (default 10)\n"
+		<< "  --benchmark-scene <o,t,l> Draw a generated scene of o objects, t textures and l lights instead of --scene\n"
+		<< "  --benchmark-result <f>  Append the measurements of this run to a benchmark results file\n";
+}
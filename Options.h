@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BakedTexture.h"
+#include "FrameRecorder.h"
+
+/// <summary>
+/// Struct containing the settings that can be changed from the command line
+/// </summary>
+struct AppOptions
+{
+	int width = 800;						// Width of the window or offscreen framebuffer
+	int height = 800;						// Height of the window or offscreen framebuffer
+	bool instancing = false;				// Draw all objects that share a mesh with one instanced draw call
+	bool culling = true;					// Skip objects whose bounding boxes are outside the view frustum
+	bool gpuDriven = false;					// Cull in a compute shader and draw with one multi-draw indirect call (OpenGL 4.3)
+	bool shadows = false;					// Shadow the main light with a cached cube shadow map
+	bool occlusion = false;					// Skip objects hidden behind others, by a CPU depth buffer and occlusion queries
+	int transformThreads = 0;				// Worker threads for the per-object matrix multiplications (0 uses the main thread)
+	int commandThreads = 0;					// Worker threads that record the per-object draws (0 records them on the main thread)
+	bool software = false;					// Draw on the CPU with the tiled software rasterizer instead of OpenGL (implies headless)
+	int softwareThreads = 0;				// Worker threads of the software rasterizer (0 picks one per hardware thread, less one)
+	std::string sceneFilePath = "room.scene";	// Scene text file (its compiled .bscene version is loaded instead when there is one)
+	bool useCompiledScene = true;			// Load the compiled (.bscene) version of the scene when there is one
+	bool compileScene = false;				// Write the compiled version of the scene and exit
+	bool useBakedTextures = true;			// Load the baked (.btex) version of an image when there is one
+	bool bakeTextures = false;				// Write baked versions of every scene image and exit
+	BakedTextureFormat bakeFormat = BakedBC1;	// Pixel format of baked textures
+	int materialSize = 2048;				// Width and height of the layers of the material texture array
+	std::string shaderCacheDirectory = "ShaderCache";	// Directory of cached program binaries (empty disables the cache)
+	bool hotReload = false;					// Rebuild shader programs when their files change
+	int swapInterval = 1;					// Vertical blanks per buffer swap (0 turns vsync off)
+	float maxFps = 0.0f;					// Upper limit of the window frame rate (0 leaves it to the swap interval)
+	float simulationRate = 120.0f;			// Fixed steps per second of the camera and light simulation
+	bool profile = false;					// Time the phases of every frame on the CPU and GPU
+	std::string traceFilePath;				// Chrome trace written at exit and on P (empty writes none; implies profile)
+	bool asyncTextures = false;				// Render headless frames with placeholders while images load (windows always do)
+	float dynamicResolutionTarget = 0.0f;	// GPU frame time in milliseconds that the internal resolution adapts to (0 renders at full size)
+	float minResolutionScale = 0.5f;		// Smallest fraction of the output width and height that dynamic resolution renders
+	float maxResolutionScale = 1.0f;		// Largest fraction of the output width and height that dynamic resolution renders
+
+	bool headless = false;					// Render into an offscreen framebuffer without opening a window
+	int frameCount = 60;					// Number of frames to render in headless mode
+	float simulatedFps = 60.0f;				// Frame rate of the fixed clock used in headless mode
+	bool captureAllFrames = false;			// Write every rendered frame to disk
+	std::vector<int> captureFrames;			// Frames that will be written to disk (empty means the last frame, or none in benchmark runs)
+	std::string outputDirectory = ".";		// Directory where captured frames are written
+	std::string recordPath;					// File or "|command" that receives every frame as video (empty records nothing)
+	RecordingFormat recordFormat = RecordingY4M;	// File format of the recording
+
+	std::string benchmarkSuite;				// Run every configuration of this benchmark suite and exit (empty runs normally)
+	std::string benchmarkOutputPath = "benchmark.jsonl";	// JSON Lines file that receives one result per configuration
+	std::string benchmarkBaselinePath;		// Results of an earlier run to compare with (empty compares with nothing)
+	float benchmarkTolerance = 10.0f;		// Percentage a metric may grow past its baseline before it counts as a regression
+	int benchmarkObjects = 0;				// Objects of the generated benchmark scene (0 loads the scene file instead)
+	int benchmarkTextures = 7;				// Materials of the generated benchmark scene
+	int benchmarkLights = 0;				// Point lights of the generated benchmark scene
+	std::string benchmarkResultPath;		// File that the result of this benchmark run is appended to (implies profile)
+};
+
+/// <summary>
+/// Parses the command line arguments into the provided options struct.
+/// </summary>
+/// <param name="argc">Number of arguments</param>
+/// <param name="argv">Argument strings</param>
+/// <param name="options">Options that will be filled in</param>
+/// <returns>True if the arguments are valid and the program should keep running, false otherwise</returns>
+bool ParseCommandLine(int argc, char* argv[], AppOptions& options);
+
+/// <summary>
+/// Prints the list of supported command line arguments.
+/// </summary>
+/// <param name="programName">Name of the executable</param>
+void PrintUsage(const char* programName);
@@ -0,0 +1,353 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+/// <summary>
+/// Names of the zones, as printed and written to the trace
+/// </summary>
+static const char* ZoneNames[ProfileZoneCount] =
+{
+	"Frame", "Input", "Transforms", "Culling", "Lights", "Shadows", "UniformUpload", "Draw", "DrawObject", "Swap", "Capture", "Occlusion", "GpuCulling"
+};
+
+/// <summary>
+/// Whether each zone is also timed with a GL_TIME_ELAPSED query. Only one such query can run at a time,
+/// so these zones must never be nested inside each other.
+/// </summary>
+static const bool ZoneOnGpu[ProfileZoneCount] =
+{
+	false, false, false, false, false, true, true, true, false, false, false, true, true
+};
+
+/// <summary>
+/// Upper limit of recorded trace events, so a long run over a huge scene cannot use up all memory
+/// </summary>
+static const size_t MaxTraceEvents = 1 << 22;
+
+/// <summary>
+/// Gets the number of microseconds since the profiler was created.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <returns>Microseconds</returns>
+static double GetProfilerTime(const Profiler& profiler)
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - profiler.origin).count();
+}
+
+/// <summary>
+/// Adds an event to the trace if the profiler records one.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <param name="event">Event</param>
+static void RecordEvent(Profiler& profiler, const ProfileEvent& event)
+{
+	if (profiler.recordTrace && profiler.events.size() < MaxTraceEvents)
+	{
+		profiler.events.push_back(event);
+	}
+}
+
+/// <summary>
+/// Creates the timer queries of the profiler and starts its clock. A profiler that is never created stays disabled
+/// and all calls on it return immediately.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <param name="recordTrace">Keep every event so that a Chrome trace can be written</param>
+void CreateProfiler(Profiler& profiler, bool recordTrace)
+{
+	profiler.enabled = true;
+	profiler.recordTrace = recordTrace;
+	profiler.origin = std::chrono::steady_clock::now();
+	profiler.frameNumber = -1;
+	profiler.gpuZone = -1;
+	profiler.cpuHistoryCount = 0;
+	profiler.gpuHistoryCount = 0;
+	profiler.droppedQueries = 0;
+
+	for (ProfileQueryFrame& frame : profiler.queryFrames)
+	{
+		glGenQueries(ProfileZoneCount, frame.queries);
+		std::fill(frame.issued, frame.issued + ProfileZoneCount, false);
+		std::fill(frame.start, frame.start + ProfileZoneCount, 0.0);
+	}
+}
+
+/// <summary>
+/// Starts a frame. Reads back the timer queries issued ProfileQueryLatency frames ago.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void BeginProfileFrame(Profiler& profiler)
+{
+	if (!profiler.enabled)
+	{
+		return;
+	}
+
+	++profiler.frameNumber;
+	ProfileQueryFrame& frame = profiler.queryFrames[profiler.frameNumber % ProfileQueryLatency];
+
+	// The queries of this slot were issued ProfileQueryLatency frames ago. A query that is still not done
+	// is dropped rather than waited for, and gets reused below
+	bool anyIssued = std::find(frame.issued, frame.issued + ProfileZoneCount, true) != frame.issued + ProfileZoneCount;
+	if (anyIssued)
+	{
+		int row = profiler.gpuHistoryCount % ProfileHistoryLength;
+		for (int zone = 0; zone < ProfileZoneCount; ++zone)
+		{
+			profiler.gpuHistory[zone][row] = -1.0f;
+			if (!frame.issued[zone])
+			{
+				continue;
+			}
+
+			GLint available = 0;
+			glGetQueryObjectiv(frame.queries[zone], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(frame.queries[zone], GL_QUERY_RESULT, &nanoseconds);
+				profiler.gpuHistory[zone][row] = static_cast<float>(nanoseconds / 1.0e6);
+
+				// The trace shows GPU zones at the time they were submitted, on a track of their own
+				RecordEvent(profiler, { static_cast<ProfileZone>(zone), true, -1, frame.start[zone], nanoseconds / 1.0e3 });
+			}
+			else
+			{
+				++profiler.droppedQueries;
+			}
+			frame.issued[zone] = false;
+		}
+		++profiler.gpuHistoryCount;
+	}
+
+	std::fill(profiler.cpuFrameTotals, profiler.cpuFrameTotals + ProfileZoneCount, 0.0);
+	BeginProfileZone(profiler, ZoneFrame);
+}
+
+/// <summary>
+/// Ends a frame and adds its zone times to the history.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void EndProfileFrame(Profiler& profiler)
+{
+	if (!profiler.enabled)
+	{
+		return;
+	}
+
+	EndProfileZone(profiler);
+
+	int row = profiler.cpuHistoryCount % ProfileHistoryLength;
+	for (int zone = 0; zone < ProfileZoneCount; ++zone)
+	{
+		profiler.cpuHistory[zone][row] = static_cast<float>(profiler.cpuFrameTotals[zone]);
+	}
+	++profiler.cpuHistoryCount;
+}
+
+/// <summary>
+/// Starts timing a zone. Zones can be nested, and zones that are timed on the GPU must not overlap each other.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <param name="zone">Zone</param>
+/// <param name="argument">Value shown with the zone in the trace (e.g. an object index), -1 for none</param>
+void BeginProfileZone(Profiler& profiler, ProfileZone zone, int32_t argument)
+{
+	if (!profiler.enabled)
+	{
+		return;
+	}
+
+	double now = GetProfilerTime(profiler);
+	profiler.openZones.push_back({ zone, argument, now });
+
+	if (ZoneOnGpu[zone] && profiler.gpuZone < 0 && profiler.frameNumber >= 0)
+	{
+		ProfileQueryFrame& frame = profiler.queryFrames[profiler.frameNumber % ProfileQueryLatency];
+		if (!frame.issued[zone])
+		{
+			glBeginQuery(GL_TIME_ELAPSED, frame.queries[zone]);
+			frame.issued[zone] = true;
+			frame.start[zone] = now;
+			profiler.gpuZone = zone;
+		}
+	}
+}
+
+/// <summary>
+/// Stops timing the zone that was started last.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void EndProfileZone(Profiler& profiler)
+{
+	if (!profiler.enabled || profiler.openZones.empty())
+	{
+		return;
+	}
+
+	ProfileOpenZone open = profiler.openZones.back();
+	profiler.openZones.pop_back();
+
+	if (profiler.gpuZone == open.zone)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		profiler.gpuZone = -1;
+	}
+
+	double duration = GetProfilerTime(profiler) - open.start;
+	profiler.cpuFrameTotals[open.zone] += duration / 1.0e3;
+	RecordEvent(profiler, { open.zone, false, open.argument, open.start, duration });
+}
+
+/// <summary>
+/// Prints one line of percentiles for a zone.
+/// </summary>
+/// <param name="label">Zone name and clock</param>
+/// <param name="history">Milliseconds of the zone in the last frames (negative entries are missing samples)</param>
+/// <param name="count">Number of frames in the history</param>
+static void PrintZonePercentiles(const std::string& label, const float* history, int count)
+{
+	std::vector<float> samples;
+	for (int i = 0; i < std::min(count, ProfileHistoryLength); ++i)
+	{
+		if (history[i] >= 0.0f)
+		{
+			samples.push_back(history[i]);
+		}
+	}
+	if (samples.empty())
+	{
+		return;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&samples](double fraction)
+	{
+		return samples[static_cast<size_t>(fraction * (samples.size() - 1) + 0.5)];
+	};
+
+	std::cout << "  " << std::left << std::setw(22) << label << std::right << std::fixed << std::setprecision(3)
+		<< std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.95) << std::setw(10) << percentile(0.99)
+		<< std::setw(10) << samples.back() << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+}
+
+/// <summary>
+/// Prints the median, 95th and 99th percentile and maximum of every zone over the last frames.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void PrintProfileSummary(const Profiler& profiler)
+{
+	if (!profiler.enabled)
+	{
+		return;
+	}
+
+	std::cout << "Profile of the last " << std::min(profiler.cpuHistoryCount, ProfileHistoryLength) << " frames (ms):" << std::endl;
+	std::cout << "  " << std::left << std::setw(22) << "zone" << std::right << std::setw(10) << "p50" << std::setw(10) << "p95"
+		<< std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+	for (int zone = 0; zone < ProfileZoneCount; ++zone)
+	{
+		PrintZonePercentiles(std::string(ZoneNames[zone]) + " (cpu)", profiler.cpuHistory[zone], profiler.cpuHistoryCount);
+		if (ZoneOnGpu[zone])
+		{
+			PrintZonePercentiles(std::string(ZoneNames[zone]) + " (gpu)", profiler.gpuHistory[zone], profiler.gpuHistoryCount);
+		}
+	}
+	if (profiler.droppedQueries > 0)
+	{
+		std::cout << "  " << profiler.droppedQueries << " timer queries were not ready in time and were dropped" << std::endl;
+	}
+}
+
+/// <summary>
+/// Gets the median GPU time of a frame over the last frames, where the GPU time of a frame is the sum of its GPU-timed zones.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <returns>Milliseconds, or -1 if no GPU times were measured</returns>
+double GetProfileGpuFrameMedian(const Profiler& profiler)
+{
+	std::vector<double> frames;
+	for (int row = 0; row < std::min(profiler.gpuHistoryCount, ProfileHistoryLength); ++row)
+	{
+		double total = 0.0;
+		bool measured = false;
+		for (int zone = 0; zone < ProfileZoneCount; ++zone)
+		{
+			if (ZoneOnGpu[zone] && profiler.gpuHistory[zone][row] >= 0.0f)
+			{
+				total += profiler.gpuHistory[zone][row];
+				measured = true;
+			}
+		}
+		if (measured)
+		{
+			frames.push_back(total);
+		}
+	}
+	if (frames.empty())
+	{
+		return -1.0;
+	}
+
+	std::sort(frames.begin(), frames.end());
+	return frames[frames.size() / 2];
+}
+
+/// <summary>
+/// Writes the recorded events as a Chrome trace (chrome://tracing or Perfetto).
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <param name="filePath">Path of the JSON file</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteChromeTrace(const Profiler& profiler, const std::string& filePath)
+{
+	FILE* file = std::fopen(filePath.c_str(), "w");
+	if (file == nullptr)
+	{
+		std::cerr << "Failed to write trace: " << filePath << std::endl;
+		return false;
+	}
+
+	// Thread 1 is the render thread and thread 2 the GPU
+	std::fprintf(file, "{\"traceEvents\":[\n");
+	std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Render thread\"}},\n");
+	std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+	for (const ProfileEvent& event : profiler.events)
+	{
+		std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+			ZoneNames[event.zone], event.gpu ? "gpu" : "cpu", event.gpu ? 2 : 1, event.start, event.duration);
+		if (event.argument >= 0)
+		{
+			std::fprintf(file, ",\"args\":{\"object\":%d}", event.argument);
+		}
+		std::fprintf(file, "}");
+	}
+	std::fprintf(file, "\n]}\n");
+
+	bool written = std::ferror(file) == 0;
+	std::fclose(file);
+	return written;
+}
+
+/// <summary>
+/// Deletes the timer queries.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void DeleteProfiler(Profiler& profiler)
+{
+	if (!profiler.enabled)
+	{
+		return;
+	}
+
+	for (ProfileQueryFrame& frame : profiler.queryFrames)
+	{
+		glDeleteQueries(ProfileZoneCount, frame.queries);
+	}
+	profiler.enabled = false;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Phases of a frame that the profiler times
+/// </summary>
+enum ProfileZone
+{
+	ZoneFrame,				// Whole frame
+	ZoneInput,				// Polling events and advancing the simulation
+	ZoneTransforms,			// Model and transformation matrices
+	ZoneCulling,			// Refitting the hierarchy and culling against the frustum
+	ZoneLights,				// Assigning the point lights to clusters and uploading the light lists
+	ZoneShadows,			// Shadow map passes (also timed on the GPU)
+	ZoneUniformUpload,		// Frame uniforms, uniform ring, instance data and recorded draws (also timed on the GPU)
+	ZoneDraw,				// All draw calls of the frame (also timed on the GPU)
+	ZoneDrawObject,			// Draw calls of one object or instance batch
+	ZoneSwap,				// glfwSwapBuffers(), or glFinish() in headless mode
+	ZoneCapture,			// Writing captured frames to disk and starting the readbacks of the recording
+	ZoneOcclusion,			// Drawing bounding boxes inside occlusion queries (also timed on the GPU)
+	ZoneGpuCulling,			// Compute dispatch that culls the scene for gpu-driven rendering (also timed on the GPU)
+	ProfileZoneCount
+};
+
+/// <summary>
+/// Number of frames between issuing GPU timer queries and reading them back. The results are ready
+/// by then, so reading them never stalls the pipeline.
+/// </summary>
+const int ProfileQueryLatency = 4;
+
+/// <summary>
+/// Number of frames that the rolling percentiles are taken over
+/// </summary>
+const int ProfileHistoryLength = 256;
+
+/// <summary>
+/// Struct containing one timed zone, as written to the Chrome trace
+/// </summary>
+struct ProfileEvent
+{
+	ProfileZone zone;
+	bool gpu;				// Measured with a timer query instead of the CPU clock
+	int32_t argument;		// Object index of ZoneDrawObject events, -1 otherwise
+	double start;			// Microseconds since the profiler was created
+	double duration;		// Microseconds
+};
+
+/// <summary>
+/// Struct containing the timer queries of one frame
+/// </summary>
+struct ProfileQueryFrame
+{
+	GLuint queries[ProfileZoneCount];		// GL_TIME_ELAPSED query of every GPU-timed zone
+	bool issued[ProfileZoneCount];			// Whether the query was used in the frame
+	double start[ProfileZoneCount];			// CPU time at which the zone was submitted, for the trace
+};
+
+/// <summary>
+/// Struct containing a CPU zone that has been started and not ended yet
+/// </summary>
+struct ProfileOpenZone
+{
+	ProfileZone zone;
+	int32_t argument;
+	double start;
+};
+
+/// <summary>
+/// Struct containing the CPU timers, the ring of GPU timer queries and the history of the last frames
+/// </summary>
+struct Profiler
+{
+	bool enabled = false;
+	bool recordTrace = false;				// Keep every event for the Chrome trace
+	std::chrono::steady_clock::time_point origin;
+
+	std::vector<ProfileOpenZone> openZones;	// Stack of nested CPU zones
+	ProfileQueryFrame queryFrames[ProfileQueryLatency];
+	int64_t frameNumber = -1;
+	int gpuZone = -1;						// GPU zone whose query is running, -1 when none is
+
+	double cpuFrameTotals[ProfileZoneCount];					// CPU milliseconds of every zone in the current frame
+	float cpuHistory[ProfileZoneCount][ProfileHistoryLength];	// CPU milliseconds of every zone in the last frames
+	float gpuHistory[ProfileZoneCount][ProfileHistoryLength];	// GPU milliseconds of every zone in the last frames
+	int cpuHistoryCount = 0;				// Frames in cpuHistory so far (at most ProfileHistoryLength)
+	int gpuHistoryCount = 0;				// Frames in gpuHistory so far (at most ProfileHistoryLength)
+	int64_t droppedQueries = 0;				// Queries that were not ready in time and got reused
+
+	std::vector<ProfileEvent> events;		// Events for the trace when recordTrace is set
+};
+
+/// <summary>
+/// Creates the timer queries of the profiler and starts its clock. A profiler that is never created stays disabled
+/// and all calls on it return immediately.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <param name="recordTrace">Keep every event so that a Chrome trace can be written</param>
+void CreateProfiler(Profiler& profiler, bool recordTrace);
+
+/// <summary>
+/// Starts a frame. Reads back the timer queries issued ProfileQueryLatency frames ago.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void BeginProfileFrame(Profiler& profiler);
+
+/// <summary>
+/// Ends a frame and adds its zone times to the history.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void EndProfileFrame(Profiler& profiler);
+
+/// <summary>
+/// Starts timing a zone. Zones can be nested, and zones that are timed on the GPU must not overlap each other.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <param name="zone">Zone</param>
+/// <param name="argument">Value shown with the zone in the trace (e.g. an object index), -1 for none</param>
+void BeginProfileZone(Profiler& profiler, ProfileZone zone, int32_t argument = -1);
+
+/// <summary>
+/// Stops timing the zone that was started last.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void EndProfileZone(Profiler& profiler);
+
+/// <summary>
+/// Prints the median, 95th and 99th percentile and maximum of every zone over the last frames.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void PrintProfileSummary(const Profiler& profiler);
+
+/// <summary>
+/// Gets the median GPU time of a frame over the last frames, where the GPU time of a frame is the sum of its GPU-timed zones.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <returns>Milliseconds, or -1 if no GPU times were measured</returns>
+double GetProfileGpuFrameMedian(const Profiler& profiler);
+
+/// <summary>
+/// Writes the recorded events as a Chrome trace (chrome://tracing or Perfetto).
+/// </summary>
+/// <param name="profiler">Profiler</param>
+/// <param name="filePath">Path of the JSON file</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteChromeTrace(const Profiler& profiler, const std::string& filePath);
+
+/// <summary>
+/// Deletes the timer queries.
+/// </summary>
+/// <param name="profiler">Profiler</param>
+void DeleteProfiler(Profiler& profiler);
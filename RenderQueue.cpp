@@ -0,0 +1,220 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+/// <summary>
+/// Number of bits of the depth part of a sort key
+/// </summary>
+static const int SortKeyDepthBits = 28;
+
+/// <summary>
+/// Builds the 64-bit sort key of a draw packet. From the most significant bits down: program, material, vertex array
+/// object, mesh and depth, so packets that share the expensive state end up next to each other and are drawn
+/// front to back within a group. Program and vertex array names are truncated to 8 bits, which only makes the
+/// order less ideal if there ever are more than 256 of them.
+/// </summary>
+/// <param name="program">Shader program</param>
+/// <param name="material">Layer of the material texture array (12 bits)</param>
+/// <param name="vertexArray">Vertex array object</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="depth">Distance from the camera divided by the far plane distance, 0 to 1</param>
+/// <returns>Sort key</returns>
+uint64_t MakeSortKey(GLuint program, GLuint material, GLuint vertexArray, MeshType mesh, float depth)
+{
+	uint64_t depthBits = static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * ((1u << SortKeyDepthBits) - 1));
+
+	return (static_cast<uint64_t>(program & 0xFF) << 56)
+		| (static_cast<uint64_t>(material & 0xFFF) << 44)
+		| (static_cast<uint64_t>(vertexArray & 0xFF) << 36)
+		| (static_cast<uint64_t>(mesh & 0xFF) << SortKeyDepthBits)
+		| depthBits;
+}
+
+/// <summary>
+/// Removes all packets and sets the uniform ring that the packets of the coming frame point into.
+/// </summary>
+/// <param name="queue">Render queue</param>
+/// <param name="objectBuffer">Uniform ring buffer</param>
+/// <param name="objectSize">Size of every ObjectData range</param>
+void ClearRenderQueue(RenderQueue& queue, GLuint objectBuffer, GLsizeiptr objectSize)
+{
+	queue.packets.clear();
+	queue.objectBuffer = objectBuffer;
+	queue.objectSize = objectSize;
+}
+
+/// <summary>
+/// Adds a draw packet to the queue.
+/// </summary>
+/// <param name="queue">Render queue</param>
+/// <param name="packet">Draw packet</param>
+void SubmitDrawPacket(RenderQueue& queue, const DrawPacket& packet)
+{
+	queue.packets.push_back(packet);
+}
+
+/// <summary>
+/// Sorts the packets by their keys, keeping the submission order of packets with equal keys, and issues them
+/// through the state cache.
+/// </summary>
+/// <param name="queue">Render queue</param>
+/// <param name="state">State cache</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="profiler">Profiler that times every packet</param>
+void ExecuteRenderQueue(RenderQueue& queue, RenderState& state, const MeshBuffers& meshBuffers, Profiler& profiler)
+{
+	std::stable_sort(queue.packets.begin(), queue.packets.end(), [](const DrawPacket& a, const DrawPacket& b)
+	{
+		return a.key < b.key;
+	});
+
+	for (const DrawPacket& packet : queue.packets)
+	{
+		BeginProfileZone(profiler, ZoneDrawObject, packet.object);
+
+		UseProgramCached(state, packet.program);
+		BindVertexArrayCached(state, packet.vertexArray);
+		if (packet.objectOffset >= 0)
+		{
+			BindObjectUniformsCached(state, queue.objectBuffer, packet.objectOffset, queue.objectSize);
+		}
+
+		if (packet.instanceCount > 0)
+		{
+			DrawMeshInstanced(meshBuffers, packet.mesh, packet.lod, packet.instanceCount);
+		}
+		else
+		{
+			DrawMesh(meshBuffers, packet.mesh, packet.lod);
+		}
+		++state.drawCalls;
+
+		EndProfileZone(profiler);
+	}
+}
+
+/// <summary>
+/// Forgets the cached state, so that the next call of every kind is passed on to OpenGL.
+/// </summary>
+/// <param name="state">State cache</param>
+void ResetRenderState(RenderState& state)
+{
+	// 0 is a valid name to bind, so the names are set to values that OpenGL never hands out
+	state.program = ~0u;
+	state.vertexArray = ~0u;
+	state.activeTextureUnit = ~0u;
+	std::fill(state.textureTargets, state.textureTargets + RenderStateTextureUnits, 0u);
+	std::fill(state.textures, state.textures + RenderStateTextureUnits, ~0u);
+	state.objectBuffer = ~0u;
+	state.objectOffset = -1;
+	state.objectSize = 0;
+	state.frameUniformsValid = false;
+}
+
+/// <summary>
+/// Makes a program current unless it already is.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="program">Shader program</param>
+void UseProgramCached(RenderState& state, GLuint program)
+{
+	if (state.program == program)
+	{
+		++state.skippedCalls;
+		return;
+	}
+
+	glUseProgram(program);
+	state.program = program;
+	++state.issuedCalls;
+}
+
+/// <summary>
+/// Binds a vertex array object unless it already is bound.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="vertexArray">Vertex array object</param>
+void BindVertexArrayCached(RenderState& state, GLuint vertexArray)
+{
+	if (state.vertexArray == vertexArray)
+	{
+		++state.skippedCalls;
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	state.vertexArray = vertexArray;
+	++state.issuedCalls;
+}
+
+/// <summary>
+/// Binds a texture to a texture unit unless it already is bound there.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="unit">Texture unit</param>
+/// <param name="target">Texture target</param>
+/// <param name="texture">Texture</param>
+void BindTextureCached(RenderState& state, GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit < RenderStateTextureUnits && state.textureTargets[unit] == target && state.textures[unit] == texture)
+	{
+		++state.skippedCalls;
+		return;
+	}
+
+	if (state.activeTextureUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.activeTextureUnit = unit;
+	}
+	glBindTexture(target, texture);
+	if (unit < RenderStateTextureUnits)
+	{
+		state.textureTargets[unit] = target;
+		state.textures[unit] = texture;
+	}
+	++state.issuedCalls;
+}
+
+/// <summary>
+/// Binds a range of a buffer to the ObjectData binding point unless that exact range already is bound.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="buffer">Uniform buffer</param>
+/// <param name="offset">Offset of the range</param>
+/// <param name="size">Size of the range</param>
+void BindObjectUniformsCached(RenderState& state, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (state.objectBuffer == buffer && state.objectOffset == offset && state.objectSize == size)
+	{
+		++state.skippedCalls;
+		return;
+	}
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, ObjectDataBinding, buffer, offset, size);
+	state.objectBuffer = buffer;
+	state.objectOffset = offset;
+	state.objectSize = size;
+	++state.issuedCalls;
+}
+
+/// <summary>
+/// Uploads the per-frame data unless the buffer already holds the same data.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="buffer">Buffer created by CreateFrameUniformBuffer()</param>
+/// <param name="frame">Per-frame data</param>
+void UpdateFrameUniformsCached(RenderState& state, GLuint buffer, const FrameUniforms& frame)
+{
+	if (state.frameUniformsValid && std::memcmp(&state.frameUniforms, &frame, sizeof(FrameUniforms)) == 0)
+	{
+		++state.skippedCalls;
+		return;
+	}
+
+	UpdateFrameUniformBuffer(buffer, frame);
+	state.frameUniforms = frame;
+	state.frameUniformsValid = true;
+	++state.issuedCalls;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+#include "Profiler.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Number of texture units that the state cache keeps track of
+/// </summary>
+const int RenderStateTextureUnits = 8;
+
+/// <summary>
+/// Struct containing the OpenGL state that the render loop last set. Binds that would not change anything are skipped.
+/// Code that changes this state without going through the cache must call ResetRenderState() afterwards.
+/// </summary>
+struct RenderState
+{
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	GLuint activeTextureUnit = 0;
+	GLenum textureTargets[RenderStateTextureUnits] = {};
+	GLuint textures[RenderStateTextureUnits] = {};
+	GLuint objectBuffer = 0;				// Buffer bound to the ObjectData binding point
+	GLintptr objectOffset = -1;				// Offset of the bound ObjectData range
+	GLsizeiptr objectSize = 0;				// Size of the bound ObjectData range
+	FrameUniforms frameUniforms;			// Last FrameData upload
+	bool frameUniformsValid = false;		// Whether frameUniforms holds the buffer's contents
+
+	int64_t issuedCalls = 0;				// State changes that were passed on to OpenGL
+	int64_t skippedCalls = 0;				// State changes that were skipped because nothing would change
+	int64_t drawCalls = 0;					// Draw calls issued with this state
+};
+
+/// <summary>
+/// Struct containing one draw call and the state it needs
+/// </summary>
+struct DrawPacket
+{
+	uint64_t key;					// Sort key built by MakeSortKey()
+	GLuint program;
+	GLuint vertexArray;
+	MeshType mesh;
+	int lod;						// Level of detail of the mesh
+	GLsizei instanceCount;			// Number of instances, 0 for a plain draw
+	GLintptr objectOffset;			// ObjectData range in the uniform ring, -1 when the program reads no ObjectData block
+	int32_t object;					// Scene object (or first object of an instance batch), shown in the profile
+};
+
+/// <summary>
+/// Struct containing the draw packets of a frame
+/// </summary>
+struct RenderQueue
+{
+	std::vector<DrawPacket> packets;
+	GLuint objectBuffer = 0;				// Uniform ring buffer that the ObjectData ranges point into
+	GLsizeiptr objectSize = 0;				// Size of every ObjectData range
+};
+
+/// <summary>
+/// Builds the 64-bit sort key of a draw packet. From the most significant bits down: program, material, vertex array
+/// object, mesh and depth, so packets that share the expensive state end up next to each other and are drawn
+/// front to back within a group. Program and vertex array names are truncated to 8 bits, which only makes the
+/// order less ideal if there ever are more than 256 of them.
+/// </summary>
+/// <param name="program">Shader program</param>
+/// <param name="material">Layer of the material texture array (12 bits)</param>
+/// <param name="vertexArray">Vertex array object</param>
+/// <param name="mesh">Mesh type</param>
+/// <param name="depth">Distance from the camera divided by the far plane distance, 0 to 1</param>
+/// <returns>Sort key</returns>
+uint64_t MakeSortKey(GLuint program, GLuint material, GLuint vertexArray, MeshType mesh, float depth);
+
+/// <summary>
+/// Removes all packets and sets the uniform ring that the packets of the coming frame point into.
+/// </summary>
+/// <param name="queue">Render queue</param>
+/// <param name="objectBuffer">Uniform ring buffer</param>
+/// <param name="objectSize">Size of every ObjectData range</param>
+void ClearRenderQueue(RenderQueue& queue, GLuint objectBuffer, GLsizeiptr objectSize);
+
+/// <summary>
+/// Adds a draw packet to the queue.
+/// </summary>
+/// <param name="queue">Render queue</param>
+/// <param name="packet">Draw packet</param>
+void SubmitDrawPacket(RenderQueue& queue, const DrawPacket& packet);
+
+/// <summary>
+/// Sorts the packets by their keys, keeping the submission order of packets with equal keys, and issues them
+/// through the state cache.
+/// </summary>
+/// <param name="queue">Render queue</param>
+/// <param name="state">State cache</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="profiler">Profiler that times every packet</param>
+void ExecuteRenderQueue(RenderQueue& queue, RenderState& state, const MeshBuffers& meshBuffers, Profiler& profiler);
+
+/// <summary>
+/// Forgets the cached state, so that the next call of every kind is passed on to OpenGL.
+/// </summary>
+/// <param name="state">State cache</param>
+void ResetRenderState(RenderState& state);
+
+/// <summary>
+/// Makes a program current unless it already is.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="program">Shader program</param>
+void UseProgramCached(RenderState& state, GLuint program);
+
+/// <summary>
+/// Binds a vertex array object unless it already is bound.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="vertexArray">Vertex array object</param>
+void BindVertexArrayCached(RenderState& state, GLuint vertexArray);
+
+/// <summary>
+/// Binds a texture to a texture unit unless it already is bound there.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="unit">Texture unit</param>
+/// <param name="target">Texture target</param>
+/// <param name="texture">Texture</param>
+void BindTextureCached(RenderState& state, GLuint unit, GLenum target, GLuint texture);
+
+/// <summary>
+/// Binds a range of a buffer to the ObjectData binding point unless that exact range already is bound.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="buffer">Uniform buffer</param>
+/// <param name="offset">Offset of the range</param>
+/// <param name="size">Size of the range</param>
+void BindObjectUniformsCached(RenderState& state, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+/// <summary>
+/// Uploads the per-frame data unless the buffer already holds the same data.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="buffer">Buffer created by CreateFrameUniformBuffer()</param>
+/// <param name="frame">Per-frame data</param>
+void UpdateFrameUniformsCached(RenderState& state, GLuint buffer, const FrameUniforms& frame);
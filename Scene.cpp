@@ -0,0 +1,45 @@
+#include "Scene.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+/// <summary>
+/// Computes the model matrix of an object at the given time.
+/// </summary>
+/// <param name="object">Scene object</param>
+/// <param name="time">Animation time (60 units per second)</param>
+/// <returns>Model matrix of the object</returns>
+glm::mat4 ComputeModelMatrix(const SceneObject& object, float time)
+{
+	return ComputeModelMatrix(object.position, object.scale, object.rotationAxis, object.rotationSpeed, time);
+}
+
+/// <summary>
+/// Computes a model matrix from the transform components of an object.
+/// </summary>
+/// <param name="position">Position</param>
+/// <param name="scale">Scale</param>
+/// <param name="rotationAxis">Axis of the continuous rotation</param>
+/// <param name="rotationSpeed">Degrees of rotation per unit of time</param>
+/// <param name="time">Animation time (60 units per second)</param>
+/// <returns>Model matrix</returns>
+glm::mat4 ComputeModelMatrix(const glm::vec3& position, const glm::vec3& scale, const glm::vec3& rotationAxis, float rotationSpeed, float time)
+{
+	glm::mat4 modelMatrix = glm::mat4(1.0f);
+	modelMatrix = glm::translate(modelMatrix, position);
+	modelMatrix = glm::scale(modelMatrix, scale);
+	if (rotationSpeed != 0.0f)
+	{
+		modelMatrix = glm::rotate(modelMatrix, glm::radians(time * rotationSpeed), rotationAxis);
+	}
+	return modelMatrix;
+}
+
+/// <summary>
+/// Checks whether the model matrix of an object changes over time.
+/// </summary>
+/// <param name="object">Scene object</param>
+/// <returns>True if the object is animated, false if it is static</returns>
+bool IsDynamic(const SceneObject& object)
+{
+	return object.rotationSpeed != 0.0f;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+/// <summary>
+/// Struct containing data about an object in the scene
+/// </summary>
+struct SceneObject
+{
+	MeshType mesh;
+	GLuint material;			// Index into the scene's materials, which is also the layer of the material texture array
+	glm::vec3 position;
+	glm::vec3 scale;
+	glm::vec3 rotationAxis;		// Axis of the continuous rotation
+	float rotationSpeed;		// Degrees of rotation per unit of time (0 for objects that never move)
+};
+
+/// <summary>
+/// Struct containing a material that scene objects can use (an image file that becomes a layer of the material texture array)
+/// </summary>
+struct SceneMaterial
+{
+	std::string filePath;		// Empty for an untextured material, whose objects show their vertex colors
+	bool swapRedBlue;			// Upload 4-channel pixels as BGRA (how RoomTexture.png has always been uploaded)
+	bool lit;					// Whether the main light's diffuse term and shadows apply
+	bool fog;					// Whether the fog color is applied
+};
+
+/// <summary>
+/// Struct containing a point light of the scene, lit by the clustered lighting pass
+/// </summary>
+struct ScenePointLight
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	float radius;				// Distance at which the light has faded out completely
+};
+
+/// <summary>
+/// Computes the model matrix of an object at the given time.
+/// </summary>
+/// <param name="object">Scene object</param>
+/// <param name="time">Animation time (60 units per second)</param>
+/// <returns>Model matrix of the object</returns>
+glm::mat4 ComputeModelMatrix(const SceneObject& object, float time);
+
+/// <summary>
+/// Computes a model matrix from the transform components of an object.
+/// </summary>
+/// <param name="position">Position</param>
+/// <param name="scale">Scale</param>
+/// <param name="rotationAxis">Axis of the continuous rotation</param>
+/// <param name="rotationSpeed">Degrees of rotation per unit of time</param>
+/// <param name="time">Animation time (60 units per second)</param>
+/// <returns>Model matrix</returns>
+glm::mat4 ComputeModelMatrix(const glm::vec3& position, const glm::vec3& scale, const glm::vec3& rotationAxis, float rotationSpeed, float time);
+
+/// <summary>
+/// Checks whether the model matrix of an object changes over time.
+/// </summary>
+/// <param name="object">Scene object</param>
+/// <returns>True if the object is animated, false if it is static</returns>
+bool IsDynamic(const SceneObject& object);
@@ -0,0 +1,376 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char SceneFileMagic[4] = { 'B', 'S', 'C', 'N' };
+static const uint32_t SceneFileVersion = 2;
+
+/// <summary>
+/// Names of the meshes in scene text files, in MeshType order
+/// </summary>
+static const char* MeshNames[MeshTypeCount] = { "cube", "octahedron", "box", "sphere", "cylinder" };
+
+/// <summary>
+/// Gets the path of the compiled version of a scene file (the same name with the extension replaced by .bscene).
+/// </summary>
+/// <param name="sceneFilePath">Path of the scene text file</param>
+/// <returns>Path of the compiled scene</returns>
+std::string GetCompiledScenePath(const std::string& sceneFilePath)
+{
+	size_t extension = sceneFilePath.find_last_of('.');
+	size_t directory = sceneFilePath.find_last_of("/\\");
+	if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+	{
+		return sceneFilePath + ".bscene";
+	}
+	return sceneFilePath.substr(0, extension) + ".bscene";
+}
+
+/// <summary>
+/// Reads three numbers from a line of a scene text file.
+/// </summary>
+/// <param name="line">Rest of the line</param>
+/// <param name="value">Receives the numbers</param>
+/// <returns>True if there were three numbers, false otherwise</returns>
+static bool ReadVector(std::istringstream& line, glm::vec3& value)
+{
+	return static_cast<bool>(line >> value.x >> value.y >> value.z);
+}
+
+/// <summary>
+/// Parses a scene text file. Every line is empty, a # comment, or one of:
+///   material &lt;image file|none&gt; [bgra] [unlit] [nofog]
+///   object &lt;cube|octahedron|box|sphere|cylinder&gt; &lt;material index&gt; &lt;position x y z&gt; &lt;scale x y z&gt; [rotate &lt;axis x y z&gt; &lt;degrees per unit of time&gt;]
+///   light &lt;position x y z&gt; &lt;color r g b&gt; &lt;radius&gt;
+/// The objects are returned grouped by mesh (otherwise in file order), so instanced drawing needs one batch per mesh.
+/// </summary>
+/// <param name="sceneFilePath">Path of the scene text file</param>
+/// <param name="materials">Receives the materials, in layer order</param>
+/// <param name="objects">Receives the objects</param>
+/// <param name="lights">Receives the point lights</param>
+/// <returns>True if the file was read without errors, false otherwise</returns>
+bool ParseSceneText(const std::string& sceneFilePath, std::vector<SceneMaterial>& materials, std::vector<SceneObject>& objects,
+	std::vector<ScenePointLight>& lights)
+{
+	std::ifstream sceneFile(sceneFilePath);
+	if (sceneFile.fail())
+	{
+		std::cerr << "Unable to open scene file: " << sceneFilePath << std::endl;
+		return false;
+	}
+
+	materials.clear();
+	objects.clear();
+	lights.clear();
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(sceneFile, text))
+	{
+		++lineNumber;
+
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword) || keyword[0] == '#')
+		{
+			continue;
+		}
+
+		bool valid = false;
+		if (keyword == "material")
+		{
+			SceneMaterial material;
+			std::string option;
+			material.swapRedBlue = false;
+			material.lit = true;
+			material.fog = true;
+			if (line >> material.filePath)
+			{
+				// Untextured materials keep an empty layer and draw with the vertex colors
+				if (material.filePath == "none")
+				{
+					material.filePath.clear();
+				}
+
+				valid = true;
+				while (line >> option)
+				{
+					if (option == "bgra")
+					{
+						material.swapRedBlue = true;
+					}
+					else if (option == "unlit")
+					{
+						material.lit = false;
+					}
+					else if (option == "nofog")
+					{
+						material.fog = false;
+					}
+					else
+					{
+						valid = false;
+					}
+				}
+				materials.push_back(material);
+			}
+		}
+		else if (keyword == "object")
+		{
+			SceneObject object;
+			std::string meshName;
+			std::string option;
+			object.rotationAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+			object.rotationSpeed = 0.0f;
+
+			const char** mesh = MeshNames + MeshTypeCount;
+			if (line >> meshName)
+			{
+				mesh = std::find_if(MeshNames, MeshNames + MeshTypeCount, [&](const char* name) { return meshName == name; });
+			}
+
+			if (mesh != MeshNames + MeshTypeCount && line >> object.material && ReadVector(line, object.position) && ReadVector(line, object.scale))
+			{
+				object.mesh = static_cast<MeshType>(mesh - MeshNames);
+				valid = true;
+				if (line >> option)
+				{
+					valid = option == "rotate" && ReadVector(line, object.rotationAxis) && line >> object.rotationSpeed && !(line >> option);
+				}
+				objects.push_back(object);
+			}
+		}
+		else if (keyword == "light")
+		{
+			ScenePointLight light;
+			std::string option;
+			if (ReadVector(line, light.position) && ReadVector(line, light.color) && line >> light.radius)
+			{
+				valid = light.radius > 0.0f && !(line >> option);
+				lights.push_back(light);
+			}
+		}
+
+		if (!valid)
+		{
+			std::cerr << sceneFilePath << ":" << lineNumber << ": invalid line: " << text << std::endl;
+			return false;
+		}
+	}
+
+	for (const SceneObject& object : objects)
+	{
+		if (object.material >= materials.size())
+		{
+			std::cerr << sceneFilePath << ": object uses material " << object.material << ", but there are only "
+				<< materials.size() << " materials" << std::endl;
+			return false;
+		}
+	}
+
+	// Objects that share a mesh end up next to each other, so they form a single instance batch
+	std::stable_sort(objects.begin(), objects.end(), [](const SceneObject& a, const SceneObject& b) { return a.mesh < b.mesh; });
+	return true;
+}
+
+/// <summary>
+/// Parses a scene text file and writes it as a compiled scene file that can be mapped and streamed without parsing.
+/// </summary>
+/// <param name="sceneFilePath">Path of the scene text file</param>
+/// <param name="compiledFilePath">Path of the compiled scene file that will be written</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool CompileScene(const std::string& sceneFilePath, const std::string& compiledFilePath)
+{
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneObject> objects;
+	std::vector<ScenePointLight> lights;
+	if (!ParseSceneText(sceneFilePath, materials, objects, lights))
+	{
+		return false;
+	}
+
+	// Header, material table, objects (16-byte aligned), lights and then the material paths
+	SceneFileHeader header;
+	std::memcpy(header.magic, SceneFileMagic, sizeof(header.magic));
+	header.version = SceneFileVersion;
+	header.materialCount = static_cast<uint32_t>(materials.size());
+	header.objectCount = static_cast<uint32_t>(objects.size());
+	header.materialOffset = sizeof(SceneFileHeader);
+
+	size_t tableEnd = header.materialOffset + materials.size() * sizeof(SceneFileMaterial);
+	size_t objectStart = (tableEnd + 15) & ~static_cast<size_t>(15);
+	size_t lightStart = objectStart + objects.size() * sizeof(SceneFileObject);
+	size_t pathStart = lightStart + lights.size() * sizeof(SceneFileLight);
+	header.objectOffset = static_cast<uint32_t>(objectStart);
+	header.lightCount = static_cast<uint32_t>(lights.size());
+	header.lightOffset = static_cast<uint32_t>(lightStart);
+
+	std::vector<SceneFileMaterial> materialTable;
+	size_t pathOffset = pathStart;
+	for (const SceneMaterial& material : materials)
+	{
+		uint32_t flags = (material.lit ? 0u : static_cast<uint32_t>(SceneFileMaterialUnlit)) | (material.fog ? 0u : static_cast<uint32_t>(SceneFileMaterialNoFog));
+		materialTable.push_back({ static_cast<uint32_t>(pathOffset), static_cast<uint32_t>(material.filePath.size()), material.swapRedBlue ? 1u : 0u, flags });
+		pathOffset += material.filePath.size();
+	}
+
+	std::vector<SceneFileObject> records(objects.size());
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		const SceneObject& object = objects[i];
+		SceneFileObject& record = records[i];
+		record.mesh = object.mesh;
+		record.material = object.material;
+		std::memcpy(record.position, &object.position[0], sizeof(record.position));
+		std::memcpy(record.scale, &object.scale[0], sizeof(record.scale));
+		std::memcpy(record.rotationAxis, &object.rotationAxis[0], sizeof(record.rotationAxis));
+		record.rotationSpeed = object.rotationSpeed;
+	}
+
+	std::vector<SceneFileLight> lightRecords(lights.size());
+	for (size_t i = 0; i < lights.size(); ++i)
+	{
+		SceneFileLight& record = lightRecords[i];
+		std::memcpy(record.position, &lights[i].position[0], sizeof(record.position));
+		std::memcpy(record.color, &lights[i].color[0], sizeof(record.color));
+		record.radius = lights[i].radius;
+		record.padding = 0.0f;
+	}
+
+	FILE* file = std::fopen(compiledFilePath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		std::cerr << "Unable to open compiled scene for writing: " << compiledFilePath << std::endl;
+		return false;
+	}
+
+	static const unsigned char padding[16] = {};
+	std::fwrite(&header, sizeof(header), 1, file);
+	std::fwrite(materialTable.data(), sizeof(SceneFileMaterial), materialTable.size(), file);
+	std::fwrite(padding, 1, objectStart - tableEnd, file);
+	std::fwrite(records.data(), sizeof(SceneFileObject), records.size(), file);
+	std::fwrite(lightRecords.data(), sizeof(SceneFileLight), lightRecords.size(), file);
+	for (const SceneMaterial& material : materials)
+	{
+		std::fwrite(material.filePath.data(), 1, material.filePath.size(), file);
+	}
+
+	bool written = std::ferror(file) == 0;
+	std::fclose(file);
+	return written;
+}
+
+/// <summary>
+/// Maps a compiled scene file and reads its materials and lights. The objects are read afterwards with StreamSceneObjects().
+/// </summary>
+/// <param name="stream">Scene stream that will be filled in</param>
+/// <param name="compiledFilePath">Path of the compiled scene file</param>
+/// <param name="materials">Receives the materials, in layer order</param>
+/// <param name="lights">Receives the point lights</param>
+/// <returns>True if the file is a valid compiled scene, false if it does not exist or is invalid</returns>
+bool OpenSceneStream(SceneStream& stream, const std::string& compiledFilePath, std::vector<SceneMaterial>& materials,
+	std::vector<ScenePointLight>& lights)
+{
+	if (!OpenMappedFile(stream.file, compiledFilePath))
+	{
+		return false;
+	}
+
+	const unsigned char* data = stream.file.data;
+	size_t size = stream.file.size;
+	const SceneFileHeader* header = reinterpret_cast<const SceneFileHeader*>(data);
+	if (size < sizeof(SceneFileHeader) || std::memcmp(header->magic, SceneFileMagic, sizeof(header->magic)) != 0
+		|| header->version != SceneFileVersion || header->objectOffset % 16 != 0
+		|| static_cast<size_t>(header->materialOffset) + header->materialCount * sizeof(SceneFileMaterial) > size
+		|| static_cast<size_t>(header->objectOffset) + header->objectCount * sizeof(SceneFileObject) > size
+		|| static_cast<size_t>(header->lightOffset) + header->lightCount * sizeof(SceneFileLight) > size)
+	{
+		std::cerr << "Invalid compiled scene: " << compiledFilePath << std::endl;
+		CloseSceneStream(stream);
+		return false;
+	}
+
+	materials.clear();
+	const SceneFileMaterial* materialTable = reinterpret_cast<const SceneFileMaterial*>(data + header->materialOffset);
+	for (uint32_t i = 0; i < header->materialCount; ++i)
+	{
+		const SceneFileMaterial& material = materialTable[i];
+		if (static_cast<size_t>(material.pathOffset) + material.pathLength > size)
+		{
+			std::cerr << "Invalid compiled scene: " << compiledFilePath << std::endl;
+			CloseSceneStream(stream);
+			return false;
+		}
+		materials.push_back({ std::string(reinterpret_cast<const char*>(data + material.pathOffset), material.pathLength), material.swapRedBlue != 0,
+			(material.flags & SceneFileMaterialUnlit) == 0, (material.flags & SceneFileMaterialNoFog) == 0 });
+	}
+
+	// Lights are few, so they are copied out right away instead of being streamed
+	lights.clear();
+	const SceneFileLight* lightRecords = reinterpret_cast<const SceneFileLight*>(data + header->lightOffset);
+	for (uint32_t i = 0; i < header->lightCount; ++i)
+	{
+		const SceneFileLight& record = lightRecords[i];
+		lights.push_back({ glm::vec3(record.position[0], record.position[1], record.position[2]),
+			glm::vec3(record.color[0], record.color[1], record.color[2]), record.radius });
+	}
+
+	stream.header = header;
+	stream.objects = reinterpret_cast<const SceneFileObject*>(data + header->objectOffset);
+	stream.nextObject = 0;
+	return true;
+}
+
+/// <summary>
+/// Appends the next chunk of objects of a compiled scene. Records with an unknown mesh or material are skipped.
+/// </summary>
+/// <param name="stream">Scene stream</param>
+/// <param name="objects">Objects that the chunk is appended to</param>
+/// <param name="maxCount">Maximum number of records to read</param>
+/// <returns>True if any records were read, false once the whole scene has been read</returns>
+bool StreamSceneObjects(SceneStream& stream, std::vector<SceneObject>& objects, size_t maxCount)
+{
+	if (stream.header == nullptr || stream.nextObject >= stream.header->objectCount)
+	{
+		return false;
+	}
+
+	uint32_t end = static_cast<uint32_t>(std::min<size_t>(stream.header->objectCount, stream.nextObject + maxCount));
+	for (uint32_t i = stream.nextObject; i < end; ++i)
+	{
+		const SceneFileObject& record = stream.objects[i];
+		if (record.mesh >= MeshTypeCount || record.material >= stream.header->materialCount)
+		{
+			continue;
+		}
+
+		SceneObject object;
+		object.mesh = static_cast<MeshType>(record.mesh);
+		object.material = record.material;
+		object.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+		object.scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+		object.rotationAxis = glm::vec3(record.rotationAxis[0], record.rotationAxis[1], record.rotationAxis[2]);
+		object.rotationSpeed = record.rotationSpeed;
+		objects.push_back(object);
+	}
+
+	stream.nextObject = end;
+	return true;
+}
+
+/// <summary>
+/// Unmaps a compiled scene file.
+/// </summary>
+/// <param name="stream">Scene stream</param>
+void CloseSceneStream(SceneStream& stream)
+{
+	CloseMappedFile(stream.file);
+	stream.header = nullptr;
+	stream.objects = nullptr;
+	stream.nextObject = 0;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Scene.h"
+
+/// <summary>
+/// Header at the start of a compiled scene file (.bscene). All values are little-endian.
+/// The header is followed by the material table, the object records, the light records and the material file paths.
+/// </summary>
+struct SceneFileHeader
+{
+	char magic[4];				// "BSCN"
+	uint32_t version;
+	uint32_t materialCount;
+	uint32_t objectCount;
+	uint32_t materialOffset;	// Offset of the first SceneFileMaterial from the start of the file
+	uint32_t objectOffset;		// Offset of the first SceneFileObject from the start of the file (16-byte aligned)
+	uint32_t lightCount;
+	uint32_t lightOffset;		// Offset of the first SceneFileLight from the start of the file
+};
+
+/// <summary>
+/// Struct describing a material in a compiled scene file
+/// </summary>
+struct SceneFileMaterial
+{
+	uint32_t pathOffset;		// Offset of the image file path from the start of the file (not zero-terminated)
+	uint32_t pathLength;
+	uint32_t swapRedBlue;
+	uint32_t flags;				// SceneFileMaterialFlags; always 0 in files written before the flags existed
+};
+
+/// <summary>
+/// Shading options of a material in a compiled scene file
+/// </summary>
+enum SceneFileMaterialFlags
+{
+	SceneFileMaterialUnlit = 1,
+	SceneFileMaterialNoFog = 2
+};
+
+/// <summary>
+/// Struct containing an object in a compiled scene file. Objects are stored grouped by mesh.
+/// </summary>
+struct SceneFileObject
+{
+	uint32_t mesh;				// MeshType
+	uint32_t material;			// Index into the material table
+	float position[3];
+	float scale[3];
+	float rotationAxis[3];
+	float rotationSpeed;
+};
+
+/// <summary>
+/// Struct containing a point light in a compiled scene file
+/// </summary>
+struct SceneFileLight
+{
+	float position[3];
+	float color[3];
+	float radius;
+	float padding;
+};
+
+/// <summary>
+/// Struct containing a compiled scene file whose objects are read a chunk at a time
+/// </summary>
+struct SceneStream
+{
+	MappedFile file;
+	const SceneFileHeader* header = nullptr;
+	const SceneFileObject* objects = nullptr;
+	uint32_t nextObject = 0;	// Index of the next record that StreamSceneObjects() reads
+};
+
+/// <summary>
+/// Gets the path of the compiled version of a scene file (the same name with the extension replaced by .bscene).
+/// </summary>
+/// <param name="sceneFilePath">Path of the scene text file</param>
+/// <returns>Path of the compiled scene</returns>
+std::string GetCompiledScenePath(const std::string& sceneFilePath);
+
+/// <summary>
+/// Parses a scene text file. Every line is empty, a # comment, or one of:
+///   material &lt;image file|none&gt; [bgra] [unlit] [nofog]
+///   object &lt;cube|octahedron|box|sphere|cylinder&gt; &lt;material index&gt; &lt;position x y z&gt; &lt;scale x y z&gt; [rotate &lt;axis x y z&gt; &lt;degrees per unit of time&gt;]
+///   light &lt;position x y z&gt; &lt;color r g b&gt; &lt;radius&gt;
+/// The objects are returned grouped by mesh (otherwise in file order), so instanced drawing needs one batch per mesh.
+/// </summary>
+/// <param name="sceneFilePath">Path of the scene text file</param>
+/// <param name="materials">Receives the materials, in layer order</param>
+/// <param name="objects">Receives the objects</param>
+/// <param name="lights">Receives the point lights</param>
+/// <returns>True if the file was read without errors, false otherwise</returns>
+bool ParseSceneText(const std::string& sceneFilePath, std::vector<SceneMaterial>& materials, std::vector<SceneObject>& objects,
+	std::vector<ScenePointLight>& lights);
+
+/// <summary>
+/// Parses a scene text file and writes it as a compiled scene file that can be mapped and streamed without parsing.
+/// </summary>
+/// <param name="sceneFilePath">Path of the scene text file</param>
+/// <param name="compiledFilePath">Path of the compiled scene file that will be written</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool CompileScene(const std::string& sceneFilePath, const std::string& compiledFilePath);
+
+/// <summary>
+/// Maps a compiled scene file and reads its materials and lights. The objects are read afterwards with StreamSceneObjects().
+/// </summary>
+/// <param name="stream">Scene stream that will be filled in</param>
+/// <param name="compiledFilePath">Path of the compiled scene file</param>
+/// <param name="materials">Receives the materials, in layer order</param>
+/// <param name="lights">Receives the point lights</param>
+/// <returns>True if the file is a valid compiled scene, false if it does not exist or is invalid</returns>
+bool OpenSceneStream(SceneStream& stream, const std::string& compiledFilePath, std::vector<SceneMaterial>& materials,
+	std::vector<ScenePointLight>& lights);
+
+/// <summary>
+/// Appends the next chunk of objects of a compiled scene. Records with an unknown mesh or material are skipped.
+/// </summary>
+/// <param name="stream">Scene stream</param>
+/// <param name="objects">Objects that the chunk is appended to</param>
+/// <param name="maxCount">Maximum number of records to read</param>
+/// <returns>True if any records were read, false once the whole scene has been read</returns>
+bool StreamSceneObjects(SceneStream& stream, std::vector<SceneObject>& objects, size_t maxCount);
+
+/// <summary>
+/// Unmaps a compiled scene file.
+/// </summary>
+/// <param name="stream">Scene stream</param>
+void CloseSceneStream(SceneStream& stream);
@@ -0,0 +1,492 @@
+#include "ShaderProgram.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+// KHR_parallel_shader_compile enums, in case the OpenGL loader was generated without the extension
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+/// <summary>
+/// Header of a cached program binary
+/// </summary>
+struct ProgramBinaryHeader
+{
+	char magic[4];				// "PBIN"
+	uint32_t binaryFormat;		// Format returned by glGetProgramBinary()
+	uint32_t length;			// Size of the binary that follows the header
+	uint32_t padding;
+	uint64_t key;				// Cache key, to catch hash collisions in file names
+};
+
+static const char ProgramBinaryMagic[4] = { 'P', 'B', 'I', 'N' };
+
+/// <summary>
+/// Adds bytes to a 64-bit FNV-1a hash.
+/// </summary>
+/// <param name="hash">Hash so far</param>
+/// <param name="text">Bytes to add (a terminating zero is added too, so that "ab" + "c" and "a" + "bc" differ)</param>
+/// <returns>New hash</returns>
+static uint64_t HashText(uint64_t hash, const std::string& text)
+{
+	for (size_t i = 0; i <= text.size(); ++i)
+	{
+		hash = (hash ^ static_cast<unsigned char>(text.c_str()[i])) * 1099511628211ull;
+	}
+	return hash;
+}
+
+/// <summary>
+/// Gets the modification time of a file.
+/// </summary>
+/// <param name="filePath">Path of the file</param>
+/// <returns>Modification time, or 0 if the file does not exist</returns>
+static long long GetFileModificationTime(const std::string& filePath)
+{
+	struct stat status;
+	if (stat(filePath.c_str(), &status) != 0)
+	{
+		return 0;
+	}
+	return static_cast<long long>(status.st_mtime);
+}
+
+/// <summary>
+/// Gets the path of the cached binary of a program.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="key">Cache key of the program</param>
+/// <returns>Path of the binary</returns>
+static std::string GetProgramBinaryPath(const ShaderCache& cache, uint64_t key)
+{
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "/%016llx.bin", static_cast<unsigned long long>(key));
+	return cache.directory + fileName;
+}
+
+/// <summary>
+/// Inserts preprocessor lines after the #version line of a shader.
+/// </summary>
+/// <param name="source">Shader source</param>
+/// <param name="defines">Lines to insert</param>
+/// <returns>Shader source with the lines inserted</returns>
+static std::string InsertDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+	{
+		return source;
+	}
+
+	size_t versionLine = source.compare(0, 8, "#version") == 0 ? source.find('\n') : std::string::npos;
+	if (versionLine == std::string::npos)
+	{
+		return defines + "\n" + source;
+	}
+	return source.substr(0, versionLine + 1) + defines + "\n" + source.substr(versionLine + 1);
+}
+
+/// <summary>
+/// Creates a shader based on the provided shader type and the string containing the shader source.
+/// The compile status is not checked here, so that the driver can compile in the background.
+/// </summary>
+/// <param name="shaderType">Shader type</param>
+/// <param name="shaderSource">Shader source string</param>
+/// <returns>OpenGL handle to the created shader</returns>
+static GLuint CreateShaderFromSource(GLenum shaderType, const std::string& shaderSource)
+{
+	GLuint shader = glCreateShader(shaderType);
+
+	const char* shaderSourceCStr = shaderSource.c_str();
+	GLint shaderSourceLen = static_cast<GLint>(shaderSource.length());
+	glShaderSource(shader, 1, &shaderSourceCStr, &shaderSourceLen);
+	glCompileShader(shader);
+
+	return shader;
+}
+
+/// <summary>
+/// Tries to restore a program from its cached binary.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="key">Cache key of the program</param>
+/// <returns>OpenGL handle to the linked program, or 0 if there is no usable binary</returns>
+static GLuint LoadProgramBinary(const ShaderCache& cache, uint64_t key)
+{
+	std::string contents;
+	if (cache.directory.empty() || !ReadTextFile(GetProgramBinaryPath(cache, key), contents) || contents.size() < sizeof(ProgramBinaryHeader))
+	{
+		return 0;
+	}
+
+	ProgramBinaryHeader header;
+	std::memcpy(&header, contents.data(), sizeof(header));
+	if (std::memcmp(header.magic, ProgramBinaryMagic, sizeof(header.magic)) != 0 || header.key != key
+		|| contents.size() != sizeof(header) + header.length)
+	{
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, contents.data() + sizeof(header), static_cast<GLsizei>(header.length));
+
+	// Drivers reject binaries from other driver builds, in which case the program is compiled from source again
+	GLint linkStatus;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+/// <summary>
+/// Writes the binary of a linked program to the cache.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="program">Linked program</param>
+/// <param name="key">Cache key of the program</param>
+static void SaveProgramBinary(const ShaderCache& cache, GLuint program, uint64_t key)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (cache.directory.empty() || length <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(length);
+	ProgramBinaryHeader header = {};
+	GLenum binaryFormat;
+	glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+	std::memcpy(header.magic, ProgramBinaryMagic, sizeof(header.magic));
+	header.binaryFormat = binaryFormat;
+	header.length = static_cast<uint32_t>(length);
+	header.key = key;
+
+	// Write to a temporary file first, so that another instance never reads half a binary
+	std::string filePath = GetProgramBinaryPath(cache, key);
+	std::string temporaryFilePath = filePath + ".tmp";
+	FILE* file = std::fopen(temporaryFilePath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		return;
+	}
+	std::fwrite(&header, sizeof(header), 1, file);
+	std::fwrite(binary.data(), 1, header.length, file);
+	bool written = std::ferror(file) == 0;
+	std::fclose(file);
+
+	std::remove(filePath.c_str());
+	if (!written || std::rename(temporaryFilePath.c_str(), filePath.c_str()) != 0)
+	{
+		std::remove(temporaryFilePath.c_str());
+	}
+}
+
+/// <summary>
+/// Checks whether a pending program has been linked, and prints the errors if it failed.
+/// Waits for the driver if it is still compiling.
+/// </summary>
+/// <param name="shaderProgram">Shader program</param>
+/// <returns>True if the pending program linked, false otherwise</returns>
+static bool CheckPendingProgram(ShaderProgram& shaderProgram)
+{
+	GLint linkStatus;
+	glGetProgramiv(shaderProgram.pendingProgram, GL_LINK_STATUS, &linkStatus);
+
+	if (linkStatus != GL_TRUE)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			GLint compileStatus = GL_TRUE;
+			if (shaderProgram.pendingShaders[i] != 0)
+			{
+				glGetShaderiv(shaderProgram.pendingShaders[i], GL_COMPILE_STATUS, &compileStatus);
+			}
+			if (compileStatus == GL_FALSE)
+			{
+				char infoLog[512];
+				GLsizei infoLogLen = sizeof(infoLog);
+				glGetShaderInfoLog(shaderProgram.pendingShaders[i], infoLogLen, &infoLogLen, infoLog);
+				std::cerr << (i == 0 ? shaderProgram.vertexShaderFilePath : shaderProgram.fragmentShaderFilePath)
+					<< ": shader compilation error: " << infoLog << std::endl;
+			}
+		}
+
+		char infoLog[512];
+		GLsizei infoLogLen = sizeof(infoLog);
+		glGetProgramInfoLog(shaderProgram.pendingProgram, infoLogLen, &infoLogLen, infoLog);
+		std::cerr << "program link error: " << infoLog << std::endl;
+	}
+
+	for (GLuint& shader : shaderProgram.pendingShaders)
+	{
+		if (shader != 0)
+		{
+			glDetachShader(shaderProgram.pendingProgram, shader);
+			glDeleteShader(shader);
+			shader = 0;
+		}
+	}
+
+	return linkStatus == GL_TRUE;
+}
+
+/// <summary>
+/// Makes the pending program the current one, or throws it away if it failed to link.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <returns>True if the pending program became the current one, false otherwise</returns>
+static bool CompletePendingProgram(ShaderCache& cache, ShaderProgram& shaderProgram)
+{
+	bool compiledFromSource = shaderProgram.pendingShaders[0] != 0;
+	if (!CheckPendingProgram(shaderProgram))
+	{
+		glDeleteProgram(shaderProgram.pendingProgram);
+		shaderProgram.pendingProgram = 0;
+		return false;
+	}
+
+	if (compiledFromSource)
+	{
+		SaveProgramBinary(cache, shaderProgram.pendingProgram, shaderProgram.pendingKey);
+	}
+
+	glDeleteProgram(shaderProgram.program);
+	shaderProgram.program = shaderProgram.pendingProgram;
+	shaderProgram.pendingProgram = 0;
+	return true;
+}
+
+/// <summary>
+/// Sets up the program cache for the current context and turns on background shader compilation when the driver has it.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="directory">Directory for the cached program binaries (created if needed; empty disables the cache)</param>
+void CreateShaderCache(ShaderCache& cache, const std::string& directory)
+{
+	// Binaries need ARB_get_program_binary (core in 4.1) and at least one binary format
+	GLint binaryFormatCount = 0;
+	if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+	}
+
+	cache.directory = binaryFormatCount > 0 ? directory : std::string();
+	if (!cache.directory.empty())
+	{
+#if defined(_WIN32)
+		_mkdir(cache.directory.c_str());
+#else
+		mkdir(cache.directory.c_str(), 0755);
+#endif
+	}
+
+	cache.driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|" + reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+	// Let the driver use as many compiler threads as it wants
+	if (GLAD_GL_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		cache.parallelCompile = true;
+	}
+	else if (GLAD_GL_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		cache.parallelCompile = true;
+	}
+}
+
+/// <summary>
+/// Reads a whole text file in one go.
+/// </summary>
+/// <param name="filePath">Path of the file</param>
+/// <param name="contents">Receives the contents of the file</param>
+/// <returns>True if the file was read, false otherwise</returns>
+bool ReadTextFile(const std::string& filePath, std::string& contents)
+{
+	std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+	if (file.fail())
+	{
+		return false;
+	}
+
+	std::streamoff size = file.tellg();
+	contents.resize(static_cast<size_t>(size));
+	file.seekg(0);
+	file.read(&contents[0], size);
+	return !file.fail();
+}
+
+/// <summary>
+/// Starts building a shader program. If the cache has a binary for the same sources, defines and driver,
+/// the program is restored from it; otherwise compiling and linking is started, which runs in the
+/// background on drivers with parallel shader compilation. Finish with FinishShaderProgram().
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <param name="vertexShaderFilePath">Vertex shader file path (compute shader file path when there is no fragment shader)</param>
+/// <param name="fragmentShaderFilePath">Fragment shader file path, empty for a compute program</param>
+/// <param name="defines">Preprocessor lines to insert after the #version line</param>
+void BeginShaderProgram(ShaderCache& cache, ShaderProgram& shaderProgram, const std::string& vertexShaderFilePath,
+	const std::string& fragmentShaderFilePath, const std::string& defines)
+{
+	shaderProgram.vertexShaderFilePath = vertexShaderFilePath;
+	shaderProgram.fragmentShaderFilePath = fragmentShaderFilePath;
+	shaderProgram.defines = defines;
+	shaderProgram.vertexShaderModified = GetFileModificationTime(vertexShaderFilePath);
+	shaderProgram.fragmentShaderModified = GetFileModificationTime(fragmentShaderFilePath);
+	bool compute = fragmentShaderFilePath.empty();
+
+	std::string vertexShaderSource, fragmentShaderSource;
+	if (!ReadTextFile(vertexShaderFilePath, vertexShaderSource))
+	{
+		std::cerr << "Unable to open shader file: " << vertexShaderFilePath << std::endl;
+		return;
+	}
+	if (!compute && !ReadTextFile(fragmentShaderFilePath, fragmentShaderSource))
+	{
+		std::cerr << "Unable to open shader file: " << fragmentShaderFilePath << std::endl;
+		return;
+	}
+
+	vertexShaderSource = InsertDefines(vertexShaderSource, defines);
+	fragmentShaderSource = InsertDefines(fragmentShaderSource, defines);
+
+	uint64_t key = 14695981039346656037ull;
+	key = HashText(key, vertexShaderSource);
+	key = HashText(key, fragmentShaderSource);
+	key = HashText(key, cache.driver);
+	shaderProgram.pendingKey = key;
+
+	shaderProgram.pendingProgram = LoadProgramBinary(cache, key);
+	if (shaderProgram.pendingProgram != 0)
+	{
+		cache.hits++;
+		return;
+	}
+	cache.misses++;
+
+	// The statuses are only checked once the program is needed, so that the driver can compile in the meantime
+	shaderProgram.pendingProgram = glCreateProgram();
+	if (compute)
+	{
+		shaderProgram.pendingShaders[0] = CreateShaderFromSource(GL_COMPUTE_SHADER, vertexShaderSource);
+		glAttachShader(shaderProgram.pendingProgram, shaderProgram.pendingShaders[0]);
+	}
+	else
+	{
+		shaderProgram.pendingShaders[0] = CreateShaderFromSource(GL_VERTEX_SHADER, vertexShaderSource);
+		shaderProgram.pendingShaders[1] = CreateShaderFromSource(GL_FRAGMENT_SHADER, fragmentShaderSource);
+		glAttachShader(shaderProgram.pendingProgram, shaderProgram.pendingShaders[0]);
+		glAttachShader(shaderProgram.pendingProgram, shaderProgram.pendingShaders[1]);
+	}
+	if (!cache.directory.empty())
+	{
+		glProgramParameteri(shaderProgram.pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(shaderProgram.pendingProgram);
+}
+
+/// <summary>
+/// Starts building a compute program from a single compute shader file, the same way as BeginShaderProgram().
+/// Finish with FinishShaderProgram().
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <param name="computeShaderFilePath">Compute shader file path</param>
+/// <param name="defines">Preprocessor lines to insert after the #version line</param>
+void BeginComputeProgram(ShaderCache& cache, ShaderProgram& shaderProgram, const std::string& computeShaderFilePath, const std::string& defines)
+{
+	BeginShaderProgram(cache, shaderProgram, computeShaderFilePath, "", defines);
+}
+
+/// <summary>
+/// Waits for a program started with BeginShaderProgram() or BeginComputeProgram() and makes it the current program.
+/// Programs that were compiled from source are written to the cache.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <returns>True if the program linked, false otherwise (the errors are printed)</returns>
+bool FinishShaderProgram(ShaderCache& cache, ShaderProgram& shaderProgram)
+{
+	if (shaderProgram.pendingProgram == 0)
+	{
+		return false;
+	}
+
+	return CompletePendingProgram(cache, shaderProgram);
+}
+
+/// <summary>
+/// Hot reload: starts rebuilding the program when one of its files has changed, and swaps the new program in
+/// once the driver has finished it. Never waits for the compiler when the driver compiles in the background.
+/// A program that fails to build is reported and the old one is kept.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <returns>True if a new program was swapped in (its uniforms have to be resolved again), false otherwise</returns>
+bool UpdateShaderProgram(ShaderCache& cache, ShaderProgram& shaderProgram)
+{
+	if (shaderProgram.pendingProgram == 0)
+	{
+		if (GetFileModificationTime(shaderProgram.vertexShaderFilePath) == shaderProgram.vertexShaderModified
+			&& GetFileModificationTime(shaderProgram.fragmentShaderFilePath) == shaderProgram.fragmentShaderModified)
+		{
+			return false;
+		}
+
+		std::cout << "Reloading " << shaderProgram.vertexShaderFilePath;
+		if (!shaderProgram.fragmentShaderFilePath.empty())
+		{
+			std::cout << " and " << shaderProgram.fragmentShaderFilePath;
+		}
+		std::cout << std::endl;
+		BeginShaderProgram(cache, shaderProgram, shaderProgram.vertexShaderFilePath, shaderProgram.fragmentShaderFilePath, shaderProgram.defines);
+		if (shaderProgram.pendingProgram == 0)
+		{
+			return false;
+		}
+	}
+
+	// Without parallel compilation, the status query below is where the driver does the work
+	if (cache.parallelCompile)
+	{
+		GLint completed = GL_FALSE;
+		glGetProgramiv(shaderProgram.pendingProgram, GL_COMPLETION_STATUS_KHR, &completed);
+		if (completed != GL_TRUE)
+		{
+			return false;
+		}
+	}
+
+	return CompletePendingProgram(cache, shaderProgram);
+}
+
+/// <summary>
+/// Deletes the program and any program that is still being built.
+/// </summary>
+/// <param name="shaderProgram">Shader program</param>
+void DeleteShaderProgram(ShaderProgram& shaderProgram)
+{
+	for (GLuint shader : shaderProgram.pendingShaders)
+	{
+		glDeleteShader(shader);
+	}
+	glDeleteProgram(shaderProgram.pendingProgram);
+	glDeleteProgram(shaderProgram.program);
+	shaderProgram = ShaderProgram();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// Struct containing the settings of the on-disk cache of linked shader programs
+/// </summary>
+struct ShaderCache
+{
+	std::string directory;				// Directory with the cached program binaries (empty disables the cache)
+	std::string driver;					// Vendor, renderer and version string; binaries only work on the driver that made them
+	bool parallelCompile = false;		// Whether the driver compiles in the background (KHR/ARB_parallel_shader_compile)
+	int hits = 0;						// Programs restored from the cache
+	int misses = 0;						// Programs compiled from source
+};
+
+/// <summary>
+/// Struct containing a shader program built from a vertex and a fragment shader file (or from a single
+/// compute shader file, see BeginComputeProgram()), plus the state needed to rebuild it when the files change
+/// </summary>
+struct ShaderProgram
+{
+	GLuint program = 0;
+	std::string vertexShaderFilePath;		// Compute shader file of compute programs
+	std::string fragmentShaderFilePath;		// Empty for compute programs
+	std::string defines;				// Preprocessor lines that are inserted after the #version line
+
+	GLuint pendingProgram = 0;			// Program that is still being compiled and linked
+	GLuint pendingShaders[2] = {};		// Shaders of the pending program (0 when it was restored from the cache)
+	uint64_t pendingKey = 0;			// Cache key of the pending program
+	long long vertexShaderModified = 0;		// Modification times of the shader files when they were last read
+	long long fragmentShaderModified = 0;
+};
+
+/// <summary>
+/// Sets up the program cache for the current context and turns on background shader compilation when the driver has it.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="directory">Directory for the cached program binaries (created if needed; empty disables the cache)</param>
+void CreateShaderCache(ShaderCache& cache, const std::string& directory);
+
+/// <summary>
+/// Reads a whole text file in one go.
+/// </summary>
+/// <param name="filePath">Path of the file</param>
+/// <param name="contents">Receives the contents of the file</param>
+/// <returns>True if the file was read, false otherwise</returns>
+bool ReadTextFile(const std::string& filePath, std::string& contents);
+
+/// <summary>
+/// Starts building a shader program. If the cache has a binary for the same sources, defines and driver,
+/// the program is restored from it; otherwise compiling and linking is started, which runs in the
+/// background on drivers with parallel shader compilation. Finish with FinishShaderProgram().
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <param name="vertexShaderFilePath">Vertex shader file path</param>
+/// <param name="fragmentShaderFilePath">Fragment shader file path</param>
+/// <param name="defines">Preprocessor lines to insert after the #version line</param>
+void BeginShaderProgram(ShaderCache& cache, ShaderProgram& shaderProgram, const std::string& vertexShaderFilePath,
+	const std::string& fragmentShaderFilePath, const std::string& defines = "");
+
+/// <summary>
+/// Starts building a compute program from a single compute shader file, the same way as BeginShaderProgram().
+/// Finish with FinishShaderProgram().
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <param name="computeShaderFilePath">Compute shader file path</param>
+/// <param name="defines">Preprocessor lines to insert after the #version line</param>
+void BeginComputeProgram(ShaderCache& cache, ShaderProgram& shaderProgram, const std::string& computeShaderFilePath, const std::string& defines = "");
+
+/// <summary>
+/// Waits for a program started with BeginShaderProgram() or BeginComputeProgram() and makes it the current program.
+/// Programs that were compiled from source are written to the cache.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <returns>True if the program linked, false otherwise (the errors are printed)</returns>
+bool FinishShaderProgram(ShaderCache& cache, ShaderProgram& shaderProgram);
+
+/// <summary>
+/// Hot reload: starts rebuilding the program when one of its files has changed, and swaps the new program in
+/// once the driver has finished it. Never waits for the compiler when the driver compiles in the background.
+/// A program that fails to build is reported and the old one is kept.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="shaderProgram">Shader program</param>
+/// <returns>True if a new program was swapped in (its uniforms have to be resolved again), false otherwise</returns>
+bool UpdateShaderProgram(ShaderCache& cache, ShaderProgram& shaderProgram);
+
+/// <summary>
+/// Deletes the program and any program that is still being built.
+/// </summary>
+/// <param name="shaderProgram">Shader program</param>
+void DeleteShaderProgram(ShaderProgram& shaderProgram);
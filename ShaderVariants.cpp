@@ -0,0 +1,174 @@
+#include "ShaderVariants.h"
+
+/// <summary>
+/// Preprocessor names of the features, in the order of their ShaderFeature bits
+/// </summary>
+static const char* const ShaderFeatureNames[] = { "TEXTURED", "DIFFUSE", "FOG", "INSTANCED" };
+
+/// <summary>
+/// Sets the shader files of a variant set. No variant is built yet.
+/// </summary>
+/// <param name="set">Variant set</param>
+/// <param name="vertexShaderFilePath">Vertex shader file path</param>
+/// <param name="fragmentShaderFilePath">Fragment shader file path</param>
+void CreateShaderVariantSet(ShaderVariantSet& set, const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath)
+{
+	set.vertexShaderFilePath = vertexShaderFilePath;
+	set.fragmentShaderFilePath = fragmentShaderFilePath;
+}
+
+/// <summary>
+/// Builds the preprocessor lines that switch on the given features.
+/// </summary>
+/// <param name="features">ShaderFeature flags</param>
+/// <returns>One #define line per feature</returns>
+std::string GetShaderFeatureDefines(unsigned int features)
+{
+	std::string defines;
+	for (int bit = 0; (1u << bit) < ShaderVariantCount; ++bit)
+	{
+		if ((features & (1u << bit)) != 0)
+		{
+			defines += std::string("#define ") + ShaderFeatureNames[bit] + "\n";
+		}
+	}
+	return defines;
+}
+
+/// <summary>
+/// Picks the cheapest features that draw an object of a material with a mesh correctly. Meshes without normals
+/// get no diffuse light, since the diffuse term of a zero normal is zero anyway.
+/// </summary>
+/// <param name="material">Material of the object</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="mesh">Mesh of the object</param>
+/// <returns>ShaderFeature flags, without ShaderFeatureInstanced</returns>
+unsigned int SelectShaderFeatures(const SceneMaterial& material, const MeshBuffers& meshBuffers, MeshType mesh)
+{
+	unsigned int features = 0;
+	features |= material.filePath.empty() ? 0 : ShaderFeatureTextured;
+	features |= material.lit && meshBuffers.hasNormals[mesh] ? ShaderFeatureDiffuse : 0;
+	features |= material.fog ? ShaderFeatureFog : 0;
+	return features;
+}
+
+/// <summary>
+/// Picks the features that draw a range of scene objects with a single variant: every feature that one of them needs.
+/// </summary>
+/// <param name="scene">Scene objects</param>
+/// <param name="first">Index of the first object</param>
+/// <param name="count">Number of objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <returns>ShaderFeature flags, without ShaderFeatureInstanced</returns>
+unsigned int SelectShaderFeatures(const std::vector<SceneObject>& scene, size_t first, size_t count,
+	const std::vector<SceneMaterial>& materials, const MeshBuffers& meshBuffers)
+{
+	unsigned int features = 0;
+	for (size_t i = first; i < first + count; ++i)
+	{
+		features |= SelectShaderFeatures(materials[scene[i].material], meshBuffers, scene[i].mesh);
+	}
+	return features;
+}
+
+/// <summary>
+/// Starts building a variant unless that has already happened, so several variants can compile side by side.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+/// <param name="features">ShaderFeature flags of the variant</param>
+void RequestShaderVariant(ShaderCache& cache, ShaderVariantSet& set, unsigned int features)
+{
+	ShaderVariant& variant = set.variants[features];
+	if (!variant.requested)
+	{
+		BeginShaderProgram(cache, variant.shader, set.vertexShaderFilePath, set.fragmentShaderFilePath, GetShaderFeatureDefines(features));
+		variant.requested = true;
+	}
+}
+
+/// <summary>
+/// Waits for every variant that was requested but not finished yet.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+/// <returns>Number of variants that failed to link</returns>
+int FinishShaderVariants(ShaderCache& cache, ShaderVariantSet& set)
+{
+	int failed = 0;
+	for (ShaderVariant& variant : set.variants)
+	{
+		if (variant.requested && !variant.finished)
+		{
+			failed += FinishShaderProgram(cache, variant.shader) ? 0 : 1;
+			ResolveProgramUniforms(variant.uniforms, variant.shader.program);
+			variant.finished = true;
+		}
+	}
+	return failed;
+}
+
+/// <summary>
+/// Gets a variant, building it first if it was never requested.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+/// <param name="features">ShaderFeature flags of the variant</param>
+/// <returns>Variant (its program is 0 if it failed to link)</returns>
+const ShaderVariant& GetShaderVariant(ShaderCache& cache, ShaderVariantSet& set, unsigned int features)
+{
+	ShaderVariant& variant = set.variants[features];
+	if (!variant.finished)
+	{
+		RequestShaderVariant(cache, set, features);
+		FinishShaderProgram(cache, variant.shader);
+		ResolveProgramUniforms(variant.uniforms, variant.shader.program);
+		variant.finished = true;
+	}
+	return variant;
+}
+
+/// <summary>
+/// Hot reload: rebuilds the variants that have been built when the shader files change, see UpdateShaderProgram().
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+void UpdateShaderVariants(ShaderCache& cache, ShaderVariantSet& set)
+{
+	for (ShaderVariant& variant : set.variants)
+	{
+		if (variant.finished && UpdateShaderProgram(cache, variant.shader))
+		{
+			ResolveProgramUniforms(variant.uniforms, variant.shader.program);
+		}
+	}
+}
+
+/// <summary>
+/// Counts the variants that have been built.
+/// </summary>
+/// <param name="set">Variant set</param>
+/// <returns>Number of variants</returns>
+int CountShaderVariants(const ShaderVariantSet& set)
+{
+	int count = 0;
+	for (const ShaderVariant& variant : set.variants)
+	{
+		count += variant.requested ? 1 : 0;
+	}
+	return count;
+}
+
+/// <summary>
+/// Deletes every variant.
+/// </summary>
+/// <param name="set">Variant set</param>
+void DeleteShaderVariantSet(ShaderVariantSet& set)
+{
+	for (ShaderVariant& variant : set.variants)
+	{
+		DeleteShaderProgram(variant.shader);
+	}
+	set = ShaderVariantSet();
+}
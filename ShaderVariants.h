@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "Scene.h"
+#include "ShaderProgram.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Features of the scene shaders. Every combination is a variant of main.vsh and main.fsh that is compiled with
+/// one #define per feature it has, so the work of a missing feature is left out of the shader entirely.
+/// </summary>
+enum ShaderFeature
+{
+	ShaderFeatureTextured = 1,		// TEXTURED: sample the material texture instead of using the vertex color
+	ShaderFeatureDiffuse = 2,		// DIFFUSE: diffuse light and shadows of the main light
+	ShaderFeatureFog = 4,			// FOG: multiply by the fog color
+	ShaderFeatureInstanced = 8,		// INSTANCED: model matrix and material from the instance data
+	ShaderVariantCount = 16
+};
+
+/// <summary>
+/// Struct containing one variant of a shader and the locations of its uniforms
+/// </summary>
+struct ShaderVariant
+{
+	ShaderProgram shader;
+	ProgramUniforms uniforms;
+	bool requested = false;			// Whether building the variant has started
+	bool finished = false;			// Whether the variant has been waited for (its program is 0 if it failed to link)
+};
+
+/// <summary>
+/// Struct containing the variants of a vertex and fragment shader pair. Variants are only built once something asks
+/// for them, and each one is built once; the shader cache keeps the binaries between runs.
+/// </summary>
+struct ShaderVariantSet
+{
+	std::string vertexShaderFilePath;
+	std::string fragmentShaderFilePath;
+	ShaderVariant variants[ShaderVariantCount];
+};
+
+/// <summary>
+/// Sets the shader files of a variant set. No variant is built yet.
+/// </summary>
+/// <param name="set">Variant set</param>
+/// <param name="vertexShaderFilePath">Vertex shader file path</param>
+/// <param name="fragmentShaderFilePath">Fragment shader file path</param>
+void CreateShaderVariantSet(ShaderVariantSet& set, const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath);
+
+/// <summary>
+/// Builds the preprocessor lines that switch on the given features.
+/// </summary>
+/// <param name="features">ShaderFeature flags</param>
+/// <returns>One #define line per feature</returns>
+std::string GetShaderFeatureDefines(unsigned int features);
+
+/// <summary>
+/// Picks the cheapest features that draw an object of a material with a mesh correctly. Meshes without normals
+/// get no diffuse light, since the diffuse term of a zero normal is zero anyway.
+/// </summary>
+/// <param name="material">Material of the object</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="mesh">Mesh of the object</param>
+/// <returns>ShaderFeature flags, without ShaderFeatureInstanced</returns>
+unsigned int SelectShaderFeatures(const SceneMaterial& material, const MeshBuffers& meshBuffers, MeshType mesh);
+
+/// <summary>
+/// Picks the features that draw a range of scene objects with a single variant: every feature that one of them needs.
+/// </summary>
+/// <param name="scene">Scene objects</param>
+/// <param name="first">Index of the first object</param>
+/// <param name="count">Number of objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <returns>ShaderFeature flags, without ShaderFeatureInstanced</returns>
+unsigned int SelectShaderFeatures(const std::vector<SceneObject>& scene, size_t first, size_t count,
+	const std::vector<SceneMaterial>& materials, const MeshBuffers& meshBuffers);
+
+/// <summary>
+/// Starts building a variant unless that has already happened, so several variants can compile side by side.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+/// <param name="features">ShaderFeature flags of the variant</param>
+void RequestShaderVariant(ShaderCache& cache, ShaderVariantSet& set, unsigned int features);
+
+/// <summary>
+/// Waits for every variant that was requested but not finished yet.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+/// <returns>Number of variants that failed to link</returns>
+int FinishShaderVariants(ShaderCache& cache, ShaderVariantSet& set);
+
+/// <summary>
+/// Gets a variant, building it first if it was never requested.
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+/// <param name="features">ShaderFeature flags of the variant</param>
+/// <returns>Variant (its program is 0 if it failed to link)</returns>
+const ShaderVariant& GetShaderVariant(ShaderCache& cache, ShaderVariantSet& set, unsigned int features);
+
+/// <summary>
+/// Hot reload: rebuilds the variants that have been built when the shader files change, see UpdateShaderProgram().
+/// </summary>
+/// <param name="cache">Shader cache</param>
+/// <param name="set">Variant set</param>
+void UpdateShaderVariants(ShaderCache& cache, ShaderVariantSet& set);
+
+/// <summary>
+/// Counts the variants that have been built.
+/// </summary>
+/// <param name="set">Variant set</param>
+/// <returns>Number of variants</returns>
+int CountShaderVariants(const ShaderVariantSet& set);
+
+/// <summary>
+/// Deletes every variant.
+/// </summary>
+/// <param name="set">Variant set</param>
+void DeleteShaderVariantSet(ShaderVariantSet& set);
@@ -0,0 +1,370 @@
+#include "ShadowMap.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+/// <summary>
+/// Direction and up vector of the camera of every cube face, in the order of the GL_TEXTURE_CUBE_MAP_* targets
+/// </summary>
+static const glm::vec3 FaceDirections[ShadowFaceCount] =
+{
+	glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+	glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+};
+static const glm::vec3 FaceUps[ShadowFaceCount] =
+{
+	glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+	glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+};
+
+/// <summary>
+/// Distance of the near plane of the cube faces
+/// </summary>
+static const float ShadowNearPlane = 0.05f;
+
+/// <summary>
+/// Creates a cube map whose faces hold distances.
+/// </summary>
+/// <param name="size">Width and height of every face</param>
+/// <returns>OpenGL handle to the cube map</returns>
+static GLuint CreateShadowCubeMap(int size)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	for (int face = 0; face < ShadowFaceCount; ++face)
+	{
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT32F, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	return texture;
+}
+
+/// <summary>
+/// Creates the buffer texture of a caster list.
+/// </summary>
+/// <param name="buffer">Receives the buffer</param>
+/// <param name="texture">Receives the buffer texture</param>
+static void CreateCasterList(GLuint& buffer, GLuint& texture)
+{
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+/// <summary>
+/// Computes the view-projection matrix of a cube face.
+/// </summary>
+/// <param name="lightPosition">Position of the light</param>
+/// <param name="face">Cube face</param>
+/// <param name="distance">Distance that the shadow map covers</param>
+/// <returns>View-projection matrix</returns>
+static glm::mat4 GetFaceViewProjection(const glm::vec3& lightPosition, int face, float distance)
+{
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, ShadowNearPlane, distance);
+	return projection * glm::lookAt(lightPosition, lightPosition + FaceDirections[face], FaceUps[face]);
+}
+
+/// <summary>
+/// Builds the caster lists of a pass: for every cube face and mesh, the given objects that reach the face.
+/// Objects whose bounds contain the light are left out.
+/// </summary>
+/// <param name="shadowMap">Shadow map whose casters vector receives the lists</param>
+/// <param name="lightPosition">Position of the light</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="objects">Objects that take part in the pass</param>
+/// <param name="batches">Receives one batch per face and mesh with any casters</param>
+static void BuildCasterLists(ShadowMap& shadowMap, const glm::vec3& lightPosition, const std::vector<SceneObject>& scene,
+	const MeshBuffers& meshBuffers, const TransformStore& transforms, const std::vector<uint32_t>& objects, std::vector<ShadowCasterBatch>& batches)
+{
+	shadowMap.casters.clear();
+	batches.clear();
+
+	std::vector<BoundingBox> bounds;
+	std::vector<uint32_t> candidates;
+	for (uint32_t object : objects)
+	{
+		BoundingBox box = ComputeObjectBounds(scene[object], meshBuffers, transforms.modelMatrices[object]);
+		bool containsLight = lightPosition.x >= box.min.x && lightPosition.y >= box.min.y && lightPosition.z >= box.min.z
+			&& lightPosition.x <= box.max.x && lightPosition.y <= box.max.y && lightPosition.z <= box.max.z;
+		if (!containsLight)
+		{
+			bounds.push_back(box);
+			candidates.push_back(object);
+		}
+	}
+
+	for (int face = 0; face < ShadowFaceCount; ++face)
+	{
+		Frustum frustum = ExtractFrustum(GetFaceViewProjection(lightPosition, face, shadowMap.distance));
+		for (int mesh = 0; mesh < MeshTypeCount; ++mesh)
+		{
+			ShadowCasterBatch batch = { face, static_cast<MeshType>(mesh), static_cast<GLint>(shadowMap.casters.size()), 0 };
+			for (size_t i = 0; i < candidates.size(); ++i)
+			{
+				if (scene[candidates[i]].mesh == mesh && IntersectsFrustum(bounds[i], frustum))
+				{
+					shadowMap.casters.push_back(candidates[i]);
+					++batch.casterCount;
+				}
+			}
+			if (batch.casterCount > 0)
+			{
+				batches.push_back(batch);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Uploads the caster lists that BuildCasterLists() built.
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+/// <param name="buffer">Buffer of the caster list buffer texture</param>
+static void UploadCasterLists(const ShadowMap& shadowMap, GLuint buffer)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, shadowMap.casters.size() * sizeof(GLuint), shadowMap.casters.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/// <summary>
+/// Clears cube faces of a shadow map and draws their casters into them.
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+/// <param name="state">State cache</param>
+/// <param name="texture">Cube map to draw into</param>
+/// <param name="size">Width and height of its faces</param>
+/// <param name="casterTexture">Buffer texture with the caster lists</param>
+/// <param name="batches">Draws of the pass</param>
+/// <param name="faces">Faces to clear and draw</param>
+/// <param name="lightPosition">Position of the light</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="vertexArray">Vertex array object with the mesh attributes</param>
+static void DrawShadowPass(ShadowMap& shadowMap, RenderState& state, GLuint texture, int size, GLuint casterTexture,
+	const std::vector<ShadowCasterBatch>& batches, const bool faces[ShadowFaceCount], const glm::vec3& lightPosition,
+	const MeshBuffers& meshBuffers, GLuint vertexArray)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.framebuffer);
+	glViewport(0, 0, size, size);
+
+	UseProgramCached(state, shadowMap.program.program);
+	BindVertexArrayCached(state, vertexArray);
+	BindTextureCached(state, ShadowCastersTextureUnit, GL_TEXTURE_BUFFER, casterTexture);
+	glUniform4f(shadowMap.uniforms.locations[UniformCasterLight], lightPosition.x, lightPosition.y, lightPosition.z, shadowMap.distance);
+
+	for (int face = 0; face < ShadowFaceCount; ++face)
+	{
+		if (!faces[face])
+		{
+			continue;
+		}
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, texture, 0);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		glm::mat4 faceViewProjection = GetFaceViewProjection(lightPosition, face, shadowMap.distance);
+		glUniformMatrix4fv(shadowMap.uniforms.locations[UniformFaceViewProjection], 1, GL_FALSE, &faceViewProjection[0][0]);
+		for (const ShadowCasterBatch& batch : batches)
+		{
+			if (batch.face == face)
+			{
+				// Casters keep their finest level, since the cached cube map does not know where the camera is
+				glUniform1i(shadowMap.uniforms.locations[UniformFirstCaster], batch.firstCaster);
+				DrawMeshInstanced(meshBuffers, batch.mesh, 0, batch.casterCount);
+				++state.drawCalls;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Creates the cube maps, the framebuffer and the caster lists, and starts building the shadow program.
+/// </summary>
+/// <param name="shadowMap">Shadow map that will be created</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="staticSize">Width and height of the faces of the static cube map</param>
+/// <param name="dynamicSize">Width and height of the faces of the dynamic cube map</param>
+/// <param name="distance">Distance from the light that the shadow maps cover</param>
+/// <returns>True if the shadow program linked, false otherwise</returns>
+bool CreateShadowMap(ShadowMap& shadowMap, ShaderCache& shaderCache, int staticSize, int dynamicSize, float distance)
+{
+	BeginShaderProgram(shaderCache, shadowMap.program, "shadow.vsh", "shadow.fsh");
+	if (!FinishShaderProgram(shaderCache, shadowMap.program))
+	{
+		return false;
+	}
+	ResolveProgramUniforms(shadowMap.uniforms, shadowMap.program.program);
+
+	shadowMap.staticSize = staticSize;
+	shadowMap.dynamicSize = dynamicSize;
+	shadowMap.distance = distance;
+	shadowMap.staticTexture = CreateShadowCubeMap(staticSize);
+	shadowMap.dynamicTexture = CreateShadowCubeMap(dynamicSize);
+	CreateCasterList(shadowMap.staticCasterBuffer, shadowMap.staticCasterTexture);
+	CreateCasterList(shadowMap.dynamicCasterBuffer, shadowMap.dynamicCasterTexture);
+
+	// Only depth is written, so the framebuffer has no color buffer
+	GLint previousFramebuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &shadowMap.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.framebuffer);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	// Faces of the dynamic cube map are only cleared once casters reach them, so they all start out empty
+	for (int face = 0; face < ShadowFaceCount; ++face)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, shadowMap.dynamicTexture, 0);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	shadowMap.staticValid = false;
+	return true;
+}
+
+/// <summary>
+/// Throws away the static cube map, so it is redrawn in the next UpdateShadowMap().
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+void InvalidateShadowMap(ShadowMap& shadowMap)
+{
+	shadowMap.staticValid = false;
+}
+
+/// <summary>
+/// Redraws the static cube map if the light moved or a static object changed in the last UpdateTransforms(),
+/// and draws the animated objects into the dynamic cube map. The instance data of every object must be current.
+/// Leaves the previously bound framebuffer and viewport in place and fills in the shadow part of the per-frame data.
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+/// <param name="state">State cache</param>
+/// <param name="lightPosition">World-space position of the light</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="vertexArray">Vertex array object with the mesh attributes</param>
+/// <param name="frame">Per-frame data</param>
+void UpdateShadowMap(ShadowMap& shadowMap, RenderState& state, const glm::vec3& lightPosition, const std::vector<SceneObject>& scene,
+	const MeshBuffers& meshBuffers, const TransformStore& transforms, GLuint vertexArray, FrameUniforms& frame)
+{
+	if (lightPosition != shadowMap.lightPosition)
+	{
+		InvalidateShadowMap(shadowMap);
+	}
+	for (uint32_t object : transforms.updatedObjects)
+	{
+		if (!IsDynamic(scene[object]))
+		{
+			InvalidateShadowMap(shadowMap);
+			break;
+		}
+	}
+
+	GLint previousFramebuffer;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	bool drew = false;
+
+	// The static objects only need to be drawn again when something about them changed
+	if (!shadowMap.staticValid)
+	{
+		std::vector<uint32_t> staticObjects;
+		for (uint32_t object = 0; object < scene.size(); ++object)
+		{
+			if (!IsDynamic(scene[object]))
+			{
+				staticObjects.push_back(object);
+			}
+		}
+		BuildCasterLists(shadowMap, lightPosition, scene, meshBuffers, transforms, staticObjects, shadowMap.staticBatches);
+		UploadCasterLists(shadowMap, shadowMap.staticCasterBuffer);
+
+		static const bool allFaces[ShadowFaceCount] = { true, true, true, true, true, true };
+		DrawShadowPass(shadowMap, state, shadowMap.staticTexture, shadowMap.staticSize, shadowMap.staticCasterTexture,
+			shadowMap.staticBatches, allFaces, lightPosition, meshBuffers, vertexArray);
+
+		shadowMap.staticValid = true;
+		shadowMap.lightPosition = lightPosition;
+		++shadowMap.staticPasses;
+		drew = true;
+	}
+
+	// The animated objects are drawn every frame, but only into the faces they reach (and the faces they just left)
+	BuildCasterLists(shadowMap, lightPosition, scene, meshBuffers, transforms, transforms.dynamicObjects, shadowMap.dynamicBatches);
+	bool faceUsed[ShadowFaceCount] = {};
+	for (const ShadowCasterBatch& batch : shadowMap.dynamicBatches)
+	{
+		faceUsed[batch.face] = true;
+	}
+
+	bool faces[ShadowFaceCount];
+	bool anyFace = false;
+	bool anyCasters = false;
+	for (int face = 0; face < ShadowFaceCount; ++face)
+	{
+		faces[face] = faceUsed[face] || shadowMap.dynamicFaceUsed[face];
+		anyFace = anyFace || faces[face];
+		anyCasters = anyCasters || faceUsed[face];
+		shadowMap.dynamicFaceUsed[face] = faceUsed[face];
+		shadowMap.dynamicFacePasses += faces[face] ? 1 : 0;
+	}
+	if (anyFace)
+	{
+		UploadCasterLists(shadowMap, shadowMap.dynamicCasterBuffer);
+		DrawShadowPass(shadowMap, state, shadowMap.dynamicTexture, shadowMap.dynamicSize, shadowMap.dynamicCasterTexture,
+			shadowMap.dynamicBatches, faces, lightPosition, meshBuffers, vertexArray);
+		drew = true;
+	}
+
+	if (drew)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	}
+
+	frame.shadowLight = glm::vec4(lightPosition, shadowMap.distance);
+	frame.shadowParameters = glm::uvec4(1u, anyCasters ? 1u : 0u, 0u, 0u);
+}
+
+/// <summary>
+/// Binds the cube maps to their texture units.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="shadowMap">Shadow map</param>
+void BindShadowMap(RenderState& state, const ShadowMap& shadowMap)
+{
+	BindTextureCached(state, StaticShadowTextureUnit, GL_TEXTURE_CUBE_MAP, shadowMap.staticTexture);
+	BindTextureCached(state, DynamicShadowTextureUnit, GL_TEXTURE_CUBE_MAP, shadowMap.dynamicTexture);
+}
+
+/// <summary>
+/// Deletes the cube maps, the framebuffer, the caster lists and the shadow program.
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+void DeleteShadowMap(ShadowMap& shadowMap)
+{
+	DeleteShaderProgram(shadowMap.program);
+	glDeleteFramebuffers(1, &shadowMap.framebuffer);
+	glDeleteTextures(1, &shadowMap.staticTexture);
+	glDeleteTextures(1, &shadowMap.dynamicTexture);
+	glDeleteTextures(1, &shadowMap.staticCasterTexture);
+	glDeleteBuffers(1, &shadowMap.staticCasterBuffer);
+	glDeleteTextures(1, &shadowMap.dynamicCasterTexture);
+	glDeleteBuffers(1, &shadowMap.dynamicCasterBuffer);
+	shadowMap = ShadowMap();
+}
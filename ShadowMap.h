@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Culling.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "ShaderProgram.h"
+#include "Transforms.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Number of faces of a cube map
+/// </summary>
+const int ShadowFaceCount = 6;
+
+/// <summary>
+/// Struct containing one instanced draw of a shadow pass: the objects of one mesh that reach one cube face
+/// </summary>
+struct ShadowCasterBatch
+{
+	int face;
+	MeshType mesh;
+	GLint firstCaster;				// First entry of the caster list
+	GLsizei casterCount;
+};
+
+/// <summary>
+/// Struct containing the cube shadow map of the main light. The static objects are drawn into a cached cube map
+/// that is only redrawn when the light moves or a static object changes. The animated objects are drawn every
+/// frame into a small second cube map, and only into the faces they reach; the shaders take the nearer of the two.
+/// Objects whose bounds contain the light (its own fixture, like the bulb) cast no shadow.
+/// </summary>
+struct ShadowMap
+{
+	ShaderProgram program;					// shadow.vsh and shadow.fsh
+	ProgramUniforms uniforms;
+	GLuint framebuffer = 0;
+	GLuint staticTexture = 0;				// Cube map with the distances to the static objects
+	GLuint dynamicTexture = 0;				// Cube map with the distances to the animated objects
+	int staticSize = 0;
+	int dynamicSize = 0;
+	float distance = 0.0f;					// Distance from the light that the shadow maps cover
+
+	GLuint staticCasterBuffer = 0;			// Caster lists of the static pass (buffer texture)
+	GLuint staticCasterTexture = 0;
+	GLuint dynamicCasterBuffer = 0;			// Caster lists of the dynamic pass (buffer texture)
+	GLuint dynamicCasterTexture = 0;
+	std::vector<GLuint> casters;			// Caster lists being built, reused every frame
+	std::vector<ShadowCasterBatch> staticBatches;
+	std::vector<ShadowCasterBatch> dynamicBatches;
+	bool dynamicFaceUsed[ShadowFaceCount] = {};	// Dynamic faces that hold casters and must be cleared before reuse
+
+	bool staticValid = false;				// Whether the static cube map is up to date
+	glm::vec3 lightPosition = glm::vec3(0.0f);	// Light position the static cube map was drawn for
+
+	int64_t staticPasses = 0;				// Times the static cube map was drawn
+	int64_t dynamicFacePasses = 0;			// Dynamic cube faces that were drawn
+};
+
+/// <summary>
+/// Creates the cube maps, the framebuffer and the caster lists, and starts building the shadow program.
+/// </summary>
+/// <param name="shadowMap">Shadow map that will be created</param>
+/// <param name="shaderCache">Shader cache</param>
+/// <param name="staticSize">Width and height of the faces of the static cube map</param>
+/// <param name="dynamicSize">Width and height of the faces of the dynamic cube map</param>
+/// <param name="distance">Distance from the light that the shadow maps cover</param>
+/// <returns>True if the shadow program linked, false otherwise</returns>
+bool CreateShadowMap(ShadowMap& shadowMap, ShaderCache& shaderCache, int staticSize, int dynamicSize, float distance);
+
+/// <summary>
+/// Throws away the static cube map, so it is redrawn in the next UpdateShadowMap().
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+void InvalidateShadowMap(ShadowMap& shadowMap);
+
+/// <summary>
+/// Redraws the static cube map if the light moved or a static object changed in the last UpdateTransforms(),
+/// and draws the animated objects into the dynamic cube map. The instance data of every object must be current.
+/// Leaves the previously bound framebuffer and viewport in place and fills in the shadow part of the per-frame data.
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+/// <param name="state">State cache</param>
+/// <param name="lightPosition">World-space position of the light</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="meshBuffers">Buffers that contain the meshes</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="vertexArray">Vertex array object with the mesh attributes</param>
+/// <param name="frame">Per-frame data</param>
+void UpdateShadowMap(ShadowMap& shadowMap, RenderState& state, const glm::vec3& lightPosition, const std::vector<SceneObject>& scene,
+	const MeshBuffers& meshBuffers, const TransformStore& transforms, GLuint vertexArray, FrameUniforms& frame);
+
+/// <summary>
+/// Binds the cube maps to their texture units.
+/// </summary>
+/// <param name="state">State cache</param>
+/// <param name="shadowMap">Shadow map</param>
+void BindShadowMap(RenderState& state, const ShadowMap& shadowMap);
+
+/// <summary>
+/// Deletes the cube maps, the framebuffer, the caster lists and the shadow program.
+/// </summary>
+/// <param name="shadowMap">Shadow map</param>
+void DeleteShadowMap(ShadowMap& shadowMap);
@@ -0,0 +1,233 @@
+#include "Simulation.h"
+
+#include <algorithm>
+
+/// <summary>
+/// Flag on Simulation::middle that marks a snapshot the renderer has not picked up yet
+/// </summary>
+static const uint32_t SnapshotFresh = 4;
+
+/// <summary>
+/// Camera movement in units per second (the old per-frame step at 60 frames per second)
+/// </summary>
+static const float CameraSpeed = 0.06f;
+
+/// <summary>
+/// Change of the ambient strength per second (the old per-frame step at 60 frames per second)
+/// </summary>
+static const float AmbientSpeed = 1.2f;
+
+/// <summary>
+/// Advances the state by one step with the given keys held down.
+/// </summary>
+/// <param name="state">State that will be advanced</param>
+/// <param name="keys">SimulationKey bits</param>
+/// <param name="seconds">Length of the step</param>
+static void StepSimulationState(SimulationState& state, uint32_t keys, float seconds)
+{
+	float move = CameraSpeed * seconds;
+
+	if (keys & KeyMoveLeft)
+	{
+		state.cameraMoveLeftRight -= move;
+		state.cameraLookLeftRight -= move;
+	}
+	if (keys & KeyMoveRight)
+	{
+		state.cameraMoveLeftRight += move;
+		state.cameraLookLeftRight += move;
+	}
+	if (keys & KeyMoveForward)
+	{
+		state.cameraMoveForwardBackward -= move;
+		state.cameraLookForwardBackward -= move;
+	}
+	if (keys & KeyMoveBackward)
+	{
+		state.cameraMoveForwardBackward += move;
+		state.cameraLookForwardBackward += move;
+	}
+	if (keys & KeyLookUp)
+	{
+		state.cameraLookUpDown += move;
+	}
+	if (keys & KeyLookDown)
+	{
+		state.cameraLookUpDown -= move;
+	}
+	if (keys & KeyLookLeft)
+	{
+		state.cameraLookLeftRight -= move;
+	}
+	if (keys & KeyLookRight)
+	{
+		state.cameraLookLeftRight += move;
+	}
+	if (keys & KeyResetCamera)
+	{
+		state.cameraMoveForwardBackward = 1.0f;
+		state.cameraMoveLeftRight = 0.0f;
+		state.cameraLookUpDown = 0.0f;
+		state.cameraLookLeftRight = 0.0f;
+	}
+	if (keys & KeyAmbientDown)
+	{
+		state.ambientStrength = std::max(state.ambientStrength - AmbientSpeed * seconds, 0.0f);
+	}
+	if (keys & KeyAmbientUp)
+	{
+		state.ambientStrength = std::min(state.ambientStrength + AmbientSpeed * seconds, 1.0f);
+	}
+}
+
+/// <summary>
+/// Interpolates between two states.
+/// </summary>
+/// <param name="a">State at weight 0</param>
+/// <param name="b">State at weight 1</param>
+/// <param name="weight">Weight of b</param>
+/// <returns>Interpolated state</returns>
+static SimulationState InterpolateState(const SimulationState& a, const SimulationState& b, float weight)
+{
+	SimulationState result;
+	result.cameraMoveForwardBackward = a.cameraMoveForwardBackward + (b.cameraMoveForwardBackward - a.cameraMoveForwardBackward) * weight;
+	result.cameraMoveLeftRight = a.cameraMoveLeftRight + (b.cameraMoveLeftRight - a.cameraMoveLeftRight) * weight;
+	result.cameraLookUpDown = a.cameraLookUpDown + (b.cameraLookUpDown - a.cameraLookUpDown) * weight;
+	result.cameraLookLeftRight = a.cameraLookLeftRight + (b.cameraLookLeftRight - a.cameraLookLeftRight) * weight;
+	result.cameraLookForwardBackward = a.cameraLookForwardBackward + (b.cameraLookForwardBackward - a.cameraLookForwardBackward) * weight;
+	result.ambientStrength = a.ambientStrength + (b.ambientStrength - a.ambientStrength) * weight;
+	return result;
+}
+
+/// <summary>
+/// Writes the last two steps into the back slot and swaps it with the middle slot.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+static void PublishSnapshot(Simulation& simulation)
+{
+	SimulationSnapshot& snapshot = simulation.slots[simulation.back];
+	snapshot.previous = simulation.previous;
+	snapshot.current = simulation.state;
+	snapshot.currentTime = simulation.stepCount * simulation.stepSeconds;
+
+	simulation.back = simulation.middle.exchange(simulation.back | SnapshotFresh, std::memory_order_acq_rel) & ~SnapshotFresh;
+}
+
+/// <summary>
+/// Thread function of a threaded simulation. Sleeps until each step is due.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+static void RunSimulation(Simulation* simulation)
+{
+	while (simulation->running.load(std::memory_order_acquire))
+	{
+		AdvanceSimulation(*simulation, GetSimulationClock(*simulation));
+
+		std::chrono::duration<double> nextStep((simulation->stepCount + 1) * simulation->stepSeconds);
+		std::this_thread::sleep_until(simulation->start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(nextStep));
+	}
+}
+
+/// <summary>
+/// Starts the simulation clock. A threaded simulation takes its steps on a thread of its own; otherwise
+/// AdvanceSimulation() has to be called before every frame.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="stepRate">Number of steps per second</param>
+/// <param name="threaded">Take the steps on a separate thread</param>
+void StartSimulation(Simulation& simulation, double stepRate, bool threaded)
+{
+	simulation.stepSeconds = 1.0 / stepRate;
+	simulation.stepCount = 0;
+	simulation.previous = simulation.state;
+	for (SimulationSnapshot& snapshot : simulation.slots)
+	{
+		snapshot.previous = simulation.state;
+		snapshot.current = simulation.state;
+		snapshot.currentTime = 0.0;
+	}
+	simulation.start = std::chrono::steady_clock::now();
+
+	if (threaded)
+	{
+		simulation.running.store(true, std::memory_order_release);
+		simulation.thread = std::thread(RunSimulation, &simulation);
+	}
+}
+
+/// <summary>
+/// Stops the simulation thread, if there is one.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+void StopSimulation(Simulation& simulation)
+{
+	simulation.running.store(false, std::memory_order_release);
+	if (simulation.thread.joinable())
+	{
+		simulation.thread.join();
+	}
+}
+
+/// <summary>
+/// Gets the number of seconds since the simulation was started.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <returns>Seconds on the simulation clock</returns>
+double GetSimulationClock(const Simulation& simulation)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - simulation.start).count();
+}
+
+/// <summary>
+/// Sets the keys that are held down. Takes effect from the next step.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="keys">SimulationKey bits</param>
+void SetSimulationInput(Simulation& simulation, uint32_t keys)
+{
+	simulation.keys.store(keys, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Takes every step up to the given time and publishes the result. Only the simulation thread calls this
+/// when the simulation is threaded.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="seconds">Time on the simulation clock</param>
+void AdvanceSimulation(Simulation& simulation, double seconds)
+{
+	uint64_t targetStep = static_cast<uint64_t>(seconds / simulation.stepSeconds);
+	if (targetStep <= simulation.stepCount)
+	{
+		return;
+	}
+
+	uint32_t keys = simulation.keys.load(std::memory_order_relaxed);
+	while (simulation.stepCount < targetStep)
+	{
+		simulation.previous = simulation.state;
+		StepSimulationState(simulation.state, keys, static_cast<float>(simulation.stepSeconds));
+		++simulation.stepCount;
+	}
+
+	PublishSnapshot(simulation);
+}
+
+/// <summary>
+/// Gets the state to render at the given time from the latest published snapshot. The state is interpolated between
+/// the last two steps and trails the simulation by one step, so it never has to be guessed ahead.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="seconds">Time on the simulation clock</param>
+/// <returns>Interpolated state</returns>
+SimulationState GetSimulationState(Simulation& simulation, double seconds)
+{
+	if (simulation.middle.load(std::memory_order_acquire) & SnapshotFresh)
+	{
+		simulation.front = simulation.middle.exchange(simulation.front, std::memory_order_acq_rel) & ~SnapshotFresh;
+	}
+
+	const SimulationSnapshot& snapshot = simulation.slots[simulation.front];
+	double weight = (seconds - snapshot.currentTime) / simulation.stepSeconds;
+	return InterpolateState(snapshot.previous, snapshot.current, static_cast<float>(std::min(std::max(weight, 0.0), 1.0)));
+}
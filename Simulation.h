@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+/// <summary>
+/// Keys that drive the simulation, one bit each
+/// </summary>
+enum SimulationKey : uint32_t
+{
+	KeyMoveLeft = 1 << 0,			// Left arrow: move the camera to the left
+	KeyMoveRight = 1 << 1,			// Right arrow: move the camera to the right
+	KeyMoveForward = 1 << 2,		// Up arrow: move the camera forward
+	KeyMoveBackward = 1 << 3,		// Down arrow: move the camera backward
+	KeyLookUp = 1 << 4,				// W: look up
+	KeyLookDown = 1 << 5,			// S: look down
+	KeyLookLeft = 1 << 6,			// A: look to the left
+	KeyLookRight = 1 << 7,			// D: look to the right
+	KeyResetCamera = 1 << 8,		// Space: move the camera back to where it started
+	KeyAmbientDown = 1 << 9,		// U: darken the ambient light
+	KeyAmbientUp = 1 << 10			// I: brighten the ambient light
+};
+
+/// <summary>
+/// Struct containing the state that the simulation advances in fixed steps
+/// </summary>
+struct SimulationState
+{
+	float cameraMoveForwardBackward = 1.0f;
+	float cameraMoveLeftRight = 0.0f;
+	float cameraLookUpDown = 0.0f;
+	float cameraLookLeftRight = 0.0f;
+	float cameraLookForwardBackward = 0.0f;
+	float ambientStrength = 0.5f;
+};
+
+/// <summary>
+/// Struct containing the last two simulation steps, which is everything the renderer needs to interpolate between them
+/// </summary>
+struct SimulationSnapshot
+{
+	SimulationState previous;		// State one step before current
+	SimulationState current;		// State after the latest step
+	double currentTime = 0.0;		// Simulation clock of current, in seconds
+};
+
+/// <summary>
+/// Struct containing a fixed-timestep simulation. Finished steps are handed to the renderer through a lock-free
+/// triple buffer: the simulation writes into its back slot and swaps it with the middle slot, and the renderer
+/// swaps its front slot with the middle slot when a newer snapshot is waiting there.
+/// </summary>
+struct Simulation
+{
+	SimulationSnapshot slots[3];
+	std::atomic<uint32_t> middle{ 1 };	// Slot between the two threads, with SnapshotFresh set while it is unread
+	uint32_t back = 0;					// Slot that only the simulation writes
+	uint32_t front = 2;					// Slot that only the renderer reads
+
+	std::atomic<uint32_t> keys{ 0 };	// SimulationKey bits that are held down
+	std::atomic<bool> running{ false };
+	std::thread thread;					// Runs the steps when the simulation is threaded
+	std::chrono::steady_clock::time_point start;	// Start of the simulation clock
+
+	double stepSeconds = 1.0 / 120.0;	// Length of one step
+	uint64_t stepCount = 0;				// Steps taken so far
+	SimulationState previous;			// State before the latest step
+	SimulationState state;				// State after the latest step
+};
+
+/// <summary>
+/// Starts the simulation clock. A threaded simulation takes its steps on a thread of its own; otherwise
+/// AdvanceSimulation() has to be called before every frame.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="stepRate">Number of steps per second</param>
+/// <param name="threaded">Take the steps on a separate thread</param>
+void StartSimulation(Simulation& simulation, double stepRate, bool threaded);
+
+/// <summary>
+/// Stops the simulation thread, if there is one.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+void StopSimulation(Simulation& simulation);
+
+/// <summary>
+/// Gets the number of seconds since the simulation was started.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <returns>Seconds on the simulation clock</returns>
+double GetSimulationClock(const Simulation& simulation);
+
+/// <summary>
+/// Sets the keys that are held down. Takes effect from the next step.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="keys">SimulationKey bits</param>
+void SetSimulationInput(Simulation& simulation, uint32_t keys);
+
+/// <summary>
+/// Takes every step up to the given time and publishes the result. Only the simulation thread calls this
+/// when the simulation is threaded.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="seconds">Time on the simulation clock</param>
+void AdvanceSimulation(Simulation& simulation, double seconds);
+
+/// <summary>
+/// Gets the state to render at the given time from the latest published snapshot. The state is interpolated between
+/// the last two steps and trails the simulation by one step, so it never has to be guessed ahead.
+/// </summary>
+/// <param name="simulation">Simulation</param>
+/// <param name="seconds">Time on the simulation clock</param>
+/// <returns>Interpolated state</returns>
+SimulationState GetSimulationState(Simulation& simulation, double seconds);
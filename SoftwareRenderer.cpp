@@ -0,0 +1,942 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/gtc/packing.hpp>
+#include <stb_image.h>
+
+#include "Headless.h"
+#include "ShaderVariants.h"
+
+#if defined(__AVX2__)
+#define SOFTWARE_USE_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_USE_SSE
+#include <emmintrin.h>
+#endif
+
+/// <summary>
+/// Number of pixels that the coverage and depth test handles at once
+/// </summary>
+#if defined(SOFTWARE_USE_AVX2)
+static const int SoftwareLaneCount = 8;
+#elif defined(SOFTWARE_USE_SSE)
+static const int SoftwareLaneCount = 4;
+#else
+static const int SoftwareLaneCount = 1;
+#endif
+
+/// <summary>
+/// Pixels that triangles may reach past the edges of the frame before they are clipped. Keeps window coordinates
+/// small enough that snapping them to 1/256 of a pixel is exact.
+/// </summary>
+static const float SoftwareGuardBand = 4096.0f;
+
+/// <summary>
+/// Largest number of setup tasks per frame, and the fewest objects that one of them handles
+/// </summary>
+static const size_t SoftwareBatchCount = 64;
+static const size_t SoftwareObjectsPerBatch = 16;
+
+/// <summary>
+/// Fog of main.fsh: constant color and factor
+/// </summary>
+static const glm::vec4 FogColor(0.6f, 0.6f, 0.6f, 1.0f);
+static const float FogFactor = std::min(std::max((1.0f - 0.3f) / (1.0f - 0.1f), 0.0f), 1.0f);
+
+/// <summary>
+/// Offsets of the attributes in SoftwareTriangle::attributes
+/// </summary>
+enum SoftwareAttribute
+{
+	AttributeUV = 0,				// outUV
+	AttributeColor = 2,				// outColor
+	AttributeFragPosition = 5,		// fragPosition (the clip-space position, as main.vsh writes it)
+	AttributeFragNormal = 8,		// fragNormal
+	AttributeViewPosition = 11		// View-space position
+};
+
+/// <summary>
+/// Struct containing a vertex after the vertex stage: clip-space position and attributes (not divided by w)
+/// </summary>
+struct SoftwareClipVertex
+{
+	glm::vec4 clip;
+	float attributes[SoftwareAttributeCount];
+};
+
+/// <summary>
+/// Struct containing what the setup tasks of a frame share
+/// </summary>
+struct SoftwareFrameSetup
+{
+	const std::vector<SceneObject>* scene;
+	const std::vector<SceneMaterial>* materials;
+	const TransformStore* transforms;
+	const std::vector<uint32_t>* visibleObjects;
+	const std::vector<uint8_t>* visibleLods;
+	glm::mat4 view;
+	glm::mat4 viewProjection;
+	glm::vec4 clipPlanes[6];		// Inside where the dot product with the clip-space position is not negative
+};
+
+/// <summary>
+/// Struct containing what the shading of every pixel reads
+/// </summary>
+struct SoftwareShading
+{
+	glm::vec3 ambient;
+	glm::vec3 lightPosition;
+	const std::vector<uint32_t>* tileLights;
+};
+
+/// <summary>
+/// Gets the name of the SIMD instruction set that the rasterizer was built with.
+/// </summary>
+/// <returns>"AVX2", "SSE2" or "scalar"</returns>
+const char* GetSoftwareSimdName()
+{
+#if defined(SOFTWARE_USE_AVX2)
+	return "AVX2";
+#elif defined(SOFTWARE_USE_SSE)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+/// <summary>
+/// Creates the color and depth buffers, unpacks the meshes and starts the worker threads.
+/// </summary>
+/// <param name="renderer">Software renderer that will be created</param>
+/// <param name="width">Width of the frame</param>
+/// <param name="height">Height of the frame</param>
+/// <param name="meshData">CPU-side meshes</param>
+/// <param name="threadCount">Number of worker threads (0 picks one less than the number of hardware threads, at least one)</param>
+void CreateSoftwareRenderer(SoftwareRenderer& renderer, int width, int height, const MeshData& meshData, unsigned int threadCount)
+{
+	renderer.width = width;
+	renderer.height = height;
+	renderer.tileCountX = (width + SoftwareTileSize - 1) / SoftwareTileSize;
+	renderer.tileCountY = (height + SoftwareTileSize - 1) / SoftwareTileSize;
+	renderer.stride = renderer.tileCountX * SoftwareTileSize;
+	renderer.color.assign(static_cast<size_t>(renderer.stride) * renderer.tileCountY * SoftwareTileSize, 0);
+	renderer.depth.assign(renderer.color.size(), 1.0f);
+
+	// Unpack the compact vertex format once: half-float UVs, 10-bit normals and the optional color stream
+	renderer.meshes = DescribeMeshData(meshData);
+	renderer.vertices.resize(meshData.vertices.size());
+	for (size_t i = 0; i < meshData.vertices.size(); ++i)
+	{
+		const PackedVertex& packed = meshData.vertices[i];
+		SoftwareVertex& vertex = renderer.vertices[i];
+		vertex.position = glm::vec3(packed.x, packed.y, packed.z);
+		vertex.uv = glm::vec2(glm::unpackHalf1x16(packed.u), glm::unpackHalf1x16(packed.v));
+		glm::vec4 normal = glm::unpackSnorm3x10_1x2(packed.normal);
+		vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+		vertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
+		if (!meshData.colors.empty())
+		{
+			GLuint color = meshData.colors[i];
+			vertex.color = glm::vec3((color & 0xFF) / 255.0f, ((color >> 8) & 0xFF) / 255.0f, ((color >> 16) & 0xFF) / 255.0f);
+		}
+	}
+	renderer.indices = meshData.indices;
+
+	renderer.tileLights.resize(static_cast<size_t>(renderer.tileCountX) * renderer.tileCountY);
+	StartThreadPool(renderer.pool, threadCount);
+}
+
+/// <summary>
+/// Decodes the image of every material on the worker threads and builds its mip levels, the same way the texture
+/// loader does for the OpenGL texture array. Images that fail to load become the same gray placeholder.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="layerSize">Width and height that every image is resized to</param>
+/// <returns>Number of images that failed to load</returns>
+int LoadSoftwareMaterials(SoftwareRenderer& renderer, const std::vector<SceneMaterial>& materials, int layerSize)
+{
+	// Rows bottom to top, the same way the texture loader flips them for OpenGL
+	stbi_set_flip_vertically_on_load(true);
+
+	renderer.materials.assign(materials.size(), SoftwareTexture());
+	std::vector<int> failed(materials.size(), 0);
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		if (materials[i].filePath.empty())
+		{
+			continue;
+		}
+
+		SubmitTask(renderer.pool, [&renderer, &materials, &failed, i, layerSize]()
+		{
+			SoftwareTexture& texture = renderer.materials[i];
+			if (!LoadImageLevels(materials[i].filePath, materials[i].swapRedBlue, BakedRGBA8, layerSize, layerSize, texture.pixels, texture.levels))
+			{
+				texture.levels.assign(1, { 1, 1, 0, 4 });
+				texture.pixels.assign(4, 128);
+				failed[i] = 1;
+			}
+		});
+	}
+	WaitForTasks(renderer.pool);
+
+	int failedCount = 0;
+	for (int value : failed)
+	{
+		failedCount += value;
+	}
+	return failedCount;
+}
+
+/// <summary>
+/// Runs main.vsh for one vertex.
+/// </summary>
+/// <param name="vertex">Mesh vertex</param>
+/// <param name="transformationMatrix">Model-view-projection matrix of the object</param>
+/// <param name="modelView">Model-view matrix of the object</param>
+/// <returns>Vertex with its clip-space position and attributes</returns>
+static SoftwareClipVertex ShadeVertex(const SoftwareVertex& vertex, const glm::mat4& transformationMatrix, const glm::mat4& modelView)
+{
+	SoftwareClipVertex result;
+	glm::vec4 position(vertex.position.x, vertex.position.y, vertex.position.z, 1.0f);
+	result.clip = transformationMatrix * position;
+	glm::vec4 viewPosition = modelView * position;
+
+	// main.vsh uses the transformation matrix as its model matrix, and vec3() of it is the first column
+	glm::vec4 normalScale = transformationMatrix[0];
+
+	float* attributes = result.attributes;
+	attributes[AttributeUV] = vertex.uv.x;
+	attributes[AttributeUV + 1] = vertex.uv.y;
+	attributes[AttributeColor] = vertex.color.x;
+	attributes[AttributeColor + 1] = vertex.color.y;
+	attributes[AttributeColor + 2] = vertex.color.z;
+	attributes[AttributeFragPosition] = result.clip.x;
+	attributes[AttributeFragPosition + 1] = result.clip.y;
+	attributes[AttributeFragPosition + 2] = result.clip.z;
+	attributes[AttributeFragNormal] = normalScale.x * vertex.normal.x;
+	attributes[AttributeFragNormal + 1] = normalScale.y * vertex.normal.y;
+	attributes[AttributeFragNormal + 2] = normalScale.z * vertex.normal.z;
+	attributes[AttributeViewPosition] = viewPosition.x;
+	attributes[AttributeViewPosition + 1] = viewPosition.y;
+	attributes[AttributeViewPosition + 2] = viewPosition.z;
+	return result;
+}
+
+/// <summary>
+/// Sets up a triangle for rasterization and adds it to the bins of the tiles it touches.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="batch">Batch that receives the triangle</param>
+/// <param name="vertices">Vertices of the triangle, inside the clip planes</param>
+/// <param name="material">Layer of the material</param>
+/// <param name="features">ShaderFeature flags</param>
+static void SetupTriangle(const SoftwareRenderer& renderer, SoftwareBatch& batch, const SoftwareClipVertex* const vertices[3],
+	uint32_t material, uint32_t features)
+{
+	SoftwareTriangle triangle;
+	float x[3], y[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const SoftwareClipVertex& vertex = *vertices[i];
+		float inverseW = 1.0f / vertex.clip.w;
+
+		// Window coordinates with the origin in the lower-left corner, snapped to 1/256 of a pixel
+		x[i] = std::round((vertex.clip.x * inverseW * 0.5f + 0.5f) * renderer.width * 256.0f) / 256.0f;
+		y[i] = std::round((vertex.clip.y * inverseW * 0.5f + 0.5f) * renderer.height * 256.0f) / 256.0f;
+		triangle.z[i] = vertex.clip.z * inverseW * 0.5f + 0.5f;
+		triangle.inverseW[i] = inverseW;
+		for (int a = 0; a < SoftwareAttributeCount; ++a)
+		{
+			triangle.attributes[i][a] = vertex.attributes[a] * inverseW;
+		}
+	}
+
+	triangle.minX = std::max(static_cast<int>(std::ceil(std::min(x[0], std::min(x[1], x[2])) - 0.5f)), 0);
+	triangle.minY = std::max(static_cast<int>(std::ceil(std::min(y[0], std::min(y[1], y[2])) - 0.5f)), 0);
+	triangle.maxX = std::min(static_cast<int>(std::floor(std::max(x[0], std::max(x[1], x[2])) - 0.5f)), renderer.width - 1);
+	triangle.maxY = std::min(static_cast<int>(std::floor(std::max(y[0], std::max(y[1], y[2])) - 0.5f)), renderer.height - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		return;
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		// The end points of every edge are ordered by position, not by the winding of the triangle
+		int a = (i + 1) % 3;
+		int b = (i + 2) % 3;
+		if (x[b] < x[a] || (x[b] == x[a] && y[b] < y[a]))
+		{
+			std::swap(a, b);
+		}
+		triangle.edgeX[i] = x[a];
+		triangle.edgeY[i] = y[a];
+		triangle.edgeDx[i] = x[b] - x[a];
+		triangle.edgeDy[i] = y[b] - y[a];
+
+		float opposite = (x[i] - x[a]) * triangle.edgeDy[i] - (y[i] - y[a]) * triangle.edgeDx[i];
+		if (opposite == 0.0f)
+		{
+			return;
+		}
+		triangle.edgeSign[i] = opposite > 0.0f ? 1.0f : -1.0f;
+		triangle.edgeScale[i] = 1.0f / std::abs(opposite);
+
+		// Of two triangles that share an edge, only one sees the edge with a positive (or zero and positive) slope
+		float slopeX = triangle.edgeSign[i] * triangle.edgeDy[i];
+		float slopeY = -triangle.edgeSign[i] * triangle.edgeDx[i];
+		triangle.edgeOwnsTies[i] = slopeX > 0.0f || (slopeX == 0.0f && slopeY > 0.0f) ? 0xFFFFFFFFu : 0u;
+		triangle.lambdaDx[i] = slopeX * triangle.edgeScale[i];
+		triangle.lambdaDy[i] = slopeY * triangle.edgeScale[i];
+	}
+
+	// dFdx() and dFdy() of the view-space position span the triangle's plane; their cross product faces the
+	// same way as the triangle's edges when it is wound counter-clockwise on the screen
+	glm::vec3 view[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* attributes = vertices[i]->attributes + AttributeViewPosition;
+		view[i] = glm::vec3(attributes[0], attributes[1], attributes[2]);
+	}
+	float windowArea = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	glm::vec3 normal = glm::cross(view[1] - view[0], view[2] - view[0]);
+	float normalLength = glm::length(normal);
+	triangle.faceNormal = normalLength > 0.0f ? normal * ((windowArea < 0.0f ? -1.0f : 1.0f) / normalLength) : glm::vec3(0.0f);
+
+	triangle.material = material;
+	triangle.features = features;
+
+	uint32_t index = static_cast<uint32_t>(batch.triangles.size());
+	batch.triangles.push_back(triangle);
+	for (int tileY = triangle.minY / SoftwareTileSize; tileY <= triangle.maxY / SoftwareTileSize; ++tileY)
+	{
+		for (int tileX = triangle.minX / SoftwareTileSize; tileX <= triangle.maxX / SoftwareTileSize; ++tileX)
+		{
+			batch.tiles[tileY * renderer.tileCountX + tileX].push_back(index);
+		}
+	}
+}
+
+/// <summary>
+/// Interpolates between two clip-space vertices.
+/// </summary>
+/// <param name="a">First vertex</param>
+/// <param name="b">Second vertex</param>
+/// <param name="t">0 for the first vertex, 1 for the second</param>
+/// <returns>Vertex in between</returns>
+static SoftwareClipVertex LerpClipVertex(const SoftwareClipVertex& a, const SoftwareClipVertex& b, float t)
+{
+	SoftwareClipVertex result;
+	result.clip = a.clip + (b.clip - a.clip) * t;
+	for (int i = 0; i < SoftwareAttributeCount; ++i)
+	{
+		result.attributes[i] = a.attributes[i] + (b.attributes[i] - a.attributes[i]) * t;
+	}
+	return result;
+}
+
+/// <summary>
+/// Clips a triangle against the near and far planes and the guard band, and sets up the pieces that are left.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="setup">Clip planes of the frame</param>
+/// <param name="batch">Batch that receives the triangles</param>
+/// <param name="a">First vertex</param>
+/// <param name="b">Second vertex</param>
+/// <param name="c">Third vertex</param>
+/// <param name="material">Layer of the material</param>
+/// <param name="features">ShaderFeature flags</param>
+static void ClipTriangle(const SoftwareRenderer& renderer, const SoftwareFrameSetup& setup, SoftwareBatch& batch,
+	const SoftwareClipVertex& a, const SoftwareClipVertex& b, const SoftwareClipVertex& c, uint32_t material, uint32_t features)
+{
+	const SoftwareClipVertex* corners[3] = { &a, &b, &c };
+
+	// Most triangles are inside every plane or completely outside one of them
+	int outsideAll = 0x3F;
+	int outsideAny = 0;
+	for (const SoftwareClipVertex* corner : corners)
+	{
+		int outside = 0;
+		for (int p = 0; p < 6; ++p)
+		{
+			outside |= glm::dot(setup.clipPlanes[p], corner->clip) < 0.0f ? 1 << p : 0;
+		}
+		outsideAll &= outside;
+		outsideAny |= outside;
+	}
+	if (outsideAll != 0)
+	{
+		return;
+	}
+	if (outsideAny == 0)
+	{
+		SetupTriangle(renderer, batch, corners, material, features);
+		return;
+	}
+
+	// Clip the polygon one plane at a time (every plane adds at most one vertex)
+	SoftwareClipVertex polygons[2][9];
+	int count = 3;
+	polygons[0][0] = a;
+	polygons[0][1] = b;
+	polygons[0][2] = c;
+	int current = 0;
+	for (int p = 0; p < 6 && count > 0; ++p)
+	{
+		if ((outsideAny & (1 << p)) == 0)
+		{
+			continue;
+		}
+
+		const SoftwareClipVertex* input = polygons[current];
+		SoftwareClipVertex* output = polygons[current ^ 1];
+		int outputCount = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			const SoftwareClipVertex& from = input[i];
+			const SoftwareClipVertex& to = input[(i + 1) % count];
+			float fromDistance = glm::dot(setup.clipPlanes[p], from.clip);
+			float toDistance = glm::dot(setup.clipPlanes[p], to.clip);
+			if (fromDistance >= 0.0f)
+			{
+				output[outputCount++] = from;
+			}
+			if ((fromDistance >= 0.0f) != (toDistance >= 0.0f))
+			{
+				output[outputCount++] = LerpClipVertex(from, to, fromDistance / (fromDistance - toDistance));
+			}
+		}
+		count = outputCount;
+		current ^= 1;
+	}
+
+	for (int i = 1; i + 1 < count; ++i)
+	{
+		const SoftwareClipVertex* fan[3] = { &polygons[current][0], &polygons[current][i], &polygons[current][i + 1] };
+		SetupTriangle(renderer, batch, fan, material, features);
+	}
+}
+
+/// <summary>
+/// Transforms, clips and sets up the triangles of a range of the visible objects. Runs on a worker thread.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="setup">Data of the frame</param>
+/// <param name="batch">Batch that receives the triangles</param>
+/// <param name="first">Index of the first visible object</param>
+/// <param name="count">Number of visible objects</param>
+static void SetupObjects(const SoftwareRenderer& renderer, const SoftwareFrameSetup& setup, SoftwareBatch& batch, size_t first, size_t count)
+{
+	std::vector<SoftwareClipVertex> shaded;
+	for (size_t i = first; i < first + count; ++i)
+	{
+		uint32_t objectIndex = (*setup.visibleObjects)[i];
+		const SceneObject& object = (*setup.scene)[objectIndex];
+		const MeshRange& range = renderer.meshes.ranges[object.mesh][(*setup.visibleLods)[i]];
+		uint32_t features = SelectShaderFeatures((*setup.materials)[object.material], renderer.meshes, object.mesh);
+
+		const glm::mat4& model = setup.transforms->modelMatrices[objectIndex];
+		glm::mat4 transformationMatrix = setup.viewProjection * model;
+		glm::mat4 modelView = setup.view * model;
+
+		// Every vertex goes through the vertex stage once, however many triangles share it
+		shaded.resize(range.vertexCount);
+		for (GLsizei v = 0; v < range.vertexCount; ++v)
+		{
+			shaded[v] = ShadeVertex(renderer.vertices[range.baseVertex + v], transformationMatrix, modelView);
+		}
+
+		for (GLsizei t = 0; t < range.indexCount; t += 3)
+		{
+			const GLuint* triangle = &renderer.indices[range.firstIndex + t];
+			ClipTriangle(renderer, setup, batch, shaded[triangle[0]], shaded[triangle[1]], shaded[triangle[2]], object.material, features);
+		}
+	}
+}
+
+/// <summary>
+/// Samples one mip level with bilinear filtering and repeating texture coordinates.
+/// </summary>
+/// <param name="texture">Texture</param>
+/// <param name="level">Mip level</param>
+/// <param name="u">Horizontal texture coordinate</param>
+/// <param name="v">Vertical texture coordinate</param>
+/// <returns>Filtered color</returns>
+static glm::vec4 SampleLevel(const SoftwareTexture& texture, int level, float u, float v)
+{
+	const BakedTextureLevel& info = texture.levels[level];
+	int width = static_cast<int>(info.width);
+	int height = static_cast<int>(info.height);
+	const unsigned char* pixels = texture.pixels.data() + info.offset;
+
+	float s = u * width - 0.5f;
+	float t = v * height - 0.5f;
+	float s0 = std::floor(s);
+	float t0 = std::floor(t);
+	float fs = s - s0;
+	float ft = t - t0;
+
+	int x0 = static_cast<int>(s0) % width;
+	int y0 = static_cast<int>(t0) % height;
+	x0 += x0 < 0 ? width : 0;
+	y0 += y0 < 0 ? height : 0;
+	int x1 = x0 + 1 < width ? x0 + 1 : 0;
+	int y1 = y0 + 1 < height ? y0 + 1 : 0;
+
+	const unsigned char* texels[4] = {
+		pixels + (static_cast<size_t>(y0) * width + x0) * 4, pixels + (static_cast<size_t>(y0) * width + x1) * 4,
+		pixels + (static_cast<size_t>(y1) * width + x0) * 4, pixels + (static_cast<size_t>(y1) * width + x1) * 4
+	};
+	float weights[4] = { (1.0f - fs) * (1.0f - ft), fs * (1.0f - ft), (1.0f - fs) * ft, fs * ft };
+
+	glm::vec4 color(0.0f);
+	for (int i = 0; i < 4; ++i)
+	{
+		color += glm::vec4(texels[i][0], texels[i][1], texels[i][2], texels[i][3]) * weights[i];
+	}
+	return color * (1.0f / 255.0f);
+}
+
+/// <summary>
+/// Samples a texture like GL_LINEAR_MIPMAP_LINEAR does, with the level picked from the texture coordinate derivatives.
+/// </summary>
+/// <param name="texture">Texture</param>
+/// <param name="uv">Texture coordinates</param>
+/// <param name="uvDx">Change of the texture coordinates per pixel to the right</param>
+/// <param name="uvDy">Change of the texture coordinates per pixel upwards</param>
+/// <returns>Filtered color</returns>
+static glm::vec4 SampleTexture(const SoftwareTexture& texture, const glm::vec2& uv, const glm::vec2& uvDx, const glm::vec2& uvDy)
+{
+	float width = static_cast<float>(texture.levels[0].width);
+	float height = static_cast<float>(texture.levels[0].height);
+	float rhoX = std::sqrt(uvDx.x * width * uvDx.x * width + uvDx.y * height * uvDx.y * height);
+	float rhoY = std::sqrt(uvDy.x * width * uvDy.x * width + uvDy.y * height * uvDy.y * height);
+	float lod = std::log2(std::max(std::max(rhoX, rhoY), 1e-20f));
+
+	// Magnified: the mag filter reads level 0 only
+	int lastLevel = static_cast<int>(texture.levels.size()) - 1;
+	if (lod <= 0.0f || lastLevel == 0)
+	{
+		return SampleLevel(texture, 0, uv.x, uv.y);
+	}
+	if (lod >= lastLevel)
+	{
+		return SampleLevel(texture, lastLevel, uv.x, uv.y);
+	}
+
+	int level = static_cast<int>(lod);
+	float blend = lod - level;
+	return SampleLevel(texture, level, uv.x, uv.y) * (1.0f - blend) + SampleLevel(texture, level + 1, uv.x, uv.y) * blend;
+}
+
+/// <summary>
+/// Runs main.fsh for one pixel of a triangle.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="shading">Lights of the frame and of the tile</param>
+/// <param name="triangle">Triangle</param>
+/// <param name="lambda">Barycentric coordinates of the pixel center</param>
+/// <returns>Color of the pixel (RGBA8)</returns>
+static uint32_t ShadePixel(const SoftwareRenderer& renderer, const SoftwareShading& shading, const SoftwareTriangle& triangle, const float lambda[3])
+{
+	// Perspective-correct attributes: interpolate them divided by w, then divide by the interpolated 1 / w
+	float inverseW = lambda[0] * triangle.inverseW[0] + lambda[1] * triangle.inverseW[1] + lambda[2] * triangle.inverseW[2];
+	float w = 1.0f / inverseW;
+	float attributes[SoftwareAttributeCount];
+	for (int a = 0; a < SoftwareAttributeCount; ++a)
+	{
+		attributes[a] = (lambda[0] * triangle.attributes[0][a] + lambda[1] * triangle.attributes[1][a] + lambda[2] * triangle.attributes[2][a]) * w;
+	}
+
+	glm::vec4 fragColor;
+	if ((triangle.features & ShaderFeatureTextured) != 0)
+	{
+		// Derivatives of the perspective-correct UV from the derivatives of the barycentric coordinates
+		glm::vec2 uv(attributes[AttributeUV], attributes[AttributeUV + 1]);
+		glm::vec2 uvDx(0.0f), uvDy(0.0f);
+		float inverseWDx = 0.0f, inverseWDy = 0.0f;
+		for (int i = 0; i < 3; ++i)
+		{
+			glm::vec2 uvOverW(triangle.attributes[i][AttributeUV], triangle.attributes[i][AttributeUV + 1]);
+			uvDx += uvOverW * triangle.lambdaDx[i];
+			uvDy += uvOverW * triangle.lambdaDy[i];
+			inverseWDx += triangle.inverseW[i] * triangle.lambdaDx[i];
+			inverseWDy += triangle.inverseW[i] * triangle.lambdaDy[i];
+		}
+		uvDx = (uvDx - uv * inverseWDx) * w;
+		uvDy = (uvDy - uv * inverseWDy) * w;
+		fragColor = SampleTexture(renderer.materials[triangle.material], uv, uvDx, uvDy);
+	}
+	else
+	{
+		fragColor = glm::vec4(attributes[AttributeColor], attributes[AttributeColor + 1], attributes[AttributeColor + 2], 1.0f);
+	}
+
+	glm::vec3 light = shading.ambient;
+	if ((triangle.features & ShaderFeatureDiffuse) != 0)
+	{
+		glm::vec3 fragPosition(attributes[AttributeFragPosition], attributes[AttributeFragPosition + 1], attributes[AttributeFragPosition + 2]);
+		glm::vec3 fragNormal(attributes[AttributeFragNormal], attributes[AttributeFragNormal + 1], attributes[AttributeFragNormal + 2]);
+		glm::vec3 lightDir = glm::normalize(shading.lightPosition - fragPosition);
+		light += glm::vec3(1.0f) * std::min(std::max(glm::dot(lightDir, fragNormal), 0.0f), 1.0f);
+	}
+
+	// Point lights of the tile, with the same falloff as ClusteredPointLights() in main.fsh
+	glm::vec3 position(attributes[AttributeViewPosition], attributes[AttributeViewPosition + 1], attributes[AttributeViewPosition + 2]);
+	for (uint32_t index : *shading.tileLights)
+	{
+		glm::vec4 positionRadius = renderer.lightData[index * 2];
+		glm::vec3 toLight = glm::vec3(positionRadius) - position;
+		float distance = glm::length(toLight);
+		float attenuation = std::min(std::max(1.0f - distance / positionRadius.w, 0.0f), 1.0f);
+		if (attenuation > 0.0f)
+		{
+			light += glm::vec3(renderer.lightData[index * 2 + 1]) * (attenuation * attenuation * std::max(glm::dot(triangle.faceNormal, toLight / distance), 0.0f));
+		}
+	}
+
+	glm::vec4 finalColor = glm::vec4(light.x, light.y, light.z, 1.0f) * fragColor;
+	if ((triangle.features & ShaderFeatureFog) != 0)
+	{
+		finalColor = finalColor * FogFactor * FogColor;
+	}
+
+	uint32_t packed = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		packed |= static_cast<uint32_t>(std::min(std::max(finalColor[i], 0.0f), 1.0f) * 255.0f + 0.5f) << (8 * i);
+	}
+	return packed;
+}
+
+/// <summary>
+/// Tests a group of SoftwareLaneCount pixels in a row against the edges of a triangle and the depth buffer,
+/// and writes the depth of the pixels that pass.
+/// </summary>
+/// <param name="triangle">Triangle</param>
+/// <param name="x">First pixel of the group</param>
+/// <param name="rowTerms">Part of every edge function that only depends on the row</param>
+/// <param name="depth">Depth of the first pixel of the group in the depth buffer</param>
+/// <param name="lambdas">Receives the barycentric coordinates of every pixel</param>
+/// <returns>Bit mask of the pixels that passed</returns>
+static unsigned int CoverPixels(const SoftwareTriangle& triangle, int x, const float rowTerms[3], float* depth, float lambdas[3][SoftwareLaneCount])
+{
+#if defined(SOFTWARE_USE_AVX2)
+	__m256 centers = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+	__m256 zero = _mm256_setzero_ps();
+	__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	__m256 z = zero;
+	for (int e = 0; e < 3; ++e)
+	{
+		__m256 value = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(centers, _mm256_set1_ps(triangle.edgeX[e])), _mm256_set1_ps(triangle.edgeDy[e])),
+			_mm256_set1_ps(rowTerms[e]));
+		value = _mm256_mul_ps(value, _mm256_set1_ps(triangle.edgeSign[e]));
+		__m256 ties = _mm256_and_ps(_mm256_cmp_ps(value, zero, _CMP_EQ_OQ), _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(triangle.edgeOwnsTies[e]))));
+		inside = _mm256_and_ps(inside, _mm256_or_ps(_mm256_cmp_ps(value, zero, _CMP_GT_OQ), ties));
+		__m256 lambda = _mm256_mul_ps(value, _mm256_set1_ps(triangle.edgeScale[e]));
+		_mm256_storeu_ps(lambdas[e], lambda);
+		z = _mm256_add_ps(z, _mm256_mul_ps(lambda, _mm256_set1_ps(triangle.z[e])));
+	}
+	__m256 old = _mm256_loadu_ps(depth);
+	__m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+	_mm256_storeu_ps(depth, _mm256_blendv_ps(old, z, pass));
+	return static_cast<unsigned int>(_mm256_movemask_ps(pass));
+#elif defined(SOFTWARE_USE_SSE)
+	__m128 centers = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+	__m128 zero = _mm_setzero_ps();
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	__m128 z = zero;
+	for (int e = 0; e < 3; ++e)
+	{
+		__m128 value = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(centers, _mm_set1_ps(triangle.edgeX[e])), _mm_set1_ps(triangle.edgeDy[e])),
+			_mm_set1_ps(rowTerms[e]));
+		value = _mm_mul_ps(value, _mm_set1_ps(triangle.edgeSign[e]));
+		__m128 ties = _mm_and_ps(_mm_cmpeq_ps(value, zero), _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(triangle.edgeOwnsTies[e]))));
+		inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(value, zero), ties));
+		__m128 lambda = _mm_mul_ps(value, _mm_set1_ps(triangle.edgeScale[e]));
+		_mm_storeu_ps(lambdas[e], lambda);
+		z = _mm_add_ps(z, _mm_mul_ps(lambda, _mm_set1_ps(triangle.z[e])));
+	}
+	__m128 old = _mm_loadu_ps(depth);
+	__m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+	_mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+	return static_cast<unsigned int>(_mm_movemask_ps(pass));
+#else
+	float center = x + 0.5f;
+	bool inside = true;
+	float z = 0.0f;
+	for (int e = 0; e < 3; ++e)
+	{
+		float value = ((center - triangle.edgeX[e]) * triangle.edgeDy[e] - rowTerms[e]) * triangle.edgeSign[e];
+		inside = inside && (value > 0.0f || (value == 0.0f && triangle.edgeOwnsTies[e] != 0));
+		lambdas[e][0] = value * triangle.edgeScale[e];
+		z += lambdas[e][0] * triangle.z[e];
+	}
+	if (!inside || !(z < *depth))
+	{
+		return 0;
+	}
+	*depth = z;
+	return 1;
+#endif
+}
+
+/// <summary>
+/// Rasterizes the part of a triangle that lies inside a tile.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="shading">Lights of the frame and of the tile</param>
+/// <param name="triangle">Triangle</param>
+/// <param name="tileX">Left pixel of the tile</param>
+/// <param name="tileY">Bottom pixel of the tile</param>
+static void RasterizeTriangle(SoftwareRenderer& renderer, const SoftwareShading& shading, const SoftwareTriangle& triangle, int tileX, int tileY)
+{
+	// Groups start at multiples of the lane count, which keeps them inside the tile
+	int startX = std::max(triangle.minX, tileX) / SoftwareLaneCount * SoftwareLaneCount;
+	int endX = std::min(triangle.maxX, tileX + SoftwareTileSize - 1);
+	int startY = std::max(triangle.minY, tileY);
+	int endY = std::min(triangle.maxY, tileY + SoftwareTileSize - 1);
+
+	float lambdas[3][SoftwareLaneCount];
+	for (int y = startY; y <= endY; ++y)
+	{
+		float center = y + 0.5f;
+		float rowTerms[3];
+		for (int e = 0; e < 3; ++e)
+		{
+			rowTerms[e] = (center - triangle.edgeY[e]) * triangle.edgeDx[e];
+		}
+
+		size_t row = static_cast<size_t>(y) * renderer.stride;
+		for (int x = startX; x <= endX; x += SoftwareLaneCount)
+		{
+			unsigned int covered = CoverPixels(triangle, x, rowTerms, &renderer.depth[row + x], lambdas);
+			for (int lane = 0; covered != 0; ++lane, covered >>= 1)
+			{
+				if ((covered & 1) != 0)
+				{
+					float lambda[3] = { lambdas[0][lane], lambdas[1][lane], lambdas[2][lane] };
+					renderer.color[row + x + lane] = ShadePixel(renderer, shading, triangle, lambda);
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Clears a tile and draws every triangle that touches it, in the order the objects were given. Runs on a worker thread.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="shading">Lights of the frame</param>
+/// <param name="tile">Index of the tile</param>
+static void DrawTile(SoftwareRenderer& renderer, SoftwareShading shading, int tile)
+{
+	int tileX = tile % renderer.tileCountX * SoftwareTileSize;
+	int tileY = tile / renderer.tileCountX * SoftwareTileSize;
+	for (int y = tileY; y < tileY + SoftwareTileSize; ++y)
+	{
+		size_t row = static_cast<size_t>(y) * renderer.stride + tileX;
+		std::fill(renderer.color.begin() + row, renderer.color.begin() + row + SoftwareTileSize, 0u);
+		std::fill(renderer.depth.begin() + row, renderer.depth.begin() + row + SoftwareTileSize, 1.0f);
+	}
+
+	shading.tileLights = &renderer.tileLights[tile];
+	for (const SoftwareBatch& batch : renderer.batches)
+	{
+		for (uint32_t index : batch.tiles[tile])
+		{
+			RasterizeTriangle(renderer, shading, batch.triangles[index], tileX, tileY);
+		}
+	}
+}
+
+/// <summary>
+/// Moves the point lights into view space and lists them in the tiles that the bounding boxes of their spheres cover.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="lights">Point lights of the scene</param>
+/// <param name="frame">Camera of the frame</param>
+static void AssignTileLights(SoftwareRenderer& renderer, const std::vector<ScenePointLight>& lights, const FrameUniforms& frame)
+{
+	renderer.lightData.clear();
+	for (std::vector<uint32_t>& tileLights : renderer.tileLights)
+	{
+		tileLights.clear();
+	}
+
+	float nearPlane = 0.1f;
+	for (uint32_t i = 0; i < lights.size(); ++i)
+	{
+		const ScenePointLight& light = lights[i];
+		glm::vec4 center = frame.view * glm::vec4(light.position.x, light.position.y, light.position.z, 1.0f);
+		renderer.lightData.push_back(glm::vec4(center.x, center.y, center.z, light.radius));
+		renderer.lightData.push_back(glm::vec4(light.color.x, light.color.y, light.color.z, 0.0f));
+		if (center.z + light.radius > -nearPlane)
+		{
+			// Reaches past the near plane, where the corners cannot be projected; skip it if nothing of it is in front
+			if (center.z - light.radius > -nearPlane)
+			{
+				continue;
+			}
+			for (std::vector<uint32_t>& tileLights : renderer.tileLights)
+			{
+				tileLights.push_back(i);
+			}
+			continue;
+		}
+
+		// Project the corners of the sphere's bounding box
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			glm::vec4 point(center.x + ((corner & 1) != 0 ? light.radius : -light.radius), center.y + ((corner & 2) != 0 ? light.radius : -light.radius),
+				center.z + ((corner & 4) != 0 ? light.radius : -light.radius), 1.0f);
+			glm::vec4 clip = frame.projection * point;
+			float windowX = (clip.x / clip.w * 0.5f + 0.5f) * renderer.width;
+			float windowY = (clip.y / clip.w * 0.5f + 0.5f) * renderer.height;
+			minX = std::min(minX, windowX);
+			minY = std::min(minY, windowY);
+			maxX = std::max(maxX, windowX);
+			maxY = std::max(maxY, windowY);
+		}
+
+		int firstTileX = std::max(static_cast<int>(std::floor(minX)) / SoftwareTileSize, 0);
+		int firstTileY = std::max(static_cast<int>(std::floor(minY)) / SoftwareTileSize, 0);
+		int lastTileX = std::min(static_cast<int>(std::floor(maxX)) / SoftwareTileSize, renderer.tileCountX - 1);
+		int lastTileY = std::min(static_cast<int>(std::floor(maxY)) / SoftwareTileSize, renderer.tileCountY - 1);
+		for (int tileY = firstTileY; tileY <= lastTileY; ++tileY)
+		{
+			for (int tileX = firstTileX; tileX <= lastTileX; ++tileX)
+			{
+				renderer.tileLights[tileY * renderer.tileCountX + tileX].push_back(i);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Draws a frame: clears the buffers, then draws the visible objects with the features their materials pick
+/// (texture, ambient and diffuse light of the main light, point lights and fog). Shadows are not drawn.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="lights">Point lights of the scene</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="visibleObjects">Indices of the objects to draw</param>
+/// <param name="visibleLods">Level of detail of every object to draw</param>
+/// <param name="frame">Camera and main light, the same per-frame data the shaders get</param>
+void DrawSoftwareFrame(SoftwareRenderer& renderer, const std::vector<SceneObject>& scene, const std::vector<SceneMaterial>& materials,
+	const std::vector<ScenePointLight>& lights, const TransformStore& transforms, const std::vector<uint32_t>& visibleObjects,
+	const std::vector<uint8_t>& visibleLods, const FrameUniforms& frame)
+{
+	SoftwareFrameSetup setup;
+	setup.scene = &scene;
+	setup.materials = &materials;
+	setup.transforms = &transforms;
+	setup.visibleObjects = &visibleObjects;
+	setup.visibleLods = &visibleLods;
+	setup.view = frame.view;
+	setup.viewProjection = frame.projection * frame.view;
+
+	// Near and far plane, and the sides of the guard band
+	float guardX = 1.0f + 2.0f * SoftwareGuardBand / renderer.width;
+	float guardY = 1.0f + 2.0f * SoftwareGuardBand / renderer.height;
+	setup.clipPlanes[0] = glm::vec4(1.0f, 0.0f, 0.0f, guardX);
+	setup.clipPlanes[1] = glm::vec4(-1.0f, 0.0f, 0.0f, guardX);
+	setup.clipPlanes[2] = glm::vec4(0.0f, 1.0f, 0.0f, guardY);
+	setup.clipPlanes[3] = glm::vec4(0.0f, -1.0f, 0.0f, guardY);
+	setup.clipPlanes[4] = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	setup.clipPlanes[5] = glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+
+	// Set up the triangles of consecutive ranges of the visible objects in parallel; every batch bins its own
+	// triangles, so the tiles can draw the batches one after the other and keep the order of the objects
+	size_t tileCount = static_cast<size_t>(renderer.tileCountX) * renderer.tileCountY;
+	size_t batchCount = std::min(SoftwareBatchCount, (visibleObjects.size() + SoftwareObjectsPerBatch - 1) / SoftwareObjectsPerBatch);
+	renderer.batches.resize(batchCount);
+	for (size_t b = 0; b < batchCount; ++b)
+	{
+		SoftwareBatch& batch = renderer.batches[b];
+		batch.triangles.clear();
+		batch.tiles.resize(tileCount);
+		for (std::vector<uint32_t>& tile : batch.tiles)
+		{
+			tile.clear();
+		}
+
+		size_t first = visibleObjects.size() * b / batchCount;
+		size_t last = visibleObjects.size() * (b + 1) / batchCount;
+		SubmitTask(renderer.pool, [&renderer, &setup, &batch, first, last]()
+		{
+			SetupObjects(renderer, setup, batch, first, last - first);
+		});
+	}
+	AssignTileLights(renderer, lights, frame);
+	WaitForTasks(renderer.pool);
+
+	renderer.triangleCount = 0;
+	for (const SoftwareBatch& batch : renderer.batches)
+	{
+		renderer.triangleCount += batch.triangles.size();
+	}
+
+	// Then every tile on its own
+	SoftwareShading shading;
+	shading.ambient = glm::vec3(frame.lightColor) * frame.ambientStrength;
+	shading.lightPosition = glm::vec3(frame.lightPos);
+	shading.tileLights = nullptr;
+	for (size_t tile = 0; tile < tileCount; ++tile)
+	{
+		SubmitTask(renderer.pool, [&renderer, shading, tile]()
+		{
+			DrawTile(renderer, shading, static_cast<int>(tile));
+		});
+	}
+	WaitForTasks(renderer.pool);
+}
+
+/// <summary>
+/// Writes the last frame to a binary PPM file.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="filePath">Path of the image file</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteSoftwareFrameToFile(const SoftwareRenderer& renderer, const std::string& filePath)
+{
+	std::vector<unsigned char> pixels(static_cast<size_t>(renderer.width) * renderer.height * 3);
+	unsigned char* pixel = pixels.data();
+	for (int y = 0; y < renderer.height; ++y)
+	{
+		const uint32_t* row = &renderer.color[static_cast<size_t>(y) * renderer.stride];
+		for (int x = 0; x < renderer.width; ++x)
+		{
+			*pixel++ = static_cast<unsigned char>(row[x] & 0xFF);
+			*pixel++ = static_cast<unsigned char>((row[x] >> 8) & 0xFF);
+			*pixel++ = static_cast<unsigned char>((row[x] >> 16) & 0xFF);
+		}
+	}
+	return WriteImageToFile(filePath, renderer.width, renderer.height, pixels.data());
+}
+
+/// <summary>
+/// Stops the worker threads and frees the buffers.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+void DeleteSoftwareRenderer(SoftwareRenderer& renderer)
+{
+	StopThreadPool(renderer.pool);
+	renderer.color.clear();
+	renderer.depth.clear();
+	renderer.vertices.clear();
+	renderer.indices.clear();
+	renderer.materials.clear();
+	renderer.batches.clear();
+	renderer.lightData.clear();
+	renderer.tileLights.clear();
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BakedTexture.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Transforms.h"
+#include "Uniforms.h"
+
+/// <summary>
+/// Width and height of the screen tiles that the rasterizer splits the frame into. Every tile is one task, and a
+/// multiple of the SIMD width, so a group of pixels never reaches into a tile that another thread is drawing.
+/// </summary>
+const int SoftwareTileSize = 64;
+
+/// <summary>
+/// Number of values that are interpolated across a triangle: the UV, color, fragment position and fragment normal
+/// outputs of main.vsh, and the view-space position that main.fsh rebuilds for the point lights
+/// </summary>
+const int SoftwareAttributeCount = 14;
+
+/// <summary>
+/// Struct containing a vertex of the CPU-side meshes, unpacked once instead of every frame
+/// </summary>
+struct SoftwareVertex
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec2 uv;
+	glm::vec3 normal;
+};
+
+/// <summary>
+/// Struct containing a material layer with its full mip chain as RGBA8 pixels, like the OpenGL texture array holds it
+/// </summary>
+struct SoftwareTexture
+{
+	std::vector<BakedTextureLevel> levels;		// Offsets are relative to pixels
+	std::vector<unsigned char> pixels;
+};
+
+/// <summary>
+/// Struct containing a triangle after clipping and setup, ready to be rasterized in every tile it touches.
+/// Every edge is stored with its end points in a fixed order, so two triangles that share an edge compute exactly
+/// the same edge function values and a pixel on the edge goes to exactly one of them.
+/// </summary>
+struct SoftwareTriangle
+{
+	float edgeX[3], edgeY[3];			// First end point of the edge opposite every vertex, in window coordinates
+	float edgeDx[3], edgeDy[3];			// Vector from the first to the second end point
+	float edgeSign[3];					// 1 or -1, so that the inside of the triangle is positive
+	float edgeScale[3];					// Turns an edge function value into the barycentric coordinate of the opposite vertex
+	uint32_t edgeOwnsTies[3];			// All bits set if pixel centers exactly on the edge belong to this triangle
+	float lambdaDx[3], lambdaDy[3];		// Change of the barycentric coordinates per pixel
+	float z[3];							// Window depth of the vertices
+	float inverseW[3];					// 1 / w of the vertices, for perspective-correct interpolation
+	float attributes[3][SoftwareAttributeCount];	// Attributes of the vertices, divided by w
+	glm::vec3 faceNormal;				// View-space face normal, as main.fsh derives it from dFdx() and dFdy()
+	uint32_t material;					// Layer of the material
+	uint32_t features;					// ShaderFeature flags, see ShaderVariants.h
+	int minX, minY, maxX, maxY;			// Pixels whose centers the triangle can cover
+};
+
+/// <summary>
+/// Struct containing the triangles that one task set up from a range of the visible objects
+/// </summary>
+struct SoftwareBatch
+{
+	std::vector<SoftwareTriangle> triangles;
+	std::vector<std::vector<uint32_t>> tiles;	// Triangles that touch every tile, in the order they were drawn
+};
+
+/// <summary>
+/// Struct containing a renderer that draws the scene on the CPU the way main.vsh and main.fsh do, for machines
+/// without a GPU. Visible objects are transformed, clipped and set up by tasks on a thread pool and binned into
+/// screen tiles; then every tile is rasterized by a task of its own, with SIMD coverage and depth tests.
+/// </summary>
+struct SoftwareRenderer
+{
+	int width = 0;
+	int height = 0;
+	int tileCountX = 0;
+	int tileCountY = 0;
+	int stride = 0;							// Pixels per row of the buffers, a whole number of tiles
+	std::vector<uint32_t> color;			// RGBA8, rows bottom to top like the OpenGL framebuffer
+	std::vector<float> depth;
+
+	MeshBuffers meshes;						// Ranges and levels of detail of the meshes, without any buffers
+	std::vector<SoftwareVertex> vertices;	// Every vertex of every mesh
+	std::vector<GLuint> indices;			// Indices relative to the base vertex of their mesh
+	std::vector<SoftwareTexture> materials;	// One texture per scene material (empty for untextured materials)
+
+	ThreadPool pool;
+	std::vector<SoftwareBatch> batches;		// Output of the setup tasks of the current frame
+	std::vector<glm::vec4> lightData;		// Two values per point light: view-space position and radius, then color
+	std::vector<std::vector<uint32_t>> tileLights;	// Point lights that reach every tile
+	size_t triangleCount = 0;				// Triangles set up in the last frame
+};
+
+/// <summary>
+/// Gets the name of the SIMD instruction set that the rasterizer was built with.
+/// </summary>
+/// <returns>"AVX2", "SSE2" or "scalar"</returns>
+const char* GetSoftwareSimdName();
+
+/// <summary>
+/// Creates the color and depth buffers, unpacks the meshes and starts the worker threads.
+/// </summary>
+/// <param name="renderer">Software renderer that will be created</param>
+/// <param name="width">Width of the frame</param>
+/// <param name="height">Height of the frame</param>
+/// <param name="meshData">CPU-side meshes</param>
+/// <param name="threadCount">Number of worker threads (0 picks one less than the number of hardware threads, at least one)</param>
+void CreateSoftwareRenderer(SoftwareRenderer& renderer, int width, int height, const MeshData& meshData, unsigned int threadCount);
+
+/// <summary>
+/// Decodes the image of every material on the worker threads and builds its mip levels, the same way the texture
+/// loader does for the OpenGL texture array. Images that fail to load become the same gray placeholder.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="layerSize">Width and height that every image is resized to</param>
+/// <returns>Number of images that failed to load</returns>
+int LoadSoftwareMaterials(SoftwareRenderer& renderer, const std::vector<SceneMaterial>& materials, int layerSize);
+
+/// <summary>
+/// Draws a frame: clears the buffers, then draws the visible objects with the features their materials pick
+/// (texture, ambient and diffuse light of the main light, point lights and fog). Shadows are not drawn.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="scene">Scene objects</param>
+/// <param name="materials">Materials of the scene</param>
+/// <param name="lights">Point lights of the scene</param>
+/// <param name="transforms">Transforms of the scene objects</param>
+/// <param name="visibleObjects">Indices of the objects to draw</param>
+/// <param name="visibleLods">Level of detail of every object to draw</param>
+/// <param name="frame">Camera and main light, the same per-frame data the shaders get</param>
+void DrawSoftwareFrame(SoftwareRenderer& renderer, const std::vector<SceneObject>& scene, const std::vector<SceneMaterial>& materials,
+	const std::vector<ScenePointLight>& lights, const TransformStore& transforms, const std::vector<uint32_t>& visibleObjects,
+	const std::vector<uint8_t>& visibleLods, const FrameUniforms& frame);
+
+/// <summary>
+/// Writes the last frame to a binary PPM file.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+/// <param name="filePath">Path of the image file</param>
+/// <returns>True if the file was written, false otherwise</returns>
+bool WriteSoftwareFrameToFile(const SoftwareRenderer& renderer, const std::string& filePath);
+
+/// <summary>
+/// Stops the worker threads and frees the buffers.
+/// </summary>
+/// <param name="renderer">Software renderer</param>
+void DeleteSoftwareRenderer(SoftwareRenderer& renderer);
@@ -0,0 +1,466 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <stb_image.h>
+
+#include "BlockCompression.h"
+
+// S3TC enums, in case the OpenGL loader was generated without the extension's definitions
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/// <summary>
+/// Gets the OpenGL internal format of a texture array.
+/// </summary>
+/// <param name="format">Pixel format of the layers</param>
+/// <returns>Internal format</returns>
+static GLenum GetInternalFormat(BakedTextureFormat format)
+{
+	switch (format)
+	{
+	case BakedBC1:
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BakedBC3:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default:
+		return GL_RGBA8;
+	}
+}
+
+/// <summary>
+/// Checks whether a baked texture can be copied into the layers of a texture array as is.
+/// </summary>
+/// <param name="header">Header of the baked texture</param>
+/// <param name="textureArray">Texture array</param>
+/// <returns>True if the size, format and number of levels match</returns>
+static bool MatchesTextureArray(const BakedTextureHeader& header, const TextureArray& textureArray)
+{
+	return header.format == static_cast<uint32_t>(textureArray.format) && header.width == static_cast<uint32_t>(textureArray.width)
+		&& header.height == static_cast<uint32_t>(textureArray.height) && header.levelCount == static_cast<uint32_t>(textureArray.levelCount);
+}
+
+/// <summary>
+/// Tries to use the baked version of a job's image. Runs on a worker thread.
+/// </summary>
+/// <param name="job">Texture load job</param>
+/// <returns>True if the baked texture will be used, false if the image has to be decoded</returns>
+static bool MapBakedTexture(TextureLoadJob& job)
+{
+	if (!OpenMappedFile(job.bakedFile, GetBakedTexturePath(job.filePath)))
+	{
+		return false;
+	}
+
+	const BakedTextureHeader* header;
+	const BakedTextureLevel* levels;
+	if (!ReadBakedTexture(job.bakedFile.data, job.bakedFile.size, header, levels) || !MatchesTextureArray(*header, *job.textureArray))
+	{
+		CloseMappedFile(job.bakedFile);
+		return false;
+	}
+
+	// Everything from the first level to the end of the file is streamed in one piece. ReadBakedTexture() made sure the
+	// levels follow each other, so no offset lies before the first one
+	uint32_t start = levels[0].offset;
+	for (uint32_t i = 0; i < header->levelCount; ++i)
+	{
+		job.levels.push_back({ levels[i].width, levels[i].height, levels[i].offset - start, levels[i].size });
+	}
+
+	job.pixels = job.bakedFile.data + start;
+	job.pixelsSize = job.bakedFile.size - start;
+	return true;
+}
+
+/// <summary>
+/// Decodes a job's image and converts it to the size, format and mip levels of its texture array. Runs on a worker thread.
+/// </summary>
+/// <param name="job">Texture load job</param>
+/// <returns>True if the image was decoded, false otherwise</returns>
+static bool ConvertImage(TextureLoadJob& job)
+{
+	const TextureArray& textureArray = *job.textureArray;
+	if (!LoadImageLevels(job.filePath, job.swapRedBlue, textureArray.format, textureArray.width, textureArray.height, job.convertedPixels, job.levels))
+	{
+		return false;
+	}
+
+	job.pixels = job.convertedPixels.data();
+	job.pixelsSize = job.convertedPixels.size();
+	return true;
+}
+
+/// <summary>
+/// Frees the converted pixels or unmaps the baked texture of a job.
+/// </summary>
+/// <param name="job">Texture load job</param>
+static void ReleasePixels(TextureLoadJob& job)
+{
+	std::vector<unsigned char>().swap(job.convertedPixels);
+	CloseMappedFile(job.bakedFile);
+	job.pixels = nullptr;
+}
+
+/// <summary>
+/// Uploads the mip levels of one layer of a texture array. When a pixel buffer object is bound to
+/// GL_PIXEL_UNPACK_BUFFER, the pixels are read from it and the copy into texture memory can happen asynchronously.
+/// </summary>
+/// <param name="textureArray">Texture array</param>
+/// <param name="layer">Layer to upload to</param>
+/// <param name="levels">Size and position of every level</param>
+/// <param name="pixels">Pixels of every level, or nullptr to read them from the bound pixel buffer object</param>
+static void UploadLayer(const TextureArray& textureArray, int layer, const std::vector<BakedTextureLevel>& levels, const unsigned char* pixels)
+{
+	// The array normally stays bound for drawing, so put back whatever was bound before
+	GLint boundTexture;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &boundTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.texture);
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		const BakedTextureLevel& level = levels[i];
+		const void* levelPixels = pixels != nullptr ? static_cast<const void*>(pixels + level.offset) : (void*)static_cast<size_t>(level.offset);
+		if (textureArray.format == BakedRGBA8)
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), 0, 0, layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, levelPixels);
+		}
+		else
+		{
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), 0, 0, layer, level.width, level.height, 1,
+				GetInternalFormat(textureArray.format), static_cast<GLsizei>(level.size), levelPixels);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, boundTexture);
+}
+
+/// <summary>
+/// Picks the size and format of a texture array: the ones of the baked textures if all layers have a matching
+/// baked texture that the driver can sample, RGBA8 at the default layer size otherwise.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+/// <param name="textureArray">Texture array that receives the size and format</param>
+/// <param name="layerFiles">Image file of every layer</param>
+/// <param name="layerSize">Default width and height of the layers</param>
+static void ChooseTextureArrayFormat(const TextureLoader& loader, TextureArray& textureArray, const std::vector<TextureLayerFile>& layerFiles, int layerSize)
+{
+	textureArray.format = BakedRGBA8;
+	textureArray.width = layerSize;
+	textureArray.height = layerSize;
+	textureArray.levelCount = GetMipLevelCount(layerSize, layerSize);
+
+	if (!loader.useBakedTextures)
+	{
+		return;
+	}
+
+	// Only the headers are read here, so mapping the files is cheap
+	TextureArray bakedArray;
+	bool firstLayer = true;
+	for (size_t i = 0; i < layerFiles.size(); ++i)
+	{
+		// Layers without an image keep the placeholder in any format
+		if (layerFiles[i].filePath.empty())
+		{
+			continue;
+		}
+
+		MappedFile file;
+		const BakedTextureHeader* header;
+		const BakedTextureLevel* levels;
+		if (!OpenMappedFile(file, GetBakedTexturePath(layerFiles[i].filePath)))
+		{
+			return;
+		}
+
+		bool valid = ReadBakedTexture(file.data, file.size, header, levels);
+		if (valid && firstLayer)
+		{
+			firstLayer = false;
+			bakedArray.format = static_cast<BakedTextureFormat>(header->format);
+			bakedArray.width = static_cast<int>(header->width);
+			bakedArray.height = static_cast<int>(header->height);
+			bakedArray.levelCount = static_cast<int>(header->levelCount);
+		}
+		valid = valid && MatchesTextureArray(*header, bakedArray);
+		CloseMappedFile(file);
+
+		if (!valid)
+		{
+			return;
+		}
+	}
+
+	if (!firstLayer && (bakedArray.format == BakedRGBA8 || loader.supportsBlockCompression))
+	{
+		textureArray.format = bakedArray.format;
+		textureArray.width = bakedArray.width;
+		textureArray.height = bakedArray.height;
+		textureArray.levelCount = bakedArray.levelCount;
+	}
+}
+
+/// <summary>
+/// Starts the worker threads of the texture loader.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+/// <param name="threadCount">Number of decode threads (0 picks one per spare hardware thread)</param>
+void StartTextureLoader(TextureLoader& loader, unsigned int threadCount)
+{
+	// Im image-space (pixels), (0, 0) is the upper-left corner of the image
+	// However, in u-v coordinates, (0, 0) is the lower-left corner of the image
+	// This means that the image will appear upside-down when we use the image data as is
+	// This function tells stbi to flip the image vertically so that it is not upside-down when we use it.
+	// The setting is global, so it is set once before any worker starts decoding.
+	stbi_set_flip_vertically_on_load(true);
+
+	// Baked textures in BC1/BC3 are only used when the driver can sample them
+	loader.supportsBlockCompression = GLAD_GL_EXT_texture_compression_s3tc != 0;
+
+	StartThreadPool(loader.pool, threadCount);
+}
+
+/// <summary>
+/// Stops the worker threads. Textures that are still loading keep their placeholder.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+void StopTextureLoader(TextureLoader& loader)
+{
+	StopThreadPool(loader.pool);
+
+	for (std::unique_ptr<TextureLoadJob>& job : loader.jobs)
+	{
+		if (job->pixelBuffer != 0)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->pixelBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &job->pixelBuffer);
+		}
+		ReleasePixels(*job);
+	}
+	loader.jobs.clear();
+}
+
+/// <summary>
+/// Creates a texture array with one layer per image file and starts loading the images on worker threads.
+/// Every layer shows a placeholder until its real pixels replace it during a later call to UpdateTextureLoader().
+/// If every image has a baked version (see BakedTexture.h) with the same size and format, the array takes that
+/// size and format, and the baked files are mapped and uploaded as is. Otherwise the array is RGBA8 and every image
+/// is decoded and resized to the default layer size, with its mip levels built on the worker thread.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+/// <param name="textureArray">Texture array that will be created</param>
+/// <param name="layerFiles">Image file of every layer</param>
+/// <param name="layerSize">Width and height of the layers when they are not taken from baked textures</param>
+void LoadTextureArrayAsync(TextureLoader& loader, TextureArray& textureArray, const std::vector<TextureLayerFile>& layerFiles, int layerSize)
+{
+	ChooseTextureArrayFormat(loader, textureArray, layerFiles, layerSize);
+	textureArray.layerCount = static_cast<int>(layerFiles.size());
+
+	glGenTextures(1, &textureArray.texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.texture);
+
+	// Minified samples read from the smaller mip levels instead of skipping across full-resolution texels
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, textureArray.levelCount - 1);
+
+	// Set the wrapping method for the s-axis (x-axis) and t-axis (y-axis)
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	// Allocate every level of every layer, then fill each layer with a gray placeholder
+	// (one 4x4 block, repeated, so that it can be written in every format)
+	unsigned char grayBlock[16][4];
+	std::fill(&grayBlock[0][0], &grayBlock[0][0] + sizeof(grayBlock), static_cast<unsigned char>(128));
+	std::vector<unsigned char> encodedBlock;
+	if (textureArray.format == BakedBC1)
+	{
+		CompressBC1(&grayBlock[0][0], 4, 4, encodedBlock);
+	}
+	else if (textureArray.format == BakedBC3)
+	{
+		CompressBC3(&grayBlock[0][0], 4, 4, encodedBlock);
+	}
+	else
+	{
+		encodedBlock.assign(&grayBlock[0][0], &grayBlock[0][0] + 4);
+	}
+
+	std::vector<BakedTextureLevel> placeholderLevels;
+	size_t placeholderSize = 0;
+	for (int i = 0, width = textureArray.width, height = textureArray.height; i < textureArray.levelCount; ++i)
+	{
+		size_t size = GetLevelSize(textureArray.format, width, height);
+		placeholderLevels.push_back({ static_cast<uint32_t>(width), static_cast<uint32_t>(height), 0, static_cast<uint32_t>(size) });
+		placeholderSize = std::max(placeholderSize, size);
+
+		if (textureArray.format == BakedRGBA8)
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, width, height, textureArray.layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+		else
+		{
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, GetInternalFormat(textureArray.format), width, height, textureArray.layerCount, 0,
+				static_cast<GLsizei>(size * textureArray.layerCount), nullptr);
+		}
+
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// Every level reads from the start of the same buffer, which is as large as level 0
+	std::vector<unsigned char> placeholder(placeholderSize);
+	for (size_t i = 0; i < placeholder.size(); i += encodedBlock.size())
+	{
+		std::copy(encodedBlock.begin(), encodedBlock.end(), placeholder.begin() + i);
+	}
+	for (int layer = 0; layer < textureArray.layerCount; ++layer)
+	{
+		UploadLayer(textureArray, layer, placeholderLevels, placeholder.data());
+	}
+
+	for (int layer = 0; layer < textureArray.layerCount; ++layer)
+	{
+		// Untextured materials have no image, so their layer stays a placeholder that nothing samples
+		if (layerFiles[layer].filePath.empty())
+		{
+			continue;
+		}
+
+		std::unique_ptr<TextureLoadJob> job(new TextureLoadJob());
+		job->filePath = layerFiles[layer].filePath;
+		job->swapRedBlue = layerFiles[layer].swapRedBlue;
+		job->textureArray = &textureArray;
+		job->layer = layer;
+		job->state.store(TextureDecoding);
+
+		TextureLoadJob* jobPointer = job.get();
+		loader.jobs.push_back(std::move(job));
+
+		bool useBakedTexture = loader.useBakedTextures;
+		SubmitTask(loader.pool, [jobPointer, useBakedTexture]()
+		{
+			bool loaded = (useBakedTexture && MapBakedTexture(*jobPointer)) || ConvertImage(*jobPointer);
+			jobPointer->state.store(loaded ? TextureDecoded : TextureFailed, std::memory_order_release);
+		});
+	}
+}
+
+/// <summary>
+/// Deletes a texture array. Layers of it must not be loading anymore.
+/// </summary>
+/// <param name="textureArray">Texture array</param>
+void DeleteTextureArray(TextureArray& textureArray)
+{
+	glDeleteTextures(1, &textureArray.texture);
+	textureArray = TextureArray();
+}
+
+/// <summary>
+/// Moves finished decodes along: maps pixel buffer objects for them (within the per-frame budget), and uploads
+/// the ones that workers have finished copying. Call once per frame on the thread that owns the OpenGL context.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+/// <returns>Number of textures that are still loading</returns>
+size_t UpdateTextureLoader(TextureLoader& loader)
+{
+	size_t streamedBytes = 0;
+
+	for (size_t i = 0; i < loader.jobs.size();)
+	{
+		TextureLoadJob& job = *loader.jobs[i];
+		int state = job.state.load(std::memory_order_acquire);
+
+		if (state == TextureFailed)
+		{
+			std::cerr << "Failed to load image: " << job.filePath << std::endl;
+			loader.jobs.erase(loader.jobs.begin() + i);
+			continue;
+		}
+
+		if (state == TextureDecoded)
+		{
+			// Always let at least one image through per frame, even if it alone is larger than the budget
+			size_t size = job.pixelsSize;
+			if (streamedBytes == 0 || streamedBytes + size <= loader.uploadBudget)
+			{
+				streamedBytes += size;
+
+				// Map a fresh pixel buffer object and let a worker do the large copy into it
+				glGenBuffers(1, &job.pixelBuffer);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pixelBuffer);
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+				job.mappedPixels = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+				if (job.mappedPixels != nullptr)
+				{
+					job.state.store(TextureCopying);
+
+					TextureLoadJob* jobPointer = &job;
+					SubmitTask(loader.pool, [jobPointer, size]()
+					{
+						std::memcpy(jobPointer->mappedPixels, jobPointer->pixels, size);
+						ReleasePixels(*jobPointer);
+						jobPointer->state.store(TextureCopied, std::memory_order_release);
+					});
+				}
+				else
+				{
+					// Mapping failed, so upload straight from the decoded or mapped pixels instead
+					glDeleteBuffers(1, &job.pixelBuffer);
+					job.pixelBuffer = 0;
+					UploadLayer(*job.textureArray, job.layer, job.levels, job.pixels);
+					ReleasePixels(job);
+					loader.jobs.erase(loader.jobs.begin() + i);
+					continue;
+				}
+			}
+		}
+		else if (state == TextureCopied)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pixelBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			// With the pixel buffer object bound, the pixel pointer is an offset into it
+			UploadLayer(*job.textureArray, job.layer, job.levels, nullptr);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			// OpenGL keeps the buffer alive until the upload has finished reading it
+			glDeleteBuffers(1, &job.pixelBuffer);
+			loader.jobs.erase(loader.jobs.begin() + i);
+			continue;
+		}
+
+		++i;
+	}
+
+	return loader.jobs.size();
+}
+
+/// <summary>
+/// Blocks until every texture has been uploaded (or has failed to load).
+/// </summary>
+/// <param name="loader">Texture loader</param>
+void FinishTextureLoads(TextureLoader& loader)
+{
+	size_t budget = loader.uploadBudget;
+	loader.uploadBudget = static_cast<size_t>(-1);
+
+	while (UpdateTextureLoader(loader) > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	loader.uploadBudget = budget;
+}
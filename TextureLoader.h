@@ -0,0 +1,127 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BakedTexture.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+/// <summary>
+/// Struct containing a 2D array texture whose layers all have the same size, format and number of mip levels
+/// </summary>
+struct TextureArray
+{
+	GLuint texture = 0;
+	BakedTextureFormat format = BakedRGBA8;
+	int width = 0;
+	int height = 0;
+	int levelCount = 0;
+	int layerCount = 0;
+};
+
+/// <summary>
+/// Struct containing an image file that becomes one layer of a texture array
+/// </summary>
+struct TextureLayerFile
+{
+	std::string filePath;
+	bool swapRedBlue;			// Swap the red and blue channels (for images that were always uploaded as BGRA)
+};
+
+/// <summary>
+/// Steps that a layer goes through while it is being loaded
+/// </summary>
+enum TextureLoadState
+{
+	TextureDecoding,		// A worker is mapping the baked texture, or decoding, resizing and converting the image file
+	TextureDecoded,			// Pixels are in memory and wait for a pixel buffer object
+	TextureCopying,			// A worker is copying the pixels into the mapped pixel buffer object
+	TextureCopied,			// The pixel buffer object is filled and waits to be unmapped and uploaded
+	TextureFailed			// The image could not be loaded; the placeholder stays
+};
+
+/// <summary>
+/// Struct containing a layer of a texture array that is being loaded in the background
+/// </summary>
+struct TextureLoadJob
+{
+	std::string filePath;
+	bool swapRedBlue = false;
+	const TextureArray* textureArray = nullptr;
+	int layer = 0;
+
+	// Filled in by the worker: either a mapped baked texture, or an image that was converted to the array's format
+	std::vector<BakedTextureLevel> levels;		// Offsets are relative to pixels
+	const unsigned char* pixels = nullptr;		// Pixels of every level, back to back
+	size_t pixelsSize = 0;
+	std::vector<unsigned char> convertedPixels;
+	MappedFile bakedFile;
+
+	GLuint pixelBuffer = 0;					// Pixel buffer object the pixels are streamed through
+	unsigned char* mappedPixels = nullptr;	// Mapped memory of the pixel buffer object while a worker copies into it
+
+	std::atomic<int> state;
+};
+
+/// <summary>
+/// Struct containing the worker threads and the layers that are still loading
+/// </summary>
+struct TextureLoader
+{
+	ThreadPool pool;
+	std::vector<std::unique_ptr<TextureLoadJob>> jobs;
+	size_t uploadBudget = 32 * 1024 * 1024;		// Bytes of pixel data that may start streaming per frame
+	bool useBakedTextures = true;				// Load the .btex version of an image when there is one
+	bool supportsBlockCompression = false;		// Whether BC1/BC3 baked textures can be uploaded
+};
+
+/// <summary>
+/// Starts the worker threads of the texture loader.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+/// <param name="threadCount">Number of decode threads (0 picks one per spare hardware thread)</param>
+void StartTextureLoader(TextureLoader& loader, unsigned int threadCount = 0);
+
+/// <summary>
+/// Stops the worker threads. Layers that are still loading keep their placeholder.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+void StopTextureLoader(TextureLoader& loader);
+
+/// <summary>
+/// Creates a texture array with one layer per image file and starts loading the images on worker threads.
+/// Every layer shows a placeholder until its real pixels replace it during a later call to UpdateTextureLoader().
+/// If every image has a baked version (see BakedTexture.h) with the same size and format, the array takes that
+/// size and format, and the baked files are mapped and uploaded as is. Otherwise the array is RGBA8 and every image
+/// is decoded and resized to the default layer size, with its mip levels built on the worker thread.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+/// <param name="textureArray">Texture array that will be created</param>
+/// <param name="layerFiles">Image file of every layer</param>
+/// <param name="layerSize">Width and height of the layers when they are not taken from baked textures</param>
+void LoadTextureArrayAsync(TextureLoader& loader, TextureArray& textureArray, const std::vector<TextureLayerFile>& layerFiles, int layerSize);
+
+/// <summary>
+/// Deletes a texture array. Layers of it must not be loading anymore.
+/// </summary>
+/// <param name="textureArray">Texture array</param>
+void DeleteTextureArray(TextureArray& textureArray);
+
+/// <summary>
+/// Moves finished decodes along: maps pixel buffer objects for them (within the per-frame budget), and uploads
+/// the ones that workers have finished copying. Call once per frame on the thread that owns the OpenGL context.
+/// </summary>
+/// <param name="loader">Texture loader</param>
+/// <returns>Number of layers that are still loading</returns>
+size_t UpdateTextureLoader(TextureLoader& loader);
+
+/// <summary>
+/// Blocks until every layer has been uploaded (or has failed to load).
+/// </summary>
+/// <param name="loader">Texture loader</param>
+void FinishTextureLoads(TextureLoader& loader);
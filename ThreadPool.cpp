@@ -0,0 +1,97 @@
+#include "ThreadPool.h"
+
+/// <summary>
+/// Main function of a worker thread: runs tasks until the pool is stopped.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+static void RunWorker(ThreadPool& pool)
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			pool.taskAvailable.wait(lock, [&pool] { return pool.stopping || !pool.tasks.empty(); });
+			if (pool.tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(pool.tasks.front());
+			pool.tasks.pop_front();
+			pool.runningTasks++;
+		}
+
+		task();
+
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.runningTasks--;
+		if (pool.runningTasks == 0 && pool.tasks.empty())
+		{
+			pool.idle.notify_all();
+		}
+	}
+}
+
+/// <summary>
+/// Starts the worker threads of a pool.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+/// <param name="threadCount">Number of worker threads (0 picks one less than the number of hardware threads, at least one)</param>
+void StartThreadPool(ThreadPool& pool, unsigned int threadCount)
+{
+	if (threadCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	pool.stopping = false;
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		pool.workers.emplace_back(RunWorker, std::ref(pool));
+	}
+}
+
+/// <summary>
+/// Finishes the queued tasks and stops the worker threads.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+void StopThreadPool(ThreadPool& pool)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.stopping = true;
+	}
+	pool.taskAvailable.notify_all();
+
+	for (std::thread& worker : pool.workers)
+	{
+		worker.join();
+	}
+	pool.workers.clear();
+}
+
+/// <summary>
+/// Adds a task to the queue. It will run on one of the worker threads.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+/// <param name="task">Task to run</param>
+void SubmitTask(ThreadPool& pool, std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.tasks.push_back(std::move(task));
+	}
+	pool.taskAvailable.notify_one();
+}
+
+/// <summary>
+/// Blocks until the queue is empty and no task is running.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+void WaitForTasks(ThreadPool& pool)
+{
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.idle.wait(lock, [&pool] { return pool.tasks.empty() && pool.runningTasks == 0; });
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Struct containing a fixed set of worker threads that run tasks from a shared queue
+/// </summary>
+struct ThreadPool
+{
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable idle;
+	int runningTasks = 0;
+	bool stopping = false;
+};
+
+/// <summary>
+/// Starts the worker threads of a pool.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+/// <param name="threadCount">Number of worker threads (0 picks one less than the number of hardware threads, at least one)</param>
+void StartThreadPool(ThreadPool& pool, unsigned int threadCount = 0);
+
+/// <summary>
+/// Finishes the queued tasks and stops the worker threads.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+void StopThreadPool(ThreadPool& pool);
+
+/// <summary>
+/// Adds a task to the queue. It will run on one of the worker threads.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+/// <param name="task">Task to run</param>
+void SubmitTask(ThreadPool& pool, std::function<void()> task);
+
+/// <summary>
+/// Blocks until the queue is empty and no task is running.
+/// </summary>
+/// <param name="pool">Thread pool</param>
+void WaitForTasks(ThreadPool& pool);
@@ -0,0 +1,175 @@
+#include "Transforms.h"
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORMS_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+/// <summary>
+/// Number of matrices that one thread pool task multiplies
+/// </summary>
+static const size_t TransformTaskSize = 2048;
+
+/// <summary>
+/// Copies the transforms of the scene objects into the store and computes their model matrices at time 0.
+/// </summary>
+/// <param name="store">Transform store that will be filled in</param>
+/// <param name="scene">Scene objects</param>
+void CreateTransformStore(TransformStore& store, const std::vector<SceneObject>& scene)
+{
+	size_t count = scene.size();
+	store.positions.resize(count);
+	store.scales.resize(count);
+	store.rotationAxes.resize(count);
+	store.rotationSpeeds.resize(count);
+	store.modelMatrices.resize(count);
+	store.dirty.assign(count, 0);
+	store.dirtyObjects.clear();
+	store.dynamicObjects.clear();
+	store.updatedObjects.clear();
+	store.time = 0.0f;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		store.positions[i] = scene[i].position;
+		store.scales[i] = scene[i].scale;
+		store.rotationAxes[i] = scene[i].rotationAxis;
+		store.rotationSpeeds[i] = scene[i].rotationSpeed;
+		store.modelMatrices[i] = ComputeModelMatrix(store.positions[i], store.scales[i], store.rotationAxes[i], store.rotationSpeeds[i], 0.0f);
+		if (IsDynamic(scene[i]))
+		{
+			store.dynamicObjects.push_back(i);
+		}
+	}
+}
+
+/// <summary>
+/// Marks the model matrix of an object as out of date.
+/// </summary>
+/// <param name="store">Transform store</param>
+/// <param name="object">Index of the object</param>
+void MarkTransformDirty(TransformStore& store, uint32_t object)
+{
+	if (store.dirty[object] == 0)
+	{
+		store.dirty[object] = 1;
+		store.dirtyObjects.push_back(object);
+	}
+}
+
+/// <summary>
+/// Moves the animation to the given time, which marks the animated objects dirty.
+/// </summary>
+/// <param name="store">Transform store</param>
+/// <param name="time">Animation time</param>
+void SetTransformTime(TransformStore& store, float time)
+{
+	if (time == store.time)
+	{
+		return;
+	}
+
+	store.time = time;
+	for (uint32_t object : store.dynamicObjects)
+	{
+		MarkTransformDirty(store, object);
+	}
+}
+
+/// <summary>
+/// Recomputes the model matrices of the dirty objects and lists them in updatedObjects.
+/// </summary>
+/// <param name="store">Transform store</param>
+void UpdateTransforms(TransformStore& store)
+{
+	for (uint32_t object : store.dirtyObjects)
+	{
+		store.modelMatrices[object] = ComputeModelMatrix(store.positions[object], store.scales[object],
+			store.rotationAxes[object], store.rotationSpeeds[object], store.time);
+		store.dirty[object] = 0;
+	}
+
+	store.updatedObjects.swap(store.dirtyObjects);
+	store.dirtyObjects.clear();
+}
+
+/// <summary>
+/// Multiplies the view-projection matrix with the model matrices of a range of objects.
+/// </summary>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="modelMatrices">Model matrices of every object</param>
+/// <param name="objects">Indices of the objects in the range</param>
+/// <param name="count">Number of objects in the range</param>
+/// <param name="results">Receives one matrix per object in the range</param>
+void MultiplyTransformRange(const glm::mat4& viewProjection, const glm::mat4* modelMatrices, const uint32_t* objects, size_t count, glm::mat4* results)
+{
+#if defined(TRANSFORMS_USE_SSE)
+	// Column c of the product is the sum of the view-projection columns, weighted by the entries of
+	// model column c. The view-projection columns stay in registers for the whole range
+	__m128 columns[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		columns[i] = _mm_loadu_ps(&viewProjection[i][0]);
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float* model = &modelMatrices[objects[i]][0][0];
+		float* result = &results[i][0][0];
+		for (int c = 0; c < 4; ++c)
+		{
+			__m128 column = _mm_mul_ps(columns[0], _mm_set1_ps(model[c * 4 + 0]));
+			column = _mm_add_ps(column, _mm_mul_ps(columns[1], _mm_set1_ps(model[c * 4 + 1])));
+			column = _mm_add_ps(column, _mm_mul_ps(columns[2], _mm_set1_ps(model[c * 4 + 2])));
+			column = _mm_add_ps(column, _mm_mul_ps(columns[3], _mm_set1_ps(model[c * 4 + 3])));
+			_mm_storeu_ps(result + c * 4, column);
+		}
+	}
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		results[i] = viewProjection * modelMatrices[objects[i]];
+	}
+#endif
+}
+
+/// <summary>
+/// Multiplies the view-projection matrix with the cached model matrices of the given objects. Uses SSE where
+/// available, and splits the work into tasks on the thread pool when there is one and the list is long.
+/// </summary>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="store">Transform store</param>
+/// <param name="objects">Indices of the objects</param>
+/// <param name="results">Receives one matrix per object, in the same order</param>
+/// <param name="pool">Thread pool to spread the work over, or nullptr to do it on the calling thread</param>
+void MultiplyTransforms(const glm::mat4& viewProjection, const TransformStore& store, const std::vector<uint32_t>& objects,
+	std::vector<glm::mat4>& results, ThreadPool* pool)
+{
+	results.resize(objects.size());
+	if (objects.empty())
+	{
+		return;
+	}
+
+	if (pool == nullptr || objects.size() < 2 * TransformTaskSize)
+	{
+		MultiplyTransformRange(viewProjection, store.modelMatrices.data(), objects.data(), objects.size(), results.data());
+		return;
+	}
+
+	// Every task writes its own part of the results, so the tasks need no locking
+	for (size_t first = 0; first < objects.size(); first += TransformTaskSize)
+	{
+		size_t count = std::min(TransformTaskSize, objects.size() - first);
+		const glm::mat4* modelMatrices = store.modelMatrices.data();
+		const uint32_t* range = objects.data() + first;
+		glm::mat4* rangeResults = results.data() + first;
+		SubmitTask(*pool, [&viewProjection, modelMatrices, range, count, rangeResults]()
+		{
+			MultiplyTransformRange(viewProjection, modelMatrices, range, count, rangeResults);
+		});
+	}
+	WaitForTasks(*pool);
+}
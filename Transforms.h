@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "ThreadPool.h"
+
+/// <summary>
+/// Struct containing the transforms of every scene object in structure-of-arrays form, together with the
+/// cached model matrices. Only objects that are marked dirty get their model matrix recomputed.
+/// </summary>
+struct TransformStore
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::vec3> rotationAxes;
+	std::vector<float> rotationSpeeds;		// Degrees per unit of time, 0 for static objects
+
+	std::vector<glm::mat4> modelMatrices;	// Cached model matrix of every object
+	std::vector<uint8_t> dirty;				// Non-zero for objects whose cached matrix is out of date
+	std::vector<uint32_t> dirtyObjects;		// Objects with their dirty flag set, in the order they were marked
+	std::vector<uint32_t> dynamicObjects;	// Objects whose model matrix changes over time
+	std::vector<uint32_t> updatedObjects;	// Objects whose model matrix changed in the last UpdateTransforms()
+	float time = 0.0f;						// Animation time of the cached matrices
+};
+
+/// <summary>
+/// Copies the transforms of the scene objects into the store and computes their model matrices at time 0.
+/// </summary>
+/// <param name="store">Transform store that will be filled in</param>
+/// <param name="scene">Scene objects</param>
+void CreateTransformStore(TransformStore& store, const std::vector<SceneObject>& scene);
+
+/// <summary>
+/// Marks the model matrix of an object as out of date.
+/// </summary>
+/// <param name="store">Transform store</param>
+/// <param name="object">Index of the object</param>
+void MarkTransformDirty(TransformStore& store, uint32_t object);
+
+/// <summary>
+/// Moves the animation to the given time, which marks the animated objects dirty.
+/// </summary>
+/// <param name="store">Transform store</param>
+/// <param name="time">Animation time</param>
+void SetTransformTime(TransformStore& store, float time);
+
+/// <summary>
+/// Recomputes the model matrices of the dirty objects and lists them in updatedObjects.
+/// </summary>
+/// <param name="store">Transform store</param>
+void UpdateTransforms(TransformStore& store);
+
+/// <summary>
+/// Multiplies the view-projection matrix with the model matrices of a range of objects.
+/// </summary>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="modelMatrices">Model matrices of every object</param>
+/// <param name="objects">Indices of the objects in the range</param>
+/// <param name="count">Number of objects in the range</param>
+/// <param name="results">Receives one matrix per object in the range</param>
+void MultiplyTransformRange(const glm::mat4& viewProjection, const glm::mat4* modelMatrices, const uint32_t* objects, size_t count, glm::mat4* results);
+
+/// <summary>
+/// Multiplies the view-projection matrix with the cached model matrices of the given objects. Uses SSE where
+/// available, and splits the work into tasks on the thread pool when there is one and the list is long.
+/// </summary>
+/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+/// <param name="store">Transform store</param>
+/// <param name="objects">Indices of the objects</param>
+/// <param name="results">Receives one matrix per object, in the same order</param>
+/// <param name="pool">Thread pool to spread the work over, or nullptr to do it on the calling thread</param>
+void MultiplyTransforms(const glm::mat4& viewProjection, const TransformStore& store, const std::vector<uint32_t>& objects,
+	std::vector<glm::mat4>& results, ThreadPool* pool);
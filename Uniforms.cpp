@@ -0,0 +1,269 @@
+#include "Uniforms.h"
+
+#include <cstring>
+
+/// <summary>
+/// Names of the loose uniforms, in the same order as the UniformName enum
+/// </summary>
+static const char* const UniformNames[UniformNameCount] = {
+	"materials",
+	"instances",
+	"clusterLights",
+	"clusterRanges",
+	"clusterIndices",
+	"staticShadowMap",
+	"dynamicShadowMap",
+	"shadowCasters",
+	"firstCaster",
+	"faceViewProjection",
+	"casterLight",
+	"boxViewProjection"
+};
+
+/// <summary>
+/// Texture units of the sampler uniforms, in the same order as the UniformName enum (-1 for uniforms that are not samplers)
+/// </summary>
+static const GLint SamplerUnits[UniformNameCount] = {
+	MaterialsTextureUnit,
+	InstancesTextureUnit,
+	ClusterLightsTextureUnit,
+	ClusterRangesTextureUnit,
+	ClusterIndicesTextureUnit,
+	StaticShadowTextureUnit,
+	DynamicShadowTextureUnit,
+	ShadowCastersTextureUnit,
+	-1,
+	-1,
+	-1,
+	-1
+};
+
+/// <summary>
+/// Looks up the locations of all known uniforms of a program, connects its uniform blocks
+/// to the shared binding points and its samplers to their texture units. Call once after the program is linked.
+/// </summary>
+/// <param name="uniforms">Struct that receives the program and its locations</param>
+/// <param name="program">Linked shader program</param>
+void ResolveProgramUniforms(ProgramUniforms& uniforms, GLuint program)
+{
+	uniforms.program = program;
+	for (int i = 0; i < UniformNameCount; ++i)
+	{
+		uniforms.locations[i] = glGetUniformLocation(program, UniformNames[i]);
+	}
+
+	// GLSL 3.30 cannot set block bindings in the shader, so connect them here
+	GLuint frameBlock = glGetUniformBlockIndex(program, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(program, frameBlock, FrameDataBinding);
+	}
+
+	GLuint objectBlock = glGetUniformBlockIndex(program, "ObjectData");
+	if (objectBlock != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(program, objectBlock, ObjectDataBinding);
+	}
+
+	// Point the samplers at their texture units, putting back the program that was in use
+	GLint currentProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+	glUseProgram(program);
+	for (int i = 0; i < UniformNameCount; ++i)
+	{
+		if (SamplerUnits[i] != -1 && uniforms.locations[i] != -1)
+		{
+			glUniform1i(uniforms.locations[i], SamplerUnits[i]);
+		}
+	}
+	glUseProgram(currentProgram);
+}
+
+/// <summary>
+/// Creates the uniform buffer that holds the FrameData block and binds it to its binding point.
+/// </summary>
+/// <returns>OpenGL handle to the buffer</returns>
+GLuint CreateFrameUniformBuffer()
+{
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameDataBinding, buffer);
+	return buffer;
+}
+
+/// <summary>
+/// Uploads the per-frame data.
+/// </summary>
+/// <param name="buffer">Buffer created by CreateFrameUniformBuffer()</param>
+/// <param name="frame">Per-frame data</param>
+void UpdateFrameUniformBuffer(GLuint buffer, const FrameUniforms& frame)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/// <summary>
+/// Creates the per-object uniform ring.
+/// </summary>
+/// <param name="ring">Ring that will be created</param>
+/// <param name="segmentSize">Initial number of bytes per frame</param>
+void CreateUniformRing(UniformRing& ring, GLsizeiptr segmentSize)
+{
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring.alignment);
+	ring.segmentSize = GetUniformRingStride(ring, segmentSize);
+
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+	glBufferData(GL_UNIFORM_BUFFER, ring.segmentSize * UniformRingFrames, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/// <summary>
+/// Deletes the uniform ring and its fences.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+void DeleteUniformRing(UniformRing& ring)
+{
+	UnmapUniformRing(ring);
+	for (int i = 0; i < UniformRingFrames; ++i)
+	{
+		if (ring.fences[i] != nullptr)
+		{
+			glDeleteSync(ring.fences[i]);
+		}
+	}
+	glDeleteBuffers(1, &ring.buffer);
+	ring = UniformRing();
+}
+
+/// <summary>
+/// Gets the number of bytes that one allocation of the given size takes up in the ring.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="size">Size of the allocation</param>
+/// <returns>Size rounded up to the uniform buffer offset alignment</returns>
+GLsizeiptr GetUniformRingStride(const UniformRing& ring, GLsizeiptr size)
+{
+	return (size + ring.alignment - 1) / ring.alignment * ring.alignment;
+}
+
+/// <summary>
+/// Starts writing the next segment: waits until the GPU has finished reading it, grows the ring
+/// if the frame needs more space than a segment has, and maps the segment.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="requiredSize">Number of bytes the frame will allocate</param>
+void BeginUniformRingFrame(UniformRing& ring, GLsizeiptr requiredSize)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+
+	if (requiredSize > ring.segmentSize)
+	{
+		// Reallocating orphans the old storage, so frames still in flight keep reading their data
+		// and the old fences no longer guard anything
+		for (int i = 0; i < UniformRingFrames; ++i)
+		{
+			if (ring.fences[i] != nullptr)
+			{
+				glDeleteSync(ring.fences[i]);
+				ring.fences[i] = nullptr;
+			}
+		}
+
+		ring.segmentSize = GetUniformRingStride(ring, requiredSize + requiredSize / 2);
+		ring.segment = 0;
+		glBufferData(GL_UNIFORM_BUFFER, ring.segmentSize * UniformRingFrames, nullptr, GL_STREAM_DRAW);
+	}
+
+	// The GPU normally finished this segment long ago; only wait if it is more than two frames behind
+	GLsync& fence = ring.fences[ring.segment];
+	if (fence != nullptr)
+	{
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	// The fence guarantees the segment is idle, so the driver does not need to synchronize the mapping
+	ring.head = 0;
+	ring.mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, ring.segment * ring.segmentSize, ring.segmentSize,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/// <summary>
+/// Copies data into the current segment.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="data">Data to copy</param>
+/// <param name="size">Size of the data</param>
+/// <returns>Offset of the data in the buffer (for glBindBufferRange), or -1 if the segment is full</returns>
+GLintptr WriteUniformRing(UniformRing& ring, const void* data, GLsizeiptr size)
+{
+	GLsizeiptr stride = GetUniformRingStride(ring, size);
+	if (ring.mapped == nullptr || ring.head + stride > ring.segmentSize)
+	{
+		return -1;
+	}
+
+	std::memcpy(ring.mapped + ring.head, data, size);
+	GLintptr offset = ring.segment * ring.segmentSize + ring.head;
+	ring.head += stride;
+	return offset;
+}
+
+/// <summary>
+/// Takes a block of the current segment that the caller fills in itself, possibly from other threads, until the
+/// segment is unmapped.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="size">Size of the block</param>
+/// <param name="offset">Receives the offset of the block in the buffer (for glBindBufferRange), or -1 if the segment is full</param>
+/// <returns>Mapped memory of the block, or nullptr if the segment is full</returns>
+unsigned char* ReserveUniformRing(UniformRing& ring, GLsizeiptr size, GLintptr& offset)
+{
+	GLsizeiptr stride = GetUniformRingStride(ring, size);
+	if (ring.mapped == nullptr || ring.head + stride > ring.segmentSize)
+	{
+		offset = -1;
+		return nullptr;
+	}
+
+	unsigned char* block = ring.mapped + ring.head;
+	offset = ring.segment * ring.segmentSize + ring.head;
+	ring.head += stride;
+	return block;
+}
+
+/// <summary>
+/// Unmaps the current segment. Must be called before any draw call reads from it.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+void UnmapUniformRing(UniformRing& ring)
+{
+	if (ring.mapped == nullptr)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	ring.mapped = nullptr;
+}
+
+/// <summary>
+/// Marks the end of the frame's draw calls: fences the current segment and moves on to the next one.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+void EndUniformRingFrame(UniformRing& ring)
+{
+	ring.fences[ring.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring.segment = (ring.segment + 1) % UniformRingFrames;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Binding points of the uniform blocks that are shared by the shader programs
+/// </summary>
+enum UniformBlockBinding
+{
+	FrameDataBinding = 0,		// FrameData block: camera and light, uploaded once per frame
+	ObjectDataBinding = 1		// ObjectData block: per-object matrices, streamed through a ring buffer
+};
+
+/// <summary>
+/// Texture units that the samplers of every program read from
+/// </summary>
+enum TextureUnit
+{
+	MaterialsTextureUnit = 0,		// Material texture array
+	InstancesTextureUnit = 1,		// Buffer texture with the instance data of every scene object
+	ClusterLightsTextureUnit = 2,	// Buffer texture with the view-space position, radius and color of every point light
+	ClusterRangesTextureUnit = 3,	// Buffer texture with the light list offset and length of every cluster
+	ClusterIndicesTextureUnit = 4,	// Buffer texture with the light lists of all clusters
+	StaticShadowTextureUnit = 5,	// Cube shadow map of the static objects
+	DynamicShadowTextureUnit = 6,	// Cube shadow map of the animated objects
+	ShadowCastersTextureUnit = 7	// Buffer texture with the objects that shadow.vsh draws
+};
+
+/// <summary>
+/// Loose (non-block) uniforms whose locations are resolved once per program
+/// </summary>
+enum UniformName
+{
+	UniformMaterials,	// Material texture array sampler of main.fsh
+	UniformInstances,	// Instance data sampler of main.vsh with INSTANCED
+	UniformClusterLights,	// Point light sampler of main.fsh
+	UniformClusterRanges,	// Cluster light list sampler of main.fsh
+	UniformClusterIndices,	// Light index sampler of main.fsh
+	UniformStaticShadowMap,		// Static shadow map sampler of main.fsh
+	UniformDynamicShadowMap,	// Dynamic shadow map sampler of main.fsh
+	UniformShadowCasters,		// Caster list sampler of shadow.vsh
+	UniformFirstCaster,			// First entry of the caster list that shadow.vsh draws
+	UniformFaceViewProjection,	// View-projection matrix of the cube face that shadow.vsh draws into
+	UniformCasterLight,			// Light position and shadow distance of shadow.fsh
+	UniformBoxViewProjection,	// Bounding box matrix times view-projection matrix of occlusion.vsh
+	UniformNameCount
+};
+
+/// <summary>
+/// Struct containing a shader program and the locations of its uniforms
+/// </summary>
+struct ProgramUniforms
+{
+	GLuint program = 0;
+	GLint locations[UniformNameCount];		// -1 for uniforms the program does not have
+};
+
+/// <summary>
+/// Layout of the FrameData uniform block (std140), see main.vsh
+/// </summary>
+struct FrameUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 lightPos;			// xyz used
+	glm::vec4 lightColor;		// xyz used
+	GLfloat ambientStrength;
+	GLfloat padding[3];			// std140 starts the next matrix on a 16-byte boundary
+	glm::mat4 inverseProjection;	// Turns window coordinates back into view space for the clustered lights
+	glm::vec4 clusterScale;		// Framebuffer width and height, depth slice scale and bias (see LightClusters)
+	glm::uvec4 clusterGrid;		// Number of clusters along x, y and z, and number of point lights
+	glm::mat4 inverseView;		// Turns view space back into world space for the shadow lookups
+	glm::vec4 shadowLight;		// Position of the shadow-casting light and the distance its shadow map covers
+	glm::uvec4 shadowParameters;	// Whether there are shadows, and whether the dynamic shadow map has any casters
+};
+
+/// <summary>
+/// Layout of the ObjectData uniform block (std140), see main.vsh
+/// </summary>
+struct ObjectUniforms
+{
+	glm::mat4 transformationMatrix;
+	glm::mat4 model;
+	GLuint material;			// Layer of the material texture array
+	GLuint padding[3];
+};
+
+/// <summary>
+/// Maximum number of frames that the GPU may still be reading from the uniform ring
+/// </summary>
+const int UniformRingFrames = 3;
+
+/// <summary>
+/// Struct containing a uniform buffer that is split into one segment per frame in flight. Each frame writes
+/// its per-object data into the next segment and binds sub-ranges of it with glBindBufferRange().
+/// A fence per segment makes sure the GPU is done with a segment before it is overwritten.
+/// </summary>
+struct UniformRing
+{
+	GLuint buffer = 0;
+	GLsizeiptr segmentSize = 0;			// Bytes per segment
+	GLint alignment = 256;				// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	int segment = 0;					// Segment written by the current frame
+	GLsizeiptr head = 0;				// Next free byte in the current segment
+	unsigned char* mapped = nullptr;	// Start of the current segment while it is mapped
+	GLsync fences[UniformRingFrames] = {};
+};
+
+/// <summary>
+/// Looks up the locations of all known uniforms of a program, connects its uniform blocks
+/// to the shared binding points and its samplers to their texture units. Call once after the program is linked.
+/// </summary>
+/// <param name="uniforms">Struct that receives the program and its locations</param>
+/// <param name="program">Linked shader program</param>
+void ResolveProgramUniforms(ProgramUniforms& uniforms, GLuint program);
+
+/// <summary>
+/// Creates the uniform buffer that holds the FrameData block and binds it to its binding point.
+/// </summary>
+/// <returns>OpenGL handle to the buffer</returns>
+GLuint CreateFrameUniformBuffer();
+
+/// <summary>
+/// Uploads the per-frame data.
+/// </summary>
+/// <param name="buffer">Buffer created by CreateFrameUniformBuffer()</param>
+/// <param name="frame">Per-frame data</param>
+void UpdateFrameUniformBuffer(GLuint buffer, const FrameUniforms& frame);
+
+/// <summary>
+/// Creates the per-object uniform ring.
+/// </summary>
+/// <param name="ring">Ring that will be created</param>
+/// <param name="segmentSize">Initial number of bytes per frame</param>
+void CreateUniformRing(UniformRing& ring, GLsizeiptr segmentSize);
+
+/// <summary>
+/// Deletes the uniform ring and its fences.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+void DeleteUniformRing(UniformRing& ring);
+
+/// <summary>
+/// Gets the number of bytes that one allocation of the given size takes up in the ring.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="size">Size of the allocation</param>
+/// <returns>Size rounded up to the uniform buffer offset alignment</returns>
+GLsizeiptr GetUniformRingStride(const UniformRing& ring, GLsizeiptr size);
+
+/// <summary>
+/// Starts writing the next segment: waits until the GPU has finished reading it, grows the ring
+/// if the frame needs more space than a segment has, and maps the segment.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="requiredSize">Number of bytes the frame will allocate</param>
+void BeginUniformRingFrame(UniformRing& ring, GLsizeiptr requiredSize);
+
+/// <summary>
+/// Copies data into the current segment.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="data">Data to copy</param>
+/// <param name="size">Size of the data</param>
+/// <returns>Offset of the data in the buffer (for glBindBufferRange), or -1 if the segment is full</returns>
+GLintptr WriteUniformRing(UniformRing& ring, const void* data, GLsizeiptr size);
+
+/// <summary>
+/// Takes a block of the current segment that the caller fills in itself, possibly from other threads, until the
+/// segment is unmapped.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+/// <param name="size">Size of the block</param>
+/// <param name="offset">Receives the offset of the block in the buffer (for glBindBufferRange), or -1 if the segment is full</param>
+/// <returns>Mapped memory of the block, or nullptr if the segment is full</returns>
+unsigned char* ReserveUniformRing(UniformRing& ring, GLsizeiptr size, GLintptr& offset);
+
+/// <summary>
+/// Unmaps the current segment. Must be called before any draw call reads from it.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+void UnmapUniformRing(UniformRing& ring);
+
+/// <summary>
+/// Marks the end of the frame's draw calls: fences the current segment and moves on to the next one.
+/// </summary>
+/// <param name="ring">Uniform ring</param>
+void EndUniformRingFrame(UniformRing& ring);